@@ -222,6 +222,10 @@ def align_for_log(log_path: Path, img_df_all: pd.DataFrame):
         log_df[log_timestamp_col],
         format=log_ts_format,
     )
+    # Add the millisecond offset, if logged, so that each image of a
+    # burst has its own row time.
+    if "Milliseconds" in log_df.columns:
+        log_df[log_timestamp_col] += pd.to_timedelta(log_df["Milliseconds"], unit="ms")
     log_df = log_df.sort_values(log_timestamp_col).reset_index(drop=True)
 
     print(f"Log rows: {len(log_df)}")
@@ -286,8 +290,15 @@ def align_for_log(log_path: Path, img_df_all: pd.DataFrame):
     log_columns = [
         log_timestamp_col,
         "Milliseconds",
+        "Frame_Micros",
+        "Burst_Image",
+        "Shutter_Press",
+        "Frame_Lateness",
+        "Skipped_Frames",
         "Pressure",
         "Depth",
+        "Descent_Rate",
+        "Frame_Interval",
         "Water_Temperature",
         "Device_Temperature",
         "Acceleration_X",
@@ -339,9 +350,16 @@ def align_for_log(log_path: Path, img_df_all: pd.DataFrame):
     print(f"Unmatched:               {n_images - n_matched}")
 
 
+def log_number(log_path: Path):
+    # Sort logs by number, so data_100.csv follows data_99.csv whether or
+    # not the names are zero-padded.
+    m = re.search(r"(\d+)$", log_path.stem)
+    return (int(m.group(1)) if m else -1, log_path.name)
+
+
 def main():
     # Discover all data_*.csv logs in the logs_dir
-    log_files = sorted(logs_dir.glob("data_*.csv"))
+    log_files = sorted(logs_dir.glob("data_*.csv"), key=log_number)
 
     if not log_files:
         print(f"No data_*.csv files found in {logs_dir}")
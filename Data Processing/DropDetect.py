@@ -86,7 +86,14 @@ df[timestamp_col] = pd.to_datetime(
     format=ts_format,
 )
 
-df = df.sort_values(timestamp_col).reset_index(drop=True)
+# Keep each row's place in the log, which is how the logger's drop index
+# numbers rows, from 0. Several rows can share a whole-second timestamp,
+# so sort on the milliseconds too, and keep ties in log order.
+df["Log_Row"] = df.index
+sort_cols = [timestamp_col]
+if "Milliseconds" in df.columns:
+    sort_cols.append("Milliseconds")
+df = df.sort_values(sort_cols, kind="mergesort").reset_index(drop=True)
 
 # -------------------------------------------------------------------
 # Optional smoothing of Depth to suppress jitter
@@ -107,40 +114,104 @@ else:
 df["Depth_smooth"] = depth_smooth
 
 # -------------------------------------------------------------------
-# Detect drops as contiguous segments where depth >= min_drop_depth
+# Use the logger's drop index, if any
 # -------------------------------------------------------------------
 
+# The logger writes drop_NN.csv next to data_NN.csv, listing each drop's
+# first and last rows. Its first line gives the logger's detector
+# settings, which are compiled in. The logger's median window counts
+# snap-and-logs, which is rows only with one image per burst. Use the
+# index only when it would find the same drops as the detection below.
 min_depth = float(dd_cfg.get("min_drop_depth_m", 5.0))
 min_duration_s = float(dd_cfg.get("min_drop_duration_s", 20.0))
+hysteresis_m = float(dd_cfg.get("drop_hysteresis_m", 0.0))
+
+use_drop_index = bool(dd_cfg.get("use_drop_index", False))
+drop_index_path = None
+if use_drop_index and data_path.name.lower().startswith("data_"):
+    for prefix in ("drop_", "DROP_"):
+        candidate = data_path.with_name(prefix + data_path.name[len("data_"):])
+        if candidate.exists():
+            drop_index_path = candidate
+            break
 
-is_deep = df["Depth_smooth"] >= min_depth
+if drop_index_path is not None:
+    with open(drop_index_path, "r") as f:
+        first_line = f.readline()
+    index_params = {
+        k: float(v) for k, v in re.findall(r"(\w+)=([-\d.]+)", first_line)
+    }
+    single_rows = ("Burst_Image" not in df.columns
+                   or df["Burst_Image"].max() == 0)
+    matches = (
+        first_line.startswith("#")
+        and single_rows
+        and index_params.get("median_window") == rolling_window
+        and index_params.get("start_depth") == min_depth
+        and index_params.get("hysteresis") == hysteresis_m
+        and index_params.get("minimum_duration") == min_duration_s
+    )
+    if not matches:
+        print(f"Not using drop index {drop_index_path}: its settings "
+              f"({first_line.strip()}) differ from the config, or the log "
+              "has bursts")
+        drop_index_path = None
+
+# -------------------------------------------------------------------
+# Detect drops as contiguous segments where depth >= min_drop_depth
+# -------------------------------------------------------------------
+
+# A drop starts when the smoothed depth reaches min_depth, and ends when
+# it comes back above min_depth - hysteresis, as in the logger.
+in_drop = False
+deep_flags = []
+for d in df["Depth_smooth"]:
+    in_drop = d >= (min_depth - hysteresis_m if in_drop else min_depth)
+    deep_flags.append(in_drop)
+is_deep = pd.Series(deep_flags, index=df.index)
 
 # Label contiguous runs
 drop_ids = (is_deep != is_deep.shift(fill_value=False)).cumsum()
 
 drops = []
-for gid, group in df[is_deep].groupby(drop_ids[is_deep]):
-    t_start = group[timestamp_col].iloc[0]
-    t_end = group[timestamp_col].iloc[-1]
-    duration_s = (t_end - t_start).total_seconds()
-
-    if duration_s < min_duration_s:
-        # too short to be a real drop
-        continue
-
-    start_idx = group.index[0]
-    end_idx = group.index[-1]
-    max_depth = group[depth_col].max()
-
-    drops.append({
-        "drop_id": len(drops) + 1,  # 1-based index
-        "start_time": t_start,
-        "end_time": t_end,
-        "duration_s": duration_s,
-        "start_idx": start_idx,
-        "end_idx": end_idx,
-        "max_depth_m": max_depth,
-    })
+if drop_index_path is not None:
+    print(f"Using drop index: {drop_index_path}")
+    drop_index = pd.read_csv(drop_index_path, comment="#")
+    # Map the logger's row numbers to rows here.
+    row_labels = pd.Series(df.index, index=df["Log_Row"])
+    for _, row in drop_index.iterrows():
+        drops.append({
+            "drop_id": int(row["Drop"]),
+            "start_time": pd.to_datetime(row["Start_Time"], format=ts_format),
+            "end_time": pd.to_datetime(row["End_Time"], format=ts_format),
+            "duration_s": float(row["Duration"]),
+            "start_idx": int(row_labels[int(row["Start_Row"])]),
+            "end_idx": int(row_labels[int(row["End_Row"])]),
+            "max_depth_m": float(row["Max_Depth"]),
+        })
+else:
+    for gid, group in df[is_deep].groupby(drop_ids[is_deep]):
+        t_start = group[timestamp_col].iloc[0]
+        t_end = group[timestamp_col].iloc[-1]
+        duration_s = (t_end - t_start).total_seconds()
+
+        if duration_s < min_duration_s:
+            # too short to be a real drop
+            continue
+
+        start_idx = group.index[0]
+        end_idx = group.index[-1]
+        max_depth = group[depth_col].max()
+
+        drops.append({
+            "drop_id": len(drops) + 1,  # 1-based index
+            "start_time": t_start,
+            "end_time": t_end,
+            "duration_s": duration_s,
+            "start_idx": start_idx,
+            "end_idx": end_idx,
+            "max_depth_m": max_depth,
+        })
 
 drops_df = pd.DataFrame(drops)
 
@@ -15,3 +15,16 @@ uint8_t Battery::currentMuxDevice = 255;
 
 bool Battery::mainInitialized = false;
 bool Battery::controllerInitialized = false;
+
+float Battery::sampledControllerVoltage = 0.0;
+float Battery::sampledControllerPercent = 0.0;
+float Battery::sampledMainVoltage = 0.0;
+float Battery::sampledMainPercent = 0.0;
+uint32_t Battery::sampleTime = 0;
+
+bool Battery::rateStarted = false;
+float Battery::rateStartControllerPercent = 0.0;
+float Battery::rateStartMainPercent = 0.0;
+uint32_t Battery::rateStartTime = 0;
+float Battery::controllerDischargeRate = 0.0;
+float Battery::mainDischargeRate = 0.0;
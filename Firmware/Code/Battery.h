@@ -101,6 +101,24 @@ private:
     static bool mainInitialized;
     static bool controllerInitialized;
 
+    // The most recent battery sample, and when it was taken, in ms since
+    // boot.
+    static float sampledControllerVoltage;
+    static float sampledControllerPercent;
+    static float sampledMainVoltage;
+    static float sampledMainPercent;
+    static uint32_t sampleTime;
+
+    // Discharge rate measurement. The charge percents when it started,
+    // and when, in ms since boot, and the rates measured since, in percent
+    // per hour, or 0 until measured.
+    static bool rateStarted;
+    static float rateStartControllerPercent;
+    static float rateStartMainPercent;
+    static uint32_t rateStartTime;
+    static float controllerDischargeRate;
+    static float mainDischargeRate;
+
 
 //----------------------------------------------------------------------
 // Initialization.
@@ -204,6 +222,9 @@ public:
         mainInitialized = false;
 #endif
 
+        // Take the first sample.
+        sample( );
+
         return mainInitialized && controllerInitialized;
     }
 
@@ -486,4 +507,166 @@ public:
         return 0.0;
 #endif
     }
+
+
+
+//----------------------------------------------------------------------
+// Sampling.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Samples the battery voltages and percents.
+     *
+     * Each monitor is read in turn, so the mux is switched at most twice.
+     * The values are saved for the getSampled*() methods.
+     *
+     * @see update()
+     */
+    static inline void sample( )
+    {
+        sampledControllerVoltage = getControllerVoltage( );
+        sampledControllerPercent = getControllerPercent( );
+        sampledMainVoltage       = getMainVoltage( );
+        sampledMainPercent       = getMainPercent( );
+        sampleTime = millis( );
+
+        // Measure the discharge rates once enough time has passed for
+        // the percents to change by several steps.
+        const uint32_t elapsed = sampleTime - rateStartTime;
+        if ( rateStarted && elapsed >= BATTERY_RATE_TIME )
+        {
+            const float hours = elapsed / 3600000.0;
+            controllerDischargeRate =
+                (rateStartControllerPercent - sampledControllerPercent) / hours;
+            mainDischargeRate =
+                (rateStartMainPercent - sampledMainPercent) / hours;
+        }
+    }
+
+    /**
+     * Samples the batteries if the most recent sample is older than
+     * BATTERY_SAMPLE_INTERVAL.
+     *
+     * @return
+     *   Returns true if the batteries were sampled.
+     *
+     * @see sample()
+     */
+    static inline bool update( )
+    {
+        if ( (millis( ) - sampleTime) < BATTERY_SAMPLE_INTERVAL )
+            return false;
+        sample( );
+        return true;
+    }
+
+    /**
+     * Returns the microcontroller battery charge percent from the most
+     * recent sample.
+     *
+     * @return
+     *   Returns the percent.
+     *
+     * @see getControllerPercent()
+     * @see update()
+     */
+    static inline float getSampledControllerPercent( )
+    {
+        return sampledControllerPercent;
+    }
+
+    /**
+     * Returns the microcontroller battery voltage from the most recent
+     * sample.
+     *
+     * @return
+     *   Returns the voltage.
+     *
+     * @see getControllerVoltage()
+     * @see update()
+     */
+    static inline float getSampledControllerVoltage( )
+    {
+        return sampledControllerVoltage;
+    }
+
+    /**
+     * Returns the main battery charge percent from the most recent sample.
+     *
+     * @return
+     *   Returns the percent.
+     *
+     * @see getMainPercent()
+     * @see update()
+     */
+    static inline float getSampledMainPercent( )
+    {
+        return sampledMainPercent;
+    }
+
+    /**
+     * Returns the main battery voltage from the most recent sample.
+     *
+     * @return
+     *   Returns the voltage.
+     *
+     * @see getMainVoltage()
+     * @see update()
+     */
+    static inline float getSampledMainVoltage( )
+    {
+        return sampledMainVoltage;
+    }
+
+
+//----------------------------------------------------------------------
+// Discharge rate.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Starts measuring the battery discharge rates afresh.
+     *
+     * The rates are measured from the most recent sample's percents. They
+     * are unknown until BATTERY_RATE_TIME has passed.
+     *
+     * @see getControllerDischargeRate()
+     * @see getMainDischargeRate()
+     */
+    static inline void startDischargeRate( )
+    {
+        rateStarted                = true;
+        rateStartControllerPercent = sampledControllerPercent;
+        rateStartMainPercent       = sampledMainPercent;
+        rateStartTime              = sampleTime;
+        controllerDischargeRate    = 0.0;
+        mainDischargeRate          = 0.0;
+    }
+
+    /**
+     * Returns the microcontroller battery discharge rate.
+     *
+     * @return
+     *   Returns the rate, in percent per hour, or 0 if it has not been
+     *   measured.
+     *
+     * @see startDischargeRate()
+     */
+    static inline float getControllerDischargeRate( )
+    {
+        return controllerDischargeRate;
+    }
+
+    /**
+     * Returns the main battery discharge rate.
+     *
+     * @return
+     *   Returns the rate, in percent per hour, or 0 if it has not been
+     *   measured.
+     *
+     * @see startDischargeRate()
+     */
+    static inline float getMainDischargeRate( )
+    {
+        return mainDischargeRate;
+    }
 };
@@ -1,9 +1,122 @@
 #include "Camera.h"
 
 bool Camera::powerStatus = false;
+uint8_t Camera::powerState = 0;
+uint32_t Camera::powerStateTime = 0;
+
+Adafruit_ZeroTimer Camera::burstTimer( BURST_TIMER_NUMBER );
+volatile bool Camera::bursting = false;
+volatile uint8_t Camera::burstImages = 0;
+volatile uint8_t Camera::burstImagesDone = 0;
+volatile bool Camera::burstShutterDown = false;
+volatile uint32_t Camera::burstPressMicros[UINT8_MAX];
+volatile uint16_t Camera::burstPressLength[UINT8_MAX];
 
 #if defined(ENABLE_USAGE_TRACKING)
 uint32_t Camera::numberOfPowerOns  = 0;
 uint32_t Camera::uptimeSeconds     = 0;
 uint32_t Camera::recentPowerOnTime = 0;
 #endif
+
+
+
+
+
+//----------------------------------------------------------------------
+// Burst.
+//----------------------------------------------------------------------
+/**
+ * Starts to snap a burst of images with the camera.
+ *
+ * The shutter is pressed now, and the burst timer's interrupt does
+ * the rest: it holds each press for CAMERA_RELAY_DELAY ms, waits
+ * CAMERA_SHUTTER_DELAY ms after each release for the camera, and
+ * presses again for the next image. The time of each press is noted.
+ * Use isBursting() to tell when the burst, including the wait after
+ * its last image, is over.
+ *
+ * If the camera power is off, or a burst is in progress, no action is
+ * taken.
+ *
+ * @param[in] nImages
+ *   The number of images to snap in a burst.
+ *
+ * @return
+ *   Returns true if the burst has started.
+ *
+ * @see getBurstPressLength()
+ * @see getBurstPressMicros()
+ * @see isBursting()
+ * @see setPower()
+ */
+bool Camera::startBurst( const uint8_t nImages )
+{
+    if ( !powerStatus || bursting || nImages == 0 )
+        return false;
+
+#if defined(DEBUG_VERBOSE_CAMERA)
+    Serial.printf( "Debug: Camera shutter of %d images.\r\n", nImages );
+#endif
+
+    // Configuring the timer resets its counter, so the first press is
+    // timed from here. In match frequency mode, the counter restarts on
+    // each compare match, after compare + 1 ticks.
+    burstTimer.configure( TC_CLOCK_PRESCALER_DIV64, TC_COUNTER_SIZE_16BIT,
+        TC_WAVE_GENERATION_MATCH_FREQ );
+    burstTimer.setCompare( 0, CAMERA_RELAY_DELAY * BURST_TIMER_TICKS_PER_MS - 1 );
+    burstTimer.setCallback( true, TC_CALLBACK_CC_CHANNEL0, onBurstTimer );
+
+    burstImages      = nImages;
+    burstImagesDone  = 0;
+    burstShutterDown = true;
+    bursting         = true;
+    burstPressMicros[0] = micros( );
+    digitalWrite( CAMERA_SHUTTER_PIN, HIGH );
+    burstTimer.enable( true );
+    return true;
+}
+
+/**
+ * Releases or presses the shutter, on the burst timer's compare match.
+ *
+ * This is called from the timer's interrupt. After a release, the
+ * timer is set to wait for the camera. After that wait, the shutter is
+ * pressed for the next image, if any, and the timer is set for the
+ * press length. Otherwise the timer is stopped and the burst is over.
+ *
+ * @see startBurst()
+ */
+void Camera::onBurstTimer( )
+{
+    const uint32_t t = micros( );
+    const uint8_t image = burstImagesDone;
+    if ( burstShutterDown )
+    {
+        digitalWrite( CAMERA_SHUTTER_PIN, LOW );
+        burstShutterDown = false;
+        burstPressLength[image] = t - burstPressMicros[image];
+        burstImagesDone = image + 1;
+        burstTimer.setCompare( 0, CAMERA_SHUTTER_DELAY * BURST_TIMER_TICKS_PER_MS - 1 );
+        return;
+    }
+
+    if ( image < burstImages )
+    {
+        burstPressMicros[image] = t;
+        digitalWrite( CAMERA_SHUTTER_PIN, HIGH );
+        burstShutterDown = true;
+        burstTimer.setCompare( 0, CAMERA_RELAY_DELAY * BURST_TIMER_TICKS_PER_MS - 1 );
+        return;
+    }
+
+    burstTimer.enable( false );
+    bursting = false;
+}
+
+/**
+ * Calls the burst timer's handler on a TC3 interrupt.
+ */
+void TC3_Handler( )
+{
+    Adafruit_ZeroTimer::timerHandler( 3 );
+}
@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <Arduino.h>
+#include <Adafruit_ZeroTimer.h>
 
 #include "pltlogger.h"
 #include "pins.h"
@@ -19,6 +20,10 @@
  * - An intensifier in front of the camera lens to brigten dim content.
  *   A pair of microcontroller pins are routed to a relay that powers
  *   on/off the intensifier.
+ *
+ * The shutter is pressed and released for each image of a burst by the
+ * TC3 timer's interrupt, so that press lengths and the spacing of
+ * images do not depend on what loop() is doing. See startBurst().
  */
 class Camera
 {
@@ -36,6 +41,17 @@ private:
     static const uint8_t CAMERA_RELAY_DELAY    = 10;    // ms.
     static const uint16_t CAMERA_POWERUP_DELAY = 15000; // ms.
 
+    // The burst timer, TC3, counts the 48 MHz clock divided by 64. Its
+    // 16-bit counter reaches 87 ms.
+    static const uint8_t BURST_TIMER_NUMBER       = 3;
+    static const uint16_t BURST_TIMER_TICKS_PER_MS = 750;
+
+    // Power sequence states. See update().
+    static const uint8_t POWER_IDLE              = 0; // No sequence.
+    static const uint8_t POWER_CAMERA_RELAY      = 1; // Pulsing the camera relay.
+    static const uint8_t POWER_INTENSIFIER_RELAY = 2; // Pulsing the intensifier relay.
+    static const uint8_t POWER_WARMING           = 3; // Waiting for the camera to boot.
+
 
 //----------------------------------------------------------------------
 // Fields.
@@ -44,6 +60,22 @@ private:
     // Whether the camera power is on or off.
     static bool powerStatus;
 
+    // The power sequence state, and when it was entered, in ms since boot.
+    static uint8_t powerState;
+    static uint32_t powerStateTime;
+
+    // The burst in progress, shared with the burst timer interrupt: the
+    // number of images, the number whose shutter press has ended, whether
+    // the shutter is down, and each image's press time, from micros(),
+    // and press length, in us.
+    static Adafruit_ZeroTimer burstTimer;
+    static volatile bool bursting;
+    static volatile uint8_t burstImages;
+    static volatile uint8_t burstImagesDone;
+    static volatile bool burstShutterDown;
+    static volatile uint32_t burstPressMicros[UINT8_MAX];
+    static volatile uint16_t burstPressLength[UINT8_MAX];
+
 #if defined(ENABLE_USAGE_TRACKING)
     // Usage counters and uptime.
     static uint32_t numberOfPowerOns;
@@ -76,6 +108,7 @@ public:
         // There is no way to insure that the camera is off. Assume it
         // is and keep track of it from now on.
         powerStatus = false;
+        powerState  = POWER_IDLE;
 #if defined(DEBUG_VERBOSE_CAMERA)
         Serial.print( "Debug: Camera and intensifier initialized.\r\n" );
 #endif
@@ -203,6 +236,10 @@ public:
      *   TRUE    TRUE    Toggle camera and turn on intensifier.
      *   FALSE   TRUE    Toggle camera and turn off intensifier.
      *
+     * This waits for the power sequence to finish, which on power up
+     * takes several seconds for the camera to boot. Use beginPower()
+     * instead to return immediately.
+     *
      * @param[in] onOff
      *   True to turn the camera and intensifier on, and false to
      *   turn them off.
@@ -210,16 +247,55 @@ public:
      *   True to force on/off even when the camera status thinks it
      *   is already in the right on/off state.
      *
+     * @see beginPower()
      * @see isPowerOn()
-     * @see snap()
+     * @see startBurst()
      */
     static inline void setPower( const bool onOff, const bool force = false )
+    {
+        beginPower( onOff, force );
+        waitUntilReady( );
+    }
+
+    /**
+     * Starts to turn the power on/off on the camera and intensifier,
+     * without waiting.
+     *
+     * This is setPower() without the waits. The relays are pulsed and the
+     * camera boots while update() is called, from loop(). Use isReady()
+     * to tell when the camera can take images, or waitUntilReady() to
+     * wait for it.
+     *
+     * If an earlier power sequence is still pulsing a relay, that pulse
+     * is finished first. This takes at most a few ms.
+     *
+     * @param[in] onOff
+     *   True to turn the camera and intensifier on, and false to
+     *   turn them off.
+     * @param[in] force
+     *   True to force on/off even when the camera status thinks it
+     *   is already in the right on/off state.
+     *
+     * @see isReady()
+     * @see setPower()
+     * @see update()
+     * @see waitUntilReady()
+     */
+    static inline void beginPower( const bool onOff, const bool force = false )
     {
         // Abort if the current power state matches the desired state.
         // But ignore the state if we're forcing the action.
         if ( force == false && powerStatus == onOff )
             return;
 
+        // A relay pulse cannot be cut short, or the relay may not latch.
+        while ( powerState == POWER_CAMERA_RELAY ||
+                powerState == POWER_INTENSIFIER_RELAY )
+        {
+            delay( 1 );
+            update( );
+        }
+
         // To power the camera and intensifier on or off we set the associated
         // relay HIGH then LOW a moment later, causing the relay to latch
         // or unlatch. Because there is no way for us to know the current
@@ -233,42 +309,9 @@ public:
 #endif
 
         digitalWrite( CAMERA_POWER_SET_PIN, HIGH );
-        delay( CAMERA_RELAY_DELAY );
-        digitalWrite( CAMERA_POWER_SET_PIN, LOW );
-
-        // Turn on/off intensifier. Because the intensifier has separate
-        // on and off pins, this always leaves the intensifier in the
-        // intended state.
-#if defined(DEBUG_VERBOSE_CAMERA)
-        Serial.printf( "Debug: Camera intensifier power %s.\r\n",
-            onOff ? "ON" : "OFF" );
-#endif
-
-        if ( onOff )
-        {
-            digitalWrite( INTENSIFIER_POWER_SET_PIN, HIGH );
-            delay( CAMERA_RELAY_DELAY );
-            digitalWrite( INTENSIFIER_POWER_SET_PIN, LOW );
-        }
-        else
-        {
-            digitalWrite( INTENSIFIER_POWER_UNSET_PIN, HIGH );
-            delay( CAMERA_RELAY_DELAY );
-            digitalWrite( INTENSIFIER_POWER_UNSET_PIN, LOW );
-        }
-
-        // On power up, wait for the camera and intensifier to finish
-        // powering up before continuing.
-        if ( onOff )
-        {
-#if defined(DEBUG_VERBOSE_CAMERA)
-            Serial.printf( "Debug: Camera power ON delay for %d ms.\r\n",
-                CAMERA_POWERUP_DELAY );
-#endif
-            delay( CAMERA_POWERUP_DELAY );
-        }
-
-        powerStatus = onOff;
+        powerState     = POWER_CAMERA_RELAY;
+        powerStateTime = millis( );
+        powerStatus    = onOff;
 
 #if defined(ENABLE_USAGE_TRACKING)
         if ( powerStatus )
@@ -286,38 +329,212 @@ public:
 #endif
     }
 
+    /**
+     * Advances a power sequence in progress, if any.
+     *
+     * This is called on each pass through loop(). Each call takes at most
+     * one step and returns. The steps are:
+     *
+     * - Hold the camera relay pin HIGH for CAMERA_RELAY_DELAY ms.
+     * - Hold the intensifier on or off pin HIGH for CAMERA_RELAY_DELAY ms.
+     * - On power up, wait CAMERA_POWERUP_DELAY ms for the camera to boot.
+     *
+     * @see beginPower()
+     * @see isReady()
+     */
+    static inline void update( )
+    {
+        const uint32_t elapsed = millis( ) - powerStateTime;
+        switch ( powerState )
+        {
+            default:
+            case POWER_IDLE:
+                return;
+
+            case POWER_CAMERA_RELAY:
+                if ( elapsed < CAMERA_RELAY_DELAY )
+                    return;
+                digitalWrite( CAMERA_POWER_SET_PIN, LOW );
+
+                // Turn on/off intensifier. Because the intensifier has
+                // separate on and off pins, this always leaves the
+                // intensifier in the intended state.
+#if defined(DEBUG_VERBOSE_CAMERA)
+                Serial.printf( "Debug: Camera intensifier power %s.\r\n",
+                    powerStatus ? "ON" : "OFF" );
+#endif
+                digitalWrite( powerStatus ?
+                    INTENSIFIER_POWER_SET_PIN : INTENSIFIER_POWER_UNSET_PIN, HIGH );
+                powerState = POWER_INTENSIFIER_RELAY;
+                break;
+
+            case POWER_INTENSIFIER_RELAY:
+                if ( elapsed < CAMERA_RELAY_DELAY )
+                    return;
+                digitalWrite( powerStatus ?
+                    INTENSIFIER_POWER_SET_PIN : INTENSIFIER_POWER_UNSET_PIN, LOW );
+                powerState = powerStatus ? POWER_WARMING : POWER_IDLE;
+                break;
+
+            case POWER_WARMING:
+                if ( elapsed < CAMERA_POWERUP_DELAY )
+                    return;
+#if defined(DEBUG_VERBOSE_CAMERA)
+                Serial.print( "Debug: Camera power ON delay done.\r\n" );
+#endif
+                powerState = POWER_IDLE;
+                break;
+        }
+        powerStateTime = millis( );
+    }
+
+    /**
+     * Returns true if the camera and intensifier are on and have finished
+     * powering up.
+     *
+     * @return
+     *   Returns true if ready.
+     *
+     * @see beginPower()
+     * @see waitUntilReady()
+     */
+    static inline bool isReady( )
+    {
+        return powerStatus && powerState == POWER_IDLE;
+    }
+
+    /**
+     * Waits for a power sequence in progress, if any, to finish.
+     *
+     * If the camera is powering up, this waits for it to be ready. If
+     * there is no power sequence in progress, this returns immediately.
+     *
+     * @see beginPower()
+     * @see isReady()
+     */
+    static inline void waitUntilReady( )
+    {
+        while ( powerState != POWER_IDLE )
+        {
+            const uint32_t elapsed = millis( ) - powerStateTime;
+            const uint32_t wait = (powerState == POWER_WARMING) ?
+                CAMERA_POWERUP_DELAY : CAMERA_RELAY_DELAY;
+            if ( elapsed < wait )
+                delay( wait - elapsed );
+            update( );
+        }
+    }
+
 
 //----------------------------------------------------------------------
-// Use methods.
+// Burst.
 //----------------------------------------------------------------------
 public:
     /**
-     * Snaps a picture with the camera.
+     * Starts to snap a burst of images with the camera.
+     *
+     * The shutter is pressed now, and the burst timer's interrupt does
+     * the rest: it holds each press for CAMERA_RELAY_DELAY ms, waits
+     * CAMERA_SHUTTER_DELAY ms after each release for the camera, and
+     * presses again for the next image. The time of each press is noted.
+     * Use isBursting() to tell when the burst, including the wait after
+     * its last image, is over.
      *
-     * If the camera power is off, an error message is output and no
-     * action is taken.
+     * If the camera power is off, or a burst is in progress, no action is
+     * taken.
      *
      * @param[in] nImages
      *   The number of images to snap in a burst.
      *
-     * @see isPowerOn()
+     * @return
+     *   Returns true if the burst has started.
+     *
+     * @see getBurstPressLength()
+     * @see getBurstPressMicros()
+     * @see isBursting()
      * @see setPower()
      */
-    static inline void snap( const uint8_t nImages )
+    static bool startBurst( const uint8_t nImages );
+
+    /**
+     * Returns true if a burst is in progress.
+     *
+     * @return
+     *   Returns true if bursting.
+     *
+     * @see startBurst()
+     */
+    static inline bool isBursting( )
     {
-        if ( !powerStatus )
-            return;
+        return bursting;
+    }
 
-#if defined(DEBUG_VERBOSE_CAMERA)
-        Serial.printf( "Debug: Camera shutter of %d images.\r\n", nImages );
-#endif
+    /**
+     * Returns when the shutter was pressed for an image of the most
+     * recent burst.
+     *
+     * The first image's time is known as soon as the burst starts. The
+     * others are known once the burst is over.
+     *
+     * @param[in] image
+     *   The image's index in the burst, from 0.
+     *
+     * @return
+     *   Returns the time, from micros().
+     *
+     * @see getBurstPressLength()
+     * @see startBurst()
+     */
+    static inline uint32_t getBurstPressMicros( const uint8_t image )
+    {
+        return burstPressMicros[image];
+    }
 
-        for ( uint8_t i = 0; i < nImages; ++i )
-        {
-            digitalWrite( CAMERA_SHUTTER_PIN, HIGH );
-            delay( CAMERA_RELAY_DELAY );
-            digitalWrite( CAMERA_SHUTTER_PIN, LOW );
-            delay( CAMERA_SHUTTER_DELAY );
-        }
+    /**
+     * Returns how long the shutter was held down for an image of the most
+     * recent burst.
+     *
+     * @param[in] image
+     *   The image's index in the burst, from 0.
+     *
+     * @return
+     *   Returns the time, in us.
+     *
+     * @see getBurstPressMicros()
+     * @see startBurst()
+     */
+    static inline uint32_t getBurstPressLength( const uint8_t image )
+    {
+        return burstPressLength[image];
     }
+
+    /**
+     * Returns how long a burst takes, including the wait after its last
+     * image.
+     *
+     * @param[in] nImages
+     *   The number of images in the burst.
+     *
+     * @return
+     *   Returns the time, in ms.
+     *
+     * @see startBurst()
+     */
+    static inline uint32_t getBurstDuration( const uint8_t nImages )
+    {
+        return (uint32_t)nImages * (CAMERA_RELAY_DELAY + CAMERA_SHUTTER_DELAY);
+    }
+
+private:
+    /**
+     * Releases or presses the shutter, on the burst timer's compare match.
+     *
+     * This is called from the timer's interrupt. After a release, the
+     * timer is set to wait for the camera. After that wait, the shutter is
+     * pressed for the next image, if any, and the timer is set for the
+     * press length. Otherwise the timer is stopped and the burst is over.
+     *
+     * @see startBurst()
+     */
+    static void onBurstTimer( );
 };
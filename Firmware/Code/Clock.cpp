@@ -3,6 +3,86 @@
 RTC_DS3231 Clock::rtc;
 bool Clock::initialized = false;
 
+uint32_t Clock::syncSeconds = SECONDS_FROM_1970_TO_2000;
+uint32_t Clock::syncMillis = 0;
+bool Clock::baseValid = false;
+uint32_t Clock::baseSeconds = 0;
+uint32_t Clock::baseMillis = 0;
+int32_t Clock::driftPpm = 0;
+bool Clock::resyncPending = false;
+uint32_t Clock::resyncSeconds = 0;
+uint32_t Clock::resyncPollTime = 0;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Synchronization.
+//----------------------------------------------------------------------
+/**
+ * Resynchronizes the millisecond counter to the real-time clock, if it
+ * is time to.
+ *
+ * Every CLOCK_RESYNC_INTERVAL, the real-time clock is read on each
+ * call until its seconds tick over, and that edge becomes the new
+ * synchronization point. This should be called often, but not while
+ * timing matters, such as during a snap-and-log.
+ *
+ * @see getTime()
+ */
+void Clock::update( )
+{
+    if ( !initialized )
+        return;
+
+    const uint32_t t = millis( );
+    if ( !resyncPending )
+    {
+        if ( (t - syncMillis) < CLOCK_RESYNC_INTERVAL )
+            return;
+        resyncPending  = true;
+        resyncSeconds  = rtc.now( ).unixtime( );
+        resyncPollTime = t;
+        return;
+    }
+
+    // Watch for the seconds to tick over. The tick is only precise if
+    // the clock was also read just before it, so ticks that fall in a
+    // longer gap between calls are skipped and the next one is used.
+    const uint32_t seconds = rtc.now( ).unixtime( );
+    const uint32_t gap = t - resyncPollTime;
+    resyncPollTime = t;
+    if ( seconds == resyncSeconds )
+        return;
+    resyncSeconds = seconds;
+    if ( gap > RESYNC_EDGE_TOLERANCE )
+        return;
+
+    // Measure the drift over the span since the first edge.
+    if ( !baseValid )
+    {
+        baseValid   = true;
+        baseSeconds = seconds;
+        baseMillis  = t;
+    }
+    else if ( seconds > baseSeconds )
+    {
+        const int64_t clockMs   = (int64_t) (seconds - baseSeconds) * 1000;
+        const int64_t counterMs = (uint32_t) (t - baseMillis);
+        const int64_t ppm = (counterMs - clockMs) * 1000000 / clockMs;
+        if ( ppm >= -MAXIMUM_DRIFT_PPM && ppm <= MAXIMUM_DRIFT_PPM )
+            driftPpm = (int32_t) ppm;
+#if defined(DEBUG_VERBOSE_CLOCK)
+        Serial.printf( "Debug: Real-time clock drift %ld ppm.\r\n", (long) ppm );
+#endif
+    }
+
+    syncSeconds   = seconds;
+    syncMillis    = t;
+    resyncPending = false;
+}
+
 
 
 
@@ -175,42 +255,25 @@ const char* Clock::nowString( const uint8_t format )
 {
     static char s[25];
 
-    if ( !initialized )
-    {
-        // The clock was not found, so it is not possible to return a
-        // current date and time. Instead, use the built-in clock to
-        // get a time since the most recent boot. Use that to create
-        // a fake time that is suitable for relative timestamping.
-        DateTime dt( SECONDS_FROM_1970_TO_2000 + millis( ) / 1000 );
-        switch ( format )
-        {
-            case TIME_ISO8601:
-                return dt.timestamp( DateTime::TIMESTAMP_FULL ).c_str( );
-
-            case TIME_RFC3339:
-                strcpy( s, "YYYY-MM-DD hh:mm:ss" );
-                return dt.toString( s );
-
-            default:
-            case TIME_EXCEL:
-                strcpy( s, "MM/DD/YYYY hh:mm:ss" );
-                return dt.toString( s );
-        }
-    }
-
+    // The time comes from the synchronized millisecond counter, so this
+    // needs no I2C transaction. If the clock was not found, this is a
+    // fake time since the most recent boot, suitable for relative
+    // timestamping.
+    DateTime dt( nowSeconds( ) );
     switch ( format )
     {
         case TIME_ISO8601:
-            return rtc.now( ).timestamp( DateTime::TIMESTAMP_FULL ).c_str( );
+            strcpy( s, "YYYY-MM-DDThh:mm:ss" );
+            return dt.toString( s );
 
         case TIME_RFC3339:
             strcpy( s, "YYYY-MM-DD hh:mm:ss" );
-            return rtc.now( ).toString( s );
+            return dt.toString( s );
 
         default:
         case TIME_EXCEL:
             strcpy( s, "MM/DD/YYYY hh:mm:ss" );
-            return rtc.now( ).toString( s );
+            return dt.toString( s );
     }
 }
 
@@ -264,6 +327,7 @@ bool Clock::setDateTime(
     }
 
     rtc.adjust( dt );
+    latch( dt.unixtime( ) );
 #if defined(DEBUG_VERBOSE_CLOCK)
     Serial.printf( "Debug: Real-time clock date set to %s.\r\n", nowString( ) );
 #endif
@@ -319,6 +383,7 @@ bool Clock::setDateTime( const char*const string )
     }
 
     rtc.adjust( dt );
+    latch( dt.unixtime( ) );
 #if defined(DEBUG_VERBOSE_CLOCK)
     Serial.printf( "Debug: Real-time clock date set to %s.\r\n", nowString( ) );
 #endif
@@ -18,6 +18,15 @@
  *   high-precision date and time that can be formatted and written to
  *   log files as a timestamp.
  *
+ * Reading the real-time clock takes an I2C transaction, and it only has
+ * a one second resolution. So the clock is read once, when it is
+ * initialized or set, and the date and time are afterwards computed from
+ * the millisecond counter. Every CLOCK_RESYNC_INTERVAL, update() watches
+ * for the real-time clock's seconds to tick over and resynchronizes the
+ * counter to that edge. It also measures how fast or slow the counter
+ * runs compared to the real-time clock, and corrects for that drift. So
+ * timestamps need no I2C traffic and have a millisecond resolution.
+ *
  * @see https://www.adafruit.com/product/3013
  * @see https://github.com/adafruit/RTClib
  */
@@ -38,6 +47,15 @@ public:
     static const uint8_t TIME_RFC3339 = 1;  // YYYY-MM-DD hh:mm:ss
     static const uint8_t TIME_ISO8601 = 2;  // YYYY-MM-DDThh:mm:ss
 
+private:
+    // The longest gap between two reads of the real-time clock for the
+    // seconds tick between them to count as a resynchronization edge.
+    static const uint32_t RESYNC_EDGE_TOLERANCE = 2;   // ms
+
+    // The largest believable drift between the millisecond counter and
+    // the real-time clock. Larger measurements are ignored.
+    static const int32_t MAXIMUM_DRIFT_PPM = 1000;
+
 
 //----------------------------------------------------------------------
 // Fields.
@@ -49,6 +67,27 @@ private:
     // A flag indicating if the clock exists and has been initialized.
     static bool initialized;
 
+    // The real-time clock's time at a synchronization point, and the
+    // millisecond counter at the same moment.
+    static uint32_t syncSeconds;
+    static uint32_t syncMillis;
+
+    // The first synchronization edge since the clock was set, used to
+    // measure drift over as long a span as possible.
+    static bool baseValid;
+    static uint32_t baseSeconds;
+    static uint32_t baseMillis;
+
+    // The millisecond counter's measured drift from the real-time clock,
+    // in parts per million. Positive when the counter runs fast.
+    static int32_t driftPpm;
+
+    // Resynchronization state. While pending, the real-time clock is read
+    // on each update() until its seconds tick over.
+    static bool resyncPending;
+    static uint32_t resyncSeconds;
+    static uint32_t resyncPollTime;
+
 
 //----------------------------------------------------------------------
 // Initialization.
@@ -95,6 +134,7 @@ public:
         rtc.adjust( restoreTime );
 
         initialized = true;
+        latch( restoreTime );
 #if defined(DEBUG_VERBOSE_CLOCK)
         Serial.print( "Debug: Real-time clock initialized.\r\n" );
 #endif
@@ -133,6 +173,81 @@ public:
     }
 
 
+//----------------------------------------------------------------------
+// Synchronization.
+//----------------------------------------------------------------------
+private:
+    /**
+     * Latches the real-time clock's time to the millisecond counter.
+     *
+     * The time is taken to be the start of the given second, as it is
+     * when the clock has just been set. The drift measurement is restarted,
+     * and a resynchronization to the next seconds edge is started.
+     *
+     * @param[in] seconds
+     *   The real-time clock's time, in seconds since 1970.
+     *
+     * @see update()
+     */
+    static inline void latch( const uint32_t seconds )
+    {
+        syncSeconds    = seconds;
+        syncMillis     = millis( );
+        baseValid      = false;
+        resyncPending  = true;
+        resyncSeconds  = seconds;
+        resyncPollTime = syncMillis;
+    }
+
+public:
+    /**
+     * Resynchronizes the millisecond counter to the real-time clock, if it
+     * is time to.
+     *
+     * Every CLOCK_RESYNC_INTERVAL, the real-time clock is read on each
+     * call until its seconds tick over, and that edge becomes the new
+     * synchronization point. This should be called often, but not while
+     * timing matters, such as during a snap-and-log.
+     *
+     * @see getTime()
+     */
+    static void update( );
+
+    /**
+     * Returns the millisecond counter's measured drift from the real-time
+     * clock.
+     *
+     * @return
+     *   Returns the drift, in parts per million. Positive when the
+     *   counter runs fast.
+     *
+     * @see update()
+     */
+    static inline int32_t getDriftPpm( )
+    {
+        return driftPpm;
+    }
+
+    /**
+     * Returns the millisecond counter span for a span of real time.
+     *
+     * The span is corrected for the counter's measured drift, so that
+     * schedules kept on the counter keep to the real-time clock.
+     *
+     * @param[in] ms
+     *   The real time span, in ms.
+     *
+     * @return
+     *   Returns the counter span, in us.
+     *
+     * @see getDriftPpm()
+     */
+    static inline uint64_t getCounterMicros( const uint32_t ms )
+    {
+        return (uint64_t) ms * 1000 + (int64_t) ms * driftPpm / 1000;
+    }
+
+
 //----------------------------------------------------------------------
 // Get and Set.
 //----------------------------------------------------------------------
@@ -198,7 +313,57 @@ public:
     {
         if ( !initialized )
             return DateTime( (uint32_t) 0 );
-        return rtc.now( );
+        return DateTime( nowSeconds( ) );
+    }
+
+    /**
+     * Returns the date and time at a given millisecond counter value.
+     *
+     * The time is computed from the most recent synchronization to the
+     * real-time clock, corrected for the millisecond counter's drift. No
+     * I2C transaction is needed. If the clock is not initialized (it was
+     * not found), a fake time since the most recent boot is returned, as
+     * for nowString().
+     *
+     * @param[in] ms
+     *   The millisecond counter value, from millis().
+     * @param[out] seconds
+     *   The returned time, in seconds since 1970.
+     * @param[out] milliseconds
+     *   The returned millisecond offset into the second.
+     *
+     * @see nowSeconds()
+     * @see nowMillisOffset()
+     */
+    static inline void getTime(
+        const uint32_t ms,
+        uint32_t& seconds,
+        uint32_t& milliseconds )
+    {
+        const int64_t elapsed = (int32_t) (ms - syncMillis);
+        const int64_t t = (int64_t) syncSeconds * 1000 +
+            elapsed - elapsed * driftPpm / 1000000;
+        seconds      = (uint32_t) (t / 1000);
+        milliseconds = (uint32_t) (t % 1000);
+    }
+
+    /**
+     * Returns the current date and time as seconds since 1970.
+     *
+     * If the clock is not initialized (it was not found), a fake time
+     * since the most recent boot is returned, as for nowString().
+     *
+     * @return
+     *   Returns the POSIX time, in seconds.
+     *
+     * @see now()
+     * @see nowString()
+     */
+    static inline uint32_t nowSeconds( )
+    {
+        uint32_t seconds, milliseconds;
+        getTime( millis( ), seconds, milliseconds );
+        return seconds;
     }
 
     /**
@@ -208,21 +373,22 @@ public:
      * last ticked over. So, if the clock seconds ticked 1/2 second ago,
      * this method returns 1/2 second = 500 ms.
      *
-     * This value is approximate. The real time clock itself does not
-     * have millisecond resolution. Instead, this method uses the processor's
-     * built-in approximate millisecond resolution clock to estimate the
-     * number of milliseconds into the next second.
+     * The real time clock itself does not have millisecond resolution.
+     * Instead, the offset is computed from the processor's millisecond
+     * counter, synchronized to the real-time clock's seconds ticking over.
+     * Until the first synchronization, the offset is approximate.
      *
      * @return
      *   Returns the millisecond offset after the clock's seconds last
      *   ticked over.
+     *
+     * @see getTime()
      */
     static inline uint32_t nowMillisOffset( )
     {
-        // We arbitrarily declare that at boot time the millisecond offset
-        // is zero. millis( ) returns the time, in ms, since boot. So modulo
-        // that by 1000 gets the millisecond offset.
-        return millis( ) % 1000;
+        uint32_t seconds, milliseconds;
+        getTime( millis( ), seconds, milliseconds );
+        return milliseconds;
     }
 
     /**
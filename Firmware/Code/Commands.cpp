@@ -6,6 +6,9 @@
 #include "Clock.h"      // Real time clock.
 #include "Laser.h"      // Laser.
 #include "Lights.h"     // Light (LEDs).
+#include "Mission.h"    // Mission plans.
+#include "Perf.h"       // Stage timing histograms.
+#include "Planner.h"    // Run forecasts.
 #include "Sensors.h"    // Inertial, pressure, and temperature sensors.
 
 char Commands::lineBuffer[MAXLINE+1];
@@ -51,6 +54,23 @@ const char* Commands::uint64ToString( uint64_t value )
     return &digits[i+1];
 }
 
+/**
+ * Formats a forecast time in whole minutes.
+ *
+ * @param[in] seconds
+ *   The time, in seconds, or UINT32_MAX for no limit.
+ * @return
+ *   Returns a string version of the time.
+ */
+const char* Commands::minutesToString( const uint32_t seconds )
+{
+    static char minutes[24];
+    if ( seconds == UINT32_MAX )
+        return "no limit";
+    sprintf( minutes, "%ld minutes", (long) (seconds / 60) );
+    return minutes;
+}
+
 
 
 
@@ -245,6 +265,29 @@ void Commands::dispatch( char*const line )
         hwinfo( );
         return;
     }
+    if ( strcmp( command, "perf" ) == 0 )
+    {
+        if ( strcmp( arg, "reset" ) == 0 )
+        {
+            Perf::reset( );
+            Serial.print( "Stage timing cleared.\r\n" );
+        }
+        else if ( *arg != '\0' )
+            help( command );
+        else
+            Perf::print( );
+        return;
+    }
+    if ( strcmp( command, "mission" ) == 0 )
+    {
+        mission( );
+        return;
+    }
+    if ( strcmp( command, "plan" ) == 0 )
+    {
+        plan( arg );
+        return;
+    }
     if ( strncmp( command, "sensor", 6 ) == 0 )
     {
         sensors( );
@@ -255,6 +298,20 @@ void Commands::dispatch( char*const line )
         status( );
         return;
     }
+    if ( strcmp( command, "stream" ) == 0 )
+    {
+        if ( strcmp( arg, "on" ) == 0 )
+            setStreaming( true );
+        else if ( strcmp( arg, "off" ) == 0 )
+            setStreaming( false );
+        else if ( *arg != '\0' )
+        {
+            help( command );
+            return;
+        }
+        Serial.printf( "Telemetry stream is %s.\r\n", isStreaming( ) ? "on" : "off" );
+        return;
+    }
     if ( strcmp( command, "test" ) == 0 )
     {
         if ( strcmp( arg, "lights" ) == 0 )
@@ -281,19 +338,76 @@ void Commands::dispatch( char*const line )
         if ( *arg == '\0' )
         {
             // No argument given. Show the current interval.
-            Serial.printf( "%ld ms\r\n", getFrameInterval( ) );
+            Serial.printf( "%ld ms\r\n", (long) getFrameInterval( ) );
         }
         else
         {
             const uint32_t interval = atoi( arg );
             if ( !setFrameInterval( interval ) )
                 Serial.printf( "Bad interval. Use >= %ld ms or 0 to reset to default.\r\n",
-                    MINIMUM_FRAME_INTERVAL );
+                    (long) MINIMUM_FRAME_INTERVAL );
             else if ( interval == 0 )
                 Serial.printf( "Frame interval reset to default %ld ms\r\n",
-                    getFrameInterval( ) );
+                    (long) getFrameInterval( ) );
+            else
+                Serial.printf( "Frame interval set to %ld ms\r\n",
+                    (long) getFrameInterval( ) );
+        }
+        return;
+    }
+    if ( strcmp( command, "spacing" ) == 0 )
+    {
+        if ( *arg == '\0' )
+        {
+            // No argument given. Show the current spacing.
+            if ( getFrameSpacing( ) > 0.0 )
+                Serial.printf( "%.3f m\r\n", getFrameSpacing( ) );
+            else
+                Serial.print( "Off. Fixed frame interval.\r\n" );
+        }
+        else
+        {
+            const float spacing = atof( arg );
+            if ( !setFrameSpacing( spacing ) )
+                Serial.printf( "Bad spacing. Use up to %.1f m or 0 for a fixed interval.\r\n",
+                    MAXIMUM_FRAME_SPACING );
+            else if ( spacing == 0.0 )
+                Serial.print( "Frame spacing off. Fixed frame interval.\r\n" );
+            else
+                Serial.printf( "Frame spacing set to %.3f m\r\n", getFrameSpacing( ) );
+        }
+        return;
+    }
+    if ( strcmp( command, "startdepth" ) == 0 )
+    {
+        if ( *arg != '\0' && !setStartDepth( atof( arg ) ) )
+        {
+            Serial.printf( "Bad depth. Use more than %.1f m, up to %.0f m.\r\n",
+                ARM_SURFACE_DEPTH, MAXIMUM_START_DEPTH );
+            return;
+        }
+        Serial.printf( "When armed, start running at %.2f m.\r\n", getStartDepth( ) );
+        return;
+    }
+    if ( strcmp( command, "maxinterval" ) == 0 )
+    {
+        if ( *arg == '\0' )
+        {
+            // No argument given. Show the current maximum interval.
+            Serial.printf( "%ld ms\r\n", (long) getMaximumFrameInterval( ) );
+        }
+        else
+        {
+            const uint32_t interval = atoi( arg );
+            if ( !setMaximumFrameInterval( interval ) )
+                Serial.printf( "Bad interval. Use >= %ld ms or 0 to reset to default.\r\n",
+                    (long) MINIMUM_FRAME_INTERVAL );
+            else if ( interval == 0 )
+                Serial.printf( "Maximum frame interval reset to default %ld ms\r\n",
+                    (long) getMaximumFrameInterval( ) );
             else
-                Serial.printf( "Frame interval set to %ld ms\r\n", getFrameInterval( ) );
+                Serial.printf( "Maximum frame interval set to %ld ms\r\n",
+                    (long) getMaximumFrameInterval( ) );
         }
         return;
     }
@@ -346,6 +460,39 @@ void Commands::dispatch( char*const line )
     }
 
     // Actions.
+    if ( strcmp( command, "arm" ) == 0 )
+    {
+        if ( strcmp( arg, "on" ) == 0 )
+        {
+            if ( !setArmed( true ) )
+            {
+                if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
+                    Serial.print( "Cannot arm while imaging is in progress.\r\n" );
+                else if ( !Sensors::isPressureSensorPresent( ) )
+                    Serial.print( "Cannot arm without a pressure sensor.\r\n" );
+                else
+                    Serial.print( "Cannot arm. Type 'status' for more info.\r\n" );
+                return;
+            }
+        }
+        else if ( strcmp( arg, "off" ) == 0 )
+        {
+            setArmed( false );
+            if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
+                Serial.print( "Still running. Use 'stop' to stop.\r\n" );
+        }
+        else if ( *arg != '\0' )
+        {
+            help( command );
+            return;
+        }
+        if ( isArmed( ) )
+            Serial.printf( "Armed. Running starts at %.2f m and stops at the surface.\r\n",
+                getStartDepth( ) );
+        else
+            Serial.print( "Not armed.\r\n" );
+        return;
+    }
     if ( strcmp( command, "camera" ) == 0 )
     {
         if ( *arg != '\0' )
@@ -355,6 +502,16 @@ void Commands::dispatch( char*const line )
                 Serial.print( "Cannot change camera on/off while imaging is in progress.\r\n" );
                 return;
             }
+            else if ( isArmed( ) )
+            {
+                Serial.print( "Cannot change camera on/off while armed. Use 'arm off'.\r\n" );
+                return;
+            }
+            else if ( isSnapping( ) || isSnapQueued( ) )
+            {
+                Serial.print( "Cannot change camera on/off while snapping.\r\n" );
+                return;
+            }
             else if ( strcmp( arg, "on" ) == 0 )
             {
                 if ( Camera::isPowerOn( ) == true )
@@ -366,11 +523,9 @@ void Commands::dispatch( char*const line )
                 }
 
                 setCameraStatus( CAMERA_BOOTING );
-                Serial.print( "Camera and intensifier powering up...\r\n" );
-                Camera::setPower( true );
-                setCameraStatus( CAMERA_READY );
-                Lights::setLightsForStatus( );
-                Serial.printf( "Camera and intensifier are on.\r\n" );
+                Camera::beginPower( true );
+                Serial.print( "Camera and intensifier powering up. They are ready when the\r\n" );
+                Serial.print( "  lights say so, or type 'camera' to check.\r\n" );
 
                 Serial.print( "  Beware: use 'camera off' or the software may get out of sync\r\n" );
                 Serial.print( "  with the camera state. Use 'camera forceoff' if that occurs.\r\n" );
@@ -412,8 +567,12 @@ void Commands::dispatch( char*const line )
             }
         }
 
-        Serial.printf( "Camera is %s.\r\n",
-            (Camera::isPowerOn() == true) ? "on" : "off" );
+        if ( Camera::isReady( ) )
+            Serial.print( "Camera is on.\r\n" );
+        else if ( Camera::isPowerOn( ) )
+            Serial.print( "Camera is powering up.\r\n" );
+        else
+            Serial.print( "Camera is off.\r\n" );
         return;
     }
     if ( strcmp( command, "laser" ) == 0 )
@@ -509,6 +668,37 @@ void Commands::dispatch( char*const line )
             Serial.printf( "%s bytes\r\n", uint64ToString( nBytes ) );
         return;
     }
+    if ( strcmp( command, "df" ) == 0 )
+    {
+        if ( !FileSystem::isInitialized( ) )
+        {
+            FileSystem::printErrorMessage( );
+            return;
+        }
+        if ( strcmp( arg, "check" ) == 0 )
+        {
+            // Count free clusters from the FAT and compare.
+            const int32_t drift = FileSystem::recountFreeClusters( );
+            if ( drift == 0 )
+                Serial.print( "Free space count checked. No change.\r\n" );
+            else
+                Serial.printf( "Free space count corrected by %ld clusters.\r\n",
+                    (long) drift );
+        }
+        else if ( *arg != '\0' )
+        {
+            help( command );
+            return;
+        }
+        Serial.printf( "%-12s %s bytes\r\n", "Capacity",
+            uint64ToString( FileSystem::getCardCapacity( ) ) );
+        Serial.printf( "%-12s %s bytes (%0.3f%%)\r\n", "In use",
+            uint64ToString( FileSystem::getSpaceUsed( ) ),
+            FileSystem::getSpaceUsedPercent( ) );
+        Serial.printf( "%-12s %s bytes\r\n", "Free",
+            uint64ToString( FileSystem::getFreeSpace( ) ) );
+        return;
+    }
     if ( strcmp( command, "format" ) == 0 )
     {
         if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
@@ -538,6 +728,38 @@ void Commands::dispatch( char*const line )
             Serial.print( "Format canceled.\r\n" );
         return;
     }
+    if ( strcmp( command, "get" ) == 0 )
+    {
+        if ( *arg == '\0' )
+        {
+            help( command );
+            return;
+        }
+        if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
+        {
+            Serial.print( "Cannot send files while imaging is in progress.\r\n" );
+            Serial.print( "Type 'stop' first.\r\n" );
+            return;
+        }
+
+        // Split off the optional offset after the path.
+        char*const space = strchr( arg, ' ' );
+        uint32_t offset = 0;
+        if ( space != NULL )
+        {
+            *space = '\0';
+            offset = strtoul( space + 1, NULL, 10 );
+        }
+
+        // The host's frames follow the command. Drop anything else.
+        flushSerialInput( );
+        if ( !FileSystem::get( arg, offset ) && FileSystem::hasError( ) )
+        {
+            FileSystem::printErrorMessage( );
+            updateStatus( );
+        }
+        return;
+    }
     if ( strcmp( command, "head" ) == 0 )
     {
         if ( *arg == '\0' )
@@ -605,16 +827,18 @@ void Commands::dispatch( char*const line )
  */
 void Commands::help( const char*const arg )
 {
-    static const int HELP_LINES = 8;
+    static const int HELP_LINES = 10;
     static const char*const col1[] = {
         "Info:",
         "  help [COMMAND]",
         "  hwinfo",
+        "  mission",
+        "  perf [reset]",
+        "  plan [N]",
         "  sensors",
         "  status",
+        "  stream [on|off]",
         "  version",
-        "",
-        "",
     };
     static const char*const col2[] = {
         "Settings:",
@@ -622,12 +846,15 @@ void Commands::help( const char*const arg )
         "  date [DT]",
         "  interval [N]",
         "  lasermode [MODE]",
-        "",
+        "  maxinterval [N]",
+        "  spacing [M]",
+        "  startdepth [M]",
         "",
         "",
     };
     static const char*const col3[] = {
         "Actions:",
+        "  arm [on|off]",
         "  camera [STATE]",
         "  laser [STATE]",
         "  reset",
@@ -635,12 +862,15 @@ void Commands::help( const char*const arg )
         "  start",
         "  stop",
         "  test NAME",
+        "",
     };
     static const char*const col4[] = {
         "Files:",
         "  cat PATH",
+        "  df [check]",
         "  du [PATH]",
         "  format",
+        "  get PATH [OFFSET]",
         "  head PATH",
         "  ls [PATH]",
         "  rm PATH",
@@ -663,6 +893,15 @@ void Commands::help( const char*const arg )
         Serial.print( "Show help on a specific COMMAND, or a list of all commands.\r\n" );
         return;
     }
+    if ( strcmp( arg, "arm" ) == 0 )
+    {
+        Serial.print( "Usage: arm [on|off]\r\n" );
+        Serial.print( "Show or set whether to start and stop running by depth. While armed,\r\n" );
+        Serial.print( "the camera powers up when the device is submerged, running starts at\r\n" );
+        Serial.print( "'startdepth', and stops after a return to the surface, with a new data\r\n" );
+        Serial.print( "log for each drop. 'start', 'stop', and the switch disarm.\r\n" );
+        return;
+    }
     if ( strcmp( arg, "cat" ) == 0 )
     {
         Serial.print( "Usage: cat PATH\r\n" );
@@ -672,7 +911,8 @@ void Commands::help( const char*const arg )
     if ( strcmp( arg, "camera" ) == 0 )
     {
         Serial.print( "Usage: camera [on|off|forceoff]\r\n" );
-        Serial.print( "Turn on/off the camera and intensifier.\r\n" );
+        Serial.print( "Turn on/off the camera and intensifier. The camera takes several\r\n" );
+        Serial.print( "seconds to power up, while other commands can be used.\r\n" );
         Serial.print( "Use 'forceoff' to turn off the camera and intensifier even if the\r\n" );
         Serial.print( "software thinks they are already off.\r\n" );
         return;
@@ -690,6 +930,14 @@ void Commands::help( const char*const arg )
         Serial.print( "(e.g. 1/20/2021 12:30:01)\r\n" );
         return;
     }
+    if ( strcmp( arg, "df" ) == 0 )
+    {
+        Serial.print( "Usage: df [check]\r\n" );
+        Serial.print( "Show SD card space in use and free, including format overhead.\r\n" );
+        Serial.print( "Use 'check' to count free space again from the card's FAT, which\r\n" );
+        Serial.print( "is slow on a large card.\r\n" );
+        return;
+    }
     if ( strcmp( arg, "du" ) == 0 )
     {
         Serial.print( "Usage: du [PATH]\r\n" );
@@ -702,6 +950,13 @@ void Commands::help( const char*const arg )
         Serial.print( "Format the SD card. Prompts for confirmation.\r\n" );
         return;
     }
+    if ( strcmp( arg, "get" ) == 0 )
+    {
+        Serial.print( "Usage: get PATH [OFFSET]\r\n" );
+        Serial.print( "Send a file, starting at OFFSET bytes (default 0), as binary\r\n" );
+        Serial.print( "frames for the 'pltget' host tool.\r\n" );
+        return;
+    }
     if ( strcmp( arg, "head" ) == 0 )
     {
         Serial.print( "Usage: head PATH\r\n" );
@@ -720,12 +975,42 @@ void Commands::help( const char*const arg )
         Serial.print( "Show the frame interval, or set with N in ms.\r\n" );
         return;
     }
+    if ( strcmp( arg, "maxinterval" ) == 0 )
+    {
+        Serial.print( "Usage: maxinterval [N]\r\n" );
+        Serial.print( "Show the longest depth-adaptive frame interval, or set with N in ms.\r\n" );
+        return;
+    }
     if ( strcmp( arg, "ls" ) == 0 )
     {
         Serial.print( "Usage: ls [PATH]\r\n" );
         Serial.print( "Show a directory list (default to '/').\r\n" );
         return;
     }
+    if ( strcmp( arg, "mission" ) == 0 )
+    {
+        Serial.print( "Usage: mission\r\n" );
+        Serial.print( "Show the mission plan in MISSION.TXT, if any, and the segment in effect.\r\n" );
+        Serial.print( "Each line is 'depth FROM TO' in m or 'time FROM TO' in s since the run\r\n" );
+        Serial.print( "started, then any of 'interval N', 'burst N', 'laser normal|continuous',\r\n" );
+        Serial.print( "and 'imu on|off'. The first line matching a frame wins. Frames that\r\n" );
+        Serial.print( "match none, and options left out, follow the settings.\r\n" );
+        return;
+    }
+    if ( strcmp( arg, "perf" ) == 0 )
+    {
+        Serial.print( "Usage: perf [reset]\r\n" );
+        Serial.print( "Show how long each snap-and-log stage takes, in us, and how many\r\n" );
+        Serial.print( "frames were missed, or clear them with 'reset'.\r\n" );
+        return;
+    }
+    if ( strcmp( arg, "plan" ) == 0 )
+    {
+        Serial.print( "Usage: plan [N]\r\n" );
+        Serial.print( "Forecast how long a run can go on before the SD card fills or a\r\n" );
+        Serial.print( "battery runs low, at N ms frame interval (default to the current one).\r\n" );
+        return;
+    }
     if ( strcmp( arg, "reset" ) == 0 )
     {
         Serial.print( "Usage: reset\r\n" );
@@ -748,7 +1033,8 @@ void Commands::help( const char*const arg )
     if ( strcmp( arg, "snap" ) == 0 )
     {
         Serial.print( "Usage: snap [N]\r\n" );
-        Serial.print( "Snap one image or N images in a burst.\r\n" );
+        Serial.print( "Snap one image or N images in a burst. If the camera is off, it\r\n" );
+        Serial.print( "powers up first, and the images are shot once it is ready.\r\n" );
         return;
     }
     if ( strcmp( arg, "lasermode" ) == 0 )
@@ -765,6 +1051,21 @@ void Commands::help( const char*const arg )
         Serial.print( "Show the burst size or set it to N frames.\r\n" );
         return;
     }
+    if ( strcmp( arg, "spacing" ) == 0 )
+    {
+        Serial.print( "Usage: spacing [M]\r\n" );
+        Serial.print( "Show the depth between frames, or set with M in m. While set, the\r\n" );
+        Serial.print( "frame interval follows the descent rate, from the minimum interval\r\n" );
+        Serial.print( "up to 'maxinterval'. Use 0 for a fixed 'interval'.\r\n" );
+        return;
+    }
+    if ( strcmp( arg, "startdepth" ) == 0 )
+    {
+        Serial.print( "Usage: startdepth [M]\r\n" );
+        Serial.print( "Show the depth at which an armed device starts running, or set with\r\n" );
+        Serial.print( "M in m.\r\n" );
+        return;
+    }
     if ( strcmp( arg, "start" ) == 0 )
     {
         Serial.print( "Usage: start\r\n" );
@@ -783,6 +1084,13 @@ void Commands::help( const char*const arg )
         Serial.print( "Stop running.\r\n" );
         return;
     }
+    if ( strcmp( arg, "stream" ) == 0 )
+    {
+        Serial.print( "Usage: stream [on|off]\r\n" );
+        Serial.print( "Show or set whether a binary telemetry frame is sent after each\r\n" );
+        Serial.print( "data log record, for the 'pltstream' host tool.\r\n" );
+        return;
+    }
     if ( strcmp( arg, "tail" ) == 0 )
     {
         Serial.print( "Usage: tail PATH\r\n" );
@@ -858,7 +1166,7 @@ void Commands::hwinfo( )
 #else
     Serial.printf( "  %-20s %ld bytes\r\n",
         "Free heap",
-        getFreeHeapMemory( ) );
+        (long) getFreeHeapMemory( ) );
 #endif
 
     // Storage card.
@@ -898,6 +1206,10 @@ void Commands::hwinfo( )
             "In use",
             uint64ToString( sdcardInUse ),
             FileSystem::getSpaceUsedPercent( ) );
+
+        Serial.printf( "  %-20s %s bytes\r\n",
+            "Free",
+            uint64ToString( FileSystem::getFreeSpace( ) ) );
     }
 
     // Components (sensors).
@@ -1024,18 +1336,18 @@ void Commands::status( )
     Serial.print( "Usage:\r\n" );
     Serial.printf( "  %-20s %ld boots, %ld seconds powered on, %d events logged\r\n",
         "Device",
-        usage.numberOfBoots,
-        usage.controllerUptimeSeconds,
+        (long) usage.numberOfBoots,
+        (long) usage.controllerUptimeSeconds,
         usage.numberOfEventsLogged );
     Serial.printf( "  %-20s %ld boots, %ld seconds powered on, %d images shot\r\n",
         "Camera",
-        Camera::getNumberOfPowerOns( ),
-        Camera::getUptimeSeconds( ),
+        (long) Camera::getNumberOfPowerOns( ),
+        (long) Camera::getUptimeSeconds( ),
         usage.numberOfImagesSnapped );
     Serial.printf( "  %-20s %ld boots, %ld seconds powered on\r\n",
         "Laser",
-        Laser::getNumberOfPowerOns( ),
-        Laser::getUptimeSeconds( ) );
+        (long) Laser::getNumberOfPowerOns( ),
+        (long) Laser::getUptimeSeconds( ) );
 #endif
 
     // Settings.
@@ -1046,7 +1358,18 @@ void Commands::status( )
 
     Serial.printf( "  %-20s %ld ms\r\n",
         "Image interval",
-        getFrameInterval( ) );
+        (long) getFrameInterval( ) );
+    if ( getFrameSpacing( ) > 0.0 )
+        Serial.printf( "  %-20s %.3f m, interval up to %ld ms\r\n",
+            "Image spacing",
+            getFrameSpacing( ),
+            (long) getMaximumFrameInterval( ) );
+    else
+        Serial.printf( "  %-20s Off. Fixed image interval.\r\n",
+            "Image spacing" );
+    Serial.printf( "  %-20s %.2f m\r\n",
+        "Start depth",
+        getStartDepth( ) );
     if ( isLaserContinuous( ) )
         Serial.printf( "  %-20s Continuous. Laser on for whole run.\r\n",
             "Laser mode" );
@@ -1071,7 +1394,38 @@ void Commands::status( )
 
     Serial.printf( "  %-20s %s\r\n",
         "Camera power",
-        (Camera::isPowerOn( ) ? "on" : "off") );
+        (Camera::isReady( ) ? "on" :
+        (Camera::isPowerOn( ) ? "powering up" : "off")) );
+
+    Serial.printf( "  %-20s %s\r\n",
+        "Armed",
+        (isArmed( ) ? "yes" : "no") );
+
+    if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
+        Serial.printf( "  %-20s %.3f m/s, image interval %ld ms\r\n",
+            "Descent rate",
+            getDescentRate( ),
+            (long) getScheduledInterval( ) );
+
+    if ( FileSystem::isInitialized( ) )
+        Serial.printf( "  %-20s %s bytes, about %ld minutes of logging\r\n",
+            "SD card free",
+            uint64ToString( FileSystem::getFreeSpace( ) ),
+            (long) (Planner::getCardSeconds( Planner::getInterval( ) ) / 60) );
+
+    if ( Mission::isLoaded( ) )
+    {
+        if ( Mission::getActiveSegment( ) == Mission::NO_SEGMENT )
+            Serial.printf( "  %-20s No segment. Following the settings.\r\n",
+                "Mission" );
+        else
+            Serial.printf( "  %-20s Segment %d, %d images every %ld ms, laser %s\r\n",
+                "Mission",
+                Mission::getActiveSegment( ) + 1,
+                Mission::getBurstSize( getBurstSize( ) ),
+                (long) getScheduledInterval( ),
+                Mission::isLaserContinuous( isLaserContinuous( ) ) ? "continuous" : "normal" );
+    }
 
     if ( getSoftwareStatus( ) != SOFTWARE_RUNNING )
         Serial.printf( "  %-20s off\r\n",
@@ -1084,7 +1438,7 @@ void Commands::status( )
 
         Serial.printf( "  %-20s %ld\r\n",
             "Log entries",
-            FileSystem::getNumberOfDataLogEntries( ) );
+            (long) FileSystem::getNumberOfDataLogEntries( ) );
     }
 }
 
@@ -1092,6 +1446,115 @@ void Commands::status( )
 
 
 
+/**
+ * Prints the run forecast to the serial port.
+ *
+ * @param[in] arg
+ *   The frame interval to forecast at, if any.
+ */
+void Commands::plan( const char*const arg )
+{
+    uint32_t interval = Planner::getInterval( );
+    if ( *arg != '\0' )
+    {
+        interval = atol( arg );
+        if ( interval < MINIMUM_FRAME_INTERVAL )
+        {
+            Serial.printf( "Frame interval must be at least %d ms.\r\n",
+                MINIMUM_FRAME_INTERVAL );
+            return;
+        }
+    }
+    Serial.printf( "Forecast at %ld ms frame interval, %d image bursts:\r\n",
+        (long) interval,
+        getBurstSize( ) );
+
+    // SD card.
+    if ( !FileSystem::isInitialized( ) )
+        Serial.printf( "  %-20s ** Not found\r\n", "SD card" );
+    else
+    {
+        Serial.printf( "  %-20s %s bytes free, %ld bytes per row (%s)\r\n",
+            "SD card",
+            uint64ToString( FileSystem::getFreeSpace( ) ),
+            (long) Planner::getBytesPerRow( ),
+            (FileSystem::getBytesPerRow( ) == 0) ? "estimated" : "measured" );
+        Serial.printf( "  %-20s %s frames, %s\r\n",
+            "",
+            uint64ToString( Planner::getCardFrames( ) ),
+            minutesToString( Planner::getCardSeconds( interval ) ) );
+    }
+
+    // Batteries.
+    if ( !Battery::isMainPresent( ) )
+        Serial.printf( "  %-20s ** %s not found\r\n",
+            "Main battery",
+            Battery::getMainMonitorName( ) );
+    else
+        Serial.printf( "  %-20s %.1f%%, %.1f%% per hour (%s), %s\r\n",
+            "Main battery",
+            Battery::getSampledMainPercent( ),
+            Planner::getMainDrain( interval ),
+            Planner::isMainDrainMeasured( ) ? "measured" : "modeled",
+            minutesToString( Planner::getMainSeconds( interval ) ) );
+
+    if ( !Battery::isControllerPresent( ) )
+        Serial.printf( "  %-20s ** %s not found\r\n",
+            "Controller battery",
+            Battery::getControllerMonitorName( ) );
+    else if ( Battery::getControllerDischargeRate( ) <= 0.0 )
+        Serial.printf( "  %-20s %.1f%%, drain not measured yet\r\n",
+            "Controller battery",
+            Battery::getSampledControllerPercent( ) );
+    else
+        Serial.printf( "  %-20s %.1f%%, %.1f%% per hour (measured), %s\r\n",
+            "Controller battery",
+            Battery::getSampledControllerPercent( ),
+            Battery::getControllerDischargeRate( ),
+            minutesToString( Planner::getControllerSeconds( ) ) );
+
+    // The run as a whole.
+    const uint32_t wanted  = Planner::getSecondsWanted( );
+    const uint32_t seconds = Planner::getSeconds( interval );
+    Serial.printf( "  %-20s %s, of %ld minutes wanted\r\n",
+        "Run",
+        minutesToString( seconds ),
+        (long) (wanted / 60) );
+    if ( seconds >= wanted )
+        Serial.printf( "  %-20s Fits.\r\n", "" );
+    else
+    {
+        const uint32_t fitting = Planner::findInterval( wanted );
+        if ( fitting == 0 )
+            Serial.printf( "  %-20s Does not fit, even at the maximum frame interval.\r\n",
+                "" );
+        else
+            Serial.printf( "  %-20s Fits at %ld ms frame interval.\r\n",
+                "",
+                (long) fitting );
+    }
+}
+
+/**
+ * Prints the mission plan to the serial port.
+ *
+ * Unless running, the plan is loaded from the SD card first, so that
+ * it can be checked before a run.
+ */
+void Commands::mission( )
+{
+    if ( getSoftwareStatus( ) != SOFTWARE_RUNNING )
+    {
+        if ( !FileSystem::isInitialized( ) )
+        {
+            Serial.print( "SD card not found.\r\n" );
+            return;
+        }
+        Mission::load( );
+    }
+    Mission::print( );
+}
+
 /**
  * Prints current sensor readings to the serial port.
  */
@@ -1151,6 +1614,9 @@ void Commands::sensors( )
 /**
  * Snaps a photo, if the device is not imaging.
  *
+ * The snap is queued to start once the camera is ready, so this returns
+ * without waiting for the camera to power up.
+ *
  * @param[in] nImages
  *   The number of images in a burst.
  */
@@ -1174,14 +1640,27 @@ void Commands::snap( const uint16_t nImages )
         Serial.print( "Cannot snap a photo while imaging is in progress.\r\n" );
         return;
     }
+    if ( isArmed( ) )
+    {
+        Serial.print( "Cannot snap a photo while armed. Use 'arm off'.\r\n" );
+        return;
+    }
 
-    Serial.print( "Camera powering up...\r\n" );
-    snapAndLog( nImages );
+    const bool ready = Camera::isReady( );
+    if ( !queueSnapAndLog( nImages ) )
+    {
+        Serial.print( "Cannot snap a photo while snapping.\r\n" );
+        return;
+    }
 
+    if ( !ready )
+        Serial.print( "Camera powering up. " );
     if ( nImages == 1 )
-        Serial.print( "One image shot.\r\n" );
+        Serial.printf( "Shooting one image%s.\r\n",
+            ready ? "" : " when it is ready" );
     else
-        Serial.printf( "%d images shot.\r\n", nImages );
+        Serial.printf( "Shooting %d images%s.\r\n", nImages,
+            ready ? "" : " when it is ready" );
 }
 
 
@@ -1212,6 +1691,8 @@ void Commands::start( )
         return;
     }
 
+    // A manual start takes over from armed mode.
+    setArmed( false );
     startRunning( );
 }
 
@@ -1230,6 +1711,12 @@ void Commands::stop( )
         Serial.print( "Still booting. Not yet ready.\r\n" );
         return;
     }
+    // A manual stop also disarms, so that a drop is not restarted.
+    if ( isArmed( ) )
+    {
+        setArmed( false );
+        Serial.print( "Disarmed.\r\n" );
+    }
     if ( getSoftwareStatus( ) != SOFTWARE_RUNNING )
     {
         Serial.print( "Device is already stopped.\r\n" );
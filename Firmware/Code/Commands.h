@@ -115,6 +115,16 @@ private:
      */
     static const char* uint64ToString( uint64_t value );
 
+    /**
+     * Formats a forecast time in whole minutes.
+     *
+     * @param[in] seconds
+     *   The time, in seconds, or UINT32_MAX for no limit.
+     * @return
+     *   Returns a string version of the time.
+     */
+    static const char* minutesToString( const uint32_t seconds );
+
     /**
      * Updates the device status based upon a current condition.
      */
@@ -184,6 +194,22 @@ public:
      */
     static void status( );
 
+    /**
+     * Prints the run forecast to the serial port.
+     *
+     * @param[in] arg
+     *   The frame interval to forecast at, if any.
+     */
+    static void plan( const char*const arg );
+
+    /**
+     * Prints the mission plan to the serial port.
+     *
+     * Unless running, the plan is loaded from the SD card first, so that
+     * it can be checked before a run.
+     */
+    static void mission( );
+
     /**
      * Prints current sensor readings to the serial port.
      */
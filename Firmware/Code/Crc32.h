@@ -0,0 +1,70 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * Computes CRC-32 checksums.
+ *
+ * The checksum is the common IEEE 802.3 CRC-32 (as used by zlib, PNG,
+ * and Ethernet), so values can be checked by standard tools on a host.
+ *
+ * The checksum is computed a nibble at a time using a 16-entry table.
+ * This is much faster than a bit at a time, but avoids the 1 KB table
+ * of a byte at a time version that would otherwise use scarce RAM.
+ *
+ * This header has no Arduino dependencies so that host-side tools can
+ * use it as well.
+ */
+class Crc32
+{
+private:
+    Crc32( ) = delete;
+    Crc32( const Crc32& ) = delete;
+    Crc32& operator=( const Crc32& ) = delete;
+
+
+//----------------------------------------------------------------------
+// Methods.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Computes or continues a CRC-32 checksum.
+     *
+     * To checksum data in pieces, pass the value returned for one piece
+     * as the starting value for the next.
+     *
+     * @param[in] data
+     *   The data to checksum.
+     * @param[in] nBytes
+     *   The number of bytes of data.
+     * @param[in] crc
+     *   The checksum of preceding data, or zero to start a new checksum.
+     *
+     * @return
+     *   Returns the checksum.
+     */
+    static inline uint32_t compute(
+        const void*const data,
+        const size_t nBytes,
+        uint32_t crc = 0 )
+    {
+        static const uint32_t table[16] =
+        {
+            0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+            0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+            0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+            0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+        };
+
+        const uint8_t* bytes = (const uint8_t*) data;
+        crc = ~crc;
+        for ( size_t i = 0; i < nBytes; ++i )
+        {
+            crc ^= bytes[i];
+            crc = (crc >> 4) ^ table[crc & 0x0F];
+            crc = (crc >> 4) ^ table[crc & 0x0F];
+        }
+        return ~crc;
+    }
+};
@@ -0,0 +1,161 @@
+#include "DropDetector.h"
+
+uint32_t DropDetector::windowFirstRows[DROP_MEDIAN_WINDOW];
+uint32_t DropDetector::windowLastRows[DROP_MEDIAN_WINDOW];
+uint32_t DropDetector::windowSeconds[DROP_MEDIAN_WINDOW];
+float DropDetector::windowDepths[DROP_MEDIAN_WINDOW];
+uint8_t DropDetector::windowNext = 0;
+uint8_t DropDetector::windowCount = 0;
+bool DropDetector::inDrop = false;
+DropRecord DropDetector::drop;
+uint16_t DropDetector::numberOfDrops = 0;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Detect.
+//----------------------------------------------------------------------
+/**
+ * Starts afresh for a new data log.
+ *
+ * @see add()
+ */
+void DropDetector::reset( )
+{
+    windowNext    = 0;
+    windowCount   = 0;
+    inDrop        = false;
+    numberOfDrops = 0;
+}
+
+/**
+ * Adds a snap-and-log's data log rows.
+ *
+ * The rows of a burst share a depth, so they are added together.
+ *
+ * @param[in] firstRow
+ *   The index in the data log of the burst's first row, from 0.
+ * @param[in] lastRow
+ *   The index of the burst's last row.
+ * @param[in] seconds
+ *   The first row's time stamp, in seconds since 1970.
+ * @param[in] depth
+ *   The rows' depth, in m.
+ *
+ * @see finish()
+ */
+void DropDetector::add( const uint32_t firstRow, const uint32_t lastRow,
+    const uint32_t seconds, const float depth )
+{
+    windowFirstRows[windowNext] = firstRow;
+    windowLastRows[windowNext]  = lastRow;
+    windowSeconds[windowNext]   = seconds;
+    windowDepths[windowNext]    = depth;
+    windowNext = (windowNext + 1) % DROP_MEDIAN_WINDOW;
+    if ( windowCount < DROP_MEDIAN_WINDOW )
+    {
+        ++windowCount;
+        if ( windowCount < DROP_MEDIAN_WINDOW )
+            return;
+    }
+
+    // The window is full. Its oldest row is at windowNext, so its middle
+    // row is HALF_WINDOW after that.
+    update( (windowNext + HALF_WINDOW) % DROP_MEDIAN_WINDOW, getMedianDepth( ) );
+}
+
+/**
+ * Ends a drop in progress, if any, at the most recent row.
+ *
+ * This should be called before the data log is closed.
+ *
+ * @see add()
+ */
+void DropDetector::finish( )
+{
+    if ( inDrop )
+    {
+        // The rows after the window's middle have not been smoothed yet.
+        // Take them as part of the drop.
+        for ( uint8_t i = 0; i < HALF_WINDOW; ++i )
+        {
+            const uint8_t index =
+                (windowNext + DROP_MEDIAN_WINDOW - HALF_WINDOW + i) % DROP_MEDIAN_WINDOW;
+            drop.endRow     = windowLastRows[index];
+            drop.endSeconds = windowSeconds[index];
+            if ( windowDepths[index] > drop.maximumDepth )
+                drop.maximumDepth = windowDepths[index];
+        }
+        endDrop( );
+    }
+    windowCount = 0;
+    windowNext  = 0;
+}
+
+/**
+ * Returns the median depth of the window.
+ *
+ * @return
+ *   Returns the median, in m.
+ */
+float DropDetector::getMedianDepth( )
+{
+    // Insertion sort a copy. The window is small.
+    float sorted[DROP_MEDIAN_WINDOW];
+    for ( uint8_t i = 0; i < DROP_MEDIAN_WINDOW; ++i )
+    {
+        const float depth = windowDepths[i];
+        uint8_t j = i;
+        for ( ; j > 0 && sorted[j - 1] > depth; --j )
+            sorted[j] = sorted[j - 1];
+        sorted[j] = depth;
+    }
+    return sorted[HALF_WINDOW];
+}
+
+/**
+ * Updates the drop state with the smoothed depth of a row.
+ *
+ * @param[in] index
+ *   The row's index in the window.
+ * @param[in] smoothedDepth
+ *   The row's smoothed depth, in m.
+ */
+void DropDetector::update( const uint8_t index, const float smoothedDepth )
+{
+    if ( !inDrop )
+    {
+        if ( smoothedDepth < DROP_START_DEPTH )
+            return;
+        inDrop = true;
+        drop.number       = numberOfDrops + 1;
+        drop.startRow     = windowFirstRows[index];
+        drop.startSeconds = windowSeconds[index];
+        drop.maximumDepth = windowDepths[index];
+    }
+    else if ( smoothedDepth < DROP_START_DEPTH - DROP_HYSTERESIS )
+    {
+        endDrop( );
+        return;
+    }
+
+    drop.endRow     = windowLastRows[index];
+    drop.endSeconds = windowSeconds[index];
+    if ( windowDepths[index] > drop.maximumDepth )
+        drop.maximumDepth = windowDepths[index];
+}
+
+/**
+ * Writes the drop in progress if it is long enough, and ends it.
+ */
+void DropDetector::endDrop( )
+{
+    inDrop = false;
+    if ( (drop.endSeconds - drop.startSeconds) < DROP_MINIMUM_DURATION )
+        return;     // Too short to be a real drop.
+
+    ++numberOfDrops;
+    FileSystem::writeDropLog( drop );
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <Arduino.h>
+
+#include "pltlogger.h"
+#include "FileSystem.h"
+
+
+/**
+ * Finds drops in the data log as it is written.
+ *
+ * This is a streaming version of the Data Processing DropDetect.py
+ * script. Each snap-and-log's depth goes into a window of the most
+ * recent DROP_MEDIAN_WINDOW snap-and-logs. The rows of a burst share
+ * their depth, so they count as one. The window's median is the smoothed
+ * depth of the row at its middle, as with the script's centered rolling
+ * median. A drop starts at the first row whose smoothed depth reaches
+ * DROP_START_DEPTH, and ends at the last row before it comes back above
+ * DROP_START_DEPTH - DROP_HYSTERESIS. The hysteresis keeps a drop that
+ * hovers near the threshold from being split.
+ *
+ * Drops that last at least DROP_MINIMUM_DURATION are written to the drop
+ * index file that goes with the data log (see FileSystem::writeDropLog()).
+ * A drop still in progress when the run stops ends at the last row.
+ *
+ * Adding a row sorts a copy of the window, a few dozen compares, so this
+ * runs in the snap-and-log without affecting its timing.
+ */
+class DropDetector
+{
+private:
+    DropDetector( ) = delete;
+    DropDetector( const DropDetector& ) = delete;
+    DropDetector& operator=( const DropDetector& ) = delete;
+
+
+//----------------------------------------------------------------------
+// Constants.
+//----------------------------------------------------------------------
+private:
+    // The row at the middle of the window.
+    static const uint8_t HALF_WINDOW = DROP_MEDIAN_WINDOW / 2;
+
+
+//----------------------------------------------------------------------
+// Fields.
+//----------------------------------------------------------------------
+private:
+    // The most recent snap-and-logs' rows, as a ring. The oldest is at
+    // windowNext once the window is full.
+    static uint32_t windowFirstRows[DROP_MEDIAN_WINDOW];
+    static uint32_t windowLastRows[DROP_MEDIAN_WINDOW];
+    static uint32_t windowSeconds[DROP_MEDIAN_WINDOW];
+    static float windowDepths[DROP_MEDIAN_WINDOW];
+    static uint8_t windowNext;
+    static uint8_t windowCount;
+
+    // The drop in progress, if any.
+    static bool inDrop;
+    static DropRecord drop;
+
+    // The number of drops written for the current data log.
+    static uint16_t numberOfDrops;
+
+
+//----------------------------------------------------------------------
+// Detect.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Starts afresh for a new data log.
+     *
+     * @see add()
+     */
+    static void reset( );
+
+    /**
+     * Adds a snap-and-log's data log rows.
+     *
+     * The rows of a burst share a depth, so they are added together.
+     *
+     * @param[in] firstRow
+     *   The index in the data log of the burst's first row, from 0.
+     * @param[in] lastRow
+     *   The index of the burst's last row.
+     * @param[in] seconds
+     *   The first row's time stamp, in seconds since 1970.
+     * @param[in] depth
+     *   The rows' depth, in m.
+     *
+     * @see finish()
+     */
+    static void add( const uint32_t firstRow, const uint32_t lastRow,
+        const uint32_t seconds, const float depth );
+
+    /**
+     * Ends a drop in progress, if any, at the most recent row.
+     *
+     * This should be called before the data log is closed.
+     *
+     * @see add()
+     */
+    static void finish( );
+
+private:
+    /**
+     * Returns the median depth of the window.
+     *
+     * @return
+     *   Returns the median, in m.
+     */
+    static float getMedianDepth( );
+
+    /**
+     * Updates the drop state with the smoothed depth of a row.
+     *
+     * @param[in] index
+     *   The row's index in the window.
+     * @param[in] smoothedDepth
+     *   The row's smoothed depth, in m.
+     */
+    static void update( const uint8_t index, const float smoothedDepth );
+
+    /**
+     * Writes the drop in progress if it is long enough, and ends it.
+     */
+    static void endDrop( );
+};
@@ -1,13 +1,13 @@
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "pins.h"
 #include "FileSystem.h"
 #include "Clock.h"
-
-#if defined(BATTERY_IN_DATA_LOG)
-#include "Battery.h"
-#endif
+#include "Crc32.h"
+#include "Mission.h"
+#include "Perf.h"
 
 
 //----------------------------------------------------------------------
@@ -42,16 +42,128 @@
 //----------------------------------------------------------------------
 // Constants.
 //----------------------------------------------------------------------
-const char*const FileSystem::DATA_LOG_FILENAME_FORMAT = "DATA_%02d.CSV";
+#if defined(DATA_LOG_BINARY)
+const char*const FileSystem::DATA_LOG_FILENAME_FORMAT = "DATA_%03d.BIN";
+#else
+const char*const FileSystem::DATA_LOG_FILENAME_FORMAT = "DATA_%03d.CSV";
+#endif
 
-const char*const FileSystem::SETTINGS_FILENAME = "SETTINGS.TXT";
+const char*const FileSystem::DROP_LOG_FILENAME_FORMAT = "DROP_%03d.CSV";
 
-#if defined(ENABLE_USAGE_TRACKING)
-const char*const FileSystem::USAGE_FILENAME = "USAGE.TXT";
+#if defined(ENABLE_IMU_STREAM)
+const char*const FileSystem::IMU_LOG_FILENAME_FORMAT = "IMU_%03d.BIN";
 #endif
 
+const char*const FileSystem::JOURNAL_FILENAMES[2] = { "SETTINGA.TXT", "SETTINGB.TXT" };
+
+const char*const FileSystem::JOURNAL_KEYS[NUMBER_OF_KEYS] =
+{
+    "interval",
+    "burstsize",
+    "lasercontinuous",
+    "spacing",
+    "maxinterval",
+    "startdepth",
+    "numberOfBoots",
+    "numberOfCameraBoots",
+    "numberOfLaserBoots",
+    "numberOfEventsLogged",
+    "numberOfImagesSnapped",
+    "controllerUptimeSeconds",
+    "cameraUptimeSeconds",
+    "laserUptimeSeconds"
+};
+
+const char*const FileSystem::MISSION_FILENAME = "MISSION.TXT";
+
+const char*const FileSystem::SETTINGS_FILENAME = "SETTINGS.TXT";
+const char*const FileSystem::USAGE_FILENAME = "USAGE.TXT";
+
 const char*const FileSystem::STATUS_LOG_FILENAME = "STATUS.TXT";
 
+// Data log columns, in CSV column order. CSV rows and binary file headers
+// are both built from this table. The printf() formats are those of the
+// original CSV rows, so CSV files, and CSV files decoded from binary
+// files, are unchanged.
+const LogColumn FileSystem::DATA_LOG_COLUMNS[] =
+{
+    { "Timestamp",          "",      "\"%s\"",  LOG_TYPE_TIME,   0, offsetof( DataLogRecord, seconds ) },
+    { "Milliseconds",       "ms",    "%ld",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, milliseconds ) },
+    { "Frame_Micros",       "us",    "%lu",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, frameMicros ) },
+    { "Burst_Image",        "",      "%lu",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, burstImage ) },
+    { "Shutter_Press",      "us",    "%lu",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, shutterPress ) },
+    { "Frame_Lateness",     "ms",    "%lu",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, frameLateness ) },
+    { "Skipped_Frames",     "",      "%lu",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, skippedFrames ) },
+    { "Pressure",           "mbar",  "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, pressure ) },
+    { "Depth",              "m",     "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, depth ) },
+    { "Descent_Rate",       "m/s",   "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, descentRate ) },
+    { "Frame_Interval",     "ms",    "%lu",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, nextFrameInterval ) },
+    { "Water_Temperature",  "C",     "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, waterTemperature ) },
+    { "Device_Temperature", "C",     "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, deviceTemperature ) },
+    { "Acceleration_X",     "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, accel[0] ) },
+    { "Acceleration_Y",     "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, accel[1] ) },
+    { "Acceleration_Z",     "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, accel[2] ) },
+    { "Magnetic_X",         "gauss", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, mag[0] ) },
+    { "Magnetic_Y",         "gauss", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, mag[1] ) },
+    { "Magnetic_Z",         "gauss", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, mag[2] ) },
+    { "Gyroscope_X",        "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, gyro[0] ) },
+    { "Gyroscope_Y",        "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, gyro[1] ) },
+    { "Gyroscope_Z",        "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, gyro[2] ) },
+#if defined(ENABLE_IMU_FIFO)
+    { "IMU_Samples",        "",      "%ld",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, inertiaStats.numberOfSamples ) },
+    { "IMU_Overruns",       "",      "%ld",     LOG_TYPE_UINT32, 0, offsetof( DataLogRecord, inertiaStats.numberOfOverruns ) },
+    { "Acceleration_X_Mean",  "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMean[0] ) },
+    { "Acceleration_Y_Mean",  "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMean[1] ) },
+    { "Acceleration_Z_Mean",  "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMean[2] ) },
+    { "Acceleration_X_Min",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMin[0] ) },
+    { "Acceleration_Y_Min",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMin[1] ) },
+    { "Acceleration_Z_Min",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMin[2] ) },
+    { "Acceleration_X_Max",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMax[0] ) },
+    { "Acceleration_Y_Max",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMax[1] ) },
+    { "Acceleration_Z_Max",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelMax[2] ) },
+    { "Acceleration_X_RMS",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelRms[0] ) },
+    { "Acceleration_Y_RMS",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelRms[1] ) },
+    { "Acceleration_Z_RMS",   "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.accelRms[2] ) },
+    { "Gyroscope_X_Mean",     "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMean[0] ) },
+    { "Gyroscope_Y_Mean",     "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMean[1] ) },
+    { "Gyroscope_Z_Mean",     "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMean[2] ) },
+    { "Gyroscope_X_Min",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMin[0] ) },
+    { "Gyroscope_Y_Min",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMin[1] ) },
+    { "Gyroscope_Z_Min",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMin[2] ) },
+    { "Gyroscope_X_Max",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMax[0] ) },
+    { "Gyroscope_Y_Max",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMax[1] ) },
+    { "Gyroscope_Z_Max",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroMax[2] ) },
+    { "Gyroscope_X_RMS",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroRms[0] ) },
+    { "Gyroscope_Y_RMS",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroRms[1] ) },
+    { "Gyroscope_Z_RMS",      "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, inertiaStats.gyroRms[2] ) },
+#endif
+#if defined(BATTERY_IN_DATA_LOG)
+    { "Controller_Volts",   "V",     "%5.3f",   LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, controllerVoltage ) },
+    { "Controller_Percent", "%",     "%3.1f",   LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, controllerPercent ) },
+    { "Main_Volts",         "V",     "%5.3f",   LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, mainVoltage ) },
+    { "Main_Percent",       "%",     "%3.1f",   LOG_TYPE_FLOAT,  0, offsetof( DataLogRecord, mainPercent ) },
+#endif
+};
+const uint16_t FileSystem::NUMBER_OF_DATA_LOG_COLUMNS =
+    sizeof( DATA_LOG_COLUMNS ) / sizeof( DATA_LOG_COLUMNS[0] );
+
+#if defined(ENABLE_IMU_STREAM)
+// IMU stream columns, in CSV column order.
+const LogColumn FileSystem::IMU_LOG_COLUMNS[] =
+{
+    { "Time",               "ms",    "%ld",     LOG_TYPE_UINT32, 0, offsetof( ImuLogRecord, time ) },
+    { "Frame",              "",      "%ld",     LOG_TYPE_UINT32, 0, offsetof( ImuLogRecord, frame ) },
+    { "Acceleration_X",     "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( ImuLogRecord, accel[0] ) },
+    { "Acceleration_Y",     "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( ImuLogRecord, accel[1] ) },
+    { "Acceleration_Z",     "m/s^2", "%f",      LOG_TYPE_FLOAT,  0, offsetof( ImuLogRecord, accel[2] ) },
+    { "Gyroscope_X",        "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( ImuLogRecord, gyro[0] ) },
+    { "Gyroscope_Y",        "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( ImuLogRecord, gyro[1] ) },
+    { "Gyroscope_Z",        "rad/s", "%f",      LOG_TYPE_FLOAT,  0, offsetof( ImuLogRecord, gyro[2] ) },
+};
+const uint16_t FileSystem::NUMBER_OF_IMU_LOG_COLUMNS =
+    sizeof( IMU_LOG_COLUMNS ) / sizeof( IMU_LOG_COLUMNS[0] );
+#endif
+
 
 //----------------------------------------------------------------------
 // Fields.
@@ -62,10 +174,57 @@ bool FileSystem::initialized = false;
 char FileSystem::sharedFilename[MAX_FILENAME+1];
 char FileSystem::sharedBuffer[BUFFER_SIZE];
 
+SdFile FileSystem::walkDirs[WALK_MAX_DEPTH + 1];
+char FileSystem::walkPath[WALK_MAX_PATH + 1];
+uint16_t FileSystem::walkPathEnds[WALK_MAX_DEPTH + 1];
+uint64_t FileSystem::walkBytes = 0;
+
+uint32_t FileSystem::freeClusters = 0;
+uint8_t FileSystem::clusterShift = 9;
+uint32_t FileSystem::bytesPerRow = 0;
+
+char FileSystem::journalValues[NUMBER_OF_KEYS][JOURNAL_VALUE_SIZE];
+uint16_t FileSystem::journalDirty = 0;
+uint8_t FileSystem::journalFile = 0;
+uint32_t FileSystem::journalGeneration = 0;
+bool FileSystem::journalLoaded = false;
+
 uint8_t FileSystem::cardErrorCode = SD_CARD_ERROR_INIT_NOT_CALLED;
 uint8_t FileSystem::localErrorCode = FS_ERROR_UNINITIALIZED;
 
 uint32_t FileSystem::numberOfDataLogEntries = 0;
+uint16_t FileSystem::nextDataLogNumber = 0;
+
+uint8_t FileSystem::dataLogBuffer[DATA_LOG_BUFFER_SIZE] __attribute__((aligned(4)));
+uint16_t FileSystem::dataLogBufferHead = 0;
+uint16_t FileSystem::dataLogBufferTail = 0;
+uint16_t FileSystem::dataLogBufferCount = 0;
+uint32_t FileSystem::dataLogFilePosition = 0;
+
+uint32_t FileSystem::numberOfDataLogRowsSinceSync = 0;
+uint32_t FileSystem::dataLogSyncTime = 0;
+
+#if defined(DATA_LOG_BINARY)
+uint32_t FileSystem::dataLogBlock[LOG_SECTOR_SIZE / sizeof(uint32_t)];
+uint32_t FileSystem::dataLogFileId = 0;
+#endif
+
+SdFile FileSystem::statusLogFile;
+char FileSystem::statusLogBuffer[STATUS_LOG_BUFFER_SIZE];
+uint16_t FileSystem::statusLogBufferHead = 0;
+uint16_t FileSystem::statusLogBufferTail = 0;
+uint16_t FileSystem::statusLogBufferCount = 0;
+
+uint8_t FileSystem::frameInput[sizeof(FrameHeader) + sizeof(uint32_t)];
+uint8_t FileSystem::frameInputCount = 0;
+
+SdFile FileSystem::dropLogFile;
+
+#if defined(ENABLE_IMU_STREAM)
+SdFile FileSystem::imuLogFile;
+uint32_t FileSystem::imuLogBlock[LOG_SECTOR_SIZE / sizeof(uint32_t)];
+uint32_t FileSystem::imuLogFileId = 0;
+#endif
 
 
 
@@ -133,6 +292,18 @@ bool FileSystem::init( )
         localErrorCode = FS_ERROR_NONE;
         cardErrorCode  = SD_CARD_ERROR_NONE;
         initialized    = true;
+        scanDataLogs( );
+
+        // Count free clusters once, here. From now on, file changes made
+        // here keep the count current.
+        clusterShift = 0;
+        while ( (1UL << clusterShift) < sd.bytesPerCluster( ) )
+            ++clusterShift;
+        freeClusters = 0;
+        recountFreeClusters( );
+
+        // A power loss may have left the latest data log open.
+        repairDataLog( );
     }
 
     return initialized;
@@ -157,6 +328,9 @@ bool FileSystem::init( )
  */
 bool FileSystem::format( )
 {
+    // Close the status log before its file is erased.
+    closeStatus( );
+
     initialized    = false;
     localErrorCode = FS_ERROR_UNINITIALIZED;
     cardErrorCode  = SD_CARD_ERROR_INIT_NOT_CALLED;
@@ -308,18 +482,257 @@ int16_t FileSystem::readLine( SdFile& file )
 
 
 
+//----------------------------------------------------------------------
+// Free space.
+//----------------------------------------------------------------------
+/**
+ * Opens a file for writing, creating it or emptying it.
+ *
+ * @param[out] file
+ *   The file to open.
+ * @param[in] path
+ *   The path of the file.
+ *
+ * @return
+ *   Returns true on success, and false if the file cannot be created
+ *   or emptied.
+ */
+bool FileSystem::createFile( SdFile& file, const char*const path )
+{
+    // Rather than opening with O_TRUNC, empty an existing file here so
+    // that the clusters it frees are counted.
+    if ( !file.open( path, O_WRONLY|O_CREAT ) )
+        return false;
+    const uint32_t size = file.fileSize( );
+    if ( size == 0 )
+        return true;
+    if ( !file.truncate( 0 ) )
+    {
+        file.close( );
+        return false;
+    }
+    trackFileSize( size, 0 );
+    return true;
+}
+
+/**
+ * Writes bytes to an open file, and counts any clusters it gains.
+ *
+ * @param[in,out] file
+ *   The file to write.
+ * @param[in] bytes
+ *   The bytes to write.
+ * @param[in] nBytes
+ *   The number of bytes to write.
+ *
+ * @return
+ *   Returns true on success, and false if not all bytes were written.
+ */
+bool FileSystem::writeFile( SdFile& file, const void*const bytes,
+    const uint32_t nBytes )
+{
+    // A failed write may still have added clusters, so count them either
+    // way. Writes within a pre-allocated extent do not change the size.
+    const uint32_t size = file.fileSize( );
+    const bool status = file.write( bytes, nBytes ) == nBytes;
+    trackFileSize( size, file.fileSize( ) );
+    return status;
+}
+
+/**
+ * Truncates an open file, and counts the clusters it frees.
+ *
+ * @param[in,out] file
+ *   The file to truncate.
+ * @param[in] length
+ *   The new file length, in bytes.
+ *
+ * @return
+ *   Returns true on success, and false on I/O errors.
+ */
+bool FileSystem::truncateFile( SdFile& file, const uint32_t length )
+{
+    const uint32_t size = file.fileSize( );
+    if ( !file.truncate( length ) )
+        return false;
+    trackFileSize( size, length );
+    return true;
+}
+
+/**
+ * Removes a closed file, and counts the clusters it frees.
+ *
+ * @param[in] path
+ *   The path of the file.
+ *
+ * @return
+ *   Returns true on success, and false if the file cannot be removed.
+ */
+bool FileSystem::removeFile( const char*const path )
+{
+    // Open the file to find its size. Removing needs write access.
+    SdFile file;
+    if ( !file.open( path, O_WRONLY ) )
+        return false;
+    const uint32_t size = file.fileSize( );
+    if ( !file.remove( ) )
+    {
+        file.close( );
+        return false;
+    }
+    trackFileSize( size, 0 );
+    return true;
+}
+
+/**
+ * Counts the SD card's free clusters again from the FAT.
+ *
+ * The kept count is replaced. This is slow on a large card, since it
+ * reads the whole FAT.
+ *
+ * @return
+ *   Returns the counted free clusters less the kept count before the
+ *   recount. This is zero if the kept count was right.
+ *
+ * @see getFreeSpace()
+ */
+int32_t FileSystem::recountFreeClusters( )
+{
+    if ( !initialized )
+        return 0;
+
+    // The count is negative on an I/O error. Keep the old count then.
+    const int32_t count = sd.freeClusterCount( );
+    if ( count < 0 )
+        return 0;
+    const int32_t drift = count - (int32_t)freeClusters;
+    freeClusters = count;
+    return drift;
+}
+
+/**
+ * Returns the SD card space taken per data log row.
+ *
+ * This is measured from the current data log, or else the most recent
+ * one, once it has PLAN_MINIMUM_ROWS rows. It includes the file
+ * header, and the IMU stream, if any.
+ *
+ * @return
+ *   Returns the size, in bytes, or 0 if it has not been measured.
+ */
+uint32_t FileSystem::getBytesPerRow( )
+{
+    if ( isDataLogOpen( ) && numberOfDataLogEntries >= PLAN_MINIMUM_ROWS )
+    {
+        uint32_t nBytes = dataLogFilePosition + dataLogBufferCount;
+#if defined(ENABLE_IMU_STREAM)
+        if ( isImuLogOpen( ) )
+            nBytes += imuLogFile.curPosition( );
+#endif
+        bytesPerRow = nBytes / numberOfDataLogEntries;
+    }
+    return bytesPerRow;
+}
+
+/**
+ * Returns the space left in the current data log's pre-allocated
+ * extent.
+ *
+ * This space is already counted as in use, but rows still fit in it.
+ *
+ * @return
+ *   Returns the size, in bytes, or 0 if there is no data log or it
+ *   has outgrown its extent.
+ */
+uint32_t FileSystem::getDataLogSpaceLeft( )
+{
+    if ( !isDataLogOpen( ) )
+        return 0;
+    const uint32_t position = dataLogFilePosition + dataLogBufferCount;
+    const uint32_t size = logFile.fileSize( );
+    return (size > position) ? size - position : 0;
+}
+
+
+
+
+
 //----------------------------------------------------------------------
 // Log file.
 //----------------------------------------------------------------------
+/**
+ * Closes the current log file, if any.
+ *
+ * Buffered rows are written and synced to the card, and a pre-allocated
+ * file is truncated to its real length, before the file is closed.
+ *
+ * @see getDataLogFilename()
+ * @see getNumberOfDataLogEntries()
+ * @see isDataLogOpen()
+ * @see newDataLog()
+ * @see syncDataLog()
+ * @see writeDataLog()
+ * @see writeDataLogHeader()
+ */
+void FileSystem::closeDataLog( )
+{
+    // Keep the log's bytes per row, with its IMU stream, for planning the
+    // next run.
+    getBytesPerRow( );
+
+#if defined(ENABLE_IMU_STREAM)
+    closeImuLog( );
+#endif
+    dropLogFile.close( );
+
+    // If there is no log file, this does nothing.
+    if ( isDataLogOpen( ) )
+    {
+#if defined(DATA_LOG_BINARY)
+        // Add the last, partly filled block, if any, to the buffer.
+        if ( ((LogBlockHeader*) dataLogBlock)->numberOfRecords > 0 &&
+             !appendDataLogBlock( ) )
+        {
+            // Write failed. The log file has been closed and error codes set.
+            return;
+        }
+#endif
+        if ( !syncDataLog( ) )
+        {
+            // Sync failed. The log file has been closed and error codes set.
+            return;
+        }
+
+        // A pre-allocated file's size is that of its whole extent. Cut it
+        // back to the bytes actually written, which frees the rest of the
+        // extent.
+        if ( !truncateFile( logFile, dataLogFilePosition + dataLogBufferCount ) )
+        {
+            setDataLogWriteError( );
+            return;
+        }
+    }
+    logFile.close( );
+    numberOfDataLogEntries = 0;
+    localErrorCode = FS_ERROR_NONE;
+}
+
+
+
+
+
 /**
  * Creates a new unique data log file.
  *
- * If there is a previous log file, it is closed.
+ * If there is a previous log file, it is closed. The new file is
+ * numbered one more than the highest numbered log file on the card,
+ * and pre-allocated as a contiguous extent when the card has room (see
+ * DATA_LOG_PREALLOCATE_DURATION).
  *
  * MAX_LOG_FILES determines the maximum number of data log files, and
  * DATA_LOG_FILENAME_FORMAT is the printf() format for log file names.
- * The number of files is intentionally limited because SD card performance
- * drops quickly as the number of files increases.
+ * The number of files is limited because SD card performance drops as
+ * the number of files increases.
  *
  * @return
  *   Returns true on success. On failure, this false is returned and
@@ -342,46 +755,218 @@ bool FileSystem::newDataLog( )
         return false;
 
     // Close a prior file, if any.
-    logFile.close( );
+    closeDataLog( );
     bool status            = true;
     numberOfDataLogEntries = 0;
     localErrorCode         = FS_ERROR_NONE;
     cardErrorCode          = SD_CARD_ERROR_NONE;
 
-    // Look for the next available number for which a log file does
-    // not currently exist.
-    for ( uint16_t i = 0; i < MAX_LOG_FILES; ++i )
+    // Start with an empty data log buffer.
+    dataLogBufferHead            = 0;
+    dataLogBufferTail            = 0;
+    dataLogBufferCount           = 0;
+    dataLogFilePosition          = 0;
+    numberOfDataLogRowsSinceSync = 0;
+    dataLogSyncTime              = millis( );
+
+#if defined(DATA_LOG_BINARY)
+    // Give the file a new ID, which its blocks carry, and start the
+    // first block.
+    dataLogFileId = Clock::nowSeconds( ) ^ micros( );
+    startDataLogBlock( 0 );
+#endif
+
+    // Use the next log file number. The root directory was scanned for
+    // the highest number in use when the file system was initialized.
+    if ( nextDataLogNumber >= MAX_LOG_FILES )
+    {
+        // Too many log files.
+        localErrorCode = FS_ERROR_TOO_MANY_LOG_FILES;
+        return false;
+    }
+    const uint16_t number = nextDataLogNumber;
+    sprintf( sharedFilename, DATA_LOG_FILENAME_FORMAT, number );
+
+    // Create it and open.
+    logFile.open( sharedFilename, O_WRONLY|O_CREAT|O_EXCL );
+    if ( !logFile )
+    {
+        // File create failed.
+        cardErrorCode = sd.sdErrorCode( );
+        if ( sd.card( )->sectorCount( ) <= 0 )
+            localErrorCode = FS_ERROR_NOCARD;
+        return false;
+    }
+    ++nextDataLogNumber;
+    preallocateDataLog( );
+
+    // Start the log file.
+    if ( !writeDataLogHeader( ) )
+    {
+        // File write failed. The SD card may be full. Remove
+        // the newly created file.
+        removeFile( sharedFilename );
+        --nextDataLogNumber;
+        status = false;
+    }
+    else
+    {
+        newDropLog( number );
+#if defined(ENABLE_IMU_STREAM)
+        newImuLog( number );
+#endif
+    }
+
+    return status;
+}
+
+
+
+
+
+/**
+ * Scans the root directory for the highest numbered data log file.
+ *
+ * The next data log number is set to one more than the highest number
+ * found among data log, drop index, and IMU stream files.
+ *
+ * @see newDataLog()
+ */
+void FileSystem::scanDataLogs( )
+{
+    nextDataLogNumber = 0;
+
+    SdFile root( "/", O_RDONLY );
+    if ( !root.isOpen( ) )
+        return;
+
+    SdFile entry;
+    while ( entry.openNext( &root, O_RDONLY ) )
     {
-        sprintf( sharedFilename, DATA_LOG_FILENAME_FORMAT, i );
-        if ( !FileSystem::sd.exists( sharedFilename ) )
+        if ( !entry.isDir( ) )
         {
-            // Found a log number not in use. Create it and open.
-            logFile.open( sharedFilename, O_WRONLY|O_CREAT );
-            if ( !logFile )
+            // Log file names are a prefix, a number, and an extension.
+            entry.getName( sharedFilename, MAX_FILENAME+1 );
+            const char* digits = NULL;
+            if ( strncmp( sharedFilename, "DATA_", 5 ) == 0 )
+                digits = sharedFilename + 5;
+            else if ( strncmp( sharedFilename, "DROP_", 5 ) == 0 )
+                digits = sharedFilename + 5;
+            else if ( strncmp( sharedFilename, "IMU_", 4 ) == 0 )
+                digits = sharedFilename + 4;
+
+            if ( digits != NULL && isDigit( *digits ) )
             {
-                // File create failed.
-                cardErrorCode = sd.sdErrorCode( );
-                if ( sd.card( )->sectorCount( ) <= 0 )
-                    localErrorCode = FS_ERROR_NOCARD;
-                status = false;
+                const uint16_t number = atoi( digits );
+                if ( number >= nextDataLogNumber )
+                    nextDataLogNumber = number + 1;
             }
+        }
+        entry.close( );
+    }
+    root.close( );
+}
 
-            // Start the log file.
-            if ( !writeDataLogHeader( ) )
-            {
-                // File write failed. The SD card may be full. Remove
-                // the newly created file.
-                sd.remove( sharedFilename );
-                status = false;
-            }
+/**
+ * Returns true if a file's sector reads as erased.
+ *
+ * Only the sector's first byte is read. A data log's written sectors
+ * never start with 0x00 or 0xFF. This assumes that the card erases to
+ * one of those, as the SD specification allows (its SCR register's
+ * DATA_STAT_AFTER_ERASE bit says which). On a card that erases to
+ * anything else, every sector reads as written, so an open log is left
+ * unrepaired rather than cut short.
+ *
+ * @param[in,out] file
+ *   The file.
+ * @param[in] sector
+ *   The sector, from the start of the file.
+ *
+ * @return
+ *   Returns true if erased, and false if written or on a read error.
+ */
+bool FileSystem::isSectorErased( SdFile& file, const uint32_t sector )
+{
+    uint8_t byte;
+    if ( !file.seekSet( sector * SECTOR_SIZE ) || file.read( &byte, 1 ) != 1 )
+        return false;
+    return byte == 0x00 || byte == 0xFF;
+}
 
-            return status;
-        }
+/**
+ * Truncates the highest numbered data log after its last complete row,
+ * if a power loss left it open.
+ *
+ * Until a pre-allocated data log is closed, its size is that of its
+ * whole extent, which was erased when it was allocated. So a log that
+ * ends in an erased sector was never closed. Its rows were written in
+ * order from the start, so the first erased sector is found by a binary
+ * search, which reads a few dozen sectors of even the largest extent.
+ * A text log is cut after the last end of line before it, and a binary
+ * log after the last whole block.
+ *
+ * @see preallocateDataLog()
+ */
+void FileSystem::repairDataLog( )
+{
+    if ( nextDataLogNumber == 0 )
+        return;
+    char filename[16];
+    sprintf( filename, DATA_LOG_FILENAME_FORMAT, nextDataLogNumber - 1 );
+    SdFile file;
+    if ( !file.open( filename, O_RDWR ) )
+        return;
+
+    const uint32_t size = file.fileSize( );
+    const uint32_t lastSector = (size == 0) ? 0 : (size - 1) / SECTOR_SIZE;
+    if ( size == 0 || !isSectorErased( file, lastSector ) )
+    {
+        file.close( );
+        return;     // Closed properly.
     }
 
-    // Could not create a unique log file name. Too many log files.
-    localErrorCode = FS_ERROR_TOO_MANY_LOG_FILES;
-    return false;
+    // Find the last written sector. Sector 'written' is written, or there
+    // are none, and sector 'erased' is erased.
+    int32_t written = -1;
+    uint32_t erased = lastSector;
+    if ( !isSectorErased( file, 0 ) )
+        written = 0;
+    else
+        erased = 0;
+    while ( written >= 0 && erased - written > 1 )
+    {
+        const uint32_t middle = written + (erased - written) / 2;
+        if ( isSectorErased( file, middle ) )
+            erased = middle;
+        else
+            written = middle;
+    }
+
+    uint32_t length = (uint32_t) (written + 1) * SECTOR_SIZE;
+#if !defined(DATA_LOG_BINARY)
+    // The last written sector may end in a partial row, or be a partial
+    // sector followed by erased bytes. Go back to the last end of line.
+    uint32_t end = 0;
+    for ( int32_t sector = written; sector >= 0 && end == 0; --sector )
+    {
+        if ( !file.seekSet( sector * SECTOR_SIZE ) ||
+             file.read( sharedBuffer, SECTOR_SIZE ) != SECTOR_SIZE )
+            break;
+        for ( int16_t i = SECTOR_SIZE - 1; i >= 0 && end == 0; --i )
+            if ( sharedBuffer[i] == '\n' )
+                end = sector * SECTOR_SIZE + i + 1;
+    }
+    length = end;
+#endif
+
+    truncateFile( file, length );
+    file.close( );
+
+    char message[96];
+    sprintf( message, "Repaired %s, cut to %ld bytes after a power loss",
+        filename,
+        (long) length );
+    writeStatus( message, STATUS_WARNING );
 }
 
 
@@ -389,19 +974,17 @@ bool FileSystem::newDataLog( )
 
 
 /**
- * Write a CSV log header.
- *
- * A header line is written to the current CSV log file. Per the CSV
- * file format de facto standard, the first line of a CSV file has the
- * name of each column for the rows in the rest of the file. Non-numeric
- * values are surrounded by double-quotes.
+ * Writes and syncs all buffered rows to the current log file.
  *
- * The header line ends with a line-feed, per POSIX/Linux/macOS
- * conventions.
+ * This is done automatically by the durability policy (see
+ * DATA_LOG_SYNC_ROWS and DATA_LOG_SYNC_INTERVAL) and on close. It may
+ * also be called on events that make a power loss more likely, such
+ * as a low battery.
  *
  * @return
  *   Returns true on success. On failure, false is returned and error codes
  *   are set. Possible failures:
+ *   - There is no log file open.
  *   - The SD card is not inserted.
  *   - The SD card is full.
  *   - The file has reached the 4GB max size for FAT.
@@ -409,63 +992,149 @@ bool FileSystem::newDataLog( )
  *   - An internal SdFat error has occurred.
  *
  * @see closeDataLog()
- * @see getErrorMessage()
- * @see getDataLogFilename()
- * @see getNumberOfLogEntries()
- * @see hasError()
- * @see isDataLogOpen()
- * @see newDataLog()
+ * @see updateDataLog()
  * @see writeDataLog()
  */
-bool FileSystem::writeDataLogHeader( )
+bool FileSystem::syncDataLog( )
 {
     if ( isDataLogOpen( ) == false )
         return false;
 
-#if defined(BATTERY_IN_DATA_LOG)
-    sprintf( sharedBuffer,
-        "\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"\r\n",
-        "Timestamp",
-        "Milliseconds",
-        "Pressure",
-        "Depth",
-        "Water_Temperature",
-        "Device_Temperature",
-        "Acceleration_X",
-        "Acceleration_Y",
-        "Acceleration_Z",
-        "Magnetic_X",
-        "Magnetic_Y",
-        "Magnetic_Z",
-        "Gyroscope_X",
-        "Gyroscope_Y",
-        "Gyroscope_Z",
-        "Controller_Volts",
-        "Controller_Percent",
-        "Main_Volts",
-        "Main_Percent" );
-#else
-    sprintf( sharedBuffer,
-        "\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"\r\n",
-        "Timestamp",
-        "Milliseconds",
-        "Pressure",
-        "Depth",
-        "Water_Temperature",
-        "Device_Temperature",
-        "Acceleration_X",
-        "Acceleration_Y",
-        "Acceleration_Z",
-        "Magnetic_X",
-        "Magnetic_Y",
-        "Magnetic_Z",
-        "Gyroscope_X",
-        "Gyroscope_Y",
-        "Gyroscope_Z" );
-#endif
+    if ( !writeDataLogSectors( ) )
+        return false;
 
-    // SdFat's write() has a bug... the method returns type size_t, which
-    // is unsigned, but the method returns a -1 on an error, which is not
+    // Write the trailing partial sector, if any, then sync. The sector is
+    // still in the buffer, so seek back to its start. The next write of
+    // that sector overwrites it with the whole sector once it fills.
+    //
+    // In a binary data log, the buffer only holds whole sectors. The
+    // partial sector is the block under construction, which is written
+    // whole with the records it has so far.
+    //
+    // See comments about SdFat's write() and sync() in the body of the
+    // writeDataLogSectors() method below.
+    const uint32_t t = micros( );
+#if defined(DATA_LOG_BINARY)
+    const uint8_t*const tail = (const uint8_t*) dataLogBlock;
+    uint16_t nBytes = 0;
+    if ( ((LogBlockHeader*) dataLogBlock)->numberOfRecords > 0 )
+    {
+        sealDataLogBlock( );
+        nBytes = LOG_SECTOR_SIZE;
+    }
+#else
+    const uint8_t*const tail = dataLogBuffer + dataLogBufferTail;
+    const uint16_t nBytes = dataLogBufferCount;
+#endif
+    if ( (nBytes > 0 && !writeFile( logFile, tail, nBytes )) ||
+         !logFile.sync( ) ||
+         (nBytes > 0 && !logFile.seekSet( dataLogFilePosition )) )
+    {
+        setDataLogWriteError( );
+        return false;
+    }
+    Perf::record( Perf::STAGE_SD_SYNC, t );
+
+#if defined(ENABLE_IMU_STREAM)
+    // The IMU stream only holds whole blocks, so it just needs a sync.
+    if ( isImuLogOpen( ) && !imuLogFile.sync( ) )
+        imuLogFile.close( );
+#endif
+
+    numberOfDataLogRowsSinceSync = 0;
+    dataLogSyncTime = millis( );
+    return true;
+}
+
+/**
+ * Syncs the current log file if the durability policy's sync interval
+ * has elapsed.
+ *
+ * This should be called periodically between rows so that buffered
+ * rows are not held in RAM much longer than DATA_LOG_SYNC_INTERVAL
+ * when the frame interval is long.
+ *
+ * @return
+ *   Returns true on success or when there is nothing to do. On failure,
+ *   false is returned and error codes are set.
+ *
+ * @see syncDataLog()
+ */
+bool FileSystem::updateDataLog( )
+{
+    if ( isDataLogOpen( ) == false || numberOfDataLogRowsSinceSync == 0 )
+        return true;
+    if ( (millis( ) - dataLogSyncTime) < DATA_LOG_SYNC_INTERVAL )
+        return true;
+    return syncDataLog( );
+}
+
+
+
+
+
+/**
+ * Adds bytes to the data log buffer.
+ *
+ * Whole sectors are written to the card as needed to make room.
+ *
+ * @param[in] bytes
+ *   The bytes to add.
+ * @param[in] nBytes
+ *   The number of bytes to add.
+ *
+ * @return
+ *   Returns true on success. On failure, false is returned and error codes
+ *   are set.
+ *
+ * @see writeDataLogSectors()
+ */
+bool FileSystem::appendDataLog( const char*const bytes, const uint16_t nBytes )
+{
+    // Make room, if needed, by writing out whole sectors. This always
+    // leaves less than a sector in the buffer.
+    if ( dataLogBufferCount + nBytes > DATA_LOG_BUFFER_SIZE &&
+         !writeDataLogSectors( ) )
+        return false;
+
+    if ( dataLogBufferCount + nBytes > DATA_LOG_BUFFER_SIZE )
+    {
+        // Not possible unless a single row is bigger than the buffer.
+        setDataLogWriteError( );
+        return false;
+    }
+
+    // Copy into the ring, wrapping around the end as needed.
+    const uint16_t nFirst = min( (uint16_t)(DATA_LOG_BUFFER_SIZE - dataLogBufferHead), nBytes );
+    memcpy( dataLogBuffer + dataLogBufferHead, bytes, nFirst );
+    memcpy( dataLogBuffer, bytes + nFirst, nBytes - nFirst );
+    dataLogBufferHead = (dataLogBufferHead + nBytes) % DATA_LOG_BUFFER_SIZE;
+    dataLogBufferCount += nBytes;
+    return true;
+}
+
+/**
+ * Writes all whole sectors in the data log buffer to the card.
+ *
+ * The file is not synced. A trailing partial sector is left in the
+ * buffer.
+ *
+ * @return
+ *   Returns true on success. On failure, false is returned and error codes
+ *   are set. Possible failures:
+ *   - The SD card is not inserted.
+ *   - The SD card is full.
+ *   - The file has reached the 4GB max size for FAT.
+ *   - A hardware error has occurred.
+ *   - An internal SdFat error has occurred.
+ *
+ * @see appendDataLog()
+ * @see syncDataLog()
+ */
+bool FileSystem::writeDataLogSectors( )
+{
+    // SdFat's write() has a bug... the method returns type size_t, which
+    // is unsigned, but the method returns a -1 on an error, which is not
     // possible. The -1 becomes ~0, when unsigned.
     //
     // Since a successful write returns the number of bytes written, we
@@ -474,7 +1143,11 @@ bool FileSystem::writeDataLogHeader( )
     //
     // write() adds data to the file, but sync() updates the file's size,
     // date, cluster pointers, and cache. We need it all so that the file
-    // is always uptodate.
+    // is uptodate on the card. Syncing after every row makes each row
+    // durable, but the sync's directory and FAT updates cost far more than
+    // the row's write. So rows are buffered and written here as whole
+    // sectors, which SdFat sends straight to the card, and the file is
+    // only synced per the durability policy in syncDataLog().
     //
     // On failure of write() or sync(), SdFat does not set the main error
     // code. It only sets the file's error code, and that is always marked as
@@ -489,23 +1162,249 @@ bool FileSystem::writeDataLogHeader( )
     // Since we've opened the file for write, and it is very very
     // unlikely that a log file will get to 4GB, the problem is
     // probably that the SD card is full.
-    const uint32_t nBytes = strlen( sharedBuffer );
-    if ( logFile.write( sharedBuffer, nBytes ) != nBytes ||
-         !logFile.sync( ) )
+    while ( dataLogBufferCount >= SECTOR_SIZE )
     {
-        // Fail to write or sync.
-        cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
-        if ( sd.card( )->sectorCount( ) <= 0 )
-            localErrorCode = FS_ERROR_NOCARD;
-        else
-            localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
-        logFile.close( );
-        numberOfDataLogEntries = 0;
-        return false;
+        // Write the whole sectors up to the head or the end of the ring,
+        // whichever comes first.
+        uint16_t nBytes = dataLogBufferCount - (dataLogBufferCount % SECTOR_SIZE);
+        if ( dataLogBufferTail + nBytes > DATA_LOG_BUFFER_SIZE )
+            nBytes = DATA_LOG_BUFFER_SIZE - dataLogBufferTail;
+
+        const uint32_t t = micros( );
+        if ( !writeFile( logFile, dataLogBuffer + dataLogBufferTail, nBytes ) )
+        {
+            setDataLogWriteError( );
+            return false;
+        }
+        Perf::record( Perf::STAGE_SD_WRITE, t );
+
+        dataLogBufferTail = (dataLogBufferTail + nBytes) % DATA_LOG_BUFFER_SIZE;
+        dataLogBufferCount -= nBytes;
+        dataLogFilePosition += nBytes;
     }
+    return true;
+}
 
+/**
+ * Pre-allocates a contiguous extent for the new, empty data log.
+ *
+ * The extent is sized for the run's frame interval and burst size. If
+ * the card has no free extent that large, smaller extents are tried. If
+ * none can be found, or the card cannot erase it, the file is left empty
+ * and grows as it is written.
+ *
+ * @see newDataLog()
+ */
+void FileSystem::preallocateDataLog( )
+{
+    // Size the extent for the expected run at the interval and burst size
+    // it starts with, from the mission plan's first segment, if any. A
+    // burst logs a row per image. Frame spacing starts at the frame
+    // interval, as the descent rate is not yet known.
+    const uint32_t interval = max( getScheduledInterval( ), (uint32_t)MINIMUM_FRAME_INTERVAL );
+    const uint8_t burst = Mission::getBurstSize( getBurstSize( ) );
+    uint64_t size = (uint64_t)DATA_LOG_PREALLOCATE_DURATION * 1000L / interval *
+        burst * DATA_LOG_PREALLOCATE_ROW_SIZE;
+    if ( size > DATA_LOG_PREALLOCATE_MAX_SIZE )
+        size = DATA_LOG_PREALLOCATE_MAX_SIZE;
+
+    // SdFat's preAllocate() needs a run of free clusters that is long
+    // enough for the whole extent. A well-used card may not have one, so
+    // try shorter extents before giving up. A shorter extent still covers
+    // the start of the run, and the file grows normally past its end.
+    const uint32_t minimumSize = sd.bytesPerCluster( );
+    while ( size >= minimumSize && !logFile.preAllocate( size ) )
+        size /= 2;
+    if ( size < minimumSize )
+        return;
+    trackFileSize( 0, (uint32_t)size );
+
+    // Erase the extent, so that after a power loss the unwritten end of
+    // the file reads as erased sectors instead of stale data from old
+    // files, and repairDataLog() can find it. If the card cannot erase,
+    // give the extent back and let the file grow as it is written.
+    uint32_t firstSector = 0;
+    uint32_t lastSector  = 0;
+    if ( !logFile.contiguousRange( &firstSector, &lastSector ) ||
+         !sd.card( )->erase( firstSector, lastSector ) )
+        truncateFile( logFile, 0 );
+}
+
+#if defined(DATA_LOG_BINARY)
+/**
+ * Starts a new, empty binary data log block.
+ *
+ * @param[in] sequence
+ *   The block's sequence number.
+ *
+ * @see appendDataLogBlock()
+ */
+void FileSystem::startDataLogBlock( const uint32_t sequence )
+{
+    memset( dataLogBlock, 0, sizeof( dataLogBlock ) );
+    LogBlockHeader*const header = (LogBlockHeader*) dataLogBlock;
+    header->magic           = LOG_BLOCK_MAGIC;
+    header->fileId          = dataLogFileId;
+    header->sequence        = sequence;
+    header->numberOfRecords = 0;
+    header->recordSize      = sizeof( DataLogRecord );
+}
+
+/**
+ * Stores the CRC of the binary data log block under construction.
+ *
+ * The CRC covers the whole block up to the CRC in its last 4 bytes.
+ *
+ * @see appendDataLogBlock()
+ */
+void FileSystem::sealDataLogBlock( )
+{
+    const uint16_t nWords = LOG_SECTOR_SIZE / sizeof( uint32_t );
+    dataLogBlock[nWords - 1] =
+        Crc32::compute( dataLogBlock, LOG_SECTOR_SIZE - sizeof( uint32_t ) );
+}
+
+/**
+ * Adds the binary data log block under construction to the data log
+ * buffer, then starts the next block.
+ *
+ * @return
+ *   Returns true on success. On failure, false is returned and error codes
+ *   are set.
+ *
+ * @see appendDataLog()
+ * @see sealDataLogBlock()
+ * @see startDataLogBlock()
+ */
+bool FileSystem::appendDataLogBlock( )
+{
+    sealDataLogBlock( );
+    if ( !appendDataLog( (const char*) dataLogBlock, LOG_SECTOR_SIZE ) )
+        return false;
+    startDataLogBlock( ((LogBlockHeader*) dataLogBlock)->sequence + 1 );
     return true;
 }
+#endif
+
+/**
+ * Sets error codes after a failed data log write and closes the log.
+ *
+ * Buffered rows that have not been written are lost.
+ *
+ * @see getErrorMessage()
+ */
+void FileSystem::setDataLogWriteError( )
+{
+    cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
+    if ( sd.card( )->sectorCount( ) <= 0 )
+        localErrorCode = FS_ERROR_NOCARD;
+    else
+        localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
+    logFile.close( );
+#if defined(ENABLE_IMU_STREAM)
+    imuLogFile.close( );
+#endif
+    numberOfDataLogEntries = 0;
+    dataLogBufferCount = 0;
+}
+
+
+
+
+
+/**
+ * Write a CSV log header.
+ *
+ * A header line is written to the current CSV log file. Per the CSV
+ * file format de facto standard, the first line of a CSV file has the
+ * name of each column for the rows in the rest of the file. Non-numeric
+ * values are surrounded by double-quotes.
+ *
+ * The header line ends with a line-feed, per POSIX/Linux/macOS
+ * conventions.
+ *
+ * If DATA_LOG_BINARY is defined, a binary file header with the data
+ * log columns is written instead (see LogFormat.h).
+ *
+ * @return
+ *   Returns true on success. On failure, false is returned and error codes
+ *   are set. Possible failures:
+ *   - The SD card is not inserted.
+ *   - The SD card is full.
+ *   - The file has reached the 4GB max size for FAT.
+ *   - A hardware error has occurred.
+ *   - An internal SdFat error has occurred.
+ *
+ * @see closeDataLog()
+ * @see getErrorMessage()
+ * @see getDataLogFilename()
+ * @see getNumberOfLogEntries()
+ * @see hasError()
+ * @see isDataLogOpen()
+ * @see newDataLog()
+ * @see writeDataLog()
+ */
+bool FileSystem::writeDataLogHeader( )
+{
+    if ( isDataLogOpen( ) == false )
+        return false;
+
+#if defined(DATA_LOG_BINARY)
+    // The binary file header is the fixed header, the column table, zero
+    // padding to a whole number of sectors, and a CRC over all of it. The
+    // pieces are added to the data log buffer one at a time, updating the
+    // CRC along the way, so the header never needs to fit in RAM at once.
+    const uint32_t nHeaderBytes = sizeof( LogFileHeader ) +
+        NUMBER_OF_DATA_LOG_COLUMNS * sizeof( LogColumn ) +
+        sizeof( uint32_t );
+    const uint16_t nSectors = (nHeaderBytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+    LogFileHeader header;
+    memset( &header, 0, sizeof( header ) );
+    header.magic           = LOG_FILE_MAGIC;
+    header.version         = LOG_FORMAT_VERSION;
+    header.numberOfSectors = nSectors;
+    header.fileId          = dataLogFileId;
+    header.recordSize      = sizeof( DataLogRecord );
+    header.numberOfColumns = NUMBER_OF_DATA_LOG_COLUMNS;
+    strncpy( header.firmwareVersion, VERSION, sizeof( header.firmwareVersion ) - 1 );
+
+    uint32_t crc = Crc32::compute( &header, sizeof( header ) );
+    if ( !appendDataLog( (const char*) &header, sizeof( header ) ) )
+        return false;
+
+    for ( uint16_t i = 0; i < NUMBER_OF_DATA_LOG_COLUMNS; ++i )
+    {
+        crc = Crc32::compute( &DATA_LOG_COLUMNS[i], sizeof( LogColumn ), crc );
+        if ( !appendDataLog( (const char*) &DATA_LOG_COLUMNS[i], sizeof( LogColumn ) ) )
+            return false;
+    }
+
+    const uint16_t nPadding = nSectors * SECTOR_SIZE - nHeaderBytes;
+    memset( sharedBuffer, 0, nPadding );
+    crc = Crc32::compute( sharedBuffer, nPadding, crc );
+    if ( !appendDataLog( sharedBuffer, nPadding ) ||
+         !appendDataLog( (const char*) &crc, sizeof( crc ) ) )
+        return false;
+#else
+    // The header is the quoted column names, separated by commas.
+    uint32_t nBytes = 0;
+    for ( uint16_t i = 0; i < NUMBER_OF_DATA_LOG_COLUMNS; ++i )
+    {
+        nBytes += sprintf( sharedBuffer + nBytes, "%s\"%s\"",
+            (i == 0) ? "" : ",",
+            DATA_LOG_COLUMNS[i].name );
+    }
+    nBytes += sprintf( sharedBuffer + nBytes, "\r\n" );
+
+    if ( !appendDataLog( sharedBuffer, nBytes ) )
+        return false;
+#endif
+
+    // Sync so that the new file is on the card with its header even if
+    // no rows follow.
+    return syncDataLog( );
+}
 
 
 
@@ -515,30 +1414,21 @@ bool FileSystem::writeDataLogHeader( )
  * Write a CSV log entry.
  *
  * A line is written to the current CSV log file using the given
- * timestamp and sensor values. Per the CSV file format de facto
- * standard, non-numeric values (such as the date and time) are
+ * record's timestamp and sensor values. Per the CSV file format de
+ * facto standard, non-numeric values (such as the date and time) are
  * surrounded by double-quotes.
  *
  * The line ends with a line-feed, per POSIX/Linux/macOS conventions.
  *
- * @param[in] dt
- *   The date and time timestamp.
- * @param[in] ms
- *   The date and time timestamp millisecond offset.
- * @param[in] pressure
- *   The water pressure.
- * @param[in] depth
- *   The water depth.
- * @param[in] waterTemperature
- *   The water temperature.
- * @param[in] deviceTemperature
- *   The device's internal temperature.
- * @param[in] accel
- *   The 3-element array with the accelerometer vector.
- * @param[in] mag
- *   The 3-element array with the magnetometer vector.
- * @param[in] gyro
- *   The 3-element array with the gyroscpe vector.
+ * If DATA_LOG_BINARY is defined, the record is added to the current
+ * binary block instead, without any formatting.
+ *
+ * The line is added to the data log buffer and written to the card
+ * with whole sectors. The log file is synced per the durability policy
+ * (see DATA_LOG_SYNC_ROWS and DATA_LOG_SYNC_INTERVAL).
+ *
+ * @param[in] record
+ *   The timestamp and sensor values.
  *
  * @return
  *   Returns true on success. On failure, false is returned and error codes
@@ -558,204 +1448,752 @@ bool FileSystem::writeDataLogHeader( )
  * @see newDataLog()
  * @see writeDataLogHeader()
  */
-bool FileSystem::writeDataLog(
-    const char*const dt,
-    const uint32_t ms,
-    const float pressure,
-    const float depth,
-    const float waterTemperature,
-    const float deviceTemperature,
-    const float* accel,
-    const float* mag,
-    const float* gyro )
+bool FileSystem::writeDataLog( const DataLogRecord& record )
 {
     if ( isDataLogOpen( ) == false )
         return false;
 
-#if defined(BATTERY_IN_DATA_LOG)
-    sprintf( sharedBuffer,
-        "\"%s\",%ld,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%5.3f,%3.1f,%5.3f,%3.1f\r\n",
-        dt,
-        ms,
-        pressure,
-        depth,
-        waterTemperature,
-        deviceTemperature,
-        accel[0],
-        accel[1],
-        accel[2],
-        mag[0],
-        mag[1],
-        mag[2],
-        gyro[0],
-        gyro[1],
-        gyro[2],
-        Battery::getControllerVoltage( ),
-        Battery::getControllerPercent( ),
-        Battery::getMainVoltage( ),
-        Battery::getMainPercent( ) );
+    const uint32_t t = micros( );
+#if defined(DATA_LOG_BINARY)
+    // Add the record to the block. Once the block is full, add it to the
+    // data log buffer. Whole sectors are written to the card as the
+    // buffer fills.
+    LogBlockHeader*const header = (LogBlockHeader*) dataLogBlock;
+    memcpy( (uint8_t*) dataLogBlock + sizeof( LogBlockHeader ) +
+        header->numberOfRecords * sizeof( DataLogRecord ),
+        &record,
+        sizeof( DataLogRecord ) );
+    ++header->numberOfRecords;
+    Perf::record( Perf::STAGE_FORMAT, t );
+
+    if ( header->numberOfRecords == DATA_LOG_RECORDS_PER_BLOCK &&
+         !appendDataLogBlock( ) )
+        return false;
 #else
-    sprintf( sharedBuffer,
-        "\"%s\",%ld,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f\r\n",
-        dt,
-        ms,
-        pressure,
-        depth,
-        waterTemperature,
-        deviceTemperature,
-        accel[0],
-        accel[1],
-        accel[2],
-        mag[0],
-        mag[1],
-        mag[2],
-        gyro[0],
-        gyro[1],
-        gyro[2] );
+    // Print each column per the column table, separated by commas.
+    const uint8_t*const fields = (const uint8_t*) &record;
+    uint32_t nBytes = 0;
+    for ( uint16_t i = 0; i < NUMBER_OF_DATA_LOG_COLUMNS; ++i )
+    {
+        const LogColumn& column = DATA_LOG_COLUMNS[i];
+        const uint8_t*const field = fields + column.offset;
+        if ( i != 0 )
+            sharedBuffer[nBytes++] = ',';
+
+        switch ( column.type )
+        {
+            case LOG_TYPE_TIME:
+            {
+                char timestamp[25];
+                strcpy( timestamp, "MM/DD/YYYY hh:mm:ss" );
+                DateTime dt( *(const uint32_t*) field );
+                nBytes += sprintf( sharedBuffer + nBytes, column.format,
+                    dt.toString( timestamp ) );
+                break;
+            }
+
+            case LOG_TYPE_UINT32:
+                nBytes += sprintf( sharedBuffer + nBytes, column.format,
+                    *(const uint32_t*) field );
+                break;
+
+            case LOG_TYPE_INT32:
+                nBytes += sprintf( sharedBuffer + nBytes, column.format,
+                    *(const int32_t*) field );
+                break;
+
+            default:
+            case LOG_TYPE_FLOAT:
+                nBytes += sprintf( sharedBuffer + nBytes, column.format,
+                    *(const float*) field );
+                break;
+        }
+    }
+    nBytes += sprintf( sharedBuffer + nBytes, "\r\n" );
+    Perf::record( Perf::STAGE_FORMAT, t );
+
+    // Buffer the row. Whole sectors are written to the card as the
+    // buffer fills.
+    if ( !appendDataLog( sharedBuffer, nBytes ) )
+        return false;
 #endif
 
-    // See comments about SdFat's write() and sync() in the body of the
-    // writeDataLogHeader() method above.
+    ++numberOfDataLogEntries;
+    ++numberOfDataLogRowsSinceSync;
+
+    // Apply the durability policy.
+    if ( numberOfDataLogRowsSinceSync >= DATA_LOG_SYNC_ROWS ||
+         (millis( ) - dataLogSyncTime) >= DATA_LOG_SYNC_INTERVAL )
+        return syncDataLog( );
+    return true;
+}
+
+
+
+
+
+#if defined(ENABLE_IMU_STREAM)
+//----------------------------------------------------------------------
+// IMU stream file.
+//----------------------------------------------------------------------
+/**
+ * Writes an IMU stream record.
+ *
+ * The record is added to the current block, and whole blocks are
+ * written to the card. The file is synced along with the data log.
+ * Records in the last, partly filled block are written when the file
+ * is closed.
+ *
+ * @param[in] record
+ *   The sample.
+ *
+ * @return
+ *   Returns false if there is no IMU stream file open or an error
+ *   occurred. On an error, the IMU stream file is closed.
+ *
+ * @see isImuLogOpen()
+ */
+bool FileSystem::writeImuLog( const ImuLogRecord& record )
+{
+    if ( isImuLogOpen( ) == false )
+        return false;
+
+    LogBlockHeader*const header = (LogBlockHeader*) imuLogBlock;
+    memcpy( (uint8_t*) imuLogBlock + sizeof( LogBlockHeader ) +
+        header->numberOfRecords * sizeof( ImuLogRecord ),
+        &record,
+        sizeof( ImuLogRecord ) );
+    ++header->numberOfRecords;
+
+    if ( header->numberOfRecords == IMU_LOG_RECORDS_PER_BLOCK )
+        return writeImuLogBlock( );
+    return true;
+}
+
+/**
+ * Creates an IMU stream file to go with a new data log.
+ *
+ * Failure is not fatal. The data log is written without an IMU
+ * stream.
+ *
+ * @param[in] number
+ *   The data log's file number.
+ *
+ * @see newDataLog()
+ */
+void FileSystem::newImuLog( const uint16_t number )
+{
+    // The file number is free for data logs, but a stale IMU stream file
+    // could be left from a data log that has since been removed.
+    sprintf( sharedFilename, IMU_LOG_FILENAME_FORMAT, number );
+    if ( !createFile( imuLogFile, sharedFilename ) )
+        return;
+
+    // The file header is small enough to build in the shared buffer and
+    // write at once. See LogFormat.h.
+    const uint32_t nHeaderBytes = sizeof( LogFileHeader ) +
+        NUMBER_OF_IMU_LOG_COLUMNS * sizeof( LogColumn ) +
+        sizeof( uint32_t );
+    const uint16_t nSectors = (nHeaderBytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    const uint16_t nBytes = nSectors * SECTOR_SIZE;
+    imuLogFileId = Clock::nowSeconds( ) ^ micros( ) ^ number;
+
+    memset( sharedBuffer, 0, nBytes );
+    LogFileHeader*const header = (LogFileHeader*) sharedBuffer;
+    header->magic           = LOG_FILE_MAGIC;
+    header->version         = LOG_FORMAT_VERSION;
+    header->numberOfSectors = nSectors;
+    header->fileId          = imuLogFileId;
+    header->recordSize      = sizeof( ImuLogRecord );
+    header->numberOfColumns = NUMBER_OF_IMU_LOG_COLUMNS;
+    strncpy( header->firmwareVersion, VERSION, sizeof( header->firmwareVersion ) - 1 );
+    memcpy( sharedBuffer + sizeof( LogFileHeader ), IMU_LOG_COLUMNS,
+        NUMBER_OF_IMU_LOG_COLUMNS * sizeof( LogColumn ) );
+    const uint32_t crc = Crc32::compute( sharedBuffer, nBytes - sizeof( uint32_t ) );
+    memcpy( sharedBuffer + nBytes - sizeof( uint32_t ), &crc, sizeof( crc ) );
+
+    if ( !writeFile( imuLogFile, sharedBuffer, nBytes ) ||
+         !imuLogFile.sync( ) )
+    {
+        imuLogFile.close( );
+        removeFile( sharedFilename );
+        return;
+    }
+
+    startImuLogBlock( 0 );
+}
+
+/**
+ * Starts a new, empty IMU stream block.
+ *
+ * @param[in] sequence
+ *   The block's sequence number.
+ *
+ * @see writeImuLogBlock()
+ */
+void FileSystem::startImuLogBlock( const uint32_t sequence )
+{
+    memset( imuLogBlock, 0, sizeof( imuLogBlock ) );
+    LogBlockHeader*const header = (LogBlockHeader*) imuLogBlock;
+    header->magic           = LOG_BLOCK_MAGIC;
+    header->fileId          = imuLogFileId;
+    header->sequence        = sequence;
+    header->numberOfRecords = 0;
+    header->recordSize      = sizeof( ImuLogRecord );
+}
+
+/**
+ * Writes the IMU stream block under construction and starts the next.
+ *
+ * @return
+ *   Returns false if an error occurred. The IMU stream file is closed.
+ *
+ * @see writeImuLog()
+ */
+bool FileSystem::writeImuLogBlock( )
+{
+    // Blocks are whole sectors at sector-aligned file positions, so SdFat
+    // writes them straight to the card.
+    const uint16_t nWords = LOG_SECTOR_SIZE / sizeof( uint32_t );
+    imuLogBlock[nWords - 1] =
+        Crc32::compute( imuLogBlock, LOG_SECTOR_SIZE - sizeof( uint32_t ) );
+    if ( !writeFile( imuLogFile, imuLogBlock, LOG_SECTOR_SIZE ) )
+    {
+        cardErrorCode = sd.sdErrorCode( );
+        imuLogFile.close( );
+        return false;
+    }
+
+    startImuLogBlock( ((LogBlockHeader*) imuLogBlock)->sequence + 1 );
+    return true;
+}
+
+/**
+ * Closes the current IMU stream file, if any, after writing its last,
+ * partly filled block.
+ *
+ * @see closeDataLog()
+ */
+void FileSystem::closeImuLog( )
+{
+    if ( isImuLogOpen( ) == false )
+        return;
+    if ( ((LogBlockHeader*) imuLogBlock)->numberOfRecords > 0 &&
+         !writeImuLogBlock( ) )
+        return;
+    imuLogFile.close( );
+}
+#endif
+
+
+
+
+
+//----------------------------------------------------------------------
+// Drop index file.
+//----------------------------------------------------------------------
+/**
+ * Writes a drop index record as a CSV row, and syncs it to the card.
+ *
+ * Drops are minutes apart, so each is synced as it is written.
+ *
+ * @param[in] record
+ *   The drop.
+ *
+ * @return
+ *   Returns false if there is no drop index file open or an error
+ *   occurred. On an error, the drop index file is closed.
+ *
+ * @see isDropLogOpen()
+ * @see DropDetector
+ */
+bool FileSystem::writeDropLog( const DropRecord& record )
+{
+    if ( isDropLogOpen( ) == false )
+        return false;
+
+    // The time stamps match the data log's.
+    char startTime[25];
+    char endTime[25];
+    strcpy( startTime, "MM/DD/YYYY hh:mm:ss" );
+    strcpy( endTime, "MM/DD/YYYY hh:mm:ss" );
+    DateTime start( record.startSeconds );
+    DateTime end( record.endSeconds );
+    sprintf( sharedBuffer, "%d,%lu,%lu,\"%s\",\"%s\",%lu,%f\r\n",
+        record.number,
+        (unsigned long) record.startRow,
+        (unsigned long) record.endRow,
+        start.toString( startTime ),
+        end.toString( endTime ),
+        (unsigned long) (record.endSeconds - record.startSeconds),
+        record.maximumDepth );
+
     const uint32_t nBytes = strlen( sharedBuffer );
-    if ( logFile.write( sharedBuffer, nBytes ) != nBytes ||
-         !logFile.sync( ) )
+    if ( !writeFile( dropLogFile, sharedBuffer, nBytes ) ||
+         !dropLogFile.sync( ) )
     {
-        cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
-        if ( sd.card( )->sectorCount( ) <= 0 )
-            localErrorCode = FS_ERROR_NOCARD;
-        else
-            localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
-        logFile.close( );
-        numberOfDataLogEntries = 0;
+        cardErrorCode = sd.sdErrorCode( );
+        dropLogFile.close( );
         return false;
     }
+    return true;
+}
 
-    ++numberOfDataLogEntries;
+/**
+ * Creates a drop index file to go with a new data log.
+ *
+ * Failure is not fatal. The data log is written without a drop
+ * index.
+ *
+ * @param[in] number
+ *   The data log's file number.
+ *
+ * @see newDataLog()
+ */
+void FileSystem::newDropLog( const uint16_t number )
+{
+    // The file number is free for data logs, but a stale drop index file
+    // could be left from a data log that has since been removed.
+    sprintf( sharedFilename, DROP_LOG_FILENAME_FORMAT, number );
+    if ( !createFile( dropLogFile, sharedFilename ) )
+        return;
+
+    // A comment line gives the detector's parameters, so that Data
+    // Processing can tell if its own would find the same drops. The
+    // median window counts snap-and-logs, not rows. The column names
+    // follow the Data Processing drops summary.
+    const int n = sprintf( sharedBuffer,
+        "# median_window=%d start_depth=%.2f hysteresis=%.2f minimum_duration=%d\r\n",
+        DROP_MEDIAN_WINDOW,
+        DROP_START_DEPTH,
+        DROP_HYSTERESIS,
+        DROP_MINIMUM_DURATION );
+    strcpy( sharedBuffer + n,
+        "Drop,Start_Row,End_Row,Start_Time,End_Time,Duration,Max_Depth\r\n" );
+    const uint32_t nBytes = strlen( sharedBuffer );
+    if ( !writeFile( dropLogFile, sharedBuffer, nBytes ) ||
+         !dropLogFile.sync( ) )
+    {
+        dropLogFile.close( );
+        removeFile( sharedFilename );
+    }
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Settings journal.
+//----------------------------------------------------------------------
+//
+// The settings journal replaces files that were rewritten and synced on
+// every change. Changes are staged in RAM and appended to the journal in
+// batches, each ending in a checksummed commit line:
+//
+//   generation 12
+//   interval 1000
+//   burstsize 1
+//   ...
+//   commit 5d2ae0c1
+//   interval 500
+//   commit 0f3b9a27
+//
+// A later line for a key replaces an earlier one. The checksum is the
+// CRC-32 of the batch's lines since the previous commit line, without
+// their line endings.
+/**
+ * Loads settings from the settings journal, if any.
+ *
+ * Settings that are not in the journal are left unchanged.
+ *
+ * @param[out] interval
+ *   The frame interval, in ms.
+ * @param[out] isLaserContinuous
+ *   True if the laser mode is continuous, and false if normal.
+ * @param[out] burstSize
+ *   The number of frames to capture per recording event.
+ * @param[out] spacing
+ *   The depth between frames, in m, or 0 for a fixed frame interval.
+ * @param[out] maximumInterval
+ *   The longest depth-adaptive frame interval, in ms.
+ * @param[out] startDepth
+ *   The depth at which an armed device starts running, in m.
+ *
+ * @return
+ *   Returns true if any setting was found, and false if there is no
+ *   journal or an error occurred.
+ *
+ * @see stageInteger()
+ * @see stageFloat()
+ */
+bool FileSystem::loadSettings(
+    uint32_t &interval,
+    bool &isLaserContinuous,
+    uint8_t &burstSize,
+    float &spacing,
+    uint32_t &maximumInterval,
+    float &startDepth )
+{
+    if ( !initialized )
+        return false;
+    loadJournal( );
+
+    bool found = false;
+    uint32_t value;
+    found |= getInteger( KEY_INTERVAL, interval );
+    if ( getInteger( KEY_BURST_SIZE, value ) )
+    {
+        burstSize = value;
+        found = true;
+    }
+    if ( getInteger( KEY_LASER_CONTINUOUS, value ) )
+    {
+        isLaserContinuous = (value == 1);
+        found = true;
+    }
+    found |= getFloat( KEY_SPACING, spacing );
+    found |= getInteger( KEY_MAXIMUM_INTERVAL, maximumInterval );
+    found |= getFloat( KEY_START_DEPTH, startDepth );
+    return found;
+}
+
+#if defined(ENABLE_USAGE_TRACKING)
+/**
+ * Loads usage from the settings journal, if any.
+ *
+ * @param[out] usage
+ *   The current usage.
+ *
+ * @return
+ *   Returns true if any usage was found, and false if there is no
+ *   journal or an error occurred.
+ *
+ * @see stageUsage()
+ */
+bool FileSystem::loadUsage( Usage& usage )
+{
+    if ( !initialized )
+        return false;
+    loadJournal( );
+
+    bool found = false;
+    found |= getInteger( KEY_BOOTS, usage.numberOfBoots );
+    found |= getInteger( KEY_CAMERA_BOOTS, usage.numberOfCameraBoots );
+    found |= getInteger( KEY_LASER_BOOTS, usage.numberOfLaserBoots );
+    found |= getInteger( KEY_EVENTS, usage.numberOfEventsLogged );
+    found |= getInteger( KEY_IMAGES, usage.numberOfImagesSnapped );
+    found |= getInteger( KEY_CONTROLLER_UPTIME, usage.controllerUptimeSeconds );
+    found |= getInteger( KEY_CAMERA_UPTIME, usage.cameraUptimeSeconds );
+    found |= getInteger( KEY_LASER_UPTIME, usage.laserUptimeSeconds );
+    return found;
+}
+
+/**
+ * Stages usage for the next commit.
+ *
+ * @param[in] usage
+ *   The current usage.
+ *
+ * @see commitSettings()
+ * @see loadUsage()
+ */
+void FileSystem::stageUsage( const Usage& usage )
+{
+    stageInteger( KEY_BOOTS, usage.numberOfBoots );
+    stageInteger( KEY_CAMERA_BOOTS, usage.numberOfCameraBoots );
+    stageInteger( KEY_LASER_BOOTS, usage.numberOfLaserBoots );
+    stageInteger( KEY_EVENTS, usage.numberOfEventsLogged );
+    stageInteger( KEY_IMAGES, usage.numberOfImagesSnapped );
+    stageInteger( KEY_CONTROLLER_UPTIME, usage.controllerUptimeSeconds );
+    stageInteger( KEY_CAMERA_UPTIME, usage.cameraUptimeSeconds );
+    stageInteger( KEY_LASER_UPTIME, usage.laserUptimeSeconds );
+}
+#endif
+
+/**
+ * Stages an integer value for the next commit.
+ *
+ * Nothing is written to the card. The key is only marked as changed
+ * if its value differs from the journal's.
+ *
+ * @param[in] key
+ *   One of the KEY_* values.
+ * @param[in] value
+ *   The value.
+ *
+ * @see commitSettings()
+ */
+void FileSystem::stageInteger( const uint8_t key, const uint32_t value )
+{
+    char text[JOURNAL_VALUE_SIZE];
+    snprintf( text, sizeof( text ), "%ld", (long) value );
+    stageValue( key, text );
+}
+
+/**
+ * Stages a floating point value for the next commit.
+ *
+ * Nothing is written to the card. The key is only marked as changed
+ * if its value, to 3 decimal places, differs from the journal's.
+ *
+ * @param[in] key
+ *   One of the KEY_* values.
+ * @param[in] value
+ *   The value.
+ *
+ * @see commitSettings()
+ */
+void FileSystem::stageFloat( const uint8_t key, const float value )
+{
+    char text[JOURNAL_VALUE_SIZE];
+    snprintf( text, sizeof( text ), "%.3f", value );
+    stageValue( key, text );
+}
+
+/**
+ * Appends the values staged since the most recent commit to the
+ * settings journal, as one batch, and syncs it.
+ *
+ * The batch ends with a commit line holding its checksum. A batch
+ * without one, such as one cut short by a power loss, is ignored when
+ * the journal is loaded. When the journal would grow past
+ * JOURNAL_COMPACT_SIZE, all values are instead written to the other
+ * journal file, under the next generation. The older file is kept
+ * until then, so a valid journal is always on the card.
+ *
+ * @return
+ *   Returns true on success or when there is nothing to do. On failure,
+ *   false is returned, error codes are set, and the values stay staged.
+ *
+ * @see updateSettings()
+ */
+bool FileSystem::commitSettings( )
+{
+    if ( !initialized )
+        return false;
+    loadJournal( );
+    if ( journalDirty == 0 )
+        return true;
+
+    localErrorCode = FS_ERROR_NONE;
+    cardErrorCode  = SD_CARD_ERROR_NONE;
+
+    // Without a journal yet, or if it was removed by a command, or if it
+    // is full, start the other file.
+    SdFile file;
+    if ( journalGeneration == 0 ||
+         !file.open( JOURNAL_FILENAMES[journalFile], O_WRONLY|O_APPEND ) )
+        return compactJournal( );
+
+    const uint32_t nBytes = formatBatch( journalDirty, 0 );
+    if ( file.fileSize( ) + nBytes > JOURNAL_COMPACT_SIZE )
+    {
+        file.close( );
+        return compactJournal( );
+    }
+
+    // See comments about SdFat's write() and sync() in the body of the
+    // writeDataLogSectors() method above.
+    if ( !writeFile( file, sharedBuffer, nBytes ) ||
+         !file.sync( ) )
+    {
+        cardErrorCode  = sd.sdErrorCode( );  // Probably NONE.
+        localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
+        file.close( );
+        return false;
+    }
+
+    file.close( );
+    journalDirty = 0;
     return true;
 }
 
-
-
-
-
-//----------------------------------------------------------------------
-// Settings file.
-//----------------------------------------------------------------------
 /**
- * Loads settings from a saved settings file, if any.
+ * Loads the settings journal into RAM, once.
+ *
+ * The journal file with the highest generation and at least one valid
+ * commit is used, up to its last valid commit. Anything after that is
+ * truncated, so that appends follow it. If neither file is valid, the
+ * settings and usage files of older versions are loaded instead, and
+ * are replaced by a journal on the next commit.
+ */
+void FileSystem::loadJournal( )
+{
+    if ( journalLoaded )
+        return;
+    journalLoaded     = true;
+    journalDirty      = 0;
+    journalGeneration = 0;
+
+    uint32_t length = 0;
+    for ( uint8_t i = 0; i < 2; ++i )
+    {
+        uint32_t generation;
+        uint32_t fileLength;
+        if ( scanJournal( i, generation, fileLength ) &&
+             generation > journalGeneration )
+        {
+            journalFile       = i;
+            journalGeneration = generation;
+            length            = fileLength;
+        }
+    }
+
+    SdFile file;
+    if ( journalGeneration != 0 )
+    {
+        if ( !file.open( JOURNAL_FILENAMES[journalFile], O_RDWR ) )
+            return;
+        readValues( file, length );
+        if ( file.fileSize( ) > length )
+            truncateFile( file, length );
+        file.close( );
+        return;
+    }
+
+    // No journal yet. The first commit writes one with these values.
+    if ( file.open( SETTINGS_FILENAME, O_RDONLY ) )
+    {
+        readValues( file, file.fileSize( ) );
+        file.close( );
+    }
+    if ( file.open( USAGE_FILENAME, O_RDONLY ) )
+    {
+        readValues( file, file.fileSize( ) );
+        file.close( );
+    }
+    for ( uint8_t i = 0; i < NUMBER_OF_KEYS; ++i )
+        if ( journalValues[i][0] != '\0' )
+            journalDirty |= (1 << i);
+}
+
+/**
+ * Checks a settings journal file.
  *
- * @param[out] interval
- *   The frame interval, in ms.
- * @param[out] isLaserContinuous
- *   True if the laser mode is continuous, and false if normal.
- * @param[out] burstSize
- *   The number of frames to capture per recording event.
+ * @param[in] index
+ *   The index in JOURNAL_FILENAMES of the file.
+ * @param[out] generation
+ *   The file's generation.
+ * @param[out] length
+ *   The length of the file up to its last valid commit, in bytes.
  *
  * @return
- *   Returns true if a file was read, and false no file was found or
- *   an error occurred.
- *
- * @see saveSettings()
+ *   Returns true if the file has at least one valid commit.
  */
-bool FileSystem::loadSettings(
-    uint32_t &interval,
-    bool &isLaserContinuous,
-    uint8_t &burstSize )
+bool FileSystem::scanJournal(
+    const uint8_t index,
+    uint32_t& generation,
+    uint32_t& length )
 {
-    if ( !initialized )
-        return false;
+    generation = 0;
+    length     = 0;
 
-    // Look for a settings file.
-    //
-    // - If the open fails, there is no file (or there is some
-    //   SD card problem). Just return false.
-    //
-    // - Otherwise read the file, parse the value and return it.
     SdFile file;
-    file.open( SETTINGS_FILENAME, O_RDONLY );
-    if ( !file )
+    if ( !file.open( JOURNAL_FILENAMES[index], O_RDONLY ) )
         return false;
 
+    // The first line holds the generation. After that, stop at the first
+    // commit line that does not match its batch, since nothing after it
+    // can be trusted.
+    uint32_t crc = 0;
+    int16_t nBytes;
+    while ( (nBytes = readLine( file )) > 0 )
+    {
+        if ( strncmp( sharedBuffer, "commit ", 7 ) == 0 )
+        {
+            if ( generation == 0 ||
+                 strtoul( sharedBuffer + 7, NULL, 16 ) != crc )
+                break;
+            length = file.curPosition( );
+            crc = 0;
+            continue;
+        }
+
+        crc = Crc32::compute( sharedBuffer, nBytes, crc );
+        if ( generation == 0 )
+        {
+            if ( strncmp( sharedBuffer, "generation ", 11 ) != 0 )
+                break;
+            generation = strtoul( sharedBuffer + 11, NULL, 10 );
+            if ( generation == 0 )
+                break;
+        }
+    }
+    file.close( );
+
+    return length != 0;
+}
+
+/**
+ * Reads known name-value lines from a file into RAM.
+ *
+ * @param[in,out] file
+ *   The file to read from.
+ * @param[in] length
+ *   The length to read up to, in bytes.
+ */
+void FileSystem::readValues( SdFile& file, const uint32_t length )
+{
     // Loop over lines in the file. Each line is a name-value pair.
     char* name;
     char* value;
-    while ( readLine( file ) > 0 )
+    while ( file.curPosition( ) < length && readLine( file ) > 0 )
     {
         // Parse the line.
         parseLine( sharedBuffer, name, value );
 
         // Ignore malformed lines that don't have a name and a value,
-        // separated by white space.
+        // separated by white space, and lines for unknown keys, which
+        // include generation and commit lines.
         if ( name[0] == '\0' || value[0] == '\0' )
             continue;
 
-        if ( strcmp( name, "interval" ) == 0 )
-        {
-            interval = atoi( value );
-        }
-        else if ( strcmp( name, "burstsize" ) == 0 )
-        {
-            burstSize = atoi( value );
-        }
-        else if ( strcmp( name, "lasercontinuous" ) == 0 )
+        for ( uint8_t i = 0; i < NUMBER_OF_KEYS; ++i )
         {
-            if ( atoi( value ) == 1 )
-                isLaserContinuous = true;
-            else
-                isLaserContinuous = false;
+            if ( strcmp( name, JOURNAL_KEYS[i] ) == 0 )
+            {
+                strncpy( journalValues[i], value, JOURNAL_VALUE_SIZE - 1 );
+                journalValues[i][JOURNAL_VALUE_SIZE - 1] = '\0';
+                break;
+            }
         }
     }
-    file.close( );
-
-    return true;
 }
 
 /**
- * Saves settings to a settings file.
- *
- * @param[in] interval
- *   The frame interval, in ms.
- * @param[in] isLaserContinuous
- *   True if the laser mode is continuous, and false if normal.
- * @param[in] burstSize
- *   The number of frames to capture per recording event.
+ * Writes all values to the other settings journal file, under the
+ * next generation, and makes it the one appended to.
  *
  * @return
- *   Returns true if the file was written, and false if an error
- *   occurred.
+ *   Returns true on success. On failure, false is returned and error
+ *   codes are set.
  *
- * @see loadSettings()
+ * @see commitSettings()
  */
-bool FileSystem::saveSettings(
-    const uint32_t interval,
-    const bool isLaserContinuous,
-    const uint8_t burstSize )
+bool FileSystem::compactJournal( )
 {
-    if ( !initialized )
-        return false;
+    // The first journal replaces the files of older versions, if any.
+    const bool first = (journalGeneration == 0);
+    const uint8_t next = first ? 0 : 1 - journalFile;
 
-    localErrorCode = FS_ERROR_NONE;
-    cardErrorCode  = SD_CARD_ERROR_NONE;
+    uint16_t keys = 0;
+    for ( uint8_t i = 0; i < NUMBER_OF_KEYS; ++i )
+        if ( journalValues[i][0] != '\0' )
+            keys |= (1 << i);
 
-    // Create or overwrite settings file.
-    //
-    // - If the open fails, the file could not be created. There may be an
-    //   SD card problem. Just return.
-    //
-    // - Otherwise write the settings to the file.
+    // The current file is not touched, so if this is cut short, it is
+    // still used on the next boot.
     SdFile file;
-    file.open( SETTINGS_FILENAME, O_WRONLY|O_CREAT );
-    if ( !file )
+    if ( !createFile( file, JOURNAL_FILENAMES[next] ) )
+    {
+        cardErrorCode  = sd.sdErrorCode( );
+        localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
         return false;
+    }
 
-    // See comments about SdFat's write() and sync() in the body of the
-    // writeDataLogHeader() method above.
-    sprintf( sharedBuffer, "interval %ld\r\nburstsize %d\r\nlasercontinuous %d\r\n",
-        interval,
-        burstSize,
-        (isLaserContinuous ? 1 : 0) );
-    const uint32_t nBytes = strlen( sharedBuffer );
-    if ( file.write( sharedBuffer, nBytes ) != nBytes ||
+    const uint32_t nBytes = formatBatch( keys, journalGeneration + 1 );
+    if ( !writeFile( file, sharedBuffer, nBytes ) ||
          !file.sync( ) )
     {
         cardErrorCode  = sd.sdErrorCode( );  // Probably NONE.
@@ -763,293 +2201,540 @@ bool FileSystem::saveSettings(
         file.close( );
         return false;
     }
-
     file.close( );
+
+    journalFile  = next;
+    ++journalGeneration;
+    journalDirty = 0;
+
+    if ( first )
+    {
+        if ( sd.exists( SETTINGS_FILENAME ) )
+            removeFile( SETTINGS_FILENAME );
+        if ( sd.exists( USAGE_FILENAME ) )
+            removeFile( USAGE_FILENAME );
+    }
     return true;
 }
 
+/**
+ * Formats a batch of name-value lines and its commit line into the
+ * shared buffer.
+ *
+ * @param[in] keys
+ *   A mask of the keys to include.
+ * @param[in] generation
+ *   The generation line to start with, or 0 for none.
+ *
+ * @return
+ *   Returns the number of bytes formatted.
+ */
+uint32_t FileSystem::formatBatch( const uint16_t keys, const uint32_t generation )
+{
+    // The checksum skips line endings, which readLine() drops.
+    uint32_t nBytes = 0;
+    uint32_t crc = 0;
+    if ( generation != 0 )
+    {
+        const int n = sprintf( sharedBuffer, "generation %ld", (long) generation );
+        crc = Crc32::compute( sharedBuffer, n, crc );
+        nBytes = n + sprintf( sharedBuffer + n, "\r\n" );
+    }
+    for ( uint8_t i = 0; i < NUMBER_OF_KEYS; ++i )
+    {
+        if ( (keys & (1 << i)) == 0 )
+            continue;
+        char*const line = sharedBuffer + nBytes;
+        const int n = sprintf( line, "%s %s", JOURNAL_KEYS[i], journalValues[i] );
+        crc = Crc32::compute( line, n, crc );
+        nBytes += n + sprintf( line + n, "\r\n" );
+    }
+    nBytes += sprintf( sharedBuffer + nBytes, "commit %08lx\r\n", (unsigned long) crc );
+    return nBytes;
+}
+
+/**
+ * Sets a value in RAM, and marks its key as changed if it differs.
+ *
+ * @param[in] key
+ *   One of the KEY_* values.
+ * @param[in] value
+ *   The value, as text.
+ */
+void FileSystem::stageValue( const uint8_t key, const char*const value )
+{
+    if ( key >= NUMBER_OF_KEYS )
+        return;
+
+    // Load first, so that the load does not replace the staged value.
+    if ( initialized )
+        loadJournal( );
+    if ( strcmp( journalValues[key], value ) == 0 )
+        return;
+    strcpy( journalValues[key], value );
+    journalDirty |= (1 << key);
+}
+
 
 
 
 
-#if defined(ENABLE_USAGE_TRACKING)
 //----------------------------------------------------------------------
-// Stats file.
+// Mission plan file.
 //----------------------------------------------------------------------
 /**
- * Loads usage from a saved usage tracking file, if any.
+ * Reads the mission plan file, a line at a time.
  *
- * @param[out] usage
- *   The current usage.
+ * Lines longer than the shared buffer are split.
  *
- * @return
- *   Returns true if a file was read, and false no file was found or
- *   an error occurred.
+ * @param[in] visit
+ *   The visitor for each line, including blank ones. The line is in
+ *   the shared buffer, so the visitor must not use FileSystem methods
+ *   that need it.
  *
- * @see saveUsage()
+ * @return
+ *   Returns true if the whole file was read, and false if it could not
+ *   be opened or the visitor ended the read.
  */
-bool FileSystem::loadUsage( Usage& usage )
+bool FileSystem::readMission( LineVisitor visit )
 {
     if ( !initialized )
         return false;
 
-    // Look for a usage tracking file.
-    //
-    // - If the open fails, there is no file (or there is some
-    //   SD card problem). Just return false.
-    //
-    // - Otherwise read the file, parse the value and return it.
+    localErrorCode = FS_ERROR_NONE;
+    cardErrorCode  = SD_CARD_ERROR_NONE;
+
     SdFile file;
-    file.open( USAGE_FILENAME, O_RDONLY );
-    if ( !file )
+    if ( !file.open( MISSION_FILENAME, O_RDONLY ) )
+    {
+        cardErrorCode = sd.sdErrorCode( );
         return false;
+    }
 
-    // Loop over lines in the file. Each line is a name-value pair.
-    char* name;
-    char* value;
-    while ( readLine( file ) > 0 )
+    // readLine() returns 0 for a blank line as well as at the end, so
+    // watch the position instead. It does not move on a read error.
+    const uint32_t size = file.fileSize( );
+    uint16_t number = 0;
+    bool status = true;
+    while ( status && file.curPosition( ) < size )
     {
-        // Parse the line.
-        parseLine( sharedBuffer, name, value );
-
-        // Ignore malformed lines that don't have a name and a value,
-        // separated by white space.
-        if ( name[0] == '\0' || value[0] == '\0' )
-            continue;
-
-        if ( strcmp( name, "numberOfBoots" ) == 0 )
-        {
-            usage.numberOfBoots = atol( value );
-        }
-        else if ( strcmp( name, "numberOfCameraBoots" ) == 0 )
+        const uint32_t position = file.curPosition( );
+        readLine( file );
+        if ( file.curPosition( ) == position )
         {
-            usage.numberOfCameraBoots = atol( value );
-        }
-        else if ( strcmp( name, "numberOfLaserBoots" ) == 0 )
-        {
-            usage.numberOfLaserBoots = atol( value );
-        }
-        else if ( strcmp( name, "numberOfEventsLogged" ) == 0 )
-        {
-            usage.numberOfEventsLogged = atol( value );
-        }
-        else if ( strcmp( name, "numberOfImagesSnapped" ) == 0 )
-        {
-            usage.numberOfImagesSnapped = atol( value );
-        }
-        else if ( strcmp( name, "controllerUptimeSeconds" ) == 0 )
-        {
-            usage.controllerUptimeSeconds = atol( value );
-        }
-        else if ( strcmp( name, "cameraUptimeSeconds" ) == 0 )
-        {
-            usage.cameraUptimeSeconds = atol( value );
-        }
-        else if ( strcmp( name, "laserUptimeSeconds" ) == 0 )
-        {
-            usage.laserUptimeSeconds = atol( value );
+            cardErrorCode = sd.sdErrorCode( );
+            status = false;
+            break;
         }
+        status = visit( sharedBuffer, ++number );
     }
     file.close( );
+    return status;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Error log file.
+//----------------------------------------------------------------------
+/**
+ * Adds bytes to the status log queue.
+ *
+ * The queue is written to the card first if needed to make room.
+ *
+ * @param[in] bytes
+ *   The bytes to add.
+ * @param[in] nBytes
+ *   The number of bytes to add.
+ *
+ * @return
+ *   Returns true on success. On failure, false is returned and error
+ *   codes are set.
+ *
+ * @see flushStatus()
+ */
+bool FileSystem::appendStatus( const char*const bytes, const uint16_t nBytes )
+{
+    if ( nBytes > STATUS_LOG_BUFFER_SIZE )
+        return false;
+    if ( nBytes > STATUS_LOG_BUFFER_SIZE - statusLogBufferCount &&
+         !flushStatus( ) )
+        return false;
 
+    for ( uint16_t i = 0; i < nBytes; ++i )
+    {
+        statusLogBuffer[statusLogBufferHead] = bytes[i];
+        statusLogBufferHead = (statusLogBufferHead + 1) % STATUS_LOG_BUFFER_SIZE;
+    }
+    statusLogBufferCount += nBytes;
     return true;
 }
 
 /**
- * Saves usage to a usage tracking file.
+ * Appends a message to the status log, creating the file if needed.
  *
- * @param[in] usage
- *   The current usage.
+ * The message is queued in RAM and written to the card later, by
+ * updateStatus() or flushStatus(), unless it is an error. Errors are
+ * written right away, along with any queued messages.
+ *
+ * @param[in] message
+ *   The message to append, along with a timestamp.
+ * @param[in] severity
+ *   The message severity. One of STATUS_INFO, STATUS_WARNING, or
+ *   STATUS_ERROR.
  *
  * @return
- *   Returns true if the file was written, and false if an error
- *   occurred.
+ *   Returns true on success. On failure, false is returned and error codes
+ *   are set. Possible failures:
+ *   - The SD card is not inserted.
+ *   - The SD card is full.
+ *   - The file has reached the 4GB max size for FAT.
+ *   - A hardware error has occurred.
+ *   - An internal SdFat error has occurred.
  *
- * @see loadUsage()
+ * @see flushStatus()
+ * @see updateStatus()
  */
-bool FileSystem::saveUsage( const Usage& usage )
+bool FileSystem::writeStatus( const char*const message, const uint8_t severity )
 {
     if ( !initialized )
         return false;
 
+    if ( *message == '\0' )
+        strcpy( sharedBuffer, "\r\n\r\n" );
+    else
+        snprintf( sharedBuffer, STATUS_LOG_BUFFER_SIZE, "%s\t%s\r\n",
+            Clock::nowString( ), message );
+
+    if ( !appendStatus( sharedBuffer, strlen( sharedBuffer ) ) )
+        return false;
+    if ( severity >= STATUS_ERROR )
+        return flushStatus( );
+    return true;
+}
+
+/**
+ * Writes queued status log messages to the card and syncs the file.
+ *
+ * @return
+ *   Returns true on success or when there is nothing to do. On failure,
+ *   false is returned, error codes are set, and the queued messages
+ *   are lost.
+ *
+ * @see closeStatus()
+ * @see updateStatus()
+ * @see writeStatus()
+ */
+bool FileSystem::flushStatus( )
+{
+    if ( !initialized || statusLogBufferCount == 0 )
+        return true;
+
     localErrorCode = FS_ERROR_NONE;
     cardErrorCode  = SD_CARD_ERROR_NONE;
 
-    // Create or overwrite settings file.
-    //
-    // - If the open fails, the file could not be created. There may be an
-    //   SD card problem. Just return.
+    // Open the status file, creating it if needed, and keep it open for
+    // later messages.
     //
-    // - Otherwise write the settings to the file.
-    SdFile file;
-    file.open( USAGE_FILENAME, O_WRONLY|O_CREAT );
-    if ( !file )
-        return false;
-
     // See comments about SdFat's write() and sync() in the body of the
-    // writeDataLogHeader() method above.
-    for ( int i = 0; i < 8; ++i )
+    // writeDataLogSectors() method above.
+    if ( !statusLogFile.isOpen( ) )
     {
-        switch ( i )
+        statusLogFile.open( STATUS_LOG_FILENAME, O_WRONLY|O_CREAT|O_APPEND );
+        if ( !statusLogFile )
         {
-            case 0:
-                sprintf( sharedBuffer, "numberOfBoots %ld\r\n",
-                    usage.numberOfBoots );
-                break;
-            case 1:
-                sprintf( sharedBuffer, "numberOfCameraBoots %ld\r\n",
-                    usage.numberOfCameraBoots );
-                break;
-            case 2:
-                sprintf( sharedBuffer, "numberOfLaserBoots %ld\r\n",
-                    usage.numberOfLaserBoots );
-                break;
-            case 3:
-                sprintf( sharedBuffer, "numberOfEventsLogged %ld\r\n",
-                    usage.numberOfEventsLogged );
-                break;
-            case 4:
-                sprintf( sharedBuffer, "numberOfImagesSnapped %ld\r\n",
-                    usage.numberOfImagesSnapped );
-                break;
-            case 5:
-                sprintf( sharedBuffer, "controllerUptimeSeconds %ld\r\n",
-                    usage.controllerUptimeSeconds );
-                break;
-            case 6:
-                sprintf( sharedBuffer, "cameraUptimeSeconds %ld\r\n",
-                    usage.cameraUptimeSeconds );
-                break;
-            case 7:
-                sprintf( sharedBuffer, "laserUptimeSeconds %ld\r\n",
-                    usage.laserUptimeSeconds );
-                break;
+            // File open/create failed. Rely upon SdFat's error codes.
+            cardErrorCode = sd.sdErrorCode( );
+            statusLogBufferTail = statusLogBufferHead;
+            statusLogBufferCount = 0;
+            return false;
         }
 
-        const uint32_t nBytes = strlen( sharedBuffer );
-        if ( file.write( sharedBuffer, nBytes ) != nBytes ||
-             !file.sync( ) )
+        if ( statusLogFile.fileSize( ) == 0 )
         {
-            cardErrorCode  = sd.sdErrorCode( );  // Probably NONE.
-            localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
-            file.close( );
-            return false;
+            // The file has just been created. Add a first message. Not
+            // in sharedBuffer, which may hold the message being queued
+            // by writeStatus().
+            char created[48];
+            const int n = sprintf( created, "%s\tLog file created\r\n",
+                Clock::nowString( ) );
+            writeFile( statusLogFile, created, n );
         }
     }
 
-    file.close( );
+    // Write the queue in at most two pieces, where it wraps around.
+    bool status = true;
+    while ( statusLogBufferCount > 0 && status )
+    {
+        uint16_t nBytes = STATUS_LOG_BUFFER_SIZE - statusLogBufferTail;
+        if ( nBytes > statusLogBufferCount )
+            nBytes = statusLogBufferCount;
+        if ( !writeFile( statusLogFile, statusLogBuffer + statusLogBufferTail, nBytes ) )
+            status = false;
+        statusLogBufferTail = (statusLogBufferTail + nBytes) % STATUS_LOG_BUFFER_SIZE;
+        statusLogBufferCount -= nBytes;
+    }
+
+    if ( !status || !statusLogFile.sync( ) )
+    {
+        // File write or sync failed. The SD card may be full. Drop the
+        // queue and close the file, so the next message tries afresh.
+        cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
+        if ( sd.card( )->sectorCount( ) <= 0 )
+            localErrorCode = FS_ERROR_NOCARD;
+        else
+            localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
+        statusLogBufferTail = statusLogBufferHead;
+        statusLogBufferCount = 0;
+        statusLogFile.close( );
+        return false;
+    }
+
     return true;
 }
-#endif
+
+/**
+ * Writes queued status log messages to the card and closes the file.
+ *
+ * The file is opened again by the next write. This should be called
+ * before the file may be removed or read, such as by a command.
+ *
+ * @see flushStatus()
+ */
+void FileSystem::closeStatus( )
+{
+    flushStatus( );
+    if ( statusLogFile.isOpen( ) )
+        statusLogFile.close( );
+}
 
 
 
 
 
 //----------------------------------------------------------------------
-// Error log file.
+// Directory walk.
 //----------------------------------------------------------------------
 /**
- * Appends a message to the status log, creating the file if needed.
+ * Walks a file or directory, visiting each entry.
  *
- * @param[in] message
- *   The message to append, along with a timestamp.
+ * This is shared by du(), ls(), and rmall(). The walk is iterative:
+ * it keeps one open directory handle per level, and a single path
+ * buffer that grows and shrinks as it goes down and up, so it does no
+ * heap allocation and no path lookups after opening the top.
+ *
+ * The visitor is called with the entry and the directory it is in,
+ * or NULL for the top:
+ * - WALK_FILE for a file.
+ * - WALK_DIR for a directory, before its entries, if any are walked.
+ * - WALK_DIR_END for a directory after its entries, with its handle
+ *   still open.
+ * The current path is in walkPath, and the entry's name is in
+ * sharedFilename, while the visitor runs.
+ *
+ * @param[in] path
+ *   The path of a file or directory.
+ * @param[in] recurse
+ *   True to walk subdirectories too, and false to walk only the top
+ *   directory's entries.
+ * @param[in] writable
+ *   True to open files for writing, so that the visitor can remove
+ *   them through the handle it is given. Directories are always open
+ *   for reading, which is all that rmdir() needs.
+ * @param[in] visit
+ *   The visitor. It returns false to end the walk.
  *
  * @return
- *   Returns true on success. On failure, false is returned and error codes
- *   are set. Possible failures:
- *   - The SD card is not inserted.
- *   - The SD card is full.
- *   - The file has reached the 4GB max size for FAT.
- *   - A hardware error has occurred.
- *   - An internal SdFat error has occurred.
+ *   Returns true if the whole walk was done. On failure, false is
+ *   returned, and error codes are set unless the visitor ended it.
+ *   Possible failures:
+ *   - The path does not exist.
+ *   - The path, or the directory nesting, is too deep to walk.
  */
-bool FileSystem::writeStatus( const char*const message )
+bool FileSystem::walk( const char*const path, const bool recurse,
+    const bool writable, WalkVisitor visit )
 {
-    if ( !initialized )
+    // Start the path, without a trailing '/', so that the root is empty.
+    uint16_t length = strlen( path );
+    while ( length > 0 && path[length-1] == '/' )
+        --length;
+    if ( length > WALK_MAX_PATH )
+    {
+        localErrorCode = FS_ERROR_TOO_DEEP;
         return false;
+    }
+    memcpy( walkPath, path, length );
+    walkPath[length] = '\0';
 
-    SdFile file;
-    bool status    = true;
-    localErrorCode = FS_ERROR_NONE;
-    cardErrorCode  = SD_CARD_ERROR_NONE;
-
-    // Create or overwrite status file.
-    //
-    // See comments about SdFat's write() and sync() in the body of the
-    // writeDataLogHeader() method above.
-    const bool alreadyExisted = sd.exists( STATUS_LOG_FILENAME );
-    file.open( STATUS_LOG_FILENAME, O_WRONLY|O_CREAT|O_APPEND );
-    if ( !file )
+    // Directories cannot be open for writing, so a directory at the top is
+    // opened for reading.
+    SdFile& top = walkDirs[0];
+    if ( !(writable && top.open( path, O_RDWR )) && !top.open( path, O_RDONLY ) )
     {
-        // File open/create failed. Rely upon SdFat's error codes.
-        cardErrorCode = sd.sdErrorCode( );
-        status = false;
+        localErrorCode = FS_ERROR_BAD_PATH;
+        return false;
     }
-    else
+    top.getName( sharedFilename, MAX_FILENAME+1 );
+    if ( !top.isDir( ) )
+    {
+        const bool status = visit( top, NULL, WALK_FILE, 0 );
+        top.close( );
+        return status;
+    }
+    if ( !visit( top, NULL, WALK_DIR, 0 ) )
+    {
+        top.close( );
+        return false;
+    }
+
+    // The directory at each depth is open. Its next entry is opened at the
+    // depth below, and becomes the current directory if it is to be walked.
+    uint8_t depth = 0;
+    walkPathEnds[0] = length;
+    bool status = true;
+    for ( ;; )
     {
-        const char* now = Clock::nowString( );
-        if ( !alreadyExisted )
+        SdFile& dir   = walkDirs[depth];
+        SdFile& entry = walkDirs[depth + 1];
+        const uint32_t position = dir.curPosition( );
+        bool opened = entry.openNext( &dir, writable ? O_RDWR : O_RDONLY );
+        if ( !opened && writable )
         {
-            // The file has just been created. Add a first message.
-            sprintf( sharedBuffer, "%s\tLog file created\r\n", now );
-            const uint32_t nBytes = strlen( sharedBuffer );
-            if ( file.write( sharedBuffer, nBytes ) != nBytes )
-            {
-                // File write failed. The SD card may be full.
-                cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
-                if ( sd.card( )->sectorCount( ) <= 0 )
-                    localErrorCode = FS_ERROR_NOCARD;
-                else
-                    localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
-                status = false;
-            }
+            // The entry is a directory, or the end was reached. Go back and
+            // open it for reading instead.
+            opened = dir.seekSet( position ) && entry.openNext( &dir, O_RDONLY );
         }
-        if ( *message == '\0' )
+        if ( opened )
         {
-            if ( file.write( "\r\n\r\n", 4 ) != 4 )
+            // Add the entry's name to the path.
+            entry.getName( sharedFilename, MAX_FILENAME+1 );
+            const uint16_t nameLength = strlen( sharedFilename );
+            if ( length + 1 + nameLength > WALK_MAX_PATH )
             {
-                // File write failed. The SD card may be full.
-                cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
-                if ( sd.card( )->sectorCount( ) <= 0 )
-                    localErrorCode = FS_ERROR_NOCARD;
-                else
-                    localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
+                localErrorCode = FS_ERROR_TOO_DEEP;
                 status = false;
+                break;
             }
-        }
-        else
-        {
-            sprintf( sharedBuffer, "%s\t%s\r\n", now, message );
-            const uint32_t nBytes = strlen( sharedBuffer );
-            if ( file.write( sharedBuffer, nBytes ) != nBytes )
+            walkPath[length++] = '/';
+            memcpy( walkPath + length, sharedFilename, nameLength + 1 );
+            length += nameLength;
+
+            if ( !entry.isDir( ) )
+                status = visit( entry, &dir, WALK_FILE, depth + 1 );
+            else
             {
-                // File write failed. The SD card may be full.
-                cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
-                if ( sd.card( )->sectorCount( ) <= 0 )
-                    localErrorCode = FS_ERROR_NOCARD;
-                else
-                    localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
-                status = false;
+                status = visit( entry, &dir, WALK_DIR, depth + 1 );
+                if ( status && recurse )
+                {
+                    // Walk the subdirectory.
+                    if ( depth + 1 >= WALK_MAX_DEPTH )
+                    {
+                        localErrorCode = FS_ERROR_TOO_DEEP;
+                        status = false;
+                        break;
+                    }
+                    walkPathEnds[++depth] = length;
+                    continue;
+                }
             }
-        }
+            entry.close( );
+            if ( !status )
+                break;
 
-        if ( !file.sync( ) )
-        {
-            // File sync failed. The SD card may be full.
-            cardErrorCode = sd.sdErrorCode( );  // Probably NONE.
-            if ( sd.card( )->sectorCount( ) <= 0 )
-                localErrorCode = FS_ERROR_NOCARD;
-            else
-                localErrorCode = FS_ERROR_CARD_FULL; // Best guess.
-            status = false;
+            length = walkPathEnds[depth];
+            walkPath[length] = '\0';
+            continue;
         }
-        file.close( );
+
+        // The directory's entries are done.
+        dir.getName( sharedFilename, MAX_FILENAME+1 );
+        status = visit( dir, (depth == 0) ? NULL : &walkDirs[depth - 1],
+            WALK_DIR_END, depth );
+        dir.close( );
+        if ( !status || depth == 0 )
+            break;
+        length = walkPathEnds[--depth];
+        walkPath[length] = '\0';
     }
 
+    // Close the handles still open after a failure.
+    for ( uint8_t i = 0; i <= WALK_MAX_DEPTH; ++i )
+        if ( walkDirs[i].isOpen( ) )
+            walkDirs[i].close( );
     return status;
 }
 
+/**
+ * Adds an entry's size to walkBytes, for du().
+ *
+ * @see walk()
+ */
+bool FileSystem::duVisit( SdFile& entry, SdFile*, const uint8_t event,
+    const uint8_t )
+{
+    if ( event != WALK_DIR_END )
+        walkBytes += entry.fileSize( );
+    return true;
+}
+
+/**
+ * Lists an entry to the serial port, for ls().
+ *
+ * @see walk()
+ */
+bool FileSystem::lsVisit( SdFile& entry, SdFile*, const uint8_t event,
+    const uint8_t depth )
+{
+    // The top directory itself is not listed.
+    if ( event == WALK_FILE )
+        Serial.printf( "%-20s %9ld\r\n", sharedFilename, (long) entry.fileSize( ) );
+    else if ( event == WALK_DIR && depth > 0 )
+        Serial.printf( "%s/\r\n", sharedFilename );
+    return true;
+}
+
+/**
+ * Removes a file, or a directory after its entries, for rmall().
+ *
+ * @see walk()
+ */
+bool FileSystem::rmallVisit( SdFile& entry, SdFile*, const uint8_t event,
+    const uint8_t depth )
+{
+    bool removed = true;
+    if ( event == WALK_FILE )
+    {
+        // The walk opened the file for writing, so it is removed through
+        // its handle, without looking it up again.
+        const uint32_t size = entry.fileSize( );
+        removed = entry.remove( );
+        if ( removed )
+            trackFileSize( size, 0 );
+    }
+    else if ( event == WALK_DIR_END && (depth > 0 || walkPath[0] != '\0') )
+    {
+        // The directory is empty now. If it is NOT root, then delete it.
+        // A directory's size is not recorded, but the walk has read its
+        // entries through the last one, which is near enough.
+        const uint32_t size = max( entry.curPosition( ), (uint32_t)1 );
+        removed = entry.rmdir( );
+        if ( removed )
+            trackFileSize( size, 0 );
+    }
+
+    if ( !removed )
+    {
+        if ( hasError( ) )
+            Serial.printf( "Error: %s\r\n", getErrorMessage( ) );
+        else
+            localErrorCode = FS_ERROR_CANNOT_RM;
+        Serial.printf( "Cannot remove %s\r\n", walkPath );
+    }
+    return removed;
+}
+
 
 
 
@@ -1071,6 +2756,9 @@ bool FileSystem::writeStatus( const char*const message )
  */
 bool FileSystem::cat( const char*const path )
 {
+    // Write queued status messages, in case the status log is shown.
+    flushStatus( );
+
     bool status    = true;
     localErrorCode = FS_ERROR_NONE;
     cardErrorCode  = SD_CARD_ERROR_NONE;
@@ -1115,51 +2803,27 @@ bool FileSystem::cat( const char*const path )
  *
  * @param[in] path
  *   The path of a file or directory.
- * @param[in] isTop
- *   (optional, default = true) True for the top-most call, and false
- *   during recursion.
  *
  * @return
  *   Returns the size, in bytes, on success. On failure, returns zero
  *   and error codes are set.
  */
-uint64_t FileSystem::du( const char*const path, const bool isTop )
+uint64_t FileSystem::du( const char*const path )
 {
-    if ( isTop )
-    {
-        if ( !isCardPresent( ) )
-        {
-            cardErrorCode = sd.sdErrorCode( );
-            localErrorCode = FS_ERROR_NOCARD;
-            return 0;
-        }
-        localErrorCode = FS_ERROR_NONE;
-        cardErrorCode  = SD_CARD_ERROR_NONE;
-    }
-
-    uint64_t nBytes = 0;
-    SdFile fileOrDir( path, O_RDONLY );
-    if ( !fileOrDir.isOpen( ) )
-        localErrorCode = FS_ERROR_BAD_PATH;
-    else if ( !fileOrDir.isDir( ) )
-        nBytes = fileOrDir.fileSize( );
-    else
+    if ( !isCardPresent( ) )
     {
-        nBytes = fileOrDir.fileSize( );
-
-        // Recurse through directory's children.
-        SdFile entry;
-        while ( entry.openNext( &fileOrDir, O_RDONLY ) )
-        {
-            entry.getName( sharedFilename, MAX_FILENAME+1 );
-            const String s = String( path ) + "/" + sharedFilename;
-            entry.close( );
-            nBytes += du( s.c_str( ), false );
-        }
+        cardErrorCode = sd.sdErrorCode( );
+        localErrorCode = FS_ERROR_NOCARD;
+        return 0;
     }
-    fileOrDir.close( );
+    flushStatus( );
+    localErrorCode = FS_ERROR_NONE;
+    cardErrorCode  = SD_CARD_ERROR_NONE;
 
-    return nBytes;
+    walkBytes = 0;
+    if ( !walk( path, true, false, duVisit ) )
+        return 0;
+    return walkBytes;
 }
 
 
@@ -1186,6 +2850,7 @@ bool FileSystem::head( const char*const path )
         localErrorCode = FS_ERROR_NOCARD;
         return false;
     }
+    flushStatus( );
 
     bool status = true;
     localErrorCode = FS_ERROR_NONE;
@@ -1264,46 +2929,13 @@ bool FileSystem::ls( const char*const path )
         localErrorCode = FS_ERROR_NOCARD;
         return false;
     }
+    flushStatus( );
 
-    bool status = true;
     localErrorCode = FS_ERROR_NONE;
     cardErrorCode  = SD_CARD_ERROR_NONE;
-    SdFile fileOrDir( path, O_RDONLY );
-    if ( !fileOrDir.isOpen( ) )
-    {
-        localErrorCode = FS_ERROR_BAD_PATH;
-        status = false;
-    }
-    else
-    {
-        if ( !fileOrDir.isDir( ) )
-        {
-            // The item is a file. Print its name and size.
-            fileOrDir.getName( sharedFilename, MAX_FILENAME+1 );
-            const uint32_t size = fileOrDir.fileSize( );
-            Serial.printf( "%-20s %9ld\r\n", sharedFilename, size );
-        }
-        else
-        {
-            // The item is a directory. List contents.
-            SdFile entry;
-            while ( entry.openNext( &fileOrDir, O_RDONLY ) )
-            {
-                entry.getName( sharedFilename, MAX_FILENAME+1 );
-                if (entry.isDir( ) )
-                    Serial.printf( "%s/\r\n", sharedFilename );
-                else
-                {
-                    const uint32_t size = entry.fileSize( );
-                    Serial.printf( "%-20s %9ld\r\n", sharedFilename, size );
-                }
-                entry.close( );
-            }
-        }
-        fileOrDir.close( );
-    }
 
-    return status;
+    // List a file, or a directory's entries.
+    return walk( path, false, false, lsVisit );
 }
 
 
@@ -1316,81 +2948,30 @@ bool FileSystem::ls( const char*const path )
  *
  * @param[in] path
  *   The path of a file or directory.
- * @param[in] isTop
- *   (optional, default = true) True for the top-most call, and false
- *   during recursion.
  *
  * @return
  *   Returns true on sucess or recoverable problems, and false on
  *   I/O errors.
  */
-bool FileSystem::rmall( const char*const path, const bool isTop )
+bool FileSystem::rmall( const char*const path )
 {
-    if ( isTop )
-    {
-        if ( !isCardPresent( ) )
-        {
-            cardErrorCode = sd.sdErrorCode( );
-            localErrorCode = FS_ERROR_NOCARD;
-            return false;
-        }
-        localErrorCode = FS_ERROR_NONE;
-        cardErrorCode  = SD_CARD_ERROR_NONE;
-    }
-
-    bool status = true;
-    SdFile fileOrDir( path, O_RDONLY );
-    if ( !fileOrDir.isOpen( ) )
-    {
-        localErrorCode = FS_ERROR_BAD_PATH;
-        status = false;
-    }
-    else if ( !fileOrDir.isDir( ) )
+    if ( !isCardPresent( ) )
     {
-        fileOrDir.close( );
-        if ( !sd.remove( path ) )
-        {
-            if ( hasError( ) )
-                Serial.printf( "Error: %s\r\n", getErrorMessage( ) );
-            else
-                localErrorCode = FS_ERROR_CANNOT_RM;
-            status = false;
-        }
+        cardErrorCode = sd.sdErrorCode( );
+        localErrorCode = FS_ERROR_NOCARD;
+        return false;
     }
-    else
-    {
-        // The item is a directory. Recurse through its children.
-        const bool isRoot = (strcmp( path, "/" ) == 0);
-        SdFile entry;
-        while ( entry.openNext( &fileOrDir, O_RDONLY ) )
-        {
-            entry.getName( sharedFilename, MAX_FILENAME+1 );
-            const String s = isRoot ?
-                (String( "/" ) + sharedFilename) :
-                (String( path ) + "/" + sharedFilename);
-            entry.close( );
+    // The status log may be removed, so close it. It is opened
+    // again by the next write.
+    closeStatus( );
+    localErrorCode = FS_ERROR_NONE;
+    cardErrorCode  = SD_CARD_ERROR_NONE;
 
-            if ( !rmall( s.c_str( ), false ) )
-            {
-                status = false;
-                break;
-            }
-        }
-        fileOrDir.close( );
+    const bool status = walk( path, true, true, rmallVisit );
 
-        if ( status && !isRoot )
-        {
-            // If the directory is NOT root, then delete it.
-            if ( !sd.rmdir( path ) )
-            {
-                if ( hasError( ) )
-                    Serial.printf( "Error: %s\r\n", getErrorMessage( ) );
-                else
-                    localErrorCode = FS_ERROR_CANNOT_RM;
-                status = false;
-            }
-        }
-    }
+    // Log files may have been removed, so find the next log file number
+    // again.
+    scanDataLogs( );
 
     return status;
 }
@@ -1419,6 +3000,7 @@ bool FileSystem::tail( const char*const path )
         localErrorCode = FS_ERROR_NOCARD;
         return false;
     }
+    flushStatus( );
 
     bool status = true;
     localErrorCode = FS_ERROR_NONE;
@@ -1506,3 +3088,268 @@ bool FileSystem::tail( const char*const path )
 
     return status;
 }
+
+
+
+
+
+//----------------------------------------------------------------------
+// Serial file transfer.
+//----------------------------------------------------------------------
+/**
+ * Sends a frame on the serial port.
+ *
+ * The header, payload, and CRC are written separately so that the
+ * payload need not be copied.
+ *
+ * @param[in] type
+ *   The FRAME_* frame type.
+ * @param[in] sequence
+ *   The chunk sequence number.
+ * @param[in] offset
+ *   The file offset.
+ * @param[in] payload
+ *   The payload, or NULL if there is none.
+ * @param[in] nBytes
+ *   The payload length, up to FRAME_CHUNK_SIZE.
+ */
+void FileSystem::sendFrame(
+    const uint8_t type,
+    const uint32_t sequence,
+    const uint32_t offset,
+    const void*const payload,
+    const uint16_t nBytes )
+{
+    FrameHeader header;
+    header.magic    = FRAME_MAGIC;
+    header.type     = type;
+    header.reserved = 0;
+    header.sequence = sequence;
+    header.offset   = offset;
+    header.length   = nBytes;
+
+    uint32_t crc = Crc32::compute( &header, sizeof( header ) );
+    Serial.write( (const uint8_t*) &header, sizeof( header ) );
+    if ( nBytes != 0 )
+    {
+        crc = Crc32::compute( payload, nBytes, crc );
+        Serial.write( (const uint8_t*) payload, nBytes );
+    }
+    Serial.write( (const uint8_t*) &crc, sizeof( crc ) );
+}
+
+/**
+ * Receives a host frame from the serial port, if one has arrived.
+ *
+ * Bytes are collected into the frame input buffer as they arrive, so a
+ * frame may take several calls. Host frames have no payload. On a bad
+ * magic number, length, or CRC, the first byte is dropped and the rest
+ * are scanned again for the start of a frame.
+ *
+ * @param[out] header
+ *   The frame's header.
+ *
+ * @return
+ *   Returns true if a frame was received.
+ */
+bool FileSystem::receiveFrame( FrameHeader& header )
+{
+    while ( Serial.available( ) > 0 )
+    {
+        frameInput[frameInputCount++] = Serial.read( );
+
+        // Wait for the magic number, a byte at a time.
+        const uint16_t magic = FRAME_MAGIC;
+        if ( frameInputCount <= sizeof( magic ) )
+        {
+            if ( frameInput[frameInputCount-1] !=
+                 ((const uint8_t*) &magic)[frameInputCount-1] )
+                frameInputCount = (frameInput[frameInputCount-1] ==
+                    ((const uint8_t*) &magic)[0]) ? 1 : 0;
+            continue;
+        }
+        if ( frameInputCount < sizeof( frameInput ) )
+            continue;
+
+        memcpy( &header, frameInput, sizeof( header ) );
+        uint32_t crc;
+        memcpy( &crc, frameInput + sizeof( header ), sizeof( crc ) );
+        if ( header.length == 0 &&
+             crc == Crc32::compute( frameInput, sizeof( header ) ) )
+        {
+            frameInputCount = 0;
+            return true;
+        }
+
+        // Not a frame. Drop the first byte and rescan the rest.
+        const uint8_t n = frameInputCount - 1;
+        frameInputCount = 0;
+        for ( uint8_t i = 0; i < n; ++i )
+        {
+            const uint8_t byte = frameInput[i+1];
+            frameInput[frameInputCount++] = byte;
+            if ( frameInputCount <= sizeof( magic ) &&
+                 byte != ((const uint8_t*) &magic)[frameInputCount-1] )
+                frameInputCount = (byte == ((const uint8_t*) &magic)[0]) ? 1 : 0;
+        }
+    }
+    return false;
+}
+
+
+
+
+
+/**
+ * Sends a file on the serial port, using the frame protocol described
+ * in SerialFrames.h.
+ *
+ * Up to FRAME_WINDOW chunks are sent ahead of the host's acknowledgement.
+ * On a NAK, or when no acknowledgement arrives in time, chunks are resent
+ * from the first one the host still needs (go-back-N). Chunks are read
+ * from the card as they are sent, so only one chunk is held in RAM.
+ *
+ * The whole-file CRC sent at the end is computed as each chunk is first
+ * sent, after a pass over any part of the file before the offset.
+ *
+ * @param[in] path
+ *   The path of a file.
+ * @param[in] offset
+ *   (optional, default = 0) The file offset to start at.
+ *
+ * @return
+ *   Returns true if the whole file was sent and acknowledged, and
+ *   false otherwise.
+ */
+bool FileSystem::get( const char*const path, const uint32_t offset )
+{
+    // Write queued status messages, in case the status log is sent.
+    flushStatus( );
+
+    localErrorCode  = FS_ERROR_NONE;
+    cardErrorCode   = SD_CARD_ERROR_NONE;
+    frameInputCount = 0;
+
+    SdFile file( path, O_RDONLY );
+    if ( !file.isOpen( ) || file.isDir( ) )
+    {
+        localErrorCode = file.isOpen( ) ? FS_ERROR_IS_DIR : FS_ERROR_BAD_PATH;
+        const char*const message = getErrorMessage( );
+        sendFrame( FRAME_ERROR, 0, 0, message, strlen( message ) );
+        file.close( );
+        return false;
+    }
+
+    const uint32_t fileSize = file.fileSize( );
+    const uint32_t startOffset = (offset < fileSize) ? offset : fileSize;
+    const uint32_t numberOfChunks =
+        (fileSize - startOffset + FRAME_CHUNK_SIZE - 1) / FRAME_CHUNK_SIZE;
+
+    // Checksum the part of the file before the offset.
+    uint32_t fileCrc = 0;
+    uint32_t crcPosition = 0;
+    while ( crcPosition < startOffset )
+    {
+        const uint32_t remaining = startOffset - crcPosition;
+        const int16_t nBytes = file.read( sharedBuffer,
+            (remaining < BUFFER_SIZE-1) ? remaining : BUFFER_SIZE-1 );
+        if ( nBytes <= 0 )
+            break;
+        fileCrc = Crc32::compute( sharedBuffer, nBytes, fileCrc );
+        crcPosition += nBytes;
+    }
+
+    bool status = (crcPosition == startOffset);
+    if ( status )
+    {
+        FrameStart start;
+        start.fileSize  = fileSize;
+        start.chunkSize = FRAME_CHUNK_SIZE;
+        start.window    = FRAME_WINDOW;
+        sendFrame( FRAME_START, 0, startOffset, &start, sizeof( start ) );
+    }
+
+    uint32_t ackedSequence = 0;
+    uint32_t nextSequence = 0;
+    uint32_t ackTime = millis( );
+    uint32_t hostTime = ackTime;
+    while ( status && ackedSequence < numberOfChunks )
+    {
+        // Send the next chunk, if the window allows.
+        if ( nextSequence < numberOfChunks &&
+             nextSequence < ackedSequence + FRAME_WINDOW )
+        {
+            const uint32_t position = startOffset + nextSequence * FRAME_CHUNK_SIZE;
+            const uint16_t nBytes = (fileSize - position < FRAME_CHUNK_SIZE) ?
+                fileSize - position : FRAME_CHUNK_SIZE;
+            if ( (file.curPosition( ) != position && !file.seekSet( position )) ||
+                 file.read( sharedBuffer, nBytes ) != nBytes )
+            {
+                status = false;
+                break;
+            }
+
+            // Resent chunks have already been checksummed.
+            if ( position == crcPosition )
+            {
+                fileCrc = Crc32::compute( sharedBuffer, nBytes, fileCrc );
+                crcPosition += nBytes;
+            }
+            sendFrame( FRAME_DATA, nextSequence, position, sharedBuffer, nBytes );
+            ++nextSequence;
+        }
+
+        FrameHeader header;
+        if ( receiveFrame( header ) )
+        {
+            hostTime = millis( );
+            if ( header.type == FRAME_ABORT )
+            {
+                file.close( );
+                return false;
+            }
+
+            // Both frames acknowledge every chunk before the sequence
+            // number. A NAK also asks for the rest to be resent.
+            if ( (header.type == FRAME_ACK || header.type == FRAME_NAK) &&
+                 header.sequence >= ackedSequence &&
+                 header.sequence <= nextSequence )
+            {
+                ackedSequence = header.sequence;
+                ackTime = hostTime;
+                if ( header.type == FRAME_NAK )
+                    nextSequence = ackedSequence;
+            }
+        }
+        else if ( millis( ) - hostTime >= FRAME_IDLE_TIMEOUT )
+        {
+            // The host has gone away.
+            file.close( );
+            return false;
+        }
+        else if ( nextSequence > ackedSequence &&
+                  millis( ) - ackTime >= FRAME_ACK_TIMEOUT )
+        {
+            // Acknowledgements have been lost. Resend the window.
+            nextSequence = ackedSequence;
+            ackTime = millis( );
+        }
+    }
+
+    if ( status )
+    {
+        FrameEnd end;
+        end.fileSize = fileSize;
+        end.fileCrc  = fileCrc;
+        sendFrame( FRAME_END, numberOfChunks, fileSize, &end, sizeof( end ) );
+    }
+    else
+    {
+        cardErrorCode = sd.sdErrorCode( );
+        const char*const message = getErrorMessage( );
+        sendFrame( FRAME_ERROR, nextSequence, 0, message, strlen( message ) );
+    }
+    file.close( );
+
+    return status;
+}
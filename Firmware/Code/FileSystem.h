@@ -3,21 +3,105 @@
 #include <SdFat.h>
 
 #include "pltlogger.h"
+#include "LogFormat.h"
+#include "SerialFrames.h"
 
 // Define to include battery columns in the data log.
 #define BATTERY_IN_DATA_LOG
 
+// Define to write the data log as compact binary records instead of CSV
+// text. Binary records take far less time to write and far less room on
+// the card. The "pltdecode" host tool converts a binary data log into the
+// same CSV file that would have been written otherwise.
+//#define DATA_LOG_BINARY
+
 #define FS_ERROR_CODE_LIST \
     FS_ERROR(NONE, "No error.")\
     FS_ERROR(UNINITIALIZED, "Initialization failure.")\
     FS_ERROR(NOCARD, "Missing SD card or bad card format.")\
     FS_ERROR(BAD_FORMAT, "Unsupported SD card format.")\
     FS_ERROR(CARD_FULL, "SD card is full.")\
-    FS_ERROR(TOO_MANY_LOG_FILES, "Too many log files; 100 max.")\
+    FS_ERROR(TOO_MANY_LOG_FILES, "Too many log files; 1000 max.")\
     FS_ERROR(BAD_PATH, "No such file or directory.")\
     FS_ERROR(IS_DIR, "Path is for a directory, not a file.")\
     FS_ERROR(IS_FILE, "Path is for a file, not a directory.")\
-    FS_ERROR(CANNOT_RM, "Cannot remove file or directory.")
+    FS_ERROR(CANNOT_RM, "Cannot remove file or directory.")\
+    FS_ERROR(TOO_DEEP, "Path too long or directories nested too deeply.")
+
+
+/**
+ * A data log record.
+ *
+ * One record is added to the data log per image of a snap-and-log's
+ * burst. The records of a burst share their sensor readings, but each has
+ * its image's shutter time. It is printed as a CSV row or, if
+ * DATA_LOG_BINARY is defined, written as is. The data
+ * log column table in FileSystem.cpp describes each field and must be
+ * kept in step with this structure.
+ */
+typedef struct DataLogRecord
+{
+    uint32_t seconds;           // Date and time, in seconds since 1970.
+    uint32_t milliseconds;      // Millisecond offset into the second.
+    uint32_t frameMicros;       // us since boot, at the shutter press.
+    uint32_t burstImage;        // The image's index in its burst, from 0.
+    uint32_t shutterPress;      // us the shutter was held down.
+    uint32_t frameLateness;     // ms past the frame's scheduled start.
+    uint32_t skippedFrames;     // Scheduled frames skipped before this one.
+    float pressure;             // mbar.
+    float depth;                // m.
+    float descentRate;          // m/s, smoothed, positive going down.
+    uint32_t nextFrameInterval; // ms until the next frame is due.
+    float waterTemperature;     // C.
+    float deviceTemperature;    // C.
+    float accel[3];             // m/s^2.
+    float mag[3];               // gauss.
+    float gyro[3];              // rad/s.
+#if defined(ENABLE_IMU_FIFO)
+    InertiaStats inertiaStats;  // Since the previous record.
+#endif
+#if defined(BATTERY_IN_DATA_LOG)
+    float controllerVoltage;    // V.
+    float controllerPercent;    // %.
+    float mainVoltage;          // V.
+    float mainPercent;          // %.
+#endif
+} DataLogRecord;
+
+#if defined(ENABLE_IMU_STREAM)
+/**
+ * An IMU stream record.
+ *
+ * One record is written to the IMU stream file per accelerometer and
+ * gyroscope sample drained from the inertia module's FIFO. The IMU log
+ * column table in FileSystem.cpp describes each field and must be kept
+ * in step with this structure.
+ */
+typedef struct ImuLogRecord
+{
+    uint32_t time;              // Approximate sample time, in ms since boot.
+    uint32_t frame;             // Data log record, from 0, whose statistics
+                                // include the sample.
+    float accel[3];             // m/s^2.
+    float gyro[3];              // rad/s.
+} ImuLogRecord;
+#endif
+
+/**
+ * A drop index record.
+ *
+ * One record is written to the drop index file per drop found in the
+ * data log by the DropDetector.
+ */
+typedef struct DropRecord
+{
+    uint16_t number;            // Drop, from 1, in this data log.
+    uint32_t startRow;          // First data log row, from 0.
+    uint32_t endRow;            // Last data log row.
+    uint32_t startSeconds;      // Date and time, in seconds since 1970.
+    uint32_t endSeconds;
+    float maximumDepth;         // m.
+} DropRecord;
 
 
 /**
@@ -30,8 +114,7 @@
  * - POSIX-style cat, head, tail, du, rm, and ls.
  * - Open, write, and close for a CSV log file.
  * - Open, write, and close for a status log file.
- * - Open, read, write, and close for a settings file.
- * - Open, read, write, and close for a stats file.
+ * - Load, stage, and commit for a settings journal.
  *
  * The CSV log file records a timestamp and sensor readings with one row
  * per camera imaging event. Along with separate camera images, this is
@@ -41,16 +124,14 @@
  * major device event, such as the device boot, recording start/stop, and
  * errors.
  *
- * The settings file records values for configuration parameters that need
- * to persist from one boot to the next, including the frame interval.
- * The file is read at device boot and used to initialize parameters. It is
- * also written each time one of the parameters is changed.
- *
- * The stats file records counters that record long term usage, such as
- * the number of images captured, the number of power cycles, and the
- * total run time. The file is read at device boot to initialize counters,
- * and written periodically to save values so that the persist to the next
- * boot.
+ * The settings journal records values for configuration parameters that
+ * need to persist from one boot to the next, including the frame interval,
+ * and counters that record long term usage, such as the number of images
+ * captured, the number of power cycles, and the total run time. It is read
+ * at device boot to initialize parameters and counters. Changes are staged
+ * in RAM and appended to it in checksummed batches when there is time to
+ * spare, and it is compacted into a second file as it grows. See
+ * commitSettings().
  */
 class FileSystem
 {
@@ -72,6 +153,12 @@ public:
 #undef FS_ERROR
     };
 
+    // Status log message severities. Errors are written to the card
+    // right away. Other messages are queued and written between frames.
+    static const uint8_t STATUS_INFO    = 0;
+    static const uint8_t STATUS_WARNING = 1;
+    static const uint8_t STATUS_ERROR   = 2;
+
 private:
     // Head, tail, and cat buffer size.
     static const uint32_t BUFFER_SIZE = 1025;
@@ -82,28 +169,112 @@ private:
     //   ExFAT: 255
     static const uint16_t MAX_FILENAME = 255;
 
+    // Directory walk limits. A walk keeps a directory handle open for each
+    // level below the top, and builds paths in a single buffer.
+    static const uint8_t WALK_MAX_DEPTH = 8;
+    static const uint16_t WALK_MAX_PATH = 255;
+
+    // Directory walk visitor events. See walk().
+    static const uint8_t WALK_FILE    = 0;
+    static const uint8_t WALK_DIR     = 1;
+    static const uint8_t WALK_DIR_END = 2;
+
+    // A directory walk visitor, given the entry, the directory it is in,
+    // the event, and the entry's depth below the top. It returns false to
+    // end the walk.
+    typedef bool (*WalkVisitor)( SdFile& entry, SdFile* dir,
+        const uint8_t event, const uint8_t depth );
+
+    // A text file line visitor, given the line, NULL terminated, and its
+    // number, from 1. It returns false to end the read.
+    typedef bool (*LineVisitor)( char*const line, const uint16_t number );
+
     // Log file name format.
     static const char*const DATA_LOG_FILENAME_FORMAT;
 
+    // Data log columns. Each entry describes a field of a DataLogRecord.
+    static const LogColumn DATA_LOG_COLUMNS[];
+    static const uint16_t NUMBER_OF_DATA_LOG_COLUMNS;
+
+    // Data log write buffer size. SdFat writes a whole 512-byte sector
+    // directly to the card, bypassing its single sector cache, when the
+    // file position is on a sector boundary. The data log buffer holds
+    // several sectors of rows so that they can be written that way.
+    static const uint16_t SECTOR_SIZE = 512;
+    static const uint16_t DATA_LOG_BUFFER_SECTORS = 4;
+    static const uint16_t DATA_LOG_BUFFER_SIZE =
+        SECTOR_SIZE * DATA_LOG_BUFFER_SECTORS;
+
+    // Status log message queue size.
+    static const uint16_t STATUS_LOG_BUFFER_SIZE = 1024;
+
+#if defined(DATA_LOG_BINARY)
+    // Number of data records in a whole binary data log block.
+    static const uint16_t DATA_LOG_RECORDS_PER_BLOCK =
+        LOG_BLOCK_DATA_SIZE / sizeof( DataLogRecord );
+#endif
+
+    // Drop index file name format. The number matches the data log's.
+    static const char*const DROP_LOG_FILENAME_FORMAT;
+
+#if defined(ENABLE_IMU_STREAM)
+    // IMU stream file name format. The number matches the data log's.
+    static const char*const IMU_LOG_FILENAME_FORMAT;
+
+    // IMU stream columns. Each entry describes a field of an ImuLogRecord.
+    static const LogColumn IMU_LOG_COLUMNS[];
+    static const uint16_t NUMBER_OF_IMU_LOG_COLUMNS;
+
+    // Number of IMU records in a whole IMU stream block.
+    static const uint16_t IMU_LOG_RECORDS_PER_BLOCK =
+        LOG_BLOCK_DATA_SIZE / sizeof( ImuLogRecord );
+#endif
+
 public:
     // Head and tail limits.
     static const uint32_t HEAD_LINES = 10;
     static const uint32_t TAIL_LINES = 10;
 
     // Maximum number of log files. While FAT32 will allow up to 65k files
-    // in the same directory, performance becomes very very poor. Since
-    // the number of data log files needed is limited by this performance
-    // and by the practicality of the device's use to capture images along
-    // with log file entries, the maximum number is intentionally low.
-    static const uint16_t MAX_LOG_FILES = 100;
-
-    // Settings file name.
+    // in the same directory, performance becomes very very poor. The root
+    // directory is scanned once, when the file system is initialized, to
+    // find the next log file number, so starting a run does not search
+    // for a free name. The maximum keeps log file names within 8.3 names
+    // (DATA_999.CSV).
+    static const uint16_t MAX_LOG_FILES = 1000;
+
+    // Settings journal file names. The journal is written to one and
+    // then the other, as it is compacted. See commitSettings().
+    static const char*const JOURNAL_FILENAMES[2];
+
+    // Settings journal keys. Settings and usage are kept together.
+    static const uint8_t KEY_INTERVAL          = 0;
+    static const uint8_t KEY_BURST_SIZE        = 1;
+    static const uint8_t KEY_LASER_CONTINUOUS  = 2;
+    static const uint8_t KEY_SPACING           = 3;
+    static const uint8_t KEY_MAXIMUM_INTERVAL  = 4;
+    static const uint8_t KEY_START_DEPTH       = 5;
+    static const uint8_t KEY_BOOTS             = 6;
+    static const uint8_t KEY_CAMERA_BOOTS      = 7;
+    static const uint8_t KEY_LASER_BOOTS       = 8;
+    static const uint8_t KEY_EVENTS            = 9;
+    static const uint8_t KEY_IMAGES            = 10;
+    static const uint8_t KEY_CONTROLLER_UPTIME = 11;
+    static const uint8_t KEY_CAMERA_UPTIME     = 12;
+    static const uint8_t KEY_LASER_UPTIME      = 13;
+    static const uint8_t NUMBER_OF_KEYS        = 14;
+
+    // Settings journal size past which a commit compacts it, in bytes.
+    // This keeps the journal within a cluster on most cards.
+    static const uint32_t JOURNAL_COMPACT_SIZE = 4096;
+
+    // Mission plan file name. See Mission.
+    static const char*const MISSION_FILENAME;
+
+    // Settings and usage tracking file names of older versions. They are
+    // read if there is no settings journal yet.
     static const char*const SETTINGS_FILENAME;
-
-#if defined(ENABLE_USAGE_TRACKING)
-    // Usage tracking file name.
     static const char*const USAGE_FILENAME;
-#endif
 
     // Error log file name.
     static const char*const STATUS_LOG_FILENAME;
@@ -129,6 +300,37 @@ private:
     // a single buffer.
     static char sharedBuffer[BUFFER_SIZE];
 
+    // Directory walk state. The open handle at each depth, with the top
+    // at 0, the current path and where it ended at each depth, and the
+    // bytes counted by du(). See walk().
+    static SdFile walkDirs[WALK_MAX_DEPTH + 1];
+    static char walkPath[WALK_MAX_PATH + 1];
+    static uint16_t walkPathEnds[WALK_MAX_DEPTH + 1];
+    static uint64_t walkBytes;
+
+    // Free space. Free clusters are counted from the FAT when the file
+    // system is initialized, then kept current as files here grow, shrink,
+    // and are removed. See trackFileSize().
+    static uint32_t freeClusters;
+    static uint8_t clusterShift;
+
+    // The most recently measured SD card space per data log row, in bytes,
+    // or 0. See getBytesPerRow().
+    static uint32_t bytesPerRow;
+
+    // Settings journal. The names of its keys, the most recent value of
+    // each, as text, or "" if none, and a mask of the keys staged since
+    // the most recent commit. Then which of JOURNAL_FILENAMES is appended
+    // to, and its generation, or 0 if there is no journal yet. See
+    // commitSettings().
+    static const char*const JOURNAL_KEYS[NUMBER_OF_KEYS];
+    static const uint8_t JOURNAL_VALUE_SIZE = 16;
+    static char journalValues[NUMBER_OF_KEYS][JOURNAL_VALUE_SIZE];
+    static uint16_t journalDirty;
+    static uint8_t journalFile;
+    static uint32_t journalGeneration;
+    static bool journalLoaded;
+
     // Initialization and recent error codes.
     static bool initialized;
     static uint8_t cardErrorCode;
@@ -137,6 +339,57 @@ private:
     // The number of entries written to the current log file.
     static uint32_t numberOfDataLogEntries;
 
+    // The number for the next data log file. This is one more than the
+    // highest numbered log file on the card.
+    static uint16_t nextDataLogNumber;
+
+    // Data log write buffer. The buffer is a ring of sectors. Bytes from
+    // the tail up to the head have not been written to the card as whole
+    // sectors yet. The tail is always at the start of a sector, and
+    // corresponds to the file position of the next sector to write.
+    static uint8_t dataLogBuffer[DATA_LOG_BUFFER_SIZE];
+    static uint16_t dataLogBufferHead;
+    static uint16_t dataLogBufferTail;
+    static uint16_t dataLogBufferCount;
+    static uint32_t dataLogFilePosition;
+
+    // Durability policy state. The number of rows added, and the time,
+    // since the data log was last synced to the card.
+    static uint32_t numberOfDataLogRowsSinceSync;
+    static uint32_t dataLogSyncTime;
+
+#if defined(DATA_LOG_BINARY)
+    // Binary data log block under construction. The block starts with
+    // a LogBlockHeader, and records are added after it until the block
+    // is full. The block is then added to the data log buffer.
+    static uint32_t dataLogBlock[LOG_SECTOR_SIZE / sizeof(uint32_t)];
+    static uint32_t dataLogFileId;
+#endif
+
+    // The status log file, kept open between writes, and its message
+    // queue. The queue is a ring of bytes. Bytes from the tail up to the
+    // head have not been written to the card yet.
+    static SdFile statusLogFile;
+    static char statusLogBuffer[STATUS_LOG_BUFFER_SIZE];
+    static uint16_t statusLogBufferHead;
+    static uint16_t statusLogBufferTail;
+    static uint16_t statusLogBufferCount;
+
+    // Bytes of a host frame received so far during a serial file transfer.
+    static uint8_t frameInput[sizeof(FrameHeader) + sizeof(uint32_t)];
+    static uint8_t frameInputCount;
+
+    // The current drop index file, if any.
+    static SdFile dropLogFile;
+
+#if defined(ENABLE_IMU_STREAM)
+    // The current IMU stream file, if any, and its block under
+    // construction. Whole blocks are written straight to the card.
+    static SdFile imuLogFile;
+    static uint32_t imuLogBlock[LOG_SECTOR_SIZE / sizeof(uint32_t)];
+    static uint32_t imuLogFileId;
+#endif
+
 
 //----------------------------------------------------------------------
 // Initialization.
@@ -351,58 +604,256 @@ public:
     /**
      * Returns the storage space in use by the SD card, in bytes.
      *
-     * This may take awhile.
+     * This is the card capacity less its free clusters, so it includes
+     * the FAT, directories, and other format overhead, as well as whole
+     * clusters for every file.
      *
      * If there is no SD card present, zero is returned.
      *
      * @return
      *   Returns the size, in bytes.
+     *
+     * @see getFreeSpace()
      */
     static inline uint64_t getSpaceUsed( )
     {
-#ifdef USE_FREE_SPACE
-        // The freeClusterCount() call is very slow in stock SdFat.
-        return (uint64_t)sd.bytesPerCluster( ) *
-            ((uint64_t)sd.clusterCount( ) - (uint64_t)sd.freeClusterCount( ));
-#else
-        if ( sd.card( )->sectorCount( ) == 0 )
+        if ( !initialized )
             return 0;
+        const uint64_t capacity = getCardCapacity( );
+        const uint64_t freeSpace = getFreeSpace( );
+        return (freeSpace > capacity) ? 0 : capacity - freeSpace;
+    }
 
-        // Since we expect a fairly small number of files on the SD card,
-        // it is probably much faster to count up their sizes than to
-        // count free clusters. This is NOT as accurate because it does not
-        // count format overhead.
-        return du( "/" );
-#endif
+    /**
+     * Returns the free storage space on the SD card, in bytes.
+     *
+     * The free cluster count is kept current as files are written, so
+     * this is quick. Files changed by something other than this class
+     * are not accounted for until recountFreeClusters() is called.
+     *
+     * If there is no SD card present, zero is returned.
+     *
+     * @return
+     *   Returns the size, in bytes.
+     *
+     * @see recountFreeClusters()
+     */
+    static inline uint64_t getFreeSpace( )
+    {
+        if ( !initialized )
+            return 0;
+        return (uint64_t)freeClusters << clusterShift;
     }
 
 
+//----------------------------------------------------------------------
+// Free space.
+//----------------------------------------------------------------------
+private:
+    /**
+     * Returns the number of clusters holding a file of a given size.
+     *
+     * @param[in] size
+     *   The file size, in bytes.
+     *
+     * @return
+     *   Returns the number of clusters.
+     */
+    static inline uint32_t getClusters( const uint32_t size )
+    {
+        return (uint32_t) (((uint64_t)size + (1UL << clusterShift) - 1) >>
+            clusterShift);
+    }
+
+    /**
+     * Updates the free cluster count for a file that has changed size.
+     *
+     * @param[in] oldSize
+     *   The file's size before the change, in bytes.
+     * @param[in] newSize
+     *   The file's size after the change, in bytes.
+     */
+    static inline void trackFileSize( const uint32_t oldSize,
+        const uint32_t newSize )
+    {
+        const uint32_t oldClusters = getClusters( oldSize );
+        const uint32_t newClusters = getClusters( newSize );
+        if ( newClusters <= oldClusters )
+            freeClusters += oldClusters - newClusters;
+        else if ( newClusters - oldClusters < freeClusters )
+            freeClusters -= newClusters - oldClusters;
+        else
+            freeClusters = 0;
+    }
+
+    /**
+     * Opens a file for writing, creating it or emptying it.
+     *
+     * @param[out] file
+     *   The file to open.
+     * @param[in] path
+     *   The path of the file.
+     *
+     * @return
+     *   Returns true on success, and false if the file cannot be created
+     *   or emptied.
+     */
+    static bool createFile( SdFile& file, const char*const path );
+
+    /**
+     * Writes bytes to an open file, and counts any clusters it gains.
+     *
+     * @param[in,out] file
+     *   The file to write.
+     * @param[in] bytes
+     *   The bytes to write.
+     * @param[in] nBytes
+     *   The number of bytes to write.
+     *
+     * @return
+     *   Returns true on success, and false if not all bytes were written.
+     */
+    static bool writeFile( SdFile& file, const void*const bytes,
+        const uint32_t nBytes );
+
+    /**
+     * Truncates an open file, and counts the clusters it frees.
+     *
+     * @param[in,out] file
+     *   The file to truncate.
+     * @param[in] length
+     *   The new file length, in bytes.
+     *
+     * @return
+     *   Returns true on success, and false on I/O errors.
+     */
+    static bool truncateFile( SdFile& file, const uint32_t length );
+
+    /**
+     * Removes a closed file, and counts the clusters it frees.
+     *
+     * @param[in] path
+     *   The path of the file.
+     *
+     * @return
+     *   Returns true on success, and false if the file cannot be removed.
+     */
+    static bool removeFile( const char*const path );
+
+public:
+    /**
+     * Counts the SD card's free clusters again from the FAT.
+     *
+     * The kept count is replaced. This is slow on a large card, since it
+     * reads the whole FAT.
+     *
+     * @return
+     *   Returns the counted free clusters less the kept count before the
+     *   recount. This is zero if the kept count was right.
+     *
+     * @see getFreeSpace()
+     */
+    static int32_t recountFreeClusters( );
+
+    /**
+     * Returns the SD card space taken per data log row.
+     *
+     * This is measured from the current data log, or else the most recent
+     * one, once it has PLAN_MINIMUM_ROWS rows. It includes the file
+     * header, and the IMU stream, if any.
+     *
+     * @return
+     *   Returns the size, in bytes, or 0 if it has not been measured.
+     */
+    static uint32_t getBytesPerRow( );
+
+    /**
+     * Returns the space left in the current data log's pre-allocated
+     * extent.
+     *
+     * This space is already counted as in use, but rows still fit in it.
+     *
+     * @return
+     *   Returns the size, in bytes, or 0 if there is no data log or it
+     *   has outgrown its extent.
+     */
+    static uint32_t getDataLogSpaceLeft( );
+
+
 //----------------------------------------------------------------------
 // Data log file.
 //----------------------------------------------------------------------
+private:
+    /**
+     * Scans the root directory for the highest numbered data log file.
+     *
+     * The next data log number is set to one more than the highest number
+     * found among data log and IMU stream files.
+     *
+     * @see newDataLog()
+     */
+    static void scanDataLogs( );
+
+    /**
+     * Returns true if a file's sector reads as erased.
+     *
+     * Only the sector's first byte is read. A data log's written sectors
+     * never start with 0x00 or 0xFF. This assumes that the card erases to
+     * one of those, as the SD specification allows (its SCR register's
+     * DATA_STAT_AFTER_ERASE bit says which). On a card that erases to
+     * anything else, every sector reads as written, so an open log is left
+     * unrepaired rather than cut short.
+     *
+     * @param[in,out] file
+     *   The file.
+     * @param[in] sector
+     *   The sector, from the start of the file.
+     *
+     * @return
+     *   Returns true if erased, and false if written or on a read error.
+     */
+    static bool isSectorErased( SdFile& file, const uint32_t sector );
+
+    /**
+     * Truncates the highest numbered data log after its last complete row,
+     * if a power loss left it open.
+     *
+     * Until a pre-allocated data log is closed, its size is that of its
+     * whole extent, which was erased when it was allocated. So a log that
+     * ends in an erased sector was never closed. Its rows were written in
+     * order from the start, so the first erased sector is found by a binary
+     * search, which reads a few dozen sectors of even the largest extent.
+     * A text log is cut after the last end of line before it, and a binary
+     * log after the last whole block.
+     *
+     * @see preallocateDataLog()
+     */
+    static void repairDataLog( );
+
 public:
     /**
      * Closes the current log file, if any.
      *
+     * Buffered rows are written and synced to the card, and a pre-allocated
+     * file is truncated to its real length, before the file is closed.
+     *
      * @see getDataLogFilename()
      * @see getNumberOfDataLogEntries()
      * @see isDataLogOpen()
      * @see newDataLog()
+     * @see syncDataLog()
      * @see writeDataLog()
      * @see writeDataLogHeader()
      */
-    static void closeDataLog( )
-    {
-        // If there is no log file, this does nothing.
-        logFile.close( );
-        numberOfDataLogEntries = 0;
-        localErrorCode = FS_ERROR_NONE;
-    }
+    static void closeDataLog( );
 
     /**
      * Creates a new unique log file.
      *
-     * If there is a previous log file, it is closed.
+     * If there is a previous log file, it is closed. The new file is
+     * numbered one more than the highest numbered log file on the card,
+     * and pre-allocated as a contiguous extent when the card has room (see
+     * DATA_LOG_PREALLOCATE_DURATION).
      *
      * @return
      *   Returns true on success and false on failure.
@@ -481,7 +932,121 @@ public:
         return false;
     }
 
+    /**
+     * Writes and syncs all buffered rows to the current log file.
+     *
+     * This is done automatically by the durability policy (see
+     * DATA_LOG_SYNC_ROWS and DATA_LOG_SYNC_INTERVAL) and on close. It may
+     * also be called on events that make a power loss more likely, such
+     * as a low battery.
+     *
+     * @return
+     *   Returns false if there is no log file open or an error occurred.
+     *
+     * @see closeDataLog()
+     * @see updateDataLog()
+     * @see writeDataLog()
+     */
+    static bool syncDataLog( );
+
+    /**
+     * Syncs the current log file if the durability policy's sync interval
+     * has elapsed.
+     *
+     * This should be called periodically between rows so that buffered
+     * rows are not held in RAM much longer than DATA_LOG_SYNC_INTERVAL
+     * when the frame interval is long.
+     *
+     * @return
+     *   Returns false if an error occurred.
+     *
+     * @see syncDataLog()
+     */
+    static bool updateDataLog( );
+
 private:
+    /**
+     * Adds bytes to the data log buffer.
+     *
+     * Whole sectors are written to the card as needed to make room.
+     *
+     * @param[in] bytes
+     *   The bytes to add.
+     * @param[in] nBytes
+     *   The number of bytes to add.
+     *
+     * @return
+     *   Returns false if an error occurred.
+     *
+     * @see writeDataLogSectors()
+     */
+    static bool appendDataLog( const char*const bytes, const uint16_t nBytes );
+
+    /**
+     * Writes all whole sectors in the data log buffer to the card.
+     *
+     * The file is not synced. A trailing partial sector is left in the
+     * buffer.
+     *
+     * @return
+     *   Returns false if an error occurred.
+     *
+     * @see appendDataLog()
+     * @see syncDataLog()
+     */
+    static bool writeDataLogSectors( );
+
+    /**
+     * Pre-allocates a contiguous extent for the new, empty data log.
+     *
+     * The extent is sized for the run's frame interval and burst size. If
+     * the card has no free extent that large, smaller extents are tried. If
+     * none can be found, or the card cannot erase it, the file is left empty
+     * and grows as it is written.
+     *
+     * @see newDataLog()
+     */
+    static void preallocateDataLog( );
+
+#if defined(DATA_LOG_BINARY)
+    /**
+     * Starts a new, empty binary data log block.
+     *
+     * @param[in] sequence
+     *   The block's sequence number.
+     *
+     * @see appendDataLogBlock()
+     */
+    static void startDataLogBlock( const uint32_t sequence );
+
+    /**
+     * Stores the CRC of the binary data log block under construction.
+     *
+     * @see appendDataLogBlock()
+     */
+    static void sealDataLogBlock( );
+
+    /**
+     * Adds the binary data log block under construction to the data log
+     * buffer, then starts the next block.
+     *
+     * @return
+     *   Returns false if an error occurred.
+     *
+     * @see appendDataLog()
+     * @see sealDataLogBlock()
+     * @see startDataLogBlock()
+     */
+    static bool appendDataLogBlock( );
+#endif
+
+    /**
+     * Sets error codes after a failed data log write and closes the log.
+     *
+     * @see getErrorMessage()
+     */
+    static void setDataLogWriteError( );
+
     /**
      * Write a CSV log header.
      *
@@ -493,6 +1058,9 @@ private:
      * The header line ends with a line-feed, per POSIX/Linux/macOS
      * conventions.
      *
+     * If DATA_LOG_BINARY is defined, a binary file header with the data
+     * log columns is written instead (see LogFormat.h).
+     *
      * @return
      *   Returns false if there is no log file open or an error occurred.
      *
@@ -512,30 +1080,21 @@ public:
      * Write a CSV log entry.
      *
      * A line is written to the current CSV log file using the given
-     * timestamp and sensor values. Per the CSV file format de facto
-     * standard, non-numeric values (such as the date and time) are
+     * record's timestamp and sensor values. Per the CSV file format de
+     * facto standard, non-numeric values (such as the date and time) are
      * surrounded by double-quotes.
      *
      * The line ends with a line-feed, per POSIX/Linux/macOS conventions.
      *
-     * @param[in] dt
-     *   The date and time timestamp.
-     * @param[in] ms
-     *   The date and time timestamp millisecond offset.
-     * @param[in] pressure
-     *   The water pressure.
-     * @param[in] depth
-     *   The water depth.
-     * @param[in] waterTemperature
-     *   The water temperature.
-     * @param[in] deviceTemperature
-     *   The device's internal temperature.
-     * @param[in] accel
-     *   The 3-element array with the accelerometer vector.
-     * @param[in] mag
-     *   The 3-element array with the magnetometer vector.
-     * @param[in] gyro
-     *   The 3-element array with the gyroscpe vector.
+     * If DATA_LOG_BINARY is defined, the record is added to the current
+     * binary block instead, without any formatting.
+     *
+     * The line is added to the data log buffer and written to the card
+     * with whole sectors. The log file is synced per the durability policy
+     * (see DATA_LOG_SYNC_ROWS and DATA_LOG_SYNC_INTERVAL).
+     *
+     * @param[in] record
+     *   The timestamp and sensor values.
      *
      * @return
      *   Returns false if there is no log file open or an error occurred.
@@ -547,24 +1106,155 @@ public:
      * @see newDataLog()
      * @see writeDataLogHeader()
      */
-    static bool writeDataLog(
-        const char*const dt,
-        const uint32_t ms,
-        const float pressure,
-        const float depth,
-        const float waterTemperature,
-        const float deviceTemperature,
-        const float* accel,
-        const float* mag,
-        const float* gyro );
+    static bool writeDataLog( const DataLogRecord& record );
 
 
+#if defined(ENABLE_IMU_STREAM)
 //----------------------------------------------------------------------
-// Settings file.
+// IMU stream file.
 //----------------------------------------------------------------------
 public:
     /**
-     * Loads settings from a saved settings file, if any.
+     * Returns true if there is an IMU stream file open.
+     *
+     * An IMU stream file is opened and closed along with each data log.
+     *
+     * @return
+     *   Returns true if open.
+     *
+     * @see writeImuLog()
+     */
+    static inline bool isImuLogOpen( )
+    {
+        if ( imuLogFile )
+            return true;
+        return false;
+    }
+
+    /**
+     * Writes an IMU stream record.
+     *
+     * The record is added to the current block, and whole blocks are
+     * written to the card. The file is synced along with the data log.
+     * Records in the last, partly filled block are written when the file
+     * is closed.
+     *
+     * @param[in] record
+     *   The sample.
+     *
+     * @return
+     *   Returns false if there is no IMU stream file open or an error
+     *   occurred. On an error, the IMU stream file is closed.
+     *
+     * @see isImuLogOpen()
+     */
+    static bool writeImuLog( const ImuLogRecord& record );
+
+private:
+    /**
+     * Creates an IMU stream file to go with a new data log.
+     *
+     * Failure is not fatal. The data log is written without an IMU
+     * stream.
+     *
+     * @param[in] number
+     *   The data log's file number.
+     *
+     * @see newDataLog()
+     */
+    static void newImuLog( const uint16_t number );
+
+    /**
+     * Starts a new, empty IMU stream block.
+     *
+     * @param[in] sequence
+     *   The block's sequence number.
+     *
+     * @see writeImuLogBlock()
+     */
+    static void startImuLogBlock( const uint32_t sequence );
+
+    /**
+     * Writes the IMU stream block under construction and starts the next.
+     *
+     * @return
+     *   Returns false if an error occurred. The IMU stream file is closed.
+     *
+     * @see writeImuLog()
+     */
+    static bool writeImuLogBlock( );
+
+    /**
+     * Closes the current IMU stream file, if any, after writing its last,
+     * partly filled block.
+     *
+     * @see closeDataLog()
+     */
+    static void closeImuLog( );
+#endif
+
+
+//----------------------------------------------------------------------
+// Drop index file.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Returns true if there is a drop index file open.
+     *
+     * A drop index file is opened and closed along with each data log.
+     *
+     * @return
+     *   Returns true if open.
+     *
+     * @see writeDropLog()
+     */
+    static inline bool isDropLogOpen( )
+    {
+        if ( dropLogFile )
+            return true;
+        return false;
+    }
+
+    /**
+     * Writes a drop index record as a CSV row, and syncs it to the card.
+     *
+     * Drops are minutes apart, so each is synced as it is written.
+     *
+     * @param[in] record
+     *   The drop.
+     *
+     * @return
+     *   Returns false if there is no drop index file open or an error
+     *   occurred. On an error, the drop index file is closed.
+     *
+     * @see isDropLogOpen()
+     * @see DropDetector
+     */
+    static bool writeDropLog( const DropRecord& record );
+
+private:
+    /**
+     * Creates a drop index file to go with a new data log.
+     *
+     * Failure is not fatal. The data log is written without a drop
+     * index.
+     *
+     * @param[in] number
+     *   The data log's file number.
+     *
+     * @see newDataLog()
+     */
+    static void newDropLog( const uint16_t number );
+
+
+//----------------------------------------------------------------------
+// Settings journal.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Loads settings from the settings journal, if any.
+     *
+     * Settings that are not in the journal are left unchanged.
      *
      * @param[out] interval
      *   The frame interval, in ms.
@@ -572,89 +1262,426 @@ public:
      *   True if the laser mode is continuous, and false if normal.
      * @param[out] burstSize
      *   The number of frames to capture per recording event.
+     * @param[out] spacing
+     *   The depth between frames, in m, or 0 for a fixed frame interval.
+     * @param[out] maximumInterval
+     *   The longest depth-adaptive frame interval, in ms.
+     * @param[out] startDepth
+     *   The depth at which an armed device starts running, in m.
      *
      * @return
-     *   Returns true if a file was read, and false no file was found or
-     *   an error occurred.
+     *   Returns true if any setting was found, and false if there is no
+     *   journal or an error occurred.
      *
-     * @see saveSettings()
+     * @see stageInteger()
+     * @see stageFloat()
      */
     static bool loadSettings(
         uint32_t &interval,
         bool &isLaserContinuous,
-        uint8_t &burstSize );
+        uint8_t &burstSize,
+        float &spacing,
+        uint32_t &maximumInterval,
+        float &startDepth );
 
+#if defined(ENABLE_USAGE_TRACKING)
     /**
-     * Saves settings to a settings file.
+     * Loads usage from the settings journal, if any.
      *
-     * @param[in] interval
-     *   The frame interval, in ms.
-     * @param[in] isLaserContinuous
-     *   True if the laser mode is continuous, and false if normal.
-     * @param[in] burstSize
-     *   The number of frames to capture per recording event.
+     * @param[out] usage
+     *   The current usage.
      *
      * @return
-     *   Returns true if the file was written, and false if an error
-     *   occurred.
+     *   Returns true if any usage was found, and false if there is no
+     *   journal or an error occurred.
      *
-     * @see loadSettings()
+     * @see stageUsage()
      */
-    static bool saveSettings(
-        const uint32_t interval,
-        const bool isLaserContinuous,
-        const uint8_t burstSize );
-
+    static bool loadUsage( Usage& usage );
 
-#if defined(ENABLE_USAGE_TRACKING)
-//----------------------------------------------------------------------
-// Stats file.
-//----------------------------------------------------------------------
-public:
     /**
-     * Loads usage from a saved usage tracking file, if any.
+     * Stages usage for the next commit.
      *
-     * @param[out] usage
+     * @param[in] usage
      *   The current usage.
      *
+     * @see commitSettings()
+     * @see loadUsage()
+     */
+    static void stageUsage( const Usage& usage );
+#endif
+
+    /**
+     * Stages an integer value for the next commit.
+     *
+     * Nothing is written to the card. The key is only marked as changed
+     * if its value differs from the journal's.
+     *
+     * @param[in] key
+     *   One of the KEY_* values.
+     * @param[in] value
+     *   The value.
+     *
+     * @see commitSettings()
+     */
+    static void stageInteger( const uint8_t key, const uint32_t value );
+
+    /**
+     * Stages a floating point value for the next commit.
+     *
+     * Nothing is written to the card. The key is only marked as changed
+     * if its value, to 3 decimal places, differs from the journal's.
+     *
+     * @param[in] key
+     *   One of the KEY_* values.
+     * @param[in] value
+     *   The value.
+     *
+     * @see commitSettings()
+     */
+    static void stageFloat( const uint8_t key, const float value );
+
+    /**
+     * Appends the values staged since the most recent commit to the
+     * settings journal, as one batch, and syncs it.
+     *
+     * The batch ends with a commit line holding its checksum. A batch
+     * without one, such as one cut short by a power loss, is ignored when
+     * the journal is loaded. When the journal would grow past
+     * JOURNAL_COMPACT_SIZE, all values are instead written to the other
+     * journal file, under the next generation. The older file is kept
+     * until then, so a valid journal is always on the card.
+     *
      * @return
-     *   Returns true if a file was read, and false no file was found or
-     *   an error occurred.
+     *   Returns true on success or when there is nothing to do. On failure,
+     *   false is returned, error codes are set, and the values stay staged.
      *
-     * @see saveUsage()
+     * @see updateSettings()
      */
-    static bool loadUsage( Usage& usage );
+    static bool commitSettings( );
 
     /**
-     * Saves usage to a usage tracking file.
+     * Commits staged values, if there are any.
      *
-     * @param[in] usage
-     *   The current usage.
+     * This should be called when there is time to spare, such as between
+     * frames.
      *
      * @return
-     *   Returns true if the file was written, and false if an error
-     *   occurred.
+     *   Returns true on success or when there is nothing to do. On failure,
+     *   false is returned and error codes are set.
      *
-     * @see loadUsage()
+     * @see commitSettings()
      */
-    static bool saveUsage( const Usage& usage );
-#endif
+    static inline bool updateSettings( )
+    {
+        if ( journalDirty == 0 )
+            return true;
+        return commitSettings( );
+    }
+
+private:
+    /**
+     * Loads the settings journal into RAM, once.
+     *
+     * The journal file with the highest generation and at least one valid
+     * commit is used, up to its last valid commit. Anything after that is
+     * truncated, so that appends follow it. If neither file is valid, the
+     * settings and usage files of older versions are loaded instead, and
+     * are replaced by a journal on the next commit.
+     */
+    static void loadJournal( );
+
+    /**
+     * Checks a settings journal file.
+     *
+     * @param[in] index
+     *   The index in JOURNAL_FILENAMES of the file.
+     * @param[out] generation
+     *   The file's generation.
+     * @param[out] length
+     *   The length of the file up to its last valid commit, in bytes.
+     *
+     * @return
+     *   Returns true if the file has at least one valid commit.
+     */
+    static bool scanJournal(
+        const uint8_t index,
+        uint32_t& generation,
+        uint32_t& length );
+
+    /**
+     * Reads known name-value lines from a file into RAM.
+     *
+     * @param[in,out] file
+     *   The file to read from.
+     * @param[in] length
+     *   The length to read up to, in bytes.
+     */
+    static void readValues( SdFile& file, const uint32_t length );
+
+    /**
+     * Writes all values to the other settings journal file, under the
+     * next generation, and makes it the one appended to.
+     *
+     * @return
+     *   Returns true on success. On failure, false is returned and error
+     *   codes are set.
+     *
+     * @see commitSettings()
+     */
+    static bool compactJournal( );
+
+    /**
+     * Formats a batch of name-value lines and its commit line into the
+     * shared buffer.
+     *
+     * @param[in] keys
+     *   A mask of the keys to include.
+     * @param[in] generation
+     *   The generation line to start with, or 0 for none.
+     *
+     * @return
+     *   Returns the number of bytes formatted.
+     */
+    static uint32_t formatBatch( const uint16_t keys, const uint32_t generation );
+
+    /**
+     * Sets a value in RAM, and marks its key as changed if it differs.
+     *
+     * @param[in] key
+     *   One of the KEY_* values.
+     * @param[in] value
+     *   The value, as text.
+     */
+    static void stageValue( const uint8_t key, const char*const value );
+
+    /**
+     * Gets an integer value.
+     *
+     * @param[in] key
+     *   One of the KEY_* values.
+     * @param[out] value
+     *   The value, if any. Otherwise it is unchanged.
+     *
+     * @return
+     *   Returns true if there is a value.
+     */
+    static inline bool getInteger( const uint8_t key, uint32_t& value )
+    {
+        if ( journalValues[key][0] == '\0' )
+            return false;
+        value = strtoul( journalValues[key], NULL, 10 );
+        return true;
+    }
+
+    /**
+     * Gets a floating point value.
+     *
+     * @param[in] key
+     *   One of the KEY_* values.
+     * @param[out] value
+     *   The value, if any. Otherwise it is unchanged.
+     *
+     * @return
+     *   Returns true if there is a value.
+     */
+    static inline bool getFloat( const uint8_t key, float& value )
+    {
+        if ( journalValues[key][0] == '\0' )
+            return false;
+        value = atof( journalValues[key] );
+        return true;
+    }
+
+
+//----------------------------------------------------------------------
+// Mission plan file.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Returns true if there is a mission plan file.
+     *
+     * @return
+     *   Returns true if the file exists.
+     */
+    static inline bool isMissionPresent( )
+    {
+        return initialized && sd.exists( MISSION_FILENAME );
+    }
+
+    /**
+     * Reads the mission plan file, a line at a time.
+     *
+     * Lines longer than the shared buffer are split.
+     *
+     * @param[in] visit
+     *   The visitor for each line, including blank ones. The line is in
+     *   the shared buffer, so the visitor must not use FileSystem methods
+     *   that need it.
+     *
+     * @return
+     *   Returns true if the whole file was read, and false if it could not
+     *   be opened or the visitor ended the read.
+     */
+    static bool readMission( LineVisitor visit );
 
 
 //----------------------------------------------------------------------
 // Error log file.
 //----------------------------------------------------------------------
+private:
+    /**
+     * Adds bytes to the status log queue.
+     *
+     * The queue is written to the card first if needed to make room.
+     *
+     * @param[in] bytes
+     *   The bytes to add.
+     * @param[in] nBytes
+     *   The number of bytes to add.
+     *
+     * @return
+     *   Returns true on success. On failure, false is returned and error
+     *   codes are set.
+     *
+     * @see flushStatus()
+     */
+    static bool appendStatus( const char*const bytes, const uint16_t nBytes );
+
 public:
     /**
      * Appends a message to the activity log, creating the file if needed.
      *
+     * The message is queued in RAM and written to the card later, by
+     * updateStatus() or flushStatus(), unless it is an error. Errors are
+     * written right away, along with any queued messages.
+     *
      * @param[in] message
      *   The message to append, along with a timestamp.
+     * @param[in] severity
+     *   The message severity. One of STATUS_INFO, STATUS_WARNING, or
+     *   STATUS_ERROR.
      *
      * @return
      *   Returns true on sucess.
+     *
+     * @see flushStatus()
+     * @see updateStatus()
+     */
+    static bool writeStatus(
+        const char*const message,
+        const uint8_t severity = STATUS_INFO );
+
+    /**
+     * Writes queued status log messages to the card and syncs the file.
+     *
+     * @return
+     *   Returns true on success or when there is nothing to do. On failure,
+     *   false is returned, error codes are set, and the queued messages
+     *   are lost.
+     *
+     * @see closeStatus()
+     * @see updateStatus()
+     * @see writeStatus()
+     */
+    static bool flushStatus( );
+
+    /**
+     * Writes queued status log messages to the card, if there are any.
+     *
+     * This should be called when there is time to spare, such as between
+     * frames.
+     *
+     * @return
+     *   Returns true on success or when there is nothing to do. On failure,
+     *   false is returned and error codes are set.
+     *
+     * @see flushStatus()
+     */
+    static inline bool updateStatus( )
+    {
+        if ( statusLogBufferCount == 0 )
+            return true;
+        return flushStatus( );
+    }
+
+    /**
+     * Writes queued status log messages to the card and closes the file.
+     *
+     * The file is opened again by the next write. This should be called
+     * before the file may be removed or read, such as by a command.
+     *
+     * @see flushStatus()
+     */
+    static void closeStatus( );
+
+
+//----------------------------------------------------------------------
+// Directory walk.
+//----------------------------------------------------------------------
+private:
+    /**
+     * Walks a file or directory, visiting each entry.
+     *
+     * This is shared by du(), ls(), and rmall(). The walk is iterative:
+     * it keeps one open directory handle per level, and a single path
+     * buffer that grows and shrinks as it goes down and up, so it does no
+     * heap allocation and no path lookups after opening the top.
+     *
+     * The visitor is called with the entry and the directory it is in,
+     * or NULL for the top:
+     * - WALK_FILE for a file.
+     * - WALK_DIR for a directory, before its entries, if any are walked.
+     * - WALK_DIR_END for a directory after its entries, with its handle
+     *   still open.
+     * The current path is in walkPath, and the entry's name is in
+     * sharedFilename, while the visitor runs.
+     *
+     * @param[in] path
+     *   The path of a file or directory.
+     * @param[in] recurse
+     *   True to walk subdirectories too, and false to walk only the top
+     *   directory's entries.
+     * @param[in] writable
+     *   True to open files for writing, so that the visitor can remove
+     *   them through the handle it is given. Directories are always open
+     *   for reading, which is all that rmdir() needs.
+     * @param[in] visit
+     *   The visitor. It returns false to end the walk.
+     *
+     * @return
+     *   Returns true if the whole walk was done. On failure, false is
+     *   returned, and error codes are set unless the visitor ended it.
+     *   Possible failures:
+     *   - The path does not exist.
+     *   - The path, or the directory nesting, is too deep to walk.
+     */
+    static bool walk( const char*const path, const bool recurse,
+        const bool writable, WalkVisitor visit );
+
+    /**
+     * Adds an entry's size to walkBytes, for du().
+     *
+     * @see walk()
+     */
+    static bool duVisit( SdFile& entry, SdFile* dir, const uint8_t event,
+        const uint8_t depth );
+
+    /**
+     * Lists an entry to the serial port, for ls().
+     *
+     * @see walk()
+     */
+    static bool lsVisit( SdFile& entry, SdFile* dir, const uint8_t event,
+        const uint8_t depth );
+
+    /**
+     * Removes a file, or a directory after its entries, for rmall().
+     *
+     * @see walk()
      */
-    static bool writeStatus( const char*const message );
+    static bool rmallVisit( SdFile& entry, SdFile* dir, const uint8_t event,
+        const uint8_t depth );
 
 
 //----------------------------------------------------------------------
@@ -680,14 +1707,12 @@ public:
      *
      * @param[in] path
      *   The path of a file or directory.
-     * @param[in] isTop
-     *   (optional, default = true) True for the top-most call, and false
-     *   during recursion.
      *
      * @return
-     *   Returns the size.
+     *   Returns the size, in bytes, on success. On failure, returns zero
+     *   and error codes are set.
      */
-    static uint64_t du( const char*const path, const bool isTop = true );
+    static uint64_t du( const char*const path );
 
     /**
      * Shows first 10 lines of file's content on the serial port.
@@ -731,15 +1756,12 @@ public:
      *
      * @param[in] path
      *   The path of a file or directory.
-     * @param[in] isTop
-     *   (optional, default = true) True for the top-most call, and false
-     *   during recursion.
      *
      * @return
      *   Returns true on sucess or recoverable problems, and false on
      *   I/O errors.
      */
-    static bool rmall( const char*const path, const bool isTop = true );
+    static bool rmall( const char*const path );
 
     /**
      * Removes an empty directory.
@@ -765,4 +1787,64 @@ public:
      *   I/O errors.
      */
     static bool tail( const char*const path );
+
+
+//----------------------------------------------------------------------
+// Serial file transfer.
+//----------------------------------------------------------------------
+private:
+    /**
+     * Sends a frame on the serial port.
+     *
+     * @param[in] type
+     *   The FRAME_* frame type.
+     * @param[in] sequence
+     *   The chunk sequence number.
+     * @param[in] offset
+     *   The file offset.
+     * @param[in] payload
+     *   The payload, or NULL if there is none.
+     * @param[in] nBytes
+     *   The payload length, up to FRAME_CHUNK_SIZE.
+     */
+    static void sendFrame(
+        const uint8_t type,
+        const uint32_t sequence,
+        const uint32_t offset,
+        const void*const payload,
+        const uint16_t nBytes );
+
+    /**
+     * Receives a host frame from the serial port, if one has arrived.
+     *
+     * Host frames have no payload. Bytes that are not part of a frame
+     * with a good CRC are skipped.
+     *
+     * @param[out] header
+     *   The frame's header.
+     *
+     * @return
+     *   Returns true if a frame was received.
+     */
+    static bool receiveFrame( FrameHeader& header );
+
+public:
+    /**
+     * Sends a file on the serial port, using the frame protocol described
+     * in SerialFrames.h.
+     *
+     * The transfer starts at the given offset, so an interrupted transfer
+     * can be resumed. Problems opening the file are sent as a FRAME_ERROR
+     * frame.
+     *
+     * @param[in] path
+     *   The path of a file.
+     * @param[in] offset
+     *   (optional, default = 0) The file offset to start at.
+     *
+     * @return
+     *   Returns true if the whole file was sent and acknowledged, and
+     *   false otherwise.
+     */
+    static bool get( const char*const path, const uint32_t offset = 0 );
 };
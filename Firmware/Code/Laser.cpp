@@ -1,6 +1,7 @@
 #include "Laser.h"
 
 bool Laser::powerStatus = false;
+uint32_t Laser::powerOnTime = 0;
 
 #if defined(ENABLE_USAGE_TRACKING)
 uint32_t Laser::numberOfPowerOns = 0;
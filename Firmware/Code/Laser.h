@@ -35,6 +35,9 @@ private:
     // Whether the laser power is on or off.
     static bool powerStatus;
 
+    // When the laser was most recently turned on, in ms since boot.
+    static uint32_t powerOnTime;
+
 #if defined(ENABLE_USAGE_TRACKING)
     // Usage counters and uptime.
     static uint32_t numberOfPowerOns;
@@ -165,18 +168,36 @@ public:
         return powerStatus;
     }
 
+    /**
+     * Returns true if the laser is powered on and has finished warming up.
+     *
+     * @return
+     *   Returns true if on and warmed up.
+     *
+     * @see setPower()
+     */
+    static inline bool isWarmedUp( )
+    {
+        return powerStatus && (millis( ) - powerOnTime) >= LASER_WARMUP_DELAY;
+    }
+
     /**
      * Turn the laser on or off.
      *
      * When the laser is turned on, there is a short delay before the
      * method returns so that the laser has time to warm up and stabilize.
+     * Callers that have other work to do meanwhile can skip the delay
+     * and check isWarmedUp() instead.
      *
      * @param[in] onOff
      *   True to turn the laser on, and false to turn it off.
+     * @param[in] warmup
+     *   True to wait for the laser to warm up when turning it on.
      *
      * @see isPowerOn()
+     * @see isWarmedUp()
      */
-    static inline void setPower( const bool onOff )
+    static inline void setPower( const bool onOff, const bool warmup = true )
     {
 #if defined(DEBUG_VERBOSE_LASER)
         Serial.printf( "Debug: laser power %s.\r\n",
@@ -190,7 +211,11 @@ public:
 
         // On power on, wait for the laser to warm up and stabilize.
         if ( onOff )
-            delay( LASER_WARMUP_DELAY );
+        {
+            powerOnTime = millis( );
+            if ( warmup )
+                delay( LASER_WARMUP_DELAY );
+        }
         powerStatus = onOff;
 
 #if defined(ENABLE_USAGE_TRACKING)
@@ -0,0 +1,102 @@
+#pragma once
+#include <stdint.h>
+
+
+//----------------------------------------------------------------------
+// Binary data log file format.
+//----------------------------------------------------------------------
+// A binary data log is a sequence of 512-byte sectors, written little-
+// endian, in two parts:
+//
+// - A file header. The header starts with a LogFileHeader, followed by
+//   one LogColumn per column of a data record. The header is zero padded
+//   to a whole number of sectors, and the last 4 bytes of its last sector
+//   are a CRC-32 of the rest of the header.
+//
+// - Data blocks, one per sector. Each block starts with a LogBlockHeader,
+//   followed by as many fixed-size data records as fit. The last 4 bytes
+//   of the sector are a CRC-32 of the rest of the sector. The last block
+//   of a file may hold fewer records.
+//
+// The column table describes each field of a data record: its name,
+// units, type, byte offset in the record, and the printf() format used
+// to print it in a CSV file. This lets a host-side decoder read any
+// version of the record layout without knowing it in advance.
+//
+// Blocks carry the file's ID and a sequence number starting at zero. A
+// decoder stops at the first block without the file's ID, such as the
+// erased or stale sectors left at the end of a pre-allocated file after
+// a power loss.
+//
+// This header has no Arduino dependencies so that host-side tools can
+// use it as well.
+
+// Format version. Increment when the layout of the structures below
+// changes incompatibly.
+#define LOG_FORMAT_VERSION      1
+
+// Sector size.
+#define LOG_SECTOR_SIZE         512
+
+// Magic numbers at the start of the file header and each block.
+#define LOG_FILE_MAGIC          0x474C5450  // "PTLG"
+#define LOG_BLOCK_MAGIC         0x4B4C4250  // "PBLK"
+
+// Column value types.
+#define LOG_TYPE_TIME           1   // uint32_t seconds since 1970 (UTC).
+#define LOG_TYPE_UINT32         2   // uint32_t.
+#define LOG_TYPE_INT32          3   // int32_t.
+#define LOG_TYPE_FLOAT          4   // float.
+
+// Column string sizes, including the terminating null.
+#define LOG_COLUMN_NAME_SIZE    24
+#define LOG_COLUMN_UNITS_SIZE   12
+#define LOG_COLUMN_FORMAT_SIZE  8
+
+/**
+ * The fixed start of a binary data log file header.
+ */
+typedef struct LogFileHeader
+{
+    uint32_t magic;             // LOG_FILE_MAGIC.
+    uint16_t version;           // LOG_FORMAT_VERSION.
+    uint16_t numberOfSectors;   // Header size, in sectors.
+    uint32_t fileId;            // Unique ID, repeated in each block.
+    uint16_t recordSize;        // Data record size, in bytes.
+    uint16_t numberOfColumns;   // Number of LogColumn entries that follow.
+    char firmwareVersion[16];   // Firmware VERSION string.
+} LogFileHeader;
+
+/**
+ * A column description in a binary data log file header.
+ */
+typedef struct LogColumn
+{
+    char name[LOG_COLUMN_NAME_SIZE];        // CSV column name.
+    char units[LOG_COLUMN_UNITS_SIZE];      // Units, or empty.
+    char format[LOG_COLUMN_FORMAT_SIZE];    // CSV printf() format.
+    uint8_t type;                           // LOG_TYPE_* value type.
+    uint8_t reserved;
+    uint16_t offset;                        // Byte offset in the record.
+} LogColumn;
+
+/**
+ * The start of a binary data log block.
+ */
+typedef struct LogBlockHeader
+{
+    uint32_t magic;             // LOG_BLOCK_MAGIC.
+    uint32_t fileId;            // The file header's fileId.
+    uint32_t sequence;          // Block number, starting at zero.
+    uint16_t numberOfRecords;   // Number of records in the block.
+    uint16_t recordSize;        // Data record size, in bytes.
+} LogBlockHeader;
+
+// Bytes available for records in a block, between the block header and
+// the trailing CRC.
+#define LOG_BLOCK_DATA_SIZE \
+    (LOG_SECTOR_SIZE - sizeof(LogBlockHeader) - sizeof(uint32_t))
+
+static_assert( sizeof(LogFileHeader) == 32, "Unexpected LogFileHeader size" );
+static_assert( sizeof(LogColumn) == 48, "Unexpected LogColumn size" );
+static_assert( sizeof(LogBlockHeader) == 16, "Unexpected LogBlockHeader size" );
@@ -0,0 +1,413 @@
+#include "Mission.h"
+#include "Camera.h"
+#include "FileSystem.h"
+
+MissionSegment Mission::segments[MISSION_MAX_SEGMENTS];
+uint8_t Mission::numberOfSegments = 0;
+float Mission::edges[2][MAX_EDGES];
+uint8_t Mission::numberOfEdges[2] = { 0, 0 };
+uint8_t Mission::edgeSegments[2][MAX_EDGES + 1] = { { NO_SEGMENT }, { NO_SEGMENT } };
+uint8_t Mission::cursors[2] = { 0, 0 };
+uint8_t Mission::activeSegment = NO_SEGMENT;
+uint32_t Mission::runStartTime = 0;
+uint16_t Mission::errorLine = 0;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Plan.
+//----------------------------------------------------------------------
+/**
+ * Returns the next word of a line, and ends it.
+ *
+ * @param[in,out] s
+ *   The rest of the line. It is moved past the word.
+ *
+ * @return
+ *   Returns the word, or NULL at the end of the line or at a comment.
+ */
+static char* nextWord( char*& s )
+{
+    while ( *s != '\0' && isSpace( *s ) )
+        ++s;
+    if ( *s == '\0' || *s == '#' )
+        return NULL;
+    char*const word = s;
+    while ( *s != '\0' && !isSpace( *s ) )
+        ++s;
+    if ( *s != '\0' )
+        *s++ = '\0';
+    return word;
+}
+
+/**
+ * Parses a number.
+ *
+ * @param[in] word
+ *   The word to parse, or NULL.
+ * @param[out] value
+ *   The number.
+ *
+ * @return
+ *   Returns true if the whole word is a number.
+ */
+static bool parseNumber( const char*const word, float& value )
+{
+    if ( word == NULL )
+        return false;
+    char* end;
+    value = strtod( word, &end );
+    return end != word && *end == '\0';
+}
+
+/**
+ * Loads the mission plan from the SD card, if there is one.
+ *
+ * Errors are printed, with their line. A plan with errors is not
+ * used.
+ *
+ * @return
+ *   Returns true if a plan with at least one segment was loaded.
+ *
+ * @see getErrorLine()
+ */
+bool Mission::load( )
+{
+    numberOfSegments = 0;
+    activeSegment    = NO_SEGMENT;
+    errorLine        = 0;
+
+    if ( FileSystem::isMissionPresent( ) &&
+         !FileSystem::readMission( addLine ) )
+    {
+        if ( errorLine == 0 )
+        {
+            Serial.print( "Cannot read mission plan file.\r\n" );
+            FileSystem::printErrorMessage( );
+        }
+        numberOfSegments = 0;
+    }
+
+    index( KEY_DEPTH );
+    index( KEY_TIME );
+    return numberOfSegments != 0;
+}
+
+/**
+ * Adds a plan line's segment, if any.
+ *
+ * @param[in,out] line
+ *   The line. It is broken into words in place.
+ * @param[in] number
+ *   The line number, from 1.
+ *
+ * @return
+ *   Returns false on an error, which ends the load.
+ */
+bool Mission::addLine( char*const line, const uint16_t number )
+{
+    // Skip blank and comment lines.
+    char* s = line;
+    char* word = nextWord( s );
+    if ( word == NULL )
+        return true;
+
+    if ( numberOfSegments == MISSION_MAX_SEGMENTS )
+        return error( number, "Too many segments at", word );
+    MissionSegment& segment = segments[numberOfSegments];
+    if ( strcmp( word, "depth" ) == 0 )
+        segment.key = KEY_DEPTH;
+    else if ( strcmp( word, "time" ) == 0 )
+        segment.key = KEY_TIME;
+    else
+        return error( number, "Unknown key. Use 'depth' or 'time', not", word );
+
+    word = nextWord( s );
+    if ( !parseNumber( word, segment.from ) || segment.from < 0.0 )
+        return error( number, "Bad start of range", word );
+    word = nextWord( s );
+    if ( !parseNumber( word, segment.to ) || segment.to <= segment.from )
+        return error( number, "Bad end of range", word );
+
+    segment.interval  = 0;
+    segment.burstSize = 0;
+    segment.laser     = LASER_SETTING;
+    segment.imu       = true;
+    const char* intervalWord = NULL;
+    while ( (word = nextWord( s )) != NULL )
+    {
+        const char*const value = nextWord( s );
+        if ( value == NULL )
+            return error( number, "Missing value for", word );
+
+        float n;
+        if ( strcmp( word, "interval" ) == 0 )
+        {
+            if ( !parseNumber( value, n ) || n < MINIMUM_FRAME_INTERVAL || n > UINT32_MAX )
+                return error( number, "Bad interval", value );
+            segment.interval = (uint32_t)n;
+            intervalWord = value;
+        }
+        else if ( strcmp( word, "burst" ) == 0 )
+        {
+            if ( !parseNumber( value, n ) || n < 1.0 || n > 255.0 )
+                return error( number, "Bad burst size", value );
+            segment.burstSize = (uint8_t)n;
+        }
+        else if ( strcmp( word, "laser" ) == 0 )
+        {
+            if ( strcmp( value, "normal" ) == 0 )
+                segment.laser = LASER_NORMAL;
+            else if ( strcmp( value, "continuous" ) == 0 )
+                segment.laser = LASER_CONTINUOUS;
+            else
+                return error( number, "Bad laser mode. Use 'normal' or 'continuous', not", value );
+        }
+        else if ( strcmp( word, "imu" ) == 0 )
+        {
+            if ( strcmp( value, "on" ) == 0 )
+                segment.imu = true;
+            else if ( strcmp( value, "off" ) == 0 )
+                segment.imu = false;
+            else
+                return error( number, "Bad IMU sampling. Use 'on' or 'off', not", value );
+        }
+        else
+            return error( number, "Unknown option", word );
+    }
+
+    // Each burst must be over before the next is due. A segment without a
+    // burst size uses the setting's.
+    const uint8_t burst = (segment.burstSize != 0) ? segment.burstSize : ::getBurstSize( );
+    if ( segment.interval != 0 && segment.interval < Camera::getBurstDuration( burst ) )
+        return error( number, "Interval too short for the burst", intervalWord );
+
+    ++numberOfSegments;
+    return true;
+}
+
+/**
+ * Reports a plan error.
+ *
+ * @param[in] number
+ *   The line number, from 1.
+ * @param[in] message
+ *   The error.
+ * @param[in] word
+ *   The word in error.
+ *
+ * @return
+ *   Returns false.
+ */
+bool Mission::error(
+    const uint16_t number,
+    const char*const message,
+    const char*const word )
+{
+    errorLine = number;
+    Serial.printf( "Mission plan line %d: %s '%s'.\r\n",
+        number,
+        message,
+        (word == NULL) ? "" : word );
+    return false;
+}
+
+/**
+ * Sorts a key's edges and finds the segment that wins between each
+ * pair of them.
+ *
+ * @param[in] key
+ *   One of the KEY_* values.
+ */
+void Mission::index( const uint8_t key )
+{
+    // Insertion sort the edges, without duplicates. There are few.
+    float*const keyEdges = edges[key];
+    uint8_t n = 0;
+    for ( uint8_t i = 0; i < numberOfSegments; ++i )
+    {
+        if ( segments[i].key != key )
+            continue;
+        const float values[2] = { segments[i].from, segments[i].to };
+        for ( uint8_t j = 0; j < 2; ++j )
+        {
+            uint8_t k = n;
+            for ( ; k > 0 && keyEdges[k - 1] > values[j]; --k )
+                ;
+            if ( k > 0 && keyEdges[k - 1] == values[j] )
+                continue;
+            memmove( &keyEdges[k + 1], &keyEdges[k], (n - k) * sizeof( float ) );
+            keyEdges[k] = values[j];
+            ++n;
+        }
+    }
+    numberOfEdges[key] = n;
+    cursors[key] = 0;
+
+    // Nothing comes before the first edge. Between edges, the first
+    // segment in the file that covers the lower edge covers the rest too.
+    uint8_t*const winners = edgeSegments[key];
+    winners[0] = NO_SEGMENT;
+    winners[n] = NO_SEGMENT;
+    for ( uint8_t i = 1; i < n; ++i )
+    {
+        winners[i] = NO_SEGMENT;
+        for ( uint8_t j = 0; j < numberOfSegments; ++j )
+        {
+            if ( segments[j].key == key &&
+                 segments[j].from <= keyEdges[i - 1] &&
+                 keyEdges[i - 1] < segments[j].to )
+            {
+                winners[i] = j;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Finds the segment for a key's value.
+ *
+ * @param[in] key
+ *   One of the KEY_* values.
+ * @param[in] value
+ *   The depth, in m, or the time since the run started, in s.
+ *
+ * @return
+ *   Returns the segment, or NO_SEGMENT.
+ */
+uint8_t Mission::find( const uint8_t key, const float value )
+{
+    // The winner at index i is for values from edge i - 1 up to edge i.
+    const float*const keyEdges = edges[key];
+    uint8_t cursor = cursors[key];
+    while ( cursor > 0 && value < keyEdges[cursor - 1] )
+        --cursor;
+    while ( cursor < numberOfEdges[key] && value >= keyEdges[cursor] )
+        ++cursor;
+    cursors[key] = cursor;
+    return edgeSegments[key][cursor];
+}
+
+/**
+ * Prints the plan to the serial port, marking the segment in effect.
+ */
+void Mission::print( )
+{
+    if ( numberOfSegments == 0 )
+    {
+        if ( errorLine == 0 )
+            Serial.print( "No mission plan. Frames follow the settings.\r\n" );
+        else
+            Serial.print( "Mission plan not used. Frames follow the settings.\r\n" );
+        return;
+    }
+
+    Serial.printf( "Mission plan, %d segments. Frames that match none follow the settings.\r\n",
+        numberOfSegments );
+    char range[32];
+    char interval[16];
+    char burst[16];
+    for ( uint8_t i = 0; i < numberOfSegments; ++i )
+    {
+        const MissionSegment& segment = segments[i];
+        if ( segment.key == KEY_DEPTH )
+            sprintf( range, "depth %.1f-%.1f m", segment.from, segment.to );
+        else
+            sprintf( range, "time %.0f-%.0f s", segment.from, segment.to );
+        if ( segment.interval == 0 )
+            strcpy( interval, "setting" );
+        else
+            sprintf( interval, "%ld ms", (long) segment.interval );
+        if ( segment.burstSize == 0 )
+            strcpy( burst, "setting" );
+        else
+            sprintf( burst, "%d", segment.burstSize );
+
+        static const char*const LASERS[] = { "setting", "normal", "continuous" };
+        Serial.printf( "%c %2d  %-20s interval %s, burst %s, laser %s, imu %s\r\n",
+            (i == activeSegment) ? '*' : ' ',
+            i + 1,
+            range,
+            interval,
+            burst,
+            LASERS[segment.laser],
+            segment.imu ? "on" : "off" );
+    }
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Run.
+//----------------------------------------------------------------------
+/**
+ * Loads the plan for a new run, and finds its first segment.
+ *
+ * @param[in] depth
+ *   The depth, in m, if known, or else 0.
+ *
+ * @return
+ *   Returns true if a plan was loaded.
+ *
+ * @see endRun()
+ */
+bool Mission::startRun( const float depth )
+{
+    runStartTime = millis( );
+    if ( !load( ) )
+        return false;
+    update( depth );
+    return true;
+}
+
+/**
+ * Finds the segment for a running frame.
+ *
+ * A change of segment is printed and logged.
+ *
+ * @param[in] depth
+ *   The frame's depth, in m.
+ *
+ * @return
+ *   Returns true if the segment changed.
+ */
+bool Mission::update( const float depth )
+{
+    if ( numberOfSegments == 0 )
+        return false;
+
+    // NO_SEGMENT is the highest index, so this is the one first in the
+    // file, if any.
+    const float seconds = (millis( ) - runStartTime) / 1000.0;
+    const uint8_t segment = min( find( KEY_DEPTH, depth ), find( KEY_TIME, seconds ) );
+    if ( segment == activeSegment )
+        return false;
+    activeSegment = segment;
+
+    char message[64];
+    if ( segment == NO_SEGMENT )
+        strcpy( message, "Mission segment none, following the settings" );
+    else
+        sprintf( message, "Mission segment %d", segment + 1 );
+    Serial.printf( "%s.\r\n", message );
+    FileSystem::writeStatus( message );
+    return true;
+}
+
+/**
+ * Ends the run's plan, so that the settings are followed again.
+ *
+ * @see startRun()
+ */
+void Mission::endRun( )
+{
+    numberOfSegments = 0;
+    activeSegment    = NO_SEGMENT;
+    index( KEY_DEPTH );
+    index( KEY_TIME );
+}
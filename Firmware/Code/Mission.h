@@ -0,0 +1,322 @@
+#pragma once
+#include <Arduino.h>
+
+#include "pltlogger.h"
+
+
+/**
+ * A mission plan segment.
+ *
+ * Capture settings left at 0, or LASER_SETTING, follow the device's
+ * settings.
+ */
+typedef struct MissionSegment
+{
+    uint8_t key;                // Mission::KEY_DEPTH or KEY_TIME.
+    float from;                 // m or s, inclusive.
+    float to;                   // m or s, exclusive.
+    uint32_t interval;          // ms, or 0.
+    uint8_t burstSize;          // Images, or 0.
+    uint8_t laser;              // One of Mission::LASER_*.
+    bool imu;                   // True to read the inertia module.
+} MissionSegment;
+
+
+/**
+ * Runs a mission plan, which varies the capture settings over a run.
+ *
+ * A mission plan is a text file on the SD card (MISSION.TXT) with one
+ * segment per line, keyed by depth, in m, or by time since the run
+ * started, in s:
+ *
+ *   # Dense images near the surface, sparse ones deeper down.
+ *   depth 0 20 interval 250 burst 3 laser continuous
+ *   depth 20 500 interval 2000 imu off
+ *   time 0 60 interval 1000
+ *
+ * Each segment covers from its first value up to, but not including, its
+ * second. The options, in any order, are the frame interval in ms, the
+ * burst size, the laser mode (normal or continuous), and whether to read
+ * the inertia module (on or off). Options left out, and frames that match
+ * no segment, follow the device's settings. A segment's interval must
+ * leave time for its burst (see Camera::getBurstDuration()). Where
+ * segments overlap, the first in the file wins. Text after a '#' is a
+ * comment.
+ *
+ * The plan is parsed when a run starts into a table of up to
+ * MISSION_MAX_SEGMENTS segments, and the card is not read again during
+ * the run. For each key, the segments' edges are sorted once, with the
+ * segment that wins between each pair of edges. Depth and time change
+ * little from one frame to the next, so each frame's segment is found by
+ * moving a cursor over those edges, usually by none or one.
+ *
+ * A frame's depth is only known once it has been read, so the segment
+ * found then sets the capture settings from the next frame on. A
+ * segment's laser mode takes effect when the frame in progress ends.
+ */
+class Mission
+{
+private:
+    Mission( ) = delete;
+    Mission( const Mission& ) = delete;
+    Mission& operator=( const Mission& ) = delete;
+
+
+//----------------------------------------------------------------------
+// Constants.
+//----------------------------------------------------------------------
+public:
+    // Segment keys.
+    static const uint8_t KEY_DEPTH = 0;
+    static const uint8_t KEY_TIME  = 1;
+
+    // Segment laser modes.
+    static const uint8_t LASER_SETTING    = 0; // Follow the laser mode setting.
+    static const uint8_t LASER_NORMAL     = 1;
+    static const uint8_t LASER_CONTINUOUS = 2;
+
+    // No segment.
+    static const uint8_t NO_SEGMENT = 0xFF;
+
+private:
+    // The most edges a key can have.
+    static const uint8_t MAX_EDGES = 2 * MISSION_MAX_SEGMENTS;
+
+
+//----------------------------------------------------------------------
+// Fields.
+//----------------------------------------------------------------------
+private:
+    // The plan's segments, in file order.
+    static MissionSegment segments[MISSION_MAX_SEGMENTS];
+    static uint8_t numberOfSegments;
+
+    // For each key, the segments' edges, sorted, and the segment that wins
+    // below the first edge, between each pair, and above the last. Then
+    // the cursor, the index in the winners of the most recent lookup.
+    static float edges[2][MAX_EDGES];
+    static uint8_t numberOfEdges[2];
+    static uint8_t edgeSegments[2][MAX_EDGES + 1];
+    static uint8_t cursors[2];
+
+    // The segment in effect, and when the run started, in ms since boot.
+    static uint8_t activeSegment;
+    static uint32_t runStartTime;
+
+    // The line of the plan's first error, or 0.
+    static uint16_t errorLine;
+
+
+//----------------------------------------------------------------------
+// Plan.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Loads the mission plan from the SD card, if there is one.
+     *
+     * Errors are printed, with their line. A plan with errors is not
+     * used.
+     *
+     * @return
+     *   Returns true if a plan with at least one segment was loaded.
+     *
+     * @see getErrorLine()
+     */
+    static bool load( );
+
+    /**
+     * Returns the line of the most recently loaded plan's first error.
+     *
+     * @return
+     *   Returns the line, from 1, or 0 if there was no error.
+     */
+    static inline uint16_t getErrorLine( )
+    {
+        return errorLine;
+    }
+
+    /**
+     * Returns true if a plan is loaded.
+     *
+     * @return
+     *   Returns true if loaded.
+     */
+    static inline bool isLoaded( )
+    {
+        return numberOfSegments != 0;
+    }
+
+    /**
+     * Prints the plan to the serial port, marking the segment in effect.
+     */
+    static void print( );
+
+private:
+    /**
+     * Adds a plan line's segment, if any.
+     *
+     * @param[in,out] line
+     *   The line. It is broken into words in place.
+     * @param[in] number
+     *   The line number, from 1.
+     *
+     * @return
+     *   Returns false on an error, which ends the load.
+     */
+    static bool addLine( char*const line, const uint16_t number );
+
+    /**
+     * Reports a plan error.
+     *
+     * @param[in] number
+     *   The line number, from 1.
+     * @param[in] message
+     *   The error.
+     * @param[in] word
+     *   The word in error.
+     *
+     * @return
+     *   Returns false.
+     */
+    static bool error(
+        const uint16_t number,
+        const char*const message,
+        const char*const word );
+
+    /**
+     * Sorts a key's edges and finds the segment that wins between each
+     * pair of them.
+     *
+     * @param[in] key
+     *   One of the KEY_* values.
+     */
+    static void index( const uint8_t key );
+
+    /**
+     * Finds the segment for a key's value.
+     *
+     * @param[in] key
+     *   One of the KEY_* values.
+     * @param[in] value
+     *   The depth, in m, or the time since the run started, in s.
+     *
+     * @return
+     *   Returns the segment, or NO_SEGMENT.
+     */
+    static uint8_t find( const uint8_t key, const float value );
+
+
+//----------------------------------------------------------------------
+// Run.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Loads the plan for a new run, and finds its first segment.
+     *
+     * @param[in] depth
+     *   The depth, in m, if known, or else 0.
+     *
+     * @return
+     *   Returns true if a plan was loaded.
+     *
+     * @see endRun()
+     */
+    static bool startRun( const float depth );
+
+    /**
+     * Finds the segment for a running frame.
+     *
+     * A change of segment is printed and logged.
+     *
+     * @param[in] depth
+     *   The frame's depth, in m.
+     *
+     * @return
+     *   Returns true if the segment changed.
+     */
+    static bool update( const float depth );
+
+    /**
+     * Ends the run's plan, so that the settings are followed again.
+     *
+     * @see startRun()
+     */
+    static void endRun( );
+
+    /**
+     * Returns the segment in effect.
+     *
+     * @return
+     *   Returns the segment, or NO_SEGMENT.
+     */
+    static inline uint8_t getActiveSegment( )
+    {
+        return activeSegment;
+    }
+
+
+//----------------------------------------------------------------------
+// Capture settings.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Returns the frame interval in effect.
+     *
+     * @param[in] setting
+     *   The frame interval to follow if the segment has none.
+     *
+     * @return
+     *   Returns the interval, in ms.
+     */
+    static inline uint32_t getInterval( const uint32_t setting )
+    {
+        if ( activeSegment == NO_SEGMENT || segments[activeSegment].interval == 0 )
+            return setting;
+        return segments[activeSegment].interval;
+    }
+
+    /**
+     * Returns the burst size in effect.
+     *
+     * @param[in] setting
+     *   The burst size to follow if the segment has none.
+     *
+     * @return
+     *   Returns the number of images.
+     */
+    static inline uint8_t getBurstSize( const uint8_t setting )
+    {
+        if ( activeSegment == NO_SEGMENT || segments[activeSegment].burstSize == 0 )
+            return setting;
+        return segments[activeSegment].burstSize;
+    }
+
+    /**
+     * Returns the laser mode in effect.
+     *
+     * @param[in] setting
+     *   The laser mode to follow if the segment has none. True for
+     *   continuous.
+     *
+     * @return
+     *   Returns true if continuous.
+     */
+    static inline bool isLaserContinuous( const bool setting )
+    {
+        if ( activeSegment == NO_SEGMENT ||
+             segments[activeSegment].laser == LASER_SETTING )
+            return setting;
+        return segments[activeSegment].laser == LASER_CONTINUOUS;
+    }
+
+    /**
+     * Returns true if frames read the inertia module.
+     *
+     * @return
+     *   Returns true unless the segment turns it off.
+     */
+    static inline bool isImuOn( )
+    {
+        return activeSegment == NO_SEGMENT || segments[activeSegment].imu;
+    }
+};
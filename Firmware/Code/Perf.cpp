@@ -0,0 +1,131 @@
+#include "Perf.h"
+
+const char*const Perf::STAGE_NAMES[NUMBER_OF_STAGES] = {
+    "frame",
+    "lateness",
+    "power on",
+    "shutter",
+    "power off",
+    "inertia",
+    "pressure",
+    "temperature",
+    "format",
+    "sd write",
+    "sd sync",
+};
+
+uint32_t Perf::buckets[NUMBER_OF_STAGES][NUMBER_OF_BUCKETS];
+uint32_t Perf::counts[NUMBER_OF_STAGES];
+uint64_t Perf::totals[NUMBER_OF_STAGES];
+uint32_t Perf::maximums[NUMBER_OF_STAGES];
+uint32_t Perf::numberOfMissedFrames = 0;
+uint32_t Perf::resetTime = 0;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Record.
+//----------------------------------------------------------------------
+/**
+ * Returns the upper edge of a histogram bucket.
+ *
+ * @param[in] bucket
+ *   The bucket index.
+ *
+ * @return
+ *   Returns the first time, in us, past the bucket.
+ */
+uint32_t Perf::getBucketLimit( const uint8_t bucket )
+{
+    if ( bucket == 0 )
+        return 1UL << FIRST_BUCKET_BITS;
+    if ( bucket >= NUMBER_OF_BUCKETS - 1 )
+        return UINT32_MAX;
+
+    const uint8_t top = FIRST_BUCKET_BITS + (bucket - 1) / 2;
+    const uint8_t half = (bucket - 1) % 2;
+    return (1UL << top) + (half + 1) * (1UL << (top - 1));
+}
+
+/**
+ * Returns a percentile of a stage's times.
+ *
+ * @param[in] stage
+ *   The stage.
+ * @param[in] percent
+ *   The percentile, from 1 to 100.
+ *
+ * @return
+ *   Returns the upper edge of the bucket holding the percentile, but
+ *   no more than the maximum, in us.
+ */
+uint32_t Perf::getPercentile( const uint8_t stage, const uint8_t percent )
+{
+    const uint32_t rank = (uint32_t) (((uint64_t) counts[stage] * percent + 99) / 100);
+    uint32_t n = 0;
+    for ( uint8_t i = 0; i < NUMBER_OF_BUCKETS; ++i )
+    {
+        n += buckets[stage][i];
+        if ( n >= rank )
+        {
+            const uint32_t limit = getBucketLimit( i );
+            return (limit < maximums[stage]) ? limit : maximums[stage];
+        }
+    }
+    return maximums[stage];
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Report.
+//----------------------------------------------------------------------
+/**
+ * Prints each stage's count, mean, 50th and 99th percentiles, and
+ * maximum, and the number of missed frames, to the serial port.
+ *
+ * @see reset()
+ */
+void Perf::print( )
+{
+    Serial.printf( "%-12s %8s %9s %9s %9s %9s\r\n",
+        "Stage (us)", "Count", "Mean", "p50", "p99", "Max" );
+    for ( uint8_t i = 0; i < NUMBER_OF_STAGES; ++i )
+    {
+        if ( counts[i] == 0 )
+        {
+            Serial.printf( "%-12s %8d %9s %9s %9s %9s\r\n",
+                STAGE_NAMES[i], 0, "-", "-", "-", "-" );
+            continue;
+        }
+        Serial.printf( "%-12s %8lu %9lu %9lu %9lu %9lu\r\n",
+            STAGE_NAMES[i],
+            (unsigned long) counts[i],
+            (unsigned long) (totals[i] / counts[i]),
+            (unsigned long) getPercentile( i, 50 ),
+            (unsigned long) getPercentile( i, 99 ),
+            (unsigned long) maximums[i] );
+    }
+    Serial.printf( "Missed frames: %lu\r\n", (unsigned long) numberOfMissedFrames );
+    Serial.printf( "Since reset: %lu s\r\n",
+        (unsigned long) ((millis( ) - resetTime) / 1000) );
+}
+
+/**
+ * Clears all stage histograms and the missed frame count.
+ *
+ * @see print()
+ */
+void Perf::reset( )
+{
+    memset( buckets, 0, sizeof( buckets ) );
+    memset( counts, 0, sizeof( counts ) );
+    memset( totals, 0, sizeof( totals ) );
+    memset( maximums, 0, sizeof( maximums ) );
+    numberOfMissedFrames = 0;
+    resetTime = millis( );
+}
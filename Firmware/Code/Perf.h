@@ -0,0 +1,201 @@
+#pragma once
+#include <Arduino.h>
+
+#include "pltlogger.h"
+
+
+/**
+ * Measures how long each stage of a snap-and-log takes.
+ *
+ * Each stage has a latency histogram with fixed buckets, plus its count,
+ * total, and maximum. Recording a time takes a micros() call and a few
+ * adds, so it is always on and does not disturb the timing it measures.
+ * Nothing is printed until asked, by the "perf" command.
+ *
+ * Buckets are half an octave wide: the first holds times under 64 us,
+ * and each later one covers from 64 us * 2^(n/2) up to the next. A
+ * percentile is reported as the upper edge of the bucket that holds it,
+ * so it is at most 1.5 times the real value. The maximum is exact.
+ *
+ * The stages are timed where they happen: powering up and down in
+ * beginSnapAndLog() and endSnapAndLog(), the shutter presses, as timed by Camera, in
+ * updateSnapAndLog(), each I2C step of a water sensor reading in
+ * Sensors, and formatting, writing, and syncing the data log in
+ * FileSystem. loop() records how late each frame starts, and counts the
+ * frame intervals that are missed entirely.
+ */
+class Perf
+{
+private:
+    Perf( ) = delete;
+    Perf( const Perf& ) = delete;
+    Perf& operator=( const Perf& ) = delete;
+
+
+//----------------------------------------------------------------------
+// Constants.
+//----------------------------------------------------------------------
+public:
+    // Stages.
+    static const uint8_t STAGE_FRAME       = 0;  // Whole snap-and-log.
+    static const uint8_t STAGE_LATENESS    = 1;  // Frame start past due.
+    static const uint8_t STAGE_POWER_ON    = 2;  // Camera and laser on.
+    static const uint8_t STAGE_SHUTTER     = 3;  // Shutter held down.
+    static const uint8_t STAGE_POWER_OFF   = 4;  // Camera and laser off.
+    static const uint8_t STAGE_INERTIA     = 5;  // Inertia and batteries.
+    static const uint8_t STAGE_PRESSURE    = 6;  // Pressure I2C step.
+    static const uint8_t STAGE_TEMPERATURE = 7;  // Temperature I2C step.
+    static const uint8_t STAGE_FORMAT      = 8;  // Data log row format.
+    static const uint8_t STAGE_SD_WRITE    = 9;  // Data log sector write.
+    static const uint8_t STAGE_SD_SYNC     = 10; // Data log sync.
+    static const uint8_t NUMBER_OF_STAGES  = 11;
+
+private:
+    // Histogram buckets. See getBucket().
+    static const uint8_t NUMBER_OF_BUCKETS = 32;
+    static const uint8_t FIRST_BUCKET_BITS = 6;     // 64 us.
+
+    // Stage names, for printing.
+    static const char*const STAGE_NAMES[NUMBER_OF_STAGES];
+
+
+//----------------------------------------------------------------------
+// Fields.
+//----------------------------------------------------------------------
+private:
+    // Per-stage histograms and totals, in us.
+    static uint32_t buckets[NUMBER_OF_STAGES][NUMBER_OF_BUCKETS];
+    static uint32_t counts[NUMBER_OF_STAGES];
+    static uint64_t totals[NUMBER_OF_STAGES];
+    static uint32_t maximums[NUMBER_OF_STAGES];
+
+    // Frame intervals that passed with no frame started.
+    static uint32_t numberOfMissedFrames;
+
+    // Time of the most recent reset, in ms since boot.
+    static uint32_t resetTime;
+
+
+//----------------------------------------------------------------------
+// Record.
+//----------------------------------------------------------------------
+private:
+    /**
+     * Returns the histogram bucket for a time.
+     *
+     * @param[in] us
+     *   The time, in us.
+     *
+     * @return
+     *   Returns the bucket index.
+     */
+    static inline uint8_t getBucket( const uint32_t us )
+    {
+        if ( us < (1UL << FIRST_BUCKET_BITS) )
+            return 0;
+
+        // Two buckets per power of two, split by the bit below the top.
+        const uint8_t top = 31 - __builtin_clz( us );
+        const uint8_t half = (us >> (top - 1)) & 1;
+        const uint32_t bucket = 1 + 2 * (top - FIRST_BUCKET_BITS) + half;
+        return (bucket < NUMBER_OF_BUCKETS) ? bucket : NUMBER_OF_BUCKETS - 1;
+    }
+
+    /**
+     * Returns the upper edge of a histogram bucket.
+     *
+     * @param[in] bucket
+     *   The bucket index.
+     *
+     * @return
+     *   Returns the first time, in us, past the bucket.
+     */
+    static uint32_t getBucketLimit( const uint8_t bucket );
+
+    /**
+     * Returns a percentile of a stage's times.
+     *
+     * @param[in] stage
+     *   The stage.
+     * @param[in] percent
+     *   The percentile, from 1 to 100.
+     *
+     * @return
+     *   Returns the upper edge of the bucket holding the percentile, but
+     *   no more than the maximum, in us.
+     */
+    static uint32_t getPercentile( const uint8_t stage, const uint8_t percent );
+
+public:
+    /**
+     * Adds a time to a stage's histogram.
+     *
+     * @param[in] stage
+     *   The stage.
+     * @param[in] us
+     *   The time, in us.
+     *
+     * @see record()
+     */
+    static inline void add( const uint8_t stage, const uint32_t us )
+    {
+        ++buckets[stage][getBucket( us )];
+        ++counts[stage];
+        totals[stage] += us;
+        if ( us > maximums[stage] )
+            maximums[stage] = us;
+    }
+
+    /**
+     * Adds the time since a start time to a stage's histogram.
+     *
+     * Use as:
+     * @code
+     *   const uint32_t t = micros( );
+     *   ...
+     *   Perf::record( Perf::STAGE_SD_SYNC, t );
+     * @endcode
+     *
+     * @param[in] stage
+     *   The stage.
+     * @param[in] startTime
+     *   The stage's start, from micros().
+     *
+     * @see add()
+     */
+    static inline void record( const uint8_t stage, const uint32_t startTime )
+    {
+        add( stage, micros( ) - startTime );
+    }
+
+    /**
+     * Counts frame intervals that passed with no frame started.
+     *
+     * @param[in] n
+     *   The number missed.
+     */
+    static inline void addMissedFrames( const uint32_t n )
+    {
+        numberOfMissedFrames += n;
+    }
+
+
+//----------------------------------------------------------------------
+// Report.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Prints each stage's count, mean, 50th and 99th percentiles, and
+     * maximum, and the number of missed frames, to the serial port.
+     *
+     * @see reset()
+     */
+    static void print( );
+
+    /**
+     * Clears all stage histograms and the missed frame count.
+     *
+     * @see print()
+     */
+    static void reset( );
+};
@@ -0,0 +1,384 @@
+#include "Planner.h"
+#include "Battery.h"
+#include "FileSystem.h"
+#include "Mission.h"
+
+float Planner::snapTime = 0.0;
+uint8_t Planner::snapTimeBurst = 0;
+uint32_t Planner::runStartTime = 0;
+uint32_t Planner::checkTime = 0;
+bool Planner::warned = false;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Forecast.
+//----------------------------------------------------------------------
+/**
+ * Returns the frame interval in effect.
+ *
+ * While running, this is the scheduled interval, which follows the
+ * frame spacing, if any. Otherwise it is the frame interval setting.
+ *
+ * @return
+ *   Returns the interval, in ms.
+ */
+uint32_t Planner::getInterval( )
+{
+    if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
+        return getScheduledInterval( );
+    return getFrameInterval( );
+}
+
+/**
+ * Returns the SD card space taken per data log row.
+ *
+ * @return
+ *   Returns the size, in bytes, as measured by FileSystem, or
+ *   DATA_LOG_PREALLOCATE_ROW_SIZE until measured.
+ *
+ * @see FileSystem::getBytesPerRow()
+ */
+uint32_t Planner::getBytesPerRow( )
+{
+    const uint32_t nBytes = FileSystem::getBytesPerRow( );
+    return (nBytes == 0) ? DATA_LOG_PREALLOCATE_ROW_SIZE : nBytes;
+}
+
+/**
+ * Returns the number of frames that still fit on the SD card.
+ *
+ * @return
+ *   Returns the number of frames.
+ */
+uint32_t Planner::getCardFrames( )
+{
+    // The data log's pre-allocated extent is counted as in use, but
+    // rows still fit in what is left of it.
+    const uint64_t space = FileSystem::getFreeSpace( ) +
+        FileSystem::getDataLogSpaceLeft( );
+    const uint64_t frames = space /
+        ((uint64_t)getBytesPerRow( ) * Mission::getBurstSize( getBurstSize( ) ));
+    return (frames > UINT32_MAX) ? UINT32_MAX : (uint32_t)frames;
+}
+
+/**
+ * Returns how long frames still fit on the SD card.
+ *
+ * @param[in] interval
+ *   The frame interval, in ms.
+ *
+ * @return
+ *   Returns the time, in seconds.
+ */
+uint32_t Planner::getCardSeconds( const uint32_t interval )
+{
+    const uint64_t seconds = (uint64_t)getCardFrames( ) * interval / 1000L;
+    return (seconds > UINT32_MAX) ? UINT32_MAX : (uint32_t)seconds;
+}
+
+/**
+ * Returns the fraction of the time that the laser is on.
+ *
+ * @param[in] interval
+ *   The frame interval, in ms.
+ *
+ * @return
+ *   Returns the fraction, from 0 to 1.
+ */
+float Planner::getLaserDuty( const uint32_t interval )
+{
+    if ( Mission::isLaserContinuous( isLaserContinuous( ) ) || interval == 0 )
+        return 1.0;
+
+    // The laser is on for each snap-and-log. Scale a measured length to
+    // the current burst size.
+    const uint8_t burst = Mission::getBurstSize( getBurstSize( ) );
+    const float ms = (snapTimeBurst == 0) ?
+        (float)PLAN_SNAP_TIME * burst :
+        snapTime * burst / snapTimeBurst;
+    return (ms >= interval) ? 1.0 : ms / interval;
+}
+
+/**
+ * Returns the main battery's drain.
+ *
+ * @param[in] interval
+ *   The frame interval, in ms.
+ *
+ * @return
+ *   Returns the drain, in percent per hour.
+ *
+ * @see isMainDrainMeasured()
+ */
+float Planner::getMainDrain( const uint32_t interval )
+{
+    const float modeled = PLAN_CAMERA_DRAIN +
+        PLAN_LASER_DRAIN * getLaserDuty( interval );
+    if ( !isMainDrainMeasured( ) )
+        return modeled;
+
+    // The drain was measured at the interval in effect. Scale it to this
+    // interval by the model.
+    const float current = PLAN_CAMERA_DRAIN +
+        PLAN_LASER_DRAIN * getLaserDuty( getInterval( ) );
+    return Battery::getMainDischargeRate( ) * modeled / current;
+}
+
+/**
+ * Returns true if the main battery's drain is measured, rather than
+ * only modeled.
+ *
+ * @return
+ *   Returns true if measured.
+ */
+bool Planner::isMainDrainMeasured( )
+{
+    return Battery::getMainDischargeRate( ) > 0.0;
+}
+
+/**
+ * Returns how long the main battery lasts.
+ *
+ * @param[in] interval
+ *   The frame interval, in ms.
+ *
+ * @return
+ *   Returns the time, in seconds.
+ */
+uint32_t Planner::getMainSeconds( const uint32_t interval )
+{
+    if ( !Battery::isMainPresent( ) )
+        return UINT32_MAX;
+    const float left = Battery::getSampledMainPercent( ) - BATTERY_ERROR_PERCENT;
+    if ( left <= 0.0 )
+        return 0;
+    const float seconds = left / getMainDrain( interval ) * 3600.0;
+    return (seconds >= (float)UINT32_MAX) ? UINT32_MAX : (uint32_t)seconds;
+}
+
+/**
+ * Returns how long the controller battery lasts.
+ *
+ * @return
+ *   Returns the time, in seconds, or UINT32_MAX until its drain is
+ *   measured.
+ */
+uint32_t Planner::getControllerSeconds( )
+{
+    if ( !Battery::isControllerPresent( ) )
+        return UINT32_MAX;
+    const float left = Battery::getSampledControllerPercent( ) - BATTERY_ERROR_PERCENT;
+    if ( left <= 0.0 )
+        return 0;
+    const float drain = Battery::getControllerDischargeRate( );
+    if ( drain <= 0.0 )
+        return UINT32_MAX;
+    const float seconds = left / drain * 3600.0;
+    return (seconds >= (float)UINT32_MAX) ? UINT32_MAX : (uint32_t)seconds;
+}
+
+/**
+ * Returns how long a run can go on.
+ *
+ * @param[in] interval
+ *   The frame interval, in ms.
+ *
+ * @return
+ *   Returns the time, in seconds.
+ *
+ * @see getLimit()
+ */
+uint32_t Planner::getSeconds( const uint32_t interval )
+{
+    return min( getCardSeconds( interval ),
+        min( getMainSeconds( interval ), getControllerSeconds( ) ) );
+}
+
+/**
+ * Returns what limits how long a run can go on.
+ *
+ * @param[in] interval
+ *   The frame interval, in ms.
+ *
+ * @return
+ *   Returns one of the LIMIT_* values.
+ *
+ * @see getSeconds()
+ */
+uint8_t Planner::getLimit( const uint32_t interval )
+{
+    const uint32_t seconds = getSeconds( interval );
+    if ( seconds == UINT32_MAX )
+        return LIMIT_NONE;
+    if ( seconds == getCardSeconds( interval ) )
+        return LIMIT_CARD;
+    if ( seconds == getMainSeconds( interval ) )
+        return LIMIT_MAIN;
+    return LIMIT_CONTROLLER;
+}
+
+/**
+ * Returns how long the run is still expected to go on.
+ *
+ * @return
+ *   Returns the time, in seconds, PLAN_RUN_DURATION less the time
+ *   already run.
+ */
+uint32_t Planner::getSecondsWanted( )
+{
+    if ( getSoftwareStatus( ) != SOFTWARE_RUNNING )
+        return PLAN_RUN_DURATION;
+    const uint32_t elapsed = (millis( ) - runStartTime) / 1000;
+    return (elapsed >= PLAN_RUN_DURATION) ? 0 : PLAN_RUN_DURATION - elapsed;
+}
+
+/**
+ * Returns the shortest frame interval at which a run goes on long
+ * enough.
+ *
+ * @param[in] seconds
+ *   How long the run should go on, in seconds.
+ *
+ * @return
+ *   Returns the interval, in ms, from the interval in effect up to the
+ *   maximum frame interval setting, or 0 if none is long enough.
+ */
+uint32_t Planner::findInterval( const uint32_t seconds )
+{
+    // A longer interval never shortens the run, so search between the
+    // interval in effect and the maximum.
+    uint32_t shortest = getInterval( );
+    uint32_t longest  = getMaximumFrameInterval( );
+    if ( longest < shortest )
+        longest = shortest;
+    if ( getSeconds( longest ) < seconds )
+        return 0;
+    while ( shortest < longest )
+    {
+        const uint32_t middle = shortest + (longest - shortest) / 2;
+        if ( getSeconds( middle ) >= seconds )
+            longest = middle;
+        else
+            shortest = middle + 1;
+    }
+    return shortest;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Run.
+//----------------------------------------------------------------------
+/**
+ * Starts planning a new run, and checks that it fits.
+ *
+ * @return
+ *   Returns the check() result. The run should not start on
+ *   PLAN_TOO_SHORT.
+ *
+ * @see check()
+ */
+uint8_t Planner::startRun( )
+{
+    runStartTime = millis( );
+    checkTime    = runStartTime;
+    warned       = false;
+    Battery::startDischargeRate( );
+    return check( );
+}
+
+/**
+ * Adds the length of a running snap-and-log, for the laser duty.
+ *
+ * @param[in] ms
+ *   The length, in ms.
+ * @param[in] nImages
+ *   The number of images in its burst.
+ */
+void Planner::addSnap( const uint32_t ms, const uint8_t nImages )
+{
+    if ( snapTimeBurst != nImages )
+    {
+        snapTime      = ms;
+        snapTimeBurst = nImages;
+    }
+    else
+        snapTime += PLAN_SNAP_TIME_WEIGHT * (ms - snapTime);
+}
+
+/**
+ * Checks the run, if PLAN_CHECK_INTERVAL has passed since the most
+ * recent check.
+ *
+ * @see check()
+ */
+void Planner::update( )
+{
+    const uint32_t currentTime = millis( );
+    if ( (currentTime - checkTime) < PLAN_CHECK_INTERVAL )
+        return;
+    checkTime = currentTime;
+    check( );
+}
+
+/**
+ * Checks that the run goes on for what is left of PLAN_RUN_DURATION.
+ *
+ * If not, and ENABLE_PLAN_ADAPT is defined, the run's frame interval is
+ * lengthened so that it does. Otherwise a warning is printed and
+ * logged, once per run.
+ *
+ * @return
+ *   Returns one of the PLAN_* values.
+ */
+uint8_t Planner::check( )
+{
+    const uint32_t wanted = getSecondsWanted( );
+    const uint32_t interval = getInterval( );
+    if ( getSeconds( interval ) >= wanted )
+        return PLAN_FITS;
+
+    char message[128];
+#if defined(ENABLE_PLAN_ADAPT)
+    // The frame spacing and mission plan segments set their own
+    // intervals, so only a fixed frame interval is lengthened. The run
+    // takes the longer interval, not the setting.
+    const uint32_t fitting = findInterval( wanted );
+    if ( fitting != 0 && getFrameSpacing( ) <= 0.0 &&
+         Mission::getInterval( 0 ) == 0 )
+    {
+        setRunFrameInterval( fitting );
+        sprintf( message, "Frame interval lengthened to %ld ms so the run fits",
+            (long) fitting );
+        Serial.printf( "%s.\r\n", message );
+        FileSystem::writeStatus( message, FileSystem::STATUS_WARNING );
+        return PLAN_ADAPTED;
+    }
+#endif
+
+    // Even the longest interval may not leave room for a useful run.
+    const uint32_t longest = max( getMaximumFrameInterval( ), interval );
+    if ( getSoftwareStatus( ) != SOFTWARE_RUNNING &&
+         getSeconds( longest ) < PLAN_MINIMUM_DURATION )
+        return PLAN_TOO_SHORT;
+
+    if ( !warned )
+    {
+        static const char*const LIMITS[] = {
+            "", "SD card fills", "main battery runs low",
+            "controller battery runs low" };
+        warned = true;
+        sprintf( message, "Run may end in about %ld of %ld minutes, when the %s",
+            (long) (getSeconds( interval ) / 60),
+            (long) (wanted / 60),
+            LIMITS[getLimit( interval )] );
+        Serial.printf( "Warning: %s.\r\n", message );
+        FileSystem::writeStatus( message, FileSystem::STATUS_WARNING );
+    }
+    return PLAN_SHORT;
+}
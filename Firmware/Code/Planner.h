@@ -0,0 +1,266 @@
+#pragma once
+#include <Arduino.h>
+
+#include "pltlogger.h"
+
+
+/**
+ * Forecasts how long a run can go on, and plans its frame interval.
+ *
+ * A run is cut short when the SD card fills or a battery runs down. Both
+ * are forecast from what each frame costs at a given frame interval:
+ *
+ * - SD card space, from the free space counted by FileSystem and the
+ *   data log's bytes per row, times the burst size.
+ *
+ * - Main battery charge, from its drain. The camera and intensifier are
+ *   on for the whole run, but the laser is only on during snap-and-logs,
+ *   unless it is continuous. So the drain goes down as the frame interval
+ *   goes up.
+ *
+ * - Controller battery charge, from its measured drain, which does not
+ *   depend on the frame interval.
+ *
+ * Before a run, and every PLAN_CHECK_INTERVAL while it runs, check()
+ * compares the forecast with what is left of PLAN_RUN_DURATION. A run
+ * that would be cut short is warned about or, with ENABLE_PLAN_ADAPT, has
+ * its frame interval lengthened for the rest of the run so that it fits.
+ * See pltlogger.h.
+ *
+ * Forecasts that do not depend on a limit return UINT32_MAX seconds.
+ */
+class Planner
+{
+private:
+    Planner( ) = delete;
+    Planner( const Planner& ) = delete;
+    Planner& operator=( const Planner& ) = delete;
+
+
+//----------------------------------------------------------------------
+// Constants.
+//----------------------------------------------------------------------
+public:
+    // Results of check().
+    static const uint8_t PLAN_FITS      = 0; // The run fits.
+    static const uint8_t PLAN_ADAPTED   = 1; // The run fits at a longer interval.
+    static const uint8_t PLAN_SHORT     = 2; // The run will be cut short.
+    static const uint8_t PLAN_TOO_SHORT = 3; // Not even PLAN_MINIMUM_DURATION fits.
+
+    // Forecast limits. See getLimit().
+    static const uint8_t LIMIT_NONE       = 0;
+    static const uint8_t LIMIT_CARD       = 1;
+    static const uint8_t LIMIT_MAIN       = 2;
+    static const uint8_t LIMIT_CONTROLLER = 3;
+
+
+//----------------------------------------------------------------------
+// Fields.
+//----------------------------------------------------------------------
+private:
+    // The smoothed length of a running snap-and-log, in ms, and the burst
+    // size it was measured at, or 0 until measured.
+    static float snapTime;
+    static uint8_t snapTimeBurst;
+
+    // When the run started, and when it was most recently checked, in ms
+    // since boot.
+    static uint32_t runStartTime;
+    static uint32_t checkTime;
+
+    // Whether the run has been warned about being cut short.
+    static bool warned;
+
+
+//----------------------------------------------------------------------
+// Forecast.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Returns the frame interval in effect.
+     *
+     * While running, this is the scheduled interval, which follows the
+     * frame spacing, if any. Otherwise it is the frame interval setting.
+     *
+     * @return
+     *   Returns the interval, in ms.
+     */
+    static uint32_t getInterval( );
+
+    /**
+     * Returns the SD card space taken per data log row.
+     *
+     * @return
+     *   Returns the size, in bytes, as measured by FileSystem, or
+     *   DATA_LOG_PREALLOCATE_ROW_SIZE until measured.
+     *
+     * @see FileSystem::getBytesPerRow()
+     */
+    static uint32_t getBytesPerRow( );
+
+    /**
+     * Returns the number of frames that still fit on the SD card.
+     *
+     * @return
+     *   Returns the number of frames.
+     */
+    static uint32_t getCardFrames( );
+
+    /**
+     * Returns how long frames still fit on the SD card.
+     *
+     * @param[in] interval
+     *   The frame interval, in ms.
+     *
+     * @return
+     *   Returns the time, in seconds.
+     */
+    static uint32_t getCardSeconds( const uint32_t interval );
+
+    /**
+     * Returns the fraction of the time that the laser is on.
+     *
+     * @param[in] interval
+     *   The frame interval, in ms.
+     *
+     * @return
+     *   Returns the fraction, from 0 to 1.
+     */
+    static float getLaserDuty( const uint32_t interval );
+
+    /**
+     * Returns the main battery's drain.
+     *
+     * @param[in] interval
+     *   The frame interval, in ms.
+     *
+     * @return
+     *   Returns the drain, in percent per hour.
+     *
+     * @see isMainDrainMeasured()
+     */
+    static float getMainDrain( const uint32_t interval );
+
+    /**
+     * Returns true if the main battery's drain is measured, rather than
+     * only modeled.
+     *
+     * @return
+     *   Returns true if measured.
+     */
+    static bool isMainDrainMeasured( );
+
+    /**
+     * Returns how long the main battery lasts.
+     *
+     * @param[in] interval
+     *   The frame interval, in ms.
+     *
+     * @return
+     *   Returns the time, in seconds.
+     */
+    static uint32_t getMainSeconds( const uint32_t interval );
+
+    /**
+     * Returns how long the controller battery lasts.
+     *
+     * @return
+     *   Returns the time, in seconds, or UINT32_MAX until its drain is
+     *   measured.
+     */
+    static uint32_t getControllerSeconds( );
+
+    /**
+     * Returns how long a run can go on.
+     *
+     * @param[in] interval
+     *   The frame interval, in ms.
+     *
+     * @return
+     *   Returns the time, in seconds.
+     *
+     * @see getLimit()
+     */
+    static uint32_t getSeconds( const uint32_t interval );
+
+    /**
+     * Returns what limits how long a run can go on.
+     *
+     * @param[in] interval
+     *   The frame interval, in ms.
+     *
+     * @return
+     *   Returns one of the LIMIT_* values.
+     *
+     * @see getSeconds()
+     */
+    static uint8_t getLimit( const uint32_t interval );
+
+    /**
+     * Returns how long the run is still expected to go on.
+     *
+     * @return
+     *   Returns the time, in seconds, PLAN_RUN_DURATION less the time
+     *   already run.
+     */
+    static uint32_t getSecondsWanted( );
+
+    /**
+     * Returns the shortest frame interval at which a run goes on long
+     * enough.
+     *
+     * @param[in] seconds
+     *   How long the run should go on, in seconds.
+     *
+     * @return
+     *   Returns the interval, in ms, from the interval in effect up to the
+     *   maximum frame interval setting, or 0 if none is long enough.
+     */
+    static uint32_t findInterval( const uint32_t seconds );
+
+
+//----------------------------------------------------------------------
+// Run.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Starts planning a new run, and checks that it fits.
+     *
+     * @return
+     *   Returns the check() result. The run should not start on
+     *   PLAN_TOO_SHORT.
+     *
+     * @see check()
+     */
+    static uint8_t startRun( );
+
+    /**
+     * Adds the length of a running snap-and-log, for the laser duty.
+     *
+     * @param[in] ms
+     *   The length, in ms.
+     * @param[in] nImages
+     *   The number of images in its burst.
+     */
+    static void addSnap( const uint32_t ms, const uint8_t nImages );
+
+    /**
+     * Checks the run, if PLAN_CHECK_INTERVAL has passed since the most
+     * recent check.
+     *
+     * @see check()
+     */
+    static void update( );
+
+    /**
+     * Checks that the run goes on for what is left of PLAN_RUN_DURATION.
+     *
+     * If not, and ENABLE_PLAN_ADAPT is defined, the run's frame interval is
+     * lengthened so that it does. Otherwise a warning is printed and
+     * logged, once per run.
+     *
+     * @return
+     *   Returns one of the PLAN_* values.
+     */
+    static uint8_t check( );
+};
@@ -1,6 +1,522 @@
 #include "Sensors.h"
+#include "Perf.h"
 
 Adafruit_LSM9DS1 Sensors::inertiaSensor;
 MS5837 Sensors::pressureSensor;
 TSYS01 Sensors::temperatureSensor;
 uint8_t Sensors::initialized = 0;
+
+uint16_t Sensors::pressureCoefficients[Sensors::PRESSURE_PROM_WORDS];
+uint16_t Sensors::temperatureCoefficients[8];
+float Sensors::waterDensity = Sensors::SALTWATER;
+
+uint8_t Sensors::pressureState = Sensors::CONVERSION_IDLE;
+uint32_t Sensors::pressureStateTime = 0;
+uint32_t Sensors::pressureD1 = 0;
+float Sensors::waterPressure = 0.0;
+float Sensors::waterDepth = 0.0;
+
+uint8_t Sensors::temperatureState = Sensors::CONVERSION_IDLE;
+uint32_t Sensors::temperatureStateTime = 0;
+float Sensors::waterTemperature = 0.0;
+
+#if defined(ENABLE_IMU_FIFO)
+uint8_t Sensors::inertiaFifoCount = 0;
+uint32_t Sensors::inertiaFifoTime = 0;
+float Sensors::inertiaAccel[3];
+float Sensors::inertiaGyro[3];
+
+uint32_t Sensors::inertiaFrame = 0;
+uint32_t Sensors::numberOfInertiaSamples = 0;
+uint32_t Sensors::numberOfInertiaOverruns = 0;
+float Sensors::accelSum[3];
+float Sensors::accelSumOfSquares[3];
+float Sensors::accelMin[3];
+float Sensors::accelMax[3];
+float Sensors::gyroSum[3];
+float Sensors::gyroSumOfSquares[3];
+float Sensors::gyroMin[3];
+float Sensors::gyroMax[3];
+#endif
+
+
+
+
+
+//----------------------------------------------------------------------
+// Methods.
+//----------------------------------------------------------------------
+/**
+ * Advances a water pressure and depth reading without waiting.
+ *
+ * @return
+ *   Returns true if the reading is complete, or there is none in
+ *   progress.
+ *
+ * @see getWaterPressure()
+ * @see startWaterPressure()
+ */
+bool Sensors::updateWaterPressure( )
+{
+    // Each step's I2C work is timed.
+    uint32_t t;
+    switch ( pressureState )
+    {
+        default:
+        case CONVERSION_IDLE:
+        case CONVERSION_DONE:
+            return true;
+
+        case CONVERSION_D1:
+            // When the pressure conversion is done, save it and start
+            // the temperature conversion.
+            if ( (millis( ) - pressureStateTime) < PRESSURE_CONVERSION_TIME )
+                return false;
+            t = micros( );
+            pressureD1 = readAdc( PRESSURE_ADDRESS, PRESSURE_ADC_READ );
+            sendCommand( PRESSURE_ADDRESS, PRESSURE_CONVERT_D2 );
+            Perf::record( Perf::STAGE_PRESSURE, t );
+            pressureState = CONVERSION_D2;
+            pressureStateTime = millis( );
+            return false;
+
+        case CONVERSION_D2:
+            if ( (millis( ) - pressureStateTime) < PRESSURE_CONVERSION_TIME )
+                return false;
+            t = micros( );
+            computeWaterPressure( pressureD1,
+                readAdc( PRESSURE_ADDRESS, PRESSURE_ADC_READ ) );
+            Perf::record( Perf::STAGE_PRESSURE, t );
+            pressureState = CONVERSION_DONE;
+            return true;
+    }
+}
+
+/**
+ * Advances a water temperature reading without waiting.
+ *
+ * @return
+ *   Returns true if the reading is complete, or there is none in
+ *   progress.
+ *
+ * @see getWaterTemperature()
+ * @see startWaterTemperature()
+ */
+bool Sensors::updateWaterTemperature( )
+{
+    if ( temperatureState != CONVERSION_D1 )
+        return true;
+    if ( (millis( ) - temperatureStateTime) < TEMPERATURE_CONVERSION_TIME )
+        return false;
+
+    // Convert with the datasheet's 4th order polynomial, using the 16
+    // most significant bits of the 24-bit result.
+    const uint32_t t = micros( );
+    const float adc = readAdc( TEMPERATURE_ADDRESS, TEMPERATURE_ADC_READ ) / 256;
+    const uint16_t* k = temperatureCoefficients;
+    waterTemperature =
+        -2.0 * k[1] / 1.0e21 * adc * adc * adc * adc +
+         4.0 * k[2] / 1.0e16 * adc * adc * adc +
+        -2.0 * k[3] / 1.0e11 * adc * adc +
+         1.0 * k[4] / 1.0e6  * adc +
+        -1.5 * k[5] / 1.0e2;
+    Perf::record( Perf::STAGE_TEMPERATURE, t );
+    temperatureState = CONVERSION_DONE;
+    return true;
+}
+
+
+
+
+
+#if defined(ENABLE_IMU_FIFO)
+//----------------------------------------------------------------------
+// Inertia FIFO.
+//----------------------------------------------------------------------
+/**
+ * Reads the next accelerometer and gyroscope sample from the inertia
+ * module's FIFO.
+ *
+ * The sample is added to the running statistics for the current frame.
+ * Call this until it returns false to drain the FIFO.
+ *
+ * @param[out] accel
+ *   A 3-element array returning acceleration values for X, Y, and Z,
+ *   in m/s^2.
+ * @param[out] gyro
+ *   A 3-element array returning angular velocity values for X, Y,
+ *   and Z, in rad/s.
+ * @param[out] time
+ *   The returned approximate time of the sample, in ms since boot.
+ *
+ * @return
+ *   Returns false if the FIFO is empty.
+ *
+ * @see getInertiaStats()
+ * @see isInertiaFifoDue()
+ */
+bool Sensors::readInertiaSample( float* accel, float* gyro, uint32_t& time )
+{
+    if ( !isInertiaSensorPresent( ) )
+        return false;
+
+    // Check how many samples are waiting only once per drain. The samples
+    // are not time stamped, so they are assumed to be evenly spaced at the
+    // sample rate, with the newest sample taken just now.
+    if ( inertiaFifoCount == 0 )
+    {
+        uint8_t source = 0;
+        inertiaFifoTime = millis( );
+        if ( !readInertiaRegisters( INERTIA_FIFO_SRC, &source, 1 ) )
+            return false;
+        if ( (source & INERTIA_FIFO_OVERRUN) != 0 )
+            ++numberOfInertiaOverruns;
+        inertiaFifoCount = source & INERTIA_FIFO_COUNT_MASK;
+        if ( inertiaFifoCount == 0 )
+            return false;
+    }
+
+    // Each FIFO level holds a gyroscope and an accelerometer sample. The
+    // FIFO advances once both have been read.
+    uint8_t g[6];
+    uint8_t a[6];
+    const bool status =
+        readInertiaRegisters( INERTIA_OUT_X_L_G, g, sizeof( g ) ) &&
+        readInertiaRegisters( INERTIA_OUT_X_L_XL, a, sizeof( a ) );
+    --inertiaFifoCount;
+    if ( !status )
+    {
+        inertiaFifoCount = 0;
+        return false;
+    }
+    time = inertiaFifoTime - (uint32_t) inertiaFifoCount * 1000 / INERTIA_FIFO_RATE;
+
+    // Convert to the same units as getInertia(), using the ranges set
+    // by init().
+    for ( uint8_t i = 0; i < 3; ++i )
+    {
+        const int16_t ga = (int16_t) (g[i * 2] | (g[i * 2 + 1] << 8));
+        const int16_t aa = (int16_t) (a[i * 2] | (a[i * 2 + 1] << 8));
+        accel[i] = aa * LSM9DS1_ACCEL_MG_LSB_2G / 1000.0 * SENSORS_GRAVITY_STANDARD;
+        gyro[i]  = ga * LSM9DS1_GYRO_DPS_DIGIT_245DPS * SENSORS_DPS_TO_RADS;
+        inertiaAccel[i] = accel[i];
+        inertiaGyro[i]  = gyro[i];
+
+        accelSum[i] += accel[i];
+        accelSumOfSquares[i] += accel[i] * accel[i];
+        gyroSum[i] += gyro[i];
+        gyroSumOfSquares[i] += gyro[i] * gyro[i];
+        if ( numberOfInertiaSamples == 0 || accel[i] < accelMin[i] )
+            accelMin[i] = accel[i];
+        if ( numberOfInertiaSamples == 0 || accel[i] > accelMax[i] )
+            accelMax[i] = accel[i];
+        if ( numberOfInertiaSamples == 0 || gyro[i] < gyroMin[i] )
+            gyroMin[i] = gyro[i];
+        if ( numberOfInertiaSamples == 0 || gyro[i] > gyroMax[i] )
+            gyroMax[i] = gyro[i];
+    }
+    ++numberOfInertiaSamples;
+    return true;
+}
+
+/**
+ * Returns the statistics for the current frame and starts the next.
+ *
+ * @param[out] stats
+ *   The returned statistics. All values are zero if there were no
+ *   samples.
+ *
+ * @see getInertiaFrame()
+ * @see readInertiaSample()
+ * @see resetInertiaStats()
+ */
+void Sensors::getInertiaStats( InertiaStats& stats )
+{
+    memset( &stats, 0, sizeof( stats ) );
+    stats.numberOfSamples  = numberOfInertiaSamples;
+    stats.numberOfOverruns = numberOfInertiaOverruns;
+    if ( numberOfInertiaSamples != 0 )
+    {
+        for ( uint8_t i = 0; i < 3; ++i )
+        {
+            stats.accelMean[i] = accelSum[i] / numberOfInertiaSamples;
+            stats.accelMin[i]  = accelMin[i];
+            stats.accelMax[i]  = accelMax[i];
+            stats.accelRms[i]  = sqrt( accelSumOfSquares[i] / numberOfInertiaSamples );
+            stats.gyroMean[i]  = gyroSum[i] / numberOfInertiaSamples;
+            stats.gyroMin[i]   = gyroMin[i];
+            stats.gyroMax[i]   = gyroMax[i];
+            stats.gyroRms[i]   = sqrt( gyroSumOfSquares[i] / numberOfInertiaSamples );
+        }
+    }
+
+    clearInertiaStats( );
+    ++inertiaFrame;
+}
+
+/**
+ * Discards the running statistics and restarts frame numbering.
+ *
+ * Samples still in the FIFO are discarded as well.
+ *
+ * @see getInertiaStats()
+ */
+void Sensors::resetInertiaStats( )
+{
+    float accel[3];
+    float gyro[3];
+    uint32_t time;
+    while ( readInertiaSample( accel, gyro, time ) )
+        ;
+    clearInertiaStats( );
+    inertiaFrame = 0;
+}
+
+/**
+ * Configures the inertia module to buffer samples in its FIFO.
+ *
+ * @see readInertiaSample()
+ */
+void Sensors::startInertiaFifo( )
+{
+    // Set the gyroscope's output data rate, keeping its range. The
+    // accelerometer runs at the same rate while the gyroscope is on.
+    uint8_t ctrl = 0;
+    readInertiaRegisters( INERTIA_CTRL_REG1_G, &ctrl, 1 );
+    writeInertiaRegister( INERTIA_CTRL_REG1_G,
+        (ctrl & ~INERTIA_ODR_MASK) | INERTIA_ODR_119HZ );
+
+    // Enable the FIFO in continuous mode, which overwrites the oldest
+    // samples if it is not drained in time.
+    readInertiaRegisters( INERTIA_CTRL_REG9, &ctrl, 1 );
+    writeInertiaRegister( INERTIA_CTRL_REG9, ctrl | INERTIA_FIFO_EN );
+    writeInertiaRegister( INERTIA_FIFO_CTRL, INERTIA_FIFO_CONTINUOUS );
+
+    inertiaFifoCount = 0;
+    inertiaFifoTime  = millis( );
+    for ( uint8_t i = 0; i < 3; ++i )
+    {
+        inertiaAccel[i] = 0.0;
+        inertiaGyro[i]  = 0.0;
+    }
+    clearInertiaStats( );
+    inertiaFrame = 0;
+}
+
+/**
+ * Discards the running statistics, without changing the frame number.
+ */
+void Sensors::clearInertiaStats( )
+{
+    numberOfInertiaSamples  = 0;
+    numberOfInertiaOverruns = 0;
+    for ( uint8_t i = 0; i < 3; ++i )
+    {
+        accelSum[i]          = 0.0;
+        accelSumOfSquares[i] = 0.0;
+        gyroSum[i]           = 0.0;
+        gyroSumOfSquares[i]  = 0.0;
+    }
+}
+#endif
+
+
+
+
+
+//----------------------------------------------------------------------
+// I2C.
+//----------------------------------------------------------------------
+/**
+ * Reads a sensor's 24-bit conversion result.
+ *
+ * @param[in] address
+ *   The sensor's I2C address.
+ * @param[in] command
+ *   The ADC read command.
+ *
+ * @return
+ *   Returns the result, or zero on failure.
+ */
+uint32_t Sensors::readAdc( const uint8_t address, const uint8_t command )
+{
+    if ( !sendCommand( address, command ) ||
+         Wire.requestFrom( address, (uint8_t) 3 ) != 3 )
+        return 0;
+
+    uint32_t value = Wire.read( );
+    value = (value << 8) | Wire.read( );
+    value = (value << 8) | Wire.read( );
+    return value;
+}
+
+/**
+ * Reads a sensor's 16-bit calibration coefficients.
+ *
+ * @param[in] address
+ *   The sensor's I2C address.
+ * @param[in] command
+ *   The first PROM read command.
+ * @param[out] coefficients
+ *   The returned coefficients.
+ * @param[in] nCoefficients
+ *   The number of coefficients to read.
+ *
+ * @return
+ *   Returns true on success and false on failure.
+ */
+bool Sensors::readCoefficients(
+    const uint8_t address,
+    const uint8_t command,
+    uint16_t* coefficients,
+    const uint8_t nCoefficients )
+{
+    for ( uint8_t i = 0; i < nCoefficients; ++i )
+    {
+        if ( !sendCommand( address, command + i * 2 ) ||
+             Wire.requestFrom( address, (uint8_t) 2 ) != 2 )
+            return false;
+        coefficients[i] = Wire.read( ) << 8;
+        coefficients[i] |= Wire.read( );
+    }
+    return true;
+}
+
+#if defined(ENABLE_IMU_FIFO)
+/**
+ * Reads consecutive inertia module registers.
+ *
+ * @param[in] reg
+ *   The first register.
+ * @param[out] bytes
+ *   The returned register values.
+ * @param[in] nBytes
+ *   The number of registers to read.
+ *
+ * @return
+ *   Returns true on success and false on failure.
+ */
+bool Sensors::readInertiaRegisters(
+    const uint8_t reg,
+    uint8_t* bytes,
+    const uint8_t nBytes )
+{
+    if ( !sendCommand( INERTIA_ADDRESS, reg ) ||
+         Wire.requestFrom( INERTIA_ADDRESS, nBytes ) != nBytes )
+        return false;
+    for ( uint8_t i = 0; i < nBytes; ++i )
+        bytes[i] = Wire.read( );
+    return true;
+}
+#endif
+
+/**
+ * Computes the water pressure and depth from raw conversions.
+ *
+ * @param[in] d1
+ *   The raw pressure conversion.
+ * @param[in] d2
+ *   The raw temperature conversion.
+ */
+void Sensors::computeWaterPressure( const uint32_t d1, const uint32_t d2 )
+{
+    // Depth is from the pressure above one standard atmosphere.
+    waterPressure = convertPressure( pressureCoefficients, d1, d2 ) / 10.0;
+    waterDepth    = (waterPressure * 100.0 - 101300.0) / (waterDensity * 9.80665);
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Pressure conversion.
+//----------------------------------------------------------------------
+/**
+ * Checks the pressure sensor's calibration against the CRC in its
+ * first PROM word.
+ *
+ * This follows the MS5837-30BA datasheet's CRC4, over the seven PROM
+ * words with the CRC itself taken as zero.
+ *
+ * @param[in] c
+ *   The 7 coefficients.
+ *
+ * @return
+ *   Returns true if the CRC matches.
+ */
+bool Sensors::checkPressureCrc( const uint16_t* c )
+{
+    uint16_t remainder = 0;
+    for ( uint8_t i = 0; i < 16; ++i )
+    {
+        // The eighth word is not in the PROM and counts as zero.
+        uint16_t word = 0;
+        if ( i / 2 == 0 )
+            word = c[0] & 0x0FFF;
+        else if ( i / 2 < PRESSURE_PROM_WORDS )
+            word = c[i / 2];
+        remainder ^= ((i % 2) == 0) ? (word >> 8) : (word & 0x00FF);
+
+        for ( uint8_t bit = 0; bit < 8; ++bit )
+        {
+            if ( (remainder & 0x8000) != 0 )
+                remainder = (remainder << 1) ^ 0x3000;
+            else
+                remainder <<= 1;
+        }
+    }
+    return ((remainder >> 12) & 0x000F) == (c[0] >> 12);
+}
+
+/**
+ * Converts raw pressure sensor conversions to pressure.
+ *
+ * This follows the MS5837-30BA datasheet, including its second
+ * order temperature compensation.
+ *
+ * @param[in] c
+ *   The 7 coefficients.
+ * @param[in] d1
+ *   The raw pressure conversion.
+ * @param[in] d2
+ *   The raw temperature conversion.
+ *
+ * @return
+ *   Returns the pressure, in 0.1 mbar.
+ */
+int32_t Sensors::convertPressure(
+    const uint16_t* c,
+    const uint32_t d1,
+    const uint32_t d2 )
+{
+    // First order.
+    const int32_t dT = (int32_t) d2 - (int32_t) ((uint32_t) c[5] * 256);
+    int64_t sens = (int64_t) c[1] * 32768 + ((int64_t) c[3] * dT) / 256;
+    int64_t off  = (int64_t) c[2] * 65536 + ((int64_t) c[4] * dT) / 128;
+    const int32_t temp = 2000 + ((int64_t) dT * c[6]) / 8388608;
+
+    // Second order, for low and high temperatures.
+    const int64_t t2000 = (int64_t) temp - 2000;
+    int64_t offi, sensi;
+    if ( temp < 2000 )
+    {
+        offi  = 3 * t2000 * t2000 / 2;
+        sensi = 5 * t2000 * t2000 / 8;
+        if ( temp < -1500 )
+        {
+            const int64_t t1500 = (int64_t) temp + 1500;
+            offi  += 7 * t1500 * t1500;
+            sensi += 4 * t1500 * t1500;
+        }
+    }
+    else
+    {
+        offi  = t2000 * t2000 / 16;
+        sensi = 0;
+    }
+    off  -= offi;
+    sens -= sensi;
+
+    return (((int64_t) d1 * sens) / 2097152 - off) / 8192;
+}
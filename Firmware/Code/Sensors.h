@@ -4,6 +4,7 @@
 #include <Adafruit_LSM9DS1.h>   // Gyroscope, Accelerometer, & Magnetometer
 #include <MS5837.h>             // Pressure, depth, and temperature sensor
 #include <TSYS01.h>             // Temperature sensor
+#include <Wire.h>
 
 #include "pltlogger.h"
 
@@ -59,6 +60,58 @@ public:
     static const uint8_t ALL_INITIALIZED =
         (INERTIA_INITIALIZED | PRESSURE_INITIALIZED | TEMPERATURE_INITIALIZED);
 
+private:
+    // Pressure sensor I2C address, commands, and the conversion time at
+    // the highest oversampling ratio (8192).
+    static const uint8_t PRESSURE_ADDRESS         = 0x76;
+    static const uint8_t PRESSURE_CONVERT_D1      = 0x4A;
+    static const uint8_t PRESSURE_CONVERT_D2      = 0x5A;
+    static const uint8_t PRESSURE_ADC_READ        = 0x00;
+    static const uint8_t PRESSURE_PROM_READ       = 0xA0;
+    static const uint8_t PRESSURE_CONVERSION_TIME = 20; // ms
+
+    // Pressure sensor PROM words. The first holds the CRC.
+    static const uint8_t PRESSURE_PROM_WORDS      = 7;
+
+    // Temperature sensor I2C address, commands, and conversion time.
+    static const uint8_t TEMPERATURE_ADDRESS         = 0x77;
+    static const uint8_t TEMPERATURE_CONVERT         = 0x48;
+    static const uint8_t TEMPERATURE_ADC_READ        = 0x00;
+    static const uint8_t TEMPERATURE_PROM_READ       = 0xA0;
+    static const uint8_t TEMPERATURE_CONVERSION_TIME = 10; // ms
+
+#if defined(ENABLE_IMU_FIFO)
+    // Inertia module accelerometer and gyroscope I2C address, and the
+    // registers and values used for FIFO capture.
+    static const uint8_t INERTIA_ADDRESS          = 0x6B;
+    static const uint8_t INERTIA_CTRL_REG1_G      = 0x10;
+    static const uint8_t INERTIA_OUT_X_L_G        = 0x18;
+    static const uint8_t INERTIA_CTRL_REG9        = 0x23;
+    static const uint8_t INERTIA_OUT_X_L_XL       = 0x28;
+    static const uint8_t INERTIA_FIFO_CTRL        = 0x2E;
+    static const uint8_t INERTIA_FIFO_SRC         = 0x2F;
+    static const uint8_t INERTIA_ODR_MASK         = 0xE0; // CTRL_REG1_G
+    static const uint8_t INERTIA_ODR_119HZ        = 0x60; // CTRL_REG1_G
+    static const uint8_t INERTIA_FIFO_EN          = 0x02; // CTRL_REG9
+    static const uint8_t INERTIA_FIFO_CONTINUOUS  = 0xC0; // FIFO_CTRL
+    static const uint8_t INERTIA_FIFO_COUNT_MASK  = 0x3F; // FIFO_SRC
+    static const uint8_t INERTIA_FIFO_OVERRUN     = 0x40; // FIFO_SRC
+
+public:
+    // Inertia module sample rate for FIFO capture. The 32-sample FIFO
+    // holds about 270 ms of samples at this rate.
+    static const uint16_t INERTIA_FIFO_RATE = 119; // Hz
+
+private:
+#endif
+
+    // Conversion state. The temperature sensor has only one conversion,
+    // which uses CONVERSION_D1.
+    static const uint8_t CONVERSION_IDLE        = 0;
+    static const uint8_t CONVERSION_D1          = 1;
+    static const uint8_t CONVERSION_D2          = 2;
+    static const uint8_t CONVERSION_DONE        = 3;
+
 
 //----------------------------------------------------------------------
 // Fields.
@@ -69,6 +122,47 @@ private:
     static TSYS01 temperatureSensor;
     static uint8_t initialized;
 
+    // Factory calibration coefficients read from each sensor's PROM.
+    static uint16_t pressureCoefficients[PRESSURE_PROM_WORDS];
+    static uint16_t temperatureCoefficients[8];
+    static float waterDensity;
+
+    // Pressure conversion in progress, if any. The MS5837 converts
+    // pressure (D1) and then its own temperature (D2), which is needed
+    // to compensate the pressure.
+    static uint8_t pressureState;
+    static uint32_t pressureStateTime;
+    static uint32_t pressureD1;
+    static float waterPressure;
+    static float waterDepth;
+
+    // Temperature conversion in progress, if any.
+    static uint8_t temperatureState;
+    static uint32_t temperatureStateTime;
+    static float waterTemperature;
+
+#if defined(ENABLE_IMU_FIFO)
+    // FIFO capture state. The number of samples known to be in the FIFO,
+    // when it was last checked, and the most recent sample.
+    static uint8_t inertiaFifoCount;
+    static uint32_t inertiaFifoTime;
+    static float inertiaAccel[3];
+    static float inertiaGyro[3];
+
+    // Running statistics since the previous frame.
+    static uint32_t inertiaFrame;
+    static uint32_t numberOfInertiaSamples;
+    static uint32_t numberOfInertiaOverruns;
+    static float accelSum[3];
+    static float accelSumOfSquares[3];
+    static float accelMin[3];
+    static float accelMax[3];
+    static float gyroSum[3];
+    static float gyroSumOfSquares[3];
+    static float gyroMin[3];
+    static float gyroMax[3];
+#endif
+
 
 //----------------------------------------------------------------------
 // Initialization.
@@ -92,9 +186,12 @@ public:
      * @see FRESHWATER
      * @see SALTWATER
      */
-    static inline bool init( const float waterDensity = SALTWATER )
+    static inline bool init( const float density = SALTWATER )
     {
         initialized = 0;
+        waterDensity = density;
+        pressureState = CONVERSION_IDLE;
+        temperatureState = CONVERSION_IDLE;
 
         // Inertia sensor. Initialize the library and report failure.
         // Use the default pin assignments.
@@ -109,6 +206,12 @@ public:
             // Use a 245 degrees/second range for the gyroscope.
             inertiaSensor.setupGyro( inertiaSensor.LSM9DS1_GYROSCALE_245DPS );
 
+#if defined(ENABLE_IMU_FIFO)
+            // Drain the FIFO as quickly as the bus allows.
+            Wire.setClock( 400000 );
+            startInertiaFifo( );
+#endif
+
             initialized |= INERTIA_INITIALIZED;
         }
 #if defined(DEBUG_VERBOSE_SENSORS)
@@ -128,7 +231,13 @@ public:
             // Set pressure sensor fluid density.
             pressureSensor.setFluidDensity( waterDensity );
 
-            initialized |= PRESSURE_INITIALIZED;
+            // The library reads the sensor with built-in delays, so
+            // read the calibration for use by our own conversions, and
+            // check it.
+            if ( readCoefficients( PRESSURE_ADDRESS, PRESSURE_PROM_READ,
+                    pressureCoefficients, PRESSURE_PROM_WORDS ) &&
+                 checkPressureCrc( pressureCoefficients ) )
+                initialized |= PRESSURE_INITIALIZED;
         }
 #if defined(DEBUG_VERBOSE_SENSORS)
         if ( (initialized & PRESSURE_INITIALIZED) != 0 )
@@ -143,7 +252,9 @@ public:
         temperatureSensor.init( );
         temperatureSensor.read( );
         const float temp = temperatureSensor.temperature( );
-        if ( temp > BAD_WATER_TEMPERATURE )
+        if ( temp > BAD_WATER_TEMPERATURE &&
+             readCoefficients( TEMPERATURE_ADDRESS, TEMPERATURE_PROM_READ,
+                temperatureCoefficients, 8 ) )
             initialized |= TEMPERATURE_INITIALIZED;
 #if defined(DEBUG_VERBOSE_SENSORS)
         if ( (initialized & TEMPERATURE_INITIALIZED) != 0 )
@@ -277,7 +388,12 @@ public:
      * @param[out] temp
      *   The returned device temperature, in Celsius.
      *
+     * If ENABLE_IMU_FIFO is defined, the acceleration and gyroscope values
+     * are the most recent sample drained from the FIFO. Reading the module
+     * directly would take a sample out of the FIFO.
+     *
      * @see isInertiaSensorPresent()
+     * @see readInertiaSample()
      * @see https://www.arduino.cc/en/Reference/ArduinoLSM9DS1
      */
     static inline void getInertia(
@@ -301,6 +417,22 @@ public:
             return;
         }
 
+#if defined(ENABLE_IMU_FIFO)
+        // Read the magnetometer and temperature only.
+        inertiaSensor.readMag( );
+        inertiaSensor.readTemp( );
+        for ( uint8_t i = 0; i < 3; ++i )
+        {
+            accel[i] = inertiaAccel[i];
+            gyro[i]  = inertiaGyro[i];
+        }
+        mag[0] = inertiaSensor.magData.x * LSM9DS1_MAG_MGAUSS_4GAUSS / 1000.0;
+        mag[1] = inertiaSensor.magData.y * LSM9DS1_MAG_MGAUSS_4GAUSS / 1000.0;
+        mag[2] = inertiaSensor.magData.z * LSM9DS1_MAG_MGAUSS_4GAUSS / 1000.0;
+
+        // Convert from the module's raw temperature units to Celsius.
+        temp = inertiaSensor.temperature / 16.0 + 27.5;
+#else
         // Read the sensor.
         sensors_event_t a, m, g, t;
         inertiaSensor.getEvent( &a, &m, &g, &t );
@@ -319,6 +451,7 @@ public:
 
         // Convert from the module's raw temperature units to Celsius.
         temp = t.temperature / 16.0 + 27.5;
+#endif
 #if defined(DEBUG_VERBOSE_SENSORS)
         Serial.printf( "Debug: Inertia read: accel=(%f,%f,%f)\r\n",
             accel[0], accel[1], accel[2] );
@@ -330,16 +463,184 @@ public:
 #endif
     }
 
+#if defined(ENABLE_IMU_FIFO)
+    /**
+     * Returns true if it is time to drain the inertia module's FIFO.
+     *
+     * @return
+     *   Returns true if IMU_FIFO_DRAIN_INTERVAL has elapsed since the FIFO
+     *   was last checked.
+     *
+     * @see readInertiaSample()
+     */
+    static inline bool isInertiaFifoDue( )
+    {
+        return isInertiaSensorPresent( ) &&
+            (millis( ) - inertiaFifoTime) >= IMU_FIFO_DRAIN_INTERVAL;
+    }
+
+    /**
+     * Reads the next accelerometer and gyroscope sample from the inertia
+     * module's FIFO.
+     *
+     * The sample is added to the running statistics for the current frame.
+     * Call this until it returns false to drain the FIFO.
+     *
+     * @param[out] accel
+     *   A 3-element array returning acceleration values for X, Y, and Z,
+     *   in m/s^2.
+     * @param[out] gyro
+     *   A 3-element array returning angular velocity values for X, Y,
+     *   and Z, in rad/s.
+     * @param[out] time
+     *   The returned approximate time of the sample, in ms since boot.
+     *
+     * @return
+     *   Returns false if the FIFO is empty.
+     *
+     * @see getInertiaStats()
+     * @see isInertiaFifoDue()
+     */
+    static bool readInertiaSample( float* accel, float* gyro, uint32_t& time );
+
+    /**
+     * Returns the statistics for the current frame and starts the next.
+     *
+     * @param[out] stats
+     *   The returned statistics. All values are zero if there were no
+     *   samples.
+     *
+     * @see getInertiaFrame()
+     * @see readInertiaSample()
+     * @see resetInertiaStats()
+     */
+    static void getInertiaStats( InertiaStats& stats );
+
+    /**
+     * Returns the current frame number.
+     *
+     * Frames are counted from zero by getInertiaStats() since the last
+     * resetInertiaStats(). Samples read now are part of the statistics for
+     * this frame.
+     *
+     * @return
+     *   The frame number.
+     *
+     * @see getInertiaStats()
+     */
+    static inline uint32_t getInertiaFrame( )
+    {
+        return inertiaFrame;
+    }
+
+    /**
+     * Discards the running statistics and restarts frame numbering.
+     *
+     * Samples still in the FIFO are discarded as well.
+     *
+     * @see getInertiaStats()
+     */
+    static void resetInertiaStats( );
+
+private:
+    /**
+     * Configures the inertia module to buffer samples in its FIFO.
+     *
+     * @see readInertiaSample()
+     */
+    static void startInertiaFifo( );
+
+    /**
+     * Discards the running statistics, without changing the frame number.
+     */
+    static void clearInertiaStats( );
+
+    /**
+     * Writes an inertia module register.
+     *
+     * @param[in] reg
+     *   The register.
+     * @param[in] value
+     *   The value.
+     */
+    static inline void writeInertiaRegister( const uint8_t reg, const uint8_t value )
+    {
+        Wire.beginTransmission( INERTIA_ADDRESS );
+        Wire.write( reg );
+        Wire.write( value );
+        Wire.endTransmission( );
+    }
+
+    /**
+     * Reads consecutive inertia module registers.
+     *
+     * @param[in] reg
+     *   The first register.
+     * @param[out] bytes
+     *   The returned register values.
+     * @param[in] nBytes
+     *   The number of registers to read.
+     *
+     * @return
+     *   Returns true on success and false on failure.
+     */
+    static bool readInertiaRegisters(
+        const uint8_t reg,
+        uint8_t* bytes,
+        const uint8_t nBytes );
+
+public:
+#endif
+
+    /**
+     * Starts a water pressure and depth reading.
+     *
+     * The pressure sensor takes about 40 ms to convert a reading. This
+     * starts the conversion and returns immediately. Use
+     * updateWaterPressure() to advance it without waiting, and
+     * getWaterPressure() to get the result. Nothing is done if a reading
+     * is already in progress.
+     *
+     * @see getWaterPressure()
+     * @see updateWaterPressure()
+     */
+    static inline void startWaterPressure( )
+    {
+        if ( !isPressureSensorPresent( ) || pressureState != CONVERSION_IDLE )
+            return;
+
+        sendCommand( PRESSURE_ADDRESS, PRESSURE_CONVERT_D1 );
+        pressureState = CONVERSION_D1;
+        pressureStateTime = millis( );
+    }
+
+    /**
+     * Advances a water pressure and depth reading without waiting.
+     *
+     * @return
+     *   Returns true if the reading is complete, or there is none in
+     *   progress.
+     *
+     * @see getWaterPressure()
+     * @see startWaterPressure()
+     */
+    static bool updateWaterPressure( );
+
     /**
      * Returns the current water pressure and depth.
      *
+     * If a reading was started by startWaterPressure(), this waits for
+     * it to complete, if needed, and returns it. Otherwise a new reading
+     * is made, which can take up to 40 ms.
+     *
      * @param[out] pressure
      *   The returned pressure, in mbar.
      * @param[out] depth
      *   The returned depth, in meters.
      *
      * @see isPressureSensorPresent()
-     * @see https://github.com/bluerobotics/BlueRobotics_MS5837_Library
+     * @see startWaterPressure()
+     * @see updateWaterPressure()
      */
     static inline void getWaterPressure( float& pressure, float& depth )
     {
@@ -351,11 +652,13 @@ public:
             return;
         }
 
-        // Read the sensor. Can take up to 40ms.
-        pressureSensor.read( );
+        startWaterPressure( );
+        while ( !updateWaterPressure( ) )
+            delay( 1 );
+        pressureState = CONVERSION_IDLE;
 
-        pressure = pressureSensor.pressure( );
-        depth    = pressureSensor.depth( );
+        pressure = waterPressure;
+        depth    = waterDepth;
 #if defined(DEBUG_VERBOSE_SENSORS)
         Serial.printf( "Debug: Pressure read: pressure=%f, depth=%f\r\n",
             pressure, depth );
@@ -364,14 +667,53 @@ public:
         // Ignore pressure sensor's low-precision water temperature.
     }
 
+    /**
+     * Starts a water temperature reading.
+     *
+     * The temperature sensor takes about 10 ms to convert a reading. This
+     * starts the conversion and returns immediately. Use
+     * updateWaterTemperature() to advance it without waiting, and
+     * getWaterTemperature() to get the result. Nothing is done if a
+     * reading is already in progress.
+     *
+     * @see getWaterTemperature()
+     * @see updateWaterTemperature()
+     */
+    static inline void startWaterTemperature( )
+    {
+        if ( !isTemperatureSensorPresent( ) || temperatureState != CONVERSION_IDLE )
+            return;
+
+        sendCommand( TEMPERATURE_ADDRESS, TEMPERATURE_CONVERT );
+        temperatureState = CONVERSION_D1;
+        temperatureStateTime = millis( );
+    }
+
+    /**
+     * Advances a water temperature reading without waiting.
+     *
+     * @return
+     *   Returns true if the reading is complete, or there is none in
+     *   progress.
+     *
+     * @see getWaterTemperature()
+     * @see startWaterTemperature()
+     */
+    static bool updateWaterTemperature( );
+
     /**
      * Returns the current water temperature.
      *
+     * If a reading was started by startWaterTemperature(), this waits for
+     * it to complete, if needed, and returns it. Otherwise a new reading
+     * is made, which can take up to 10 ms.
+     *
      * @param[out] temp
      *   The returned temperature, in Celsius.
      *
      * @see isTemperatureSensorPresent()
-     * @see https://github.com/bluerobotics/BlueRobotics_TSYS01_Library
+     * @see startWaterTemperature()
+     * @see updateWaterTemperature()
      */
     static inline void getWaterTemperature( float& temp )
     {
@@ -382,12 +724,126 @@ public:
             return;
         }
 
-        temperatureSensor.read( );
-        temp = temperatureSensor.temperature( );
+        startWaterTemperature( );
+        while ( !updateWaterTemperature( ) )
+            delay( 1 );
+        temperatureState = CONVERSION_IDLE;
+
+        temp = waterTemperature;
 #if defined(DEBUG_VERBOSE_SENSORS)
         Serial.printf( "Debug: Temp read: %f\r\n", temp );
 #endif
         if ( temp <= BAD_WATER_TEMPERATURE )
             temp = 0.0;
     }
+
+
+
+//----------------------------------------------------------------------
+// I2C.
+//----------------------------------------------------------------------
+private:
+    /**
+     * Sends a one-byte command to a sensor.
+     *
+     * @param[in] address
+     *   The sensor's I2C address.
+     * @param[in] command
+     *   The command.
+     *
+     * @return
+     *   Returns true on success and false on failure.
+     */
+    static inline bool sendCommand( const uint8_t address, const uint8_t command )
+    {
+        Wire.beginTransmission( address );
+        Wire.write( command );
+        return Wire.endTransmission( ) == 0;
+    }
+
+    /**
+     * Reads a sensor's 24-bit conversion result.
+     *
+     * @param[in] address
+     *   The sensor's I2C address.
+     * @param[in] command
+     *   The ADC read command.
+     *
+     * @return
+     *   Returns the result, or zero on failure.
+     */
+    static uint32_t readAdc( const uint8_t address, const uint8_t command );
+
+    /**
+     * Reads a sensor's 16-bit calibration coefficients.
+     *
+     * @param[in] address
+     *   The sensor's I2C address.
+     * @param[in] command
+     *   The first PROM read command.
+     * @param[out] coefficients
+     *   The returned coefficients.
+     * @param[in] nCoefficients
+     *   The number of coefficients to read.
+     *
+     * @return
+     *   Returns true on success and false on failure.
+     */
+    static bool readCoefficients(
+        const uint8_t address,
+        const uint8_t command,
+        uint16_t* coefficients,
+        const uint8_t nCoefficients );
+
+    /**
+     * Computes the water pressure and depth from raw conversions.
+     *
+     * @param[in] d1
+     *   The raw pressure conversion.
+     * @param[in] d2
+     *   The raw temperature conversion.
+     */
+    static void computeWaterPressure( const uint32_t d1, const uint32_t d2 );
+
+
+
+//----------------------------------------------------------------------
+// Pressure conversion.
+//----------------------------------------------------------------------
+public:
+    /**
+     * Checks the pressure sensor's calibration against the CRC in its
+     * first PROM word.
+     *
+     * This follows the MS5837-30BA datasheet's CRC4, over the seven PROM
+     * words with the CRC itself taken as zero.
+     *
+     * @param[in] c
+     *   The 7 coefficients.
+     *
+     * @return
+     *   Returns true if the CRC matches.
+     */
+    static bool checkPressureCrc( const uint16_t* c );
+
+    /**
+     * Converts raw pressure sensor conversions to pressure.
+     *
+     * This follows the MS5837-30BA datasheet, including its second
+     * order temperature compensation.
+     *
+     * @param[in] c
+     *   The 7 coefficients.
+     * @param[in] d1
+     *   The raw pressure conversion.
+     * @param[in] d2
+     *   The raw temperature conversion.
+     *
+     * @return
+     *   Returns the pressure, in 0.1 mbar.
+     */
+    static int32_t convertPressure(
+        const uint16_t* c,
+        const uint32_t d1,
+        const uint32_t d2 );
 };
@@ -0,0 +1,135 @@
+#pragma once
+#include <stdint.h>
+
+
+//----------------------------------------------------------------------
+// Serial port file transfer frames.
+//----------------------------------------------------------------------
+// The "get" command sends a file over the serial port as a sequence of
+// binary frames, and the host answers with frames of its own. Each frame
+// is a FrameHeader, followed by the header's length of payload bytes,
+// followed by a CRC-32 of the header and payload. All values are little-
+// endian.
+//
+// A transfer goes like this:
+//
+// - The host sends the text command "get PATH [OFFSET]" followed by a
+//   carriage return. The logger echoes the text, as for any command, and
+//   then switches to frames. The host skips bytes up to the first frame.
+//
+// - The logger sends a FRAME_START frame, with a FrameStart payload
+//   giving the file size. The header's offset is where the transfer
+//   starts, which is the OFFSET given, if any, so that an interrupted
+//   transfer can be resumed.
+//
+// - The logger sends FRAME_DATA frames, each with up to FRAME_CHUNK_SIZE
+//   bytes of the file. The header's sequence number counts chunks from
+//   zero, and its offset is the chunk's position in the file. Up to
+//   FRAME_WINDOW chunks are sent ahead of the host's acknowledgement.
+//
+// - The host sends FRAME_ACK frames. The header's sequence number is the
+//   next chunk the host needs, so every chunk before it has arrived
+//   intact. On a missing or corrupt chunk, the host sends a FRAME_NAK
+//   frame instead, and the logger resends from that chunk. The logger
+//   also resends from the most recently acknowledged chunk when no
+//   acknowledgement arrives for FRAME_ACK_TIMEOUT ms.
+//
+// - After every chunk is acknowledged, the logger sends a FRAME_END frame
+//   with a FrameEnd payload giving the CRC-32 of the whole file, from
+//   its start rather than from the OFFSET, so the host can check a
+//   resumed file as a whole.
+//
+// The logger sends a FRAME_ERROR frame, whose payload is a message, if
+// the file cannot be sent. The host may send a FRAME_ABORT frame to stop
+// a transfer. The logger gives up, and returns to the command prompt, if
+// nothing arrives from the host for FRAME_IDLE_TIMEOUT ms.
+//
+// While the "stream on" command is in effect, the logger also sends a
+// FRAME_TELEMETRY frame, with a TelemetryRecord payload, after each data
+// log record is written. The header's sequence number counts telemetry
+// records, including those dropped because the serial port was busy, so
+// a gap in the sequence shows how many were dropped. Telemetry frames
+// are not acknowledged, and are mixed in with the usual text output.
+//
+// This header has no Arduino dependencies so that host-side tools can
+// use it as well.
+
+// Magic number at the start of each frame.
+#define FRAME_MAGIC             0x5046      // "FP"
+
+// Frame types.
+#define FRAME_START             1   // Logger: transfer start.
+#define FRAME_DATA              2   // Logger: file chunk.
+#define FRAME_END               3   // Logger: transfer end.
+#define FRAME_ERROR             4   // Logger: transfer failed.
+#define FRAME_ACK               5   // Host: chunks received.
+#define FRAME_NAK               6   // Host: resend chunks.
+#define FRAME_ABORT             7   // Host: stop the transfer.
+#define FRAME_TELEMETRY         8   // Logger: telemetry record.
+
+// Transfer limits.
+#define FRAME_CHUNK_SIZE        512     // bytes
+#define FRAME_WINDOW            8       // chunks
+#define FRAME_ACK_TIMEOUT       500     // ms
+#define FRAME_IDLE_TIMEOUT      10000   // ms
+
+/**
+ * The start of a frame.
+ */
+typedef struct FrameHeader
+{
+    uint16_t magic;             // FRAME_MAGIC.
+    uint8_t type;               // FRAME_* frame type.
+    uint8_t reserved;
+    uint32_t sequence;          // Chunk sequence number.
+    uint32_t offset;            // File offset.
+    uint32_t length;            // Payload length, in bytes.
+} FrameHeader;
+
+/**
+ * The payload of a FRAME_START frame.
+ */
+typedef struct FrameStart
+{
+    uint32_t fileSize;          // File size, in bytes.
+    uint16_t chunkSize;         // FRAME_CHUNK_SIZE.
+    uint16_t window;            // FRAME_WINDOW.
+} FrameStart;
+
+/**
+ * The payload of a FRAME_END frame.
+ */
+typedef struct FrameEnd
+{
+    uint32_t fileSize;          // File size, in bytes.
+    uint32_t fileCrc;           // CRC-32 of the whole file.
+} FrameEnd;
+
+/**
+ * The payload of a FRAME_TELEMETRY frame.
+ *
+ * Inertia values are scaled to 16-bit integers to keep the frame small
+ * enough to be queued on the USB serial port in one piece.
+ */
+typedef struct TelemetryRecord
+{
+    uint32_t seconds;           // Date and time, in seconds since 1970.
+    uint16_t milliseconds;      // Millisecond offset into the second.
+    uint8_t hardwareStatus;     // HARDWARE_* status.
+    uint8_t softwareStatus;     // SOFTWARE_* status.
+    uint32_t frame;             // Data log record count.
+    float depth;                // m.
+    float waterTemperature;     // C.
+    float deviceTemperature;    // C.
+    int16_t accel[3];           // cm/s^2.
+    int16_t gyro[3];            // mrad/s.
+} TelemetryRecord;
+
+// The largest frame, with a whole chunk and the trailing CRC.
+#define FRAME_MAX_SIZE \
+    (sizeof(FrameHeader) + FRAME_CHUNK_SIZE + sizeof(uint32_t))
+
+static_assert( sizeof(FrameHeader) == 16, "Unexpected FrameHeader size" );
+static_assert( sizeof(FrameStart) == 8, "Unexpected FrameStart size" );
+static_assert( sizeof(FrameEnd) == 8, "Unexpected FrameEnd size" );
+static_assert( sizeof(TelemetryRecord) == 36, "Unexpected TelemetryRecord size" );
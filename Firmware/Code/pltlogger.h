@@ -13,13 +13,6 @@
 // terminal monitor on the port. This can be useful during boot debugging.
 //#define DEBUG_SERIAL
 
-// Debug-only. Define to enable benchmarking during the snap-and-log
-// process. This reports to the serial output the milliseconds taken
-// for each major step in capturing an image, including turning on
-// the laser, tripping the shutter, turning off the laser, and logging
-// the results.
-//#define DEBUG_BENCHMARK_SNAP_AND_LOG
-
 // Debug-only. Define to enable messages to the serial output on each
 // major camera action, such as power on/off and shutter.
 //#define DEBUG_VERBOSE_CAMERA
@@ -76,8 +69,8 @@
 // When the level drops below the error level (see BATTERY_ERROR_PERCENT),
 // the device sets the hardware state to a error and stops snap-and-log. The
 // periodic check (see BATTERY_CHECK_INTERVAL) should be every minute or
-// so. It takes a little time, which could affect snap-and-log interval
-// accuracy.
+// so. It uses the most recent battery sample (see BATTERY_SAMPLE_INTERVAL),
+// so it does not affect snap-and-log interval accuracy.
 //#define ENABLE_BATTERY_CHECK
 
 #if defined(ENABLE_BATTERY_CHECK)
@@ -87,23 +80,70 @@
 #define BATTERY_ERROR_PERCENT   10.0
 #define BATTERY_WARN_PERCENT    20.0
 
+// Optional. Define to let the run planner lengthen the frame interval,
+// up to the maximum frame interval setting, when a run at the current
+// interval would fill the SD card or run down a battery before
+// PLAN_RUN_DURATION. The longer interval lasts until the run stops, and
+// the frame interval setting is left unchanged. Otherwise the planner
+// only warns. See Planner.h.
+//#define ENABLE_PLAN_ADAPT
+
 // Optional. Define to enable usage tracking. This enables updates to
 // counters and uptime for the laser, camera, and device as a whole.
-// It also enables periodic updates of a usage stats file on the SD card.
+// It also enables periodic updates of the usage in the settings journal.
 // The values can be used to track usage and uptime for a particular
 // battery size and keep track of images recorded to a camera's SD card.
-// The counter and uptime updates and the periodic file update (see
-// USAGE_FILE_UPDATE_INTERVAL_EVENTS) take a little time, which could affect
-// snap-and-log interval accuracy.
+// The counter and uptime updates take a little time, which could affect
+// snap-and-log interval accuracy. The usage is staged every
+// USAGE_FILE_UPDATE_INTERVAL_EVENTS and committed between frames.
 //#define ENABLE_USAGE_TRACKING
 
+// Optional. Define to capture the inertia module's accelerometer and
+// gyroscope continuously between frames, instead of taking one sample per
+// frame. The module buffers samples in its hardware FIFO, which is drained
+// every IMU_FIFO_DRAIN_INTERVAL, including while the camera shutter is
+// held down, since the camera's timer keeps the shutter timing. The data
+// log gains per-frame mean, minimum, maximum, and RMS
+// columns for each axis, the number of samples, and the number of FIFO
+// overruns. The single sample acceleration and gyroscope columns hold the
+// most recent sample. Draining takes a little time, which could affect
+// snap-and-log interval accuracy, so the I2C bus is run at 400 kHz.
+//#define ENABLE_IMU_FIFO
+
+#if defined(ENABLE_IMU_FIFO)
+#define IMU_FIFO_DRAIN_INTERVAL 100 // ms
+
+// Optional. Define to also write every accelerometer and gyroscope sample
+// to a binary IMU stream file (IMU_NN.BIN) alongside each data log. The
+// file uses the binary data log format, and the "pltdecode" host tool
+// converts it to CSV.
+//#define ENABLE_IMU_STREAM
+
+typedef struct InertiaStats
+{
+    // Per-frame accelerometer and gyroscope statistics, over the samples
+    // drained from the FIFO since the previous frame. The RMS is of the
+    // samples themselves, not their deviation from the mean.
+    uint32_t numberOfSamples;
+    uint32_t numberOfOverruns;
+    float accelMean[3];         // m/s^2.
+    float accelMin[3];
+    float accelMax[3];
+    float accelRms[3];
+    float gyroMean[3];          // rad/s.
+    float gyroMin[3];
+    float gyroMax[3];
+    float gyroRms[3];
+} InertiaStats;
+#endif
+
 #if defined(ENABLE_USAGE_TRACKING)
 #define USAGE_FILE_UPDATE_INTERVAL_EVENTS 60 // events
 
 typedef struct Usage
 {
     // Persistent usage counters and uptime. These are saved to the
-    // usage tracking file periodically.
+    // settings journal periodically.
     uint32_t numberOfBoots;
     uint32_t numberOfCameraBoots;
     uint32_t numberOfLaserBoots;
@@ -128,6 +168,9 @@ extern Usage usage;
 #define DEFAULT_FRAME_INTERVAL   1000 // ms
 #define DEFAULT_BURST_SIZE       1
 #define DEFAULT_LASER_CONTINUOUS false
+#define DEFAULT_FRAME_SPACING    0.0   // m, 0 for a fixed frame interval
+#define DEFAULT_MAXIMUM_FRAME_INTERVAL 10000 // ms
+#define DEFAULT_START_DEPTH      2.0   // m, for armed mode
 
 
 //----------------------------------------------------------------------
@@ -136,9 +179,154 @@ extern Usage usage;
 // Shortest frame interval.
 //   There are delays built into several of the steps involved in snapping
 //   a photo and writing a log file entry. Benchmarking finds these to be
-//   around 200 ms. This determines the fastest log time.
+//   around 200 ms. Reading the sensors now overlaps the laser warm up, and
+//   writing the log entry overlaps the wait after the shutter, but this is
+//   kept until a snap-and-log is measured again on hardware. This
+//   determines the fastest log time.
 #define MINIMUM_FRAME_INTERVAL 200  // ms
 
+// Frame schedule.
+//   While running, frames are due at absolute deadlines, the run's first
+//   frame + k * the frame interval, kept to the real-time clock by
+//   correcting the millisecond counter for its drift. A late frame does
+//   not move later deadlines. When a frame is so late that whole
+//   deadlines have passed, up to FRAME_CATCH_UP_LIMIT of those frames are
+//   taken back to back, and the rest are skipped. Each data log row
+//   records how late its frame started and how many frames were skipped
+//   just before it.
+#define FRAME_CATCH_UP_LIMIT 0      // frames
+
+// Depth-adaptive frame interval.
+//   When a frame spacing is set, each frame's interval is chosen so that
+//   the device moves that far in depth between frames at the current
+//   descent (or ascent) rate. The rate is measured from the depths and
+//   shutter times of successive frames, smoothed by giving the newest
+//   measurement FRAME_SPACING_RATE_WEIGHT of the weight. The interval is
+//   kept between MINIMUM_FRAME_INTERVAL and the maximum frame interval
+//   setting. Until a rate is measured, the frame interval setting is used.
+#define FRAME_SPACING_RATE_WEIGHT 0.25
+#define MAXIMUM_FRAME_SPACING     10.0  // m
+
+// Armed mode.
+//   While armed and not running, the water depth is read every
+//   ARM_POLL_INTERVAL ms, without waiting on the conversion. When the
+//   device is deeper than ARM_WAKE_DEPTH, or is descending faster than
+//   ARM_WAKE_RATE, the camera and intensifier are powered up in the
+//   background. Running starts at the start depth setting, once the camera
+//   is ready. If instead the device stays shallower than ARM_WAKE_DEPTH for
+//   ARM_SURFACE_TIME ms, the camera is powered down again. A run is ended
+//   after its frames have been shallower than ARM_SURFACE_DEPTH for
+//   ARM_SURFACE_TIME ms, and the device stays armed for the next drop.
+//   Each drop has its own data log.
+#define ARM_POLL_INTERVAL   1000    // ms
+#define ARM_WAKE_DEPTH      0.5     // m
+#define ARM_WAKE_RATE       0.2     // m/s
+#define ARM_SURFACE_DEPTH   0.5     // m
+#define ARM_SURFACE_TIME    30000   // ms
+#define MAXIMUM_START_DEPTH 1000.0  // m
+
+// Drop detection.
+//   Each snap-and-log's depth is smoothed by a running median over
+//   DROP_MEDIAN_WINDOW snap-and-logs, centered on it. With one image per
+//   burst, that is one row each. A drop starts when the smoothed depth
+//   reaches DROP_START_DEPTH, and ends when it comes back above
+//   DROP_START_DEPTH - DROP_HYSTERESIS. Drops shorter than
+//   DROP_MINIMUM_DURATION are ignored. Each drop's first and last rows,
+//   times, and maximum depth go in a drop index file (DROP_NN.CSV) next
+//   to the data log, after a comment line with these values. The Data
+//   Processing DropDetect.py script only uses the index when its own
+//   settings match them.
+#define DROP_MEDIAN_WINDOW    5     // snap-and-logs, odd
+#define DROP_START_DEPTH      5.0   // m
+#define DROP_HYSTERESIS       1.0   // m
+#define DROP_MINIMUM_DURATION 20    // s
+
+// Data log durability.
+//   Data log rows are buffered in RAM and written to the SD card a whole
+//   sector at a time. The buffered rows are written and synced to the card
+//   after DATA_LOG_SYNC_ROWS rows or DATA_LOG_SYNC_INTERVAL ms, whichever
+//   comes first, and again when running stops or a battery runs low. On a
+//   power loss, at most one such window of rows is lost.
+#define DATA_LOG_SYNC_ROWS     8    // rows
+#define DATA_LOG_SYNC_INTERVAL 5000 // ms
+
+// Battery sampling.
+//   Battery voltages and percents change over minutes, and reading them
+//   takes several I2C transactions and mux switches. So they are sampled
+//   every BATTERY_SAMPLE_INTERVAL ms, between snap-and-logs, and the data
+//   log and battery checks use the most recent sample.
+#define BATTERY_SAMPLE_INTERVAL 60000 // ms
+
+// Battery discharge rate.
+//   Each battery's discharge rate is measured from its charge percent at
+//   the start of a run and its most recent sample. The LC709203F reports
+//   a tenth of a percent, so the rate is only measured once the run has
+//   gone on for BATTERY_RATE_TIME ms.
+#define BATTERY_RATE_TIME 600000 // ms
+
+// Clock resynchronization.
+//   Timestamps are computed from the processor's millisecond counter,
+//   which is resynchronized to the real-time clock's seconds ticking over
+//   every CLOCK_RESYNC_INTERVAL ms, between snap-and-logs. Each resync
+//   also refines the measured drift between the two clocks.
+#define CLOCK_RESYNC_INTERVAL 600000 // ms
+
+// Data log pre-allocation.
+//   A new data log is pre-allocated as a single contiguous extent on the
+//   SD card, sized for DATA_LOG_PREALLOCATE_DURATION of rows at the run's
+//   starting frame interval and burst size, which follow the mission plan
+//   if it has any, and DATA_LOG_PREALLOCATE_ROW_SIZE bytes per row, up to
+//   DATA_LOG_PREALLOCATE_MAX_SIZE. Writes within the extent never allocate
+//   clusters or touch the FAT, so their time is flat and predictable. The
+//   file is truncated to its real length when it is closed. If a run
+//   outlasts the extent, the file grows a cluster at a time as usual.
+//   The extent is erased when it is allocated, and a card that cannot
+//   erase gets no extent. After a power loss, the log is left at the
+//   extent's size, so at boot the latest data log is truncated after its
+//   last complete row if it ends in erased sectors.
+#define DATA_LOG_PREALLOCATE_DURATION 14400      // s
+#if defined(ENABLE_IMU_FIFO)
+#define DATA_LOG_PREALLOCATE_ROW_SIZE 512        // bytes
+#else
+#define DATA_LOG_PREALLOCATE_ROW_SIZE 256        // bytes
+#endif
+#define DATA_LOG_PREALLOCATE_MAX_SIZE 268435456  // bytes
+
+// Run planning.
+//   A run is expected to last PLAN_RUN_DURATION. Before it starts, and
+//   every PLAN_CHECK_INTERVAL ms while it runs, the planner forecasts how
+//   many more frames fit on the SD card and in the batteries, down to
+//   BATTERY_ERROR_PERCENT. A run that cannot last PLAN_MINIMUM_DURATION
+//   even at the maximum frame interval is refused, unless it is started
+//   by the armed depth trigger, when it is only warned about.
+//
+//   SD card use is forecast from the data log's measured bytes per row,
+//   once it has PLAN_MINIMUM_ROWS rows, and DATA_LOG_PREALLOCATE_ROW_SIZE
+//   until then. The main battery's drain is modeled as the camera and
+//   intensifier's PLAN_CAMERA_DRAIN, plus the laser's PLAN_LASER_DRAIN
+//   times the fraction of the time it is on. The laser is on for the
+//   measured length of each snap-and-log, PLAN_SNAP_TIME per image until
+//   measured, or all the time in continuous mode. The drains are rough
+//   figures for the stock batteries. Once a run has gone on for
+//   BATTERY_RATE_TIME, the measured discharge rate takes over, and the
+//   model only scales it to other frame intervals.
+#define PLAN_RUN_DURATION     14400   // s
+#define PLAN_MINIMUM_DURATION 300     // s
+#define PLAN_CHECK_INTERVAL   60000   // ms
+#define PLAN_MINIMUM_ROWS     20      // rows
+#define PLAN_CAMERA_DRAIN     15.0    // percent/hour
+#define PLAN_LASER_DRAIN      10.0    // percent/hour, laser on all the time
+#define PLAN_SNAP_TIME        110     // ms
+#define PLAN_SNAP_TIME_WEIGHT 0.1
+
+// Mission plans.
+//   A mission plan file on the SD card (MISSION.TXT) lists up to
+//   MISSION_MAX_SEGMENTS segments, keyed by depth or by time since the run
+//   started, each with its own frame interval, burst size, laser mode, and
+//   IMU sampling. It is parsed when a run starts, and each frame follows
+//   the segment it falls in. See Mission.h.
+#define MISSION_MAX_SEGMENTS  16
+
 
 //----------------------------------------------------------------------
 // Status values.
@@ -181,12 +369,31 @@ extern void setCameraStatus( const uint8_t );
 extern bool isLaserContinuous( );
 extern bool setLaserContinuous( const bool );
 
+extern bool isStreaming( );
+extern void setStreaming( const bool );
+
 extern uint8_t getBurstSize( );
 extern bool setBurstSize( const uint8_t );
 
 extern bool startRunning( );
 extern bool stopRunning( );
 
-extern bool snapAndLog( const uint8_t );
+extern bool queueSnapAndLog( const uint8_t );
+extern bool isSnapQueued( );
+extern bool beginSnapAndLog( const uint8_t );
+extern void updateSnapAndLog( );
+extern bool isSnapping( );
 extern uint32_t getFrameInterval( );
 extern bool setFrameInterval( const uint32_t );
+extern float getFrameSpacing( );
+extern bool setFrameSpacing( const float );
+extern uint32_t getMaximumFrameInterval( );
+extern bool setMaximumFrameInterval( const uint32_t );
+extern uint32_t getScheduledInterval( );
+extern void setRunFrameInterval( const uint32_t );
+extern float getDescentRate( );
+
+extern bool isArmed( );
+extern bool setArmed( const bool );
+extern float getStartDepth( );
+extern bool setStartDepth( const float );
@@ -37,6 +37,12 @@
 #include "Sensors.h"    // Inertial, pressure, and temperature sensors.
 #include "Switches.h"   // Switches.
 #include "Commands.h"   // Serial port commands.
+#include "Perf.h"       // Stage timing histograms.
+#include "DropDetector.h" // Drop index.
+#include "Planner.h"    // Run forecasts.
+#include "Mission.h"    // Mission plans.
+#include "Crc32.h"      // Checksums.
+#include "SerialFrames.h" // Serial port frames.
 
 
 //----------------------------------------------------------------------
@@ -46,13 +52,68 @@
 bool laserContinuous   = DEFAULT_LASER_CONTINUOUS;
 uint8_t burstSize      = DEFAULT_BURST_SIZE;
 uint32_t frameInterval = DEFAULT_FRAME_INTERVAL;
+float frameSpacing     = DEFAULT_FRAME_SPACING;
+uint32_t maximumFrameInterval = DEFAULT_MAXIMUM_FRAME_INTERVAL;
+float startDepth       = DEFAULT_START_DEPTH;
 
 // Current state.
 uint8_t hardwareStatus   = HARDWARE_OFF;
 uint8_t softwareStatus   = SOFTWARE_OFF;
 uint8_t cameraStatus     = CAMERA_OFF;
 bool batteriesPresent    = false;
-uint32_t previousLogTime = 0;
+
+// Frame schedule state. See updateFrameSchedule().
+bool frameScheduleStarted    = false;
+uint32_t frameScheduleStart  = 0;
+uint64_t frameScheduleMicros = 0;
+uint32_t frameLateness       = 0;
+uint32_t framesSkipped       = 0;
+uint32_t runFrameInterval    = 0;   // ms, or 0 to follow the setting.
+
+// Depth-adaptive frame interval state. See updateDescentRate().
+uint8_t descentDepths       = 0;    // Depths seen this run, up to 2.
+float descentPreviousDepth  = 0.0;  // m.
+uint32_t descentPreviousMicros = 0;
+float descentRate           = 0.0;  // m/s, positive going down.
+
+// Snap-and-log state. See updateSnapAndLog().
+#define SNAP_IDLE         0     // Not snapping.
+#define SNAP_LASER_WARMUP 1     // Waiting for the laser to warm up.
+#define SNAP_BURST        2     // Waiting for the camera's burst.
+uint8_t snapState           = SNAP_IDLE;
+uint32_t snapStateTime      = 0;
+uint8_t snapImages          = 0;
+uint8_t snapRowsLeft        = 0;    // Data log rows to write, one per image.
+uint32_t snapFirstRow       = 0;
+bool snapInitialCameraPower = false;
+bool snapInitialLaserPower  = false;
+bool snapSensorsRead        = false;
+bool snapWaterStarted       = false;
+bool snapWaterRead          = false;
+bool snapStatus             = true;
+DataLogRecord snapRecord;
+uint32_t snapBeginMicros    = 0;
+
+// Queued snap state. See queueSnapAndLog().
+uint8_t snapQueued          = 0;    // Images in the queued snap, or 0.
+bool snapQueuedCameraPower  = false;
+
+// Armed mode state. See updateArmed().
+#define ARM_OFF     0           // Not armed.
+#define ARM_WAITING 1           // Polling the depth, with the camera off.
+#define ARM_WARMING 2           // Camera powering up for a drop.
+#define ARM_RUNNING 3           // Running a drop.
+uint8_t armState          = ARM_OFF;
+bool armPolling           = false;  // A depth reading is in progress.
+uint32_t armPollTime      = 0;
+bool armHasDepth          = false;
+float armPreviousDepth    = 0.0;    // m.
+uint32_t armPreviousTime  = 0;
+uint32_t armDeepTime      = 0;      // Last time deeper than the surface.
+
+// Telemetry stream state. See sendTelemetry().
+bool streaming             = false;
+uint32_t telemetrySequence = 0;
 
 #if defined(ENABLE_BATTERY_CHECK)
 // Battery checking state.
@@ -73,6 +134,193 @@ Usage usage;
 
 
 
+//----------------------------------------------------------------------
+// Frame schedule.
+//----------------------------------------------------------------------
+/**
+ * Starts the frame schedule for a run.
+ *
+ * The run's first frame is due as soon as the camera is ready. Later
+ * frames are due at absolute deadlines, the first frame's time + k * the
+ * frame interval, with the interval measured on the real-time clock by
+ * correcting the millisecond counter for its drift. A late frame does
+ * not move later deadlines.
+ *
+ * @see updateFrameSchedule()
+ */
+void startFrameSchedule( )
+{
+    frameScheduleStarted = false;
+    frameScheduleMicros = 0;
+    frameLateness       = 0;
+    framesSkipped       = 0;
+    descentDepths       = 0;
+    descentRate         = 0.0;
+}
+
+/**
+ * Updates the descent rate from a frame's depth.
+ *
+ * The rate is the change in depth since the previous frame over the
+ * time between their shutters, smoothed by giving the newest measurement
+ * FRAME_SPACING_RATE_WEIGHT of the weight.
+ *
+ * @param[in] depth
+ *   The frame's depth, in m.
+ * @param[in] frameMicros
+ *   The frame's shutter time, from micros().
+ *
+ * @see getScheduledInterval()
+ */
+void updateDescentRate( const float depth, const uint32_t frameMicros )
+{
+    if ( descentDepths > 0 )
+    {
+        const uint32_t elapsed = frameMicros - descentPreviousMicros;
+        if ( elapsed == 0 )
+            return;
+        const float rate = (depth - descentPreviousDepth) * 1.0e6 / elapsed;
+        if ( descentDepths == 1 )
+            descentRate = rate;
+        else
+            descentRate += FRAME_SPACING_RATE_WEIGHT * (rate - descentRate);
+    }
+    descentPreviousDepth  = depth;
+    descentPreviousMicros = frameMicros;
+    if ( descentDepths < 2 )
+        ++descentDepths;
+}
+
+/**
+ * Returns the smoothed descent rate.
+ *
+ * @return
+ *   Returns the rate, in m/s, positive going down, or 0 until two frames
+ *   of the run have been logged.
+ *
+ * @see updateDescentRate()
+ */
+float getDescentRate( )
+{
+    return descentRate;
+}
+
+/**
+ * Returns the interval from one frame's deadline to the next.
+ *
+ * If the mission plan's segment sets a frame interval, this is it. With
+ * no frame spacing set, or until the descent rate is measured, this is
+ * the run's frame interval, if the planner has set one, or else the
+ * frame interval setting. Otherwise it is the time to move the frame spacing
+ * in depth at the descent rate, going down or up, kept between
+ * MINIMUM_FRAME_INTERVAL and the maximum frame interval.
+ *
+ * @return
+ *   Returns the interval, in ms.
+ *
+ * @see setRunFrameInterval()
+ * @see updateDescentRate()
+ * @see updateFrameSchedule()
+ */
+uint32_t getScheduledInterval( )
+{
+    const uint32_t missionInterval = Mission::getInterval( 0 );
+    if ( missionInterval != 0 )
+        return missionInterval;
+    if ( frameSpacing <= 0.0 || descentDepths < 2 )
+        return (runFrameInterval != 0) ? runFrameInterval : frameInterval;
+
+    const float speed = fabs( descentRate );
+    if ( speed * maximumFrameInterval <= frameSpacing * 1000.0 )
+        return maximumFrameInterval;   // Slow or stopped.
+    const uint32_t interval = (uint32_t) (frameSpacing * 1000.0 / speed + 0.5);
+    return (interval < MINIMUM_FRAME_INTERVAL) ? MINIMUM_FRAME_INTERVAL : interval;
+}
+
+/**
+ * Sets the frame interval for the rest of the run, in place of the
+ * frame interval setting, which is left unchanged.
+ *
+ * The run's frame interval is cleared when the run stops.
+ *
+ * @param[in] interval
+ *   The interval, in ms, or 0 to follow the setting again.
+ *
+ * @see getScheduledInterval()
+ * @see Planner::check()
+ */
+void setRunFrameInterval( const uint32_t interval )
+{
+    runFrameInterval = interval;
+}
+
+/**
+ * Returns true if the next frame is due, and advances the schedule.
+ *
+ * If whole frame intervals have passed since the deadline, up to
+ * FRAME_CATCH_UP_LIMIT of those frames are taken back to back by later
+ * calls, and the rest are skipped. How late the frame is and how many
+ * frames were skipped are saved for its data log row.
+ *
+ * The interval comes from getScheduledInterval(), so a change to the
+ * frame interval or descent rate takes effect from the most recent
+ * deadline.
+ *
+ * The run's first frame is due once the camera is ready, and its time
+ * starts the deadlines and the IMU statistics.
+ *
+ * @return
+ *   Returns true if a frame should start now.
+ *
+ * @see startFrameSchedule()
+ */
+bool updateFrameSchedule( )
+{
+    if ( !frameScheduleStarted )
+    {
+        if ( !Camera::isReady( ) )
+            return false;
+        frameScheduleStarted = true;
+        frameScheduleStart   = millis( );
+        frameLateness        = 0;
+        framesSkipped        = 0;
+#if defined(ENABLE_IMU_FIFO)
+        // Start the IMU statistics afresh with the run's first entry, not
+        // while the camera was booting.
+        Sensors::resetInertiaStats( );
+#endif
+        return true;
+    }
+
+    const uint32_t interval = getScheduledInterval( );
+    const uint64_t step = Clock::getCounterMicros( interval );
+    uint64_t next = frameScheduleMicros + step;
+    const uint32_t currentTime = millis( );
+    const int32_t late = (int32_t) (currentTime -
+        (frameScheduleStart + (uint32_t) (next / 1000)));
+    if ( late < 0 )
+        return false;
+
+    uint32_t skipped = 0;
+    const uint32_t behind = (uint32_t) late / interval;
+    if ( behind > FRAME_CATCH_UP_LIMIT )
+    {
+        skipped = behind - FRAME_CATCH_UP_LIMIT;
+        next += skipped * step;
+    }
+
+    frameScheduleMicros = next;
+    frameLateness = currentTime - (frameScheduleStart + (uint32_t) (next / 1000));
+    framesSkipped = skipped;
+    Perf::add( Perf::STAGE_LATENESS, frameLateness * 1000 );
+    Perf::addMissedFrames( skipped );
+    return true;
+}
+
+
+
+
+
 //----------------------------------------------------------------------
 // Settings.
 //----------------------------------------------------------------------
@@ -98,13 +346,63 @@ uint8_t getBurstSize( )
  *   Returns the frame interval, in ms.
  *
  * @see setFrameInterval()
- * @see snapAndLog()
+ * @see updateFrameSchedule()
  */
 uint32_t getFrameInterval( )
 {
     return frameInterval;
 }
 
+/**
+ * Returns the current frame spacing.
+ *
+ * The frame spacing is the depth to move between frames. When it is
+ * set, the frame interval adapts to the descent rate.
+ *
+ * @return
+ *   Returns the spacing, in m, or 0 for a fixed frame interval.
+ *
+ * @see setFrameSpacing()
+ * @see getScheduledInterval()
+ */
+float getFrameSpacing( )
+{
+    return frameSpacing;
+}
+
+/**
+ * Returns the current maximum frame interval.
+ *
+ * This limits the depth-adaptive frame interval when the descent is
+ * slow or stopped.
+ *
+ * @return
+ *   Returns the interval, in ms.
+ *
+ * @see setMaximumFrameInterval()
+ * @see getScheduledInterval()
+ */
+uint32_t getMaximumFrameInterval( )
+{
+    return maximumFrameInterval;
+}
+
+/**
+ * Returns the current start depth.
+ *
+ * While armed, running starts when the device reaches this depth.
+ *
+ * @return
+ *   Returns the depth, in m.
+ *
+ * @see setStartDepth()
+ * @see setArmed()
+ */
+float getStartDepth( )
+{
+    return startDepth;
+}
+
 /**
  * Returns true if the laser should be on throughout a run.
  *
@@ -130,7 +428,7 @@ bool isLaserContinuous( )
  *   Returns true if the change is accepted.
  *
  * @see getBurstSize()
- * @see FileSystem::saveSettings()
+ * @see FileSystem::commitSettings()
  */
 bool setBurstSize( const uint8_t nImages )
 {
@@ -141,7 +439,7 @@ bool setBurstSize( const uint8_t nImages )
         burstSize = DEFAULT_BURST_SIZE;
     else
         burstSize = nImages;
-    FileSystem::saveSettings( frameInterval, laserContinuous, burstSize );
+    FileSystem::stageInteger( FileSystem::KEY_BURST_SIZE, burstSize );
     return true;
 }
 
@@ -155,8 +453,8 @@ bool setBurstSize( const uint8_t nImages )
  *   Returns true if the change is accepted.
  *
  * @see getFrameInterval()
- * @see snapAndLog()
- * @see FileSystem::saveSettings()
+ * @see updateFrameSchedule()
+ * @see FileSystem::commitSettings()
  */
 bool setFrameInterval( const uint32_t interval )
 {
@@ -169,7 +467,83 @@ bool setFrameInterval( const uint32_t interval )
         return false; // Too small.
     else
         frameInterval = interval;
-    FileSystem::saveSettings( frameInterval, laserContinuous, burstSize );
+    FileSystem::stageInteger( FileSystem::KEY_INTERVAL, frameInterval );
+    return true;
+}
+
+/**
+ * Sets the current frame spacing.
+ *
+ * @param[in] spacing
+ *   The new frame spacing, in m, or 0 for a fixed frame interval.
+ *
+ * @return
+ *   Returns true if the change is accepted.
+ *
+ * @see getFrameSpacing()
+ * @see FileSystem::commitSettings()
+ */
+bool setFrameSpacing( const float spacing )
+{
+    if ( spacing == frameSpacing )
+        return true; // No change.
+
+    if ( spacing < 0.0 || spacing > MAXIMUM_FRAME_SPACING )
+        return false; // Out of range.
+    frameSpacing = spacing;
+    FileSystem::stageFloat( FileSystem::KEY_SPACING, frameSpacing );
+    return true;
+}
+
+/**
+ * Sets the current maximum frame interval.
+ *
+ * @param[in] interval
+ *   The new maximum frame interval, in ms.
+ *
+ * @return
+ *   Returns true if the change is accepted.
+ *
+ * @see getMaximumFrameInterval()
+ * @see FileSystem::commitSettings()
+ */
+bool setMaximumFrameInterval( const uint32_t interval )
+{
+    if ( interval == maximumFrameInterval )
+        return true; // No change.
+
+    if ( interval == 0 )
+        maximumFrameInterval = DEFAULT_MAXIMUM_FRAME_INTERVAL;
+    else if ( interval < MINIMUM_FRAME_INTERVAL )
+        return false; // Too small.
+    else
+        maximumFrameInterval = interval;
+    FileSystem::stageInteger( FileSystem::KEY_MAXIMUM_INTERVAL, maximumFrameInterval );
+    return true;
+}
+
+/**
+ * Sets the current start depth.
+ *
+ * @param[in] depth
+ *   The new start depth, in m. It must be deeper than ARM_SURFACE_DEPTH,
+ *   so that a drop is not ended as soon as it starts.
+ *
+ * @return
+ *   Returns true if the change is accepted.
+ *
+ * @see getStartDepth()
+ * @see FileSystem::commitSettings()
+ */
+bool setStartDepth( const float depth )
+{
+    if ( depth == startDepth )
+        return true; // No change.
+
+    if ( depth <= ARM_SURFACE_DEPTH || depth > MAXIMUM_START_DEPTH )
+        return false; // Out of range.
+    startDepth = depth;
+    FileSystem::stageFloat( FileSystem::KEY_START_DEPTH, startDepth );
     return true;
 }
 
@@ -183,14 +557,14 @@ bool setFrameInterval( const uint32_t interval )
  *   Returns true if the change is accepted.
  *
  * @see isLaserContinuous()
- * @see FileSystem::saveSettings()
+ * @see FileSystem::commitSettings()
  */
 bool setLaserContinuous( const bool onOff )
 {
     if ( onOff == laserContinuous )
         return true; // No change.
     laserContinuous = onOff;
-    FileSystem::saveSettings( frameInterval, laserContinuous, burstSize );
+    FileSystem::stageInteger( FileSystem::KEY_LASER_CONTINUOUS, laserContinuous ? 1 : 0 );
     return true;
 }
 
@@ -300,7 +674,7 @@ void setSoftwareStatus( const uint8_t status )
  * All counters and uptimes are set to zero.
  *
  * @see FileSystem::loadUsage()
- * @see FileSystem::saveUsage()
+ * @see FileSystem::stageUsage()
  */
 void resetUsage( )
 {
@@ -328,8 +702,9 @@ void resetUsage( )
  */
 void reset( )
 {
-    // Stop running. If running, this should turn off the laser and
-    // camera, close the data log, and reset the lights.
+    // Disarm and stop running. If running, this should turn off the laser
+    // and camera, close the data log, and reset the lights.
+    setArmed( false );
     if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
         stopRunning( );
     else
@@ -337,12 +712,15 @@ void reset( )
 
     Serial.print( "Device:\r\n" );
     FileSystem::closeDataLog( );
+    FileSystem::closeStatus( );
     Serial.print( "  Data log closed.\r\n");
 
     Laser::setPower( false );
     Serial.print( "  Laser off.\r\n");
 
+    snapQueued = 0;
     Camera::setPower( false, true );
+    setCameraStatus( CAMERA_OFF );
     Serial.print( "  Camera and intensifier off.\r\n");
 
     Lights::reset( );
@@ -353,7 +731,15 @@ void reset( )
     Serial.printf( "  Burst size reset to %d.\r\n", getBurstSize( ) );
 
     setFrameInterval( DEFAULT_FRAME_INTERVAL );
-    Serial.printf( "  Image interval reset to %ld ms.\r\n", getFrameInterval( ) );
+    Serial.printf( "  Image interval reset to %ld ms.\r\n", (long) getFrameInterval( ) );
+
+    setFrameSpacing( DEFAULT_FRAME_SPACING );
+    setMaximumFrameInterval( DEFAULT_MAXIMUM_FRAME_INTERVAL );
+    Serial.printf( "  Image spacing reset to %s, maximum interval %ld ms.\r\n",
+        (getFrameSpacing( ) > 0.0) ? "adaptive" : "off", (long) getMaximumFrameInterval( ) );
+
+    setStartDepth( DEFAULT_START_DEPTH );
+    Serial.printf( "  Start depth reset to %.1f m.\r\n", getStartDepth( ) );
 
     setLaserContinuous( DEFAULT_LASER_CONTINUOUS );
     Serial.printf( "  Laser reset to %s.\r\n",
@@ -362,10 +748,126 @@ void reset( )
 #if defined(ENABLE_USAGE_TRACKING)
     Serial.print( "Usage tracking reset.\r\n" );
     resetUsage( );
-    FileSystem::saveUsage( usage );
+    FileSystem::stageUsage( usage );
 #endif
 
-    FileSystem::saveSettings( frameInterval, laserContinuous, burstSize );
+    // The changes are committed together, the next time through loop().
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Telemetry stream.
+//----------------------------------------------------------------------
+/**
+ * Returns true if telemetry is streamed to the serial port.
+ *
+ * @return
+ *   Returns true if streaming.
+ *
+ * @see setStreaming()
+ */
+bool isStreaming( )
+{
+    return streaming;
+}
+
+/**
+ * Turns the telemetry stream on or off.
+ *
+ * While on, a FRAME_TELEMETRY frame is sent on the serial port after each
+ * data log record is written. Unlike the other settings, this one is not
+ * saved, so the stream is off after a reset.
+ *
+ * @param[in] onOff
+ *   True to stream telemetry, and false to stop.
+ *
+ * @see isStreaming()
+ * @see sendTelemetry()
+ */
+void setStreaming( const bool onOff )
+{
+    if ( onOff && !streaming )
+        telemetrySequence = 0;
+    streaming = onOff;
+}
+
+/**
+ * Scales a value to a 16-bit integer, clamped to the integer's range.
+ *
+ * @param[in] value
+ *   The value.
+ * @param[in] scale
+ *   The scale factor.
+ *
+ * @return
+ *   Returns the scaled value.
+ */
+int16_t scaleToInt16( const float value, const float scale )
+{
+    const float scaled = value * scale;
+    if ( scaled != scaled )
+        return 0;       // NaN, from a missing sensor.
+    if ( scaled <= -32768.0f )
+        return -32768;
+    if ( scaled >= 32767.0f )
+        return 32767;
+    return (int16_t) ((scaled < 0.0f) ? scaled - 0.5f : scaled + 0.5f);
+}
+
+/**
+ * Sends a data log record on the serial port as a telemetry frame.
+ *
+ * The frame is sent in one write, and only if the serial port has room
+ * to queue all of it now. Otherwise the record is dropped rather than
+ * holding up the snap-and-log, and the gap in the frame sequence numbers
+ * tells the host how many were dropped. Nothing is sent when no host has
+ * the port open.
+ *
+ * @param[in] record
+ *   The data log record just written.
+ *
+ * @see setStreaming()
+ */
+void sendTelemetry( const DataLogRecord& record )
+{
+    static const uint16_t FRAME_SIZE =
+        sizeof( FrameHeader ) + sizeof( TelemetryRecord ) + sizeof( uint32_t );
+    const uint32_t sequence = telemetrySequence++;
+    if ( !Serial || Serial.availableForWrite( ) < FRAME_SIZE )
+        return;
+
+    TelemetryRecord telemetry;
+    telemetry.seconds           = record.seconds;
+    telemetry.milliseconds      = record.milliseconds;
+    telemetry.hardwareStatus    = hardwareStatus;
+    telemetry.softwareStatus    = softwareStatus;
+    telemetry.frame             = FileSystem::getNumberOfDataLogEntries( );
+    telemetry.depth             = record.depth;
+    telemetry.waterTemperature  = record.waterTemperature;
+    telemetry.deviceTemperature = record.deviceTemperature;
+    for ( uint8_t i = 0; i < 3; ++i )
+    {
+        telemetry.accel[i] = scaleToInt16( record.accel[i], 100.0f );
+        telemetry.gyro[i]  = scaleToInt16( record.gyro[i], 1000.0f );
+    }
+
+    FrameHeader header;
+    header.magic    = FRAME_MAGIC;
+    header.type     = FRAME_TELEMETRY;
+    header.reserved = 0;
+    header.sequence = sequence;
+    header.offset   = 0;
+    header.length   = sizeof( telemetry );
+
+    uint8_t frame[FRAME_SIZE];
+    memcpy( frame, &header, sizeof( header ) );
+    memcpy( frame + sizeof( header ), &telemetry, sizeof( telemetry ) );
+    const uint32_t crc = Crc32::compute( frame, FRAME_SIZE - sizeof( crc ) );
+    memcpy( frame + FRAME_SIZE - sizeof( crc ), &crc, sizeof( crc ) );
+    Serial.write( frame, FRAME_SIZE );
 }
 
 
@@ -376,199 +878,462 @@ void reset( )
 // Run, snap, and log.
 //----------------------------------------------------------------------
 /**
- * Snaps an image, reads sensors, and adds a data log entry.
+ * Returns true if a snap-and-log is in progress.
  *
- * If the laser mode is not continuous, the laser is turned on before
- * an image is captured, and off afterwards.
+ * @return
+ *   Returns true if snapping.
  *
- * The camera is triggered and sensors read, then added to the data log.
+ * @see beginSnapAndLog()
+ * @see updateSnapAndLog()
+ */
+bool isSnapping( )
+{
+    return snapState != SNAP_IDLE;
+}
+
+/**
+ * Starts a snap-and-log.
+ *
+ * The snap-and-log is carried out by later calls to updateSnapAndLog(),
+ * which return quickly so that loop() can service switches and serial
+ * commands between steps.
+ *
+ * The camera and intensifier should be ready. They are on for the whole
+ * of a run, and queueSnapAndLog() powers them up for a snap outside of a
+ * run. If they are not ready, they are powered up here, which waits for
+ * the camera to boot. The laser is turned on, if it is not already,
+ * without waiting for it to warm up.
  *
  * @param[in] nImages
  *   The number of images in a burst.
  *
  * @return
- *   Returns true on success, false on failure. On failure, error
- *   messages have already been printed.
+ *   Returns false if a snap-and-log is already in progress.
  *
- * @see getFrameInterval()
- * @see setFrameInterval()
- * @see startRunning()
- * @see stopRunning()
+ * @see isSnapping()
+ * @see queueSnapAndLog()
+ * @see updateSnapAndLog()
  */
-bool snapAndLog( const uint8_t nImages )
+bool beginSnapAndLog( const uint8_t nImages )
 {
-    float pressure = 0.0;
-    float depth = 0.0;
-    float waterTemperature = 0.0;
-    float deviceTemperature = 0.0;
-    float accel[3];
-    float mag[3];
-    float gyro[3];
-    bool status = true;
-
-#ifdef DEBUG_BENCHMARK_SNAP_AND_LOG
-    uint32_t previousTime = millis( );
-    uint32_t nextTime = previousTime;
-    uint32_t powerOnTime = 0;
-    uint32_t powerOffTime = 0;
-    uint32_t shutterTime = 0;
-    uint32_t sensorTime = 0;
-    uint32_t logTime = 0;
-#endif
+    if ( isSnapping( ) )
+        return false;
+
+    snapImages     = nImages;
+    snapStatus     = true;
+    snapBeginMicros = micros( );
+
+    // If there is a data log (and there is while running automaticaly),
+    // then the sensors are read and a data log entry added. Otherwise
+    // that work is already done.
+    const bool logging = FileSystem::isDataLogOpen( );
+    snapSensorsRead    = !logging;
+    snapWaterStarted   = !logging;
+    snapWaterRead      = !logging;
+    snapRowsLeft       = logging ? nImages : 0;
+    memset( &snapRecord, 0, sizeof( snapRecord ) );
+    snapRecord.frameLateness = frameLateness;
+    snapRecord.skippedFrames = framesSkipped;
+    frameLateness = 0;
+    framesSkipped = 0;
 
     //
     // Camera, intensifier, and laser power up (as needed).
     //
-    // Insure the camera and intensifier power is on.
-    // - When this function is called during a run, the camera and intensifier
-    //   are already on.
-    // - When this function is called outside of a run to snap just once, the
-    //   camera and intensifier are not already on and must be turned on now.
-    const bool initialCameraPower = Camera::isPowerOn( );
-    if ( !initialCameraPower )
+    // Insure the camera and intensifier are ready.
+    // - When this function is called during a run, or for a queued snap,
+    //   the camera and intensifier are already ready.
+    // - Otherwise they may not be, and must be powered up now.
+    const uint32_t powerOnMicros = micros( );
+    snapInitialCameraPower = Camera::isPowerOn( );
+    if ( !Camera::isReady( ) )
     {
         setCameraStatus( CAMERA_BOOTING );
         Camera::setPower( true );
         setCameraStatus( CAMERA_READY );
     }
 
-    // Insure the laser is on.
-    const bool initialLaserPower = Laser::isPowerOn( );
-    if ( !initialLaserPower )
-        Laser::setPower( true );
+    // Insure the laser is on. The laser warms up while the sensors are read.
+    snapInitialLaserPower = Laser::isPowerOn( );
+    if ( !snapInitialLaserPower )
+        Laser::setPower( true, false );
+    Perf::record( Perf::STAGE_POWER_ON, powerOnMicros );
+
+    setCameraStatus( CAMERA_SHOOTING );
+    snapState     = SNAP_LASER_WARMUP;
+    snapStateTime = millis( );
+    return true;
+}
+
+#if defined(ENABLE_IMU_FIFO)
+/**
+ * Drains the inertia module's FIFO, if it is time to.
+ *
+ * Each sample is added to the running statistics for the next data log
+ * entry and, if ENABLE_IMU_STREAM is defined, written to the IMU stream
+ * file.
+ *
+ * @param[in] force
+ *   True to drain the FIFO even if IMU_FIFO_DRAIN_INTERVAL has not
+ *   elapsed.
+ *
+ * @see doSnapAndLogWork()
+ */
+void updateInertia( const bool force )
+{
+    if ( !force && !Sensors::isInertiaFifoDue( ) )
+        return;
+
+#if defined(ENABLE_IMU_STREAM)
+    ImuLogRecord record;
+    while ( Sensors::readInertiaSample( record.accel, record.gyro, record.time ) )
+    {
+        if ( !FileSystem::isImuLogOpen( ) )
+            continue;
+        record.frame = Sensors::getInertiaFrame( );
+        if ( !FileSystem::writeImuLog( record ) )
+        {
+            // The IMU stream is closed, but the data log carries on.
+            Serial.print( "Cannot write to IMU stream file.\r\n" );
+            FileSystem::writeStatus( "Cannot write to IMU stream file",
+                FileSystem::STATUS_WARNING );
+        }
+    }
+#else
+    float accel[3];
+    float gyro[3];
+    uint32_t time;
+    while ( Sensors::readInertiaSample( accel, gyro, time ) )
+        ;
+#endif
+}
+#endif
+
+/**
+ * Starts the water pressure and temperature readings for a snap-and-log.
+ *
+ * This is called just before the shutter is first pressed, so that the
+ * readings are taken as close as possible to the exposure. The sensors
+ * convert while the shutter is down, and the results are collected
+ * afterwards by doSnapAndLogWork().
+ *
+ * @see doSnapAndLogWork()
+ */
+void startSnapAndLogWater( )
+{
+    if ( snapWaterStarted )
+        return;
+    Sensors::startWaterPressure( );
+    Sensors::startWaterTemperature( );
+    snapWaterStarted = true;
+}
+
+/**
+ * Does the next piece of snap-and-log work that can overlap a wait.
+ *
+ * The inertia sensor and batteries are read first. Then the water
+ * pressure and temperature readings are collected once their conversions
+ * are done. Once the burst is over, a data log row is added for each of
+ * its images, with the image's own shutter time. Each call does one
+ * piece, so that waits are not stretched more than needed.
+ *
+ * @param[in] wait
+ *   True to wait for the water pressure and temperature conversions,
+ *   if needed, instead of returning.
+ *
+ * @return
+ *   Returns false if there was no work to do now.
+ *
+ * @see startSnapAndLogWater()
+ * @see updateSnapAndLog()
+ */
+bool doSnapAndLogWork( const bool wait )
+{
+    if ( !snapSensorsRead )
+    {
+        // Read the sensors. The mission plan may leave out the inertia
+        // module, whose columns are then 0. With ENABLE_IMU_FIFO, its
+        // samples carry on to the next frame that reads it.
+        const uint32_t t = micros( );
+        if ( Mission::isImuOn( ) )
+        {
+#if defined(ENABLE_IMU_FIFO)
+            updateInertia( true );
+#endif
+            Sensors::getInertia( snapRecord.accel, snapRecord.mag, snapRecord.gyro,
+                snapRecord.deviceTemperature );
+#if defined(ENABLE_IMU_FIFO)
+            Sensors::getInertiaStats( snapRecord.inertiaStats );
+#endif
+        }
+#if defined(BATTERY_IN_DATA_LOG)
+        snapRecord.controllerVoltage = Battery::getSampledControllerVoltage( );
+        snapRecord.controllerPercent = Battery::getSampledControllerPercent( );
+        snapRecord.mainVoltage       = Battery::getSampledMainVoltage( );
+        snapRecord.mainPercent       = Battery::getSampledMainPercent( );
+#endif
+        Perf::record( Perf::STAGE_INERTIA, t );
+        snapSensorsRead = true;
+        return true;
+    }
+
+    if ( !snapWaterRead )
+    {
+        // Collect the water pressure and temperature, once converted.
+        if ( wait )
+            startSnapAndLogWater( );
+        else if ( !snapWaterStarted ||
+                  !Sensors::updateWaterPressure( ) ||
+                  !Sensors::updateWaterTemperature( ) )
+            return false;
+        Sensors::getWaterPressure( snapRecord.pressure, snapRecord.depth );
+        Sensors::getWaterTemperature( snapRecord.waterTemperature );
+        if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
+        {
+            // The mission plan's segment for this depth sets the capture
+            // settings from the next frame on.
+            updateDescentRate( snapRecord.depth, snapRecord.frameMicros );
+            Mission::update( snapRecord.depth );
+        }
+        snapRecord.descentRate = descentRate;
+        snapRecord.nextFrameInterval = getScheduledInterval( );
+        snapWaterRead = true;
+        return true;
+    }
+
+    if ( snapRowsLeft > 0 && !Camera::isBursting( ) )
+    {
+        // Write the next image's row to the data log. The rows of a burst
+        // share the sensor readings, but each has its image's shutter time.
+        const uint8_t image = snapImages - snapRowsLeft;
+        if ( image != 0 )
+        {
+            const uint32_t offset = Camera::getBurstPressMicros( image ) -
+                Camera::getBurstPressMicros( 0 );
+            snapRecord.frameMicros = Camera::getBurstPressMicros( image );
+            Clock::getTime( snapStateTime + offset / 1000, snapRecord.seconds,
+                snapRecord.milliseconds );
+            snapRecord.frameLateness = 0;
+            snapRecord.skippedFrames = 0;
+        }
+        snapRecord.burstImage   = image;
+        snapRecord.shutterPress = Camera::getBurstPressLength( image );
+        --snapRowsLeft;
+
+        if ( !FileSystem::writeDataLog( snapRecord ) )
+        {
+            // Log file write error. Possible failures:
+            // - The SD card is not inserted.
+            // - The SD card is full.
+            // - The file has reached the 4GB max size for FAT.
+            // - A hardware error has occurred.
+            // - An internal SdFat error has occurred.
+            Serial.print( "Cannot write to data log file.\r\n" );
+            FileSystem::printErrorMessage( );
+
+            if ( FileSystem::isCardPresent( ) )
+            {
+                // Try to log a status message. This will fail silently if the
+                // SD card is full.
+                FileSystem::writeStatus( "Cannot write to data log file" );
+                FileSystem::writeStatus( FileSystem::getErrorMessage( ),
+                    FileSystem::STATUS_ERROR );
+            }
+            snapStatus   = false;
+            snapRowsLeft = 0;
+            return true;
+        }
 
-#ifdef DEBUG_BENCHMARK_SNAP_AND_LOG
-    powerOnTime = (nextTime = millis()) - previousTime;
-    previousTime = nextTime;
-#endif
+        if ( image == 0 )
+        {
+            snapFirstRow = FileSystem::getNumberOfDataLogEntries( ) - 1;
+            if ( streaming )
+                sendTelemetry( snapRecord );
+        }
+        if ( snapRowsLeft == 0 )
+            DropDetector::add( snapFirstRow,
+                FileSystem::getNumberOfDataLogEntries( ) - 1,
+                snapRecord.seconds, snapRecord.depth );
+        return true;
+    }
 
-    //
-    // Capture.
-    //
-    // Snap images and update usage.
-    setCameraStatus( CAMERA_SHOOTING );
-    Camera::snap( nImages );
-#ifdef DEBUG_BENCHMARK_SNAP_AND_LOG
-    shutterTime = (nextTime = millis()) - previousTime;
-    previousTime = nextTime;
-#endif
+    return false;
+}
 
+/**
+ * Ends a snap-and-log.
+ *
+ * The laser, camera, and intensifier are turned off if they were off
+ * when the snap-and-log began, and usage tracking is updated.
+ *
+ * @see beginSnapAndLog()
+ * @see updateSnapAndLog()
+ */
+void endSnapAndLog( )
+{
     //
     // Camera, intensifier, and laser power down (as needed).
     //
-    // Turn off the laser, if it was originally off.
-    if ( !initialLaserPower )
+    // Turn off the laser, if it was originally off. While running, leave
+    // it as the laser mode in effect wants it, which the mission plan may
+    // have just changed.
+    const uint32_t powerOffMicros = micros( );
+    const bool laserOn = (getSoftwareStatus( ) == SOFTWARE_RUNNING) ?
+        Mission::isLaserContinuous( isLaserContinuous( ) ) :
+        snapInitialLaserPower;
+    if ( !laserOn )
         Laser::setPower( false );
 
-    // Turn off the camera and intensifier, if it was originally off.
-    if ( !initialCameraPower )
+    // Turn off the camera and intensifier, if it was originally off. The
+    // relays are pulsed by updateCamera().
+    if ( !snapInitialCameraPower )
     {
-        Camera::setPower( false );
+        Camera::beginPower( false );
         setCameraStatus( CAMERA_OFF );
     }
     else
         setCameraStatus( CAMERA_READY );
-
-#ifdef DEBUG_BENCHMARK_SNAP_AND_LOG
-    powerOffTime = (nextTime = millis()) - previousTime;
-    previousTime = nextTime;
-#endif
+    Perf::record( Perf::STAGE_POWER_OFF, powerOffMicros );
 
 
 #if defined(ENABLE_USAGE_TRACKING)
     //
     // Update usage tracking in memory.
     //
-    usage.numberOfImagesSnapped += nImages;
+    usage.numberOfImagesSnapped += snapImages;
     ++usage.numberOfEventsLogged;
     const uint32_t ut = millis( ) / 1000;
     usage.controllerUptimeSeconds += (ut - usage.recentUpdateTime);
     usage.recentUpdateTime = ut;
-#endif
 
-
-    //
-    // Log.
-    //
-    // If there is a data log (and there is while running automaticaly),
-    // then read the sensors and add a data log entry.
-    //
-    // If it is time to update the usage tracking file, get the most recent
-    // values and save them.
-    if ( FileSystem::isDataLogOpen( ) )
+    // If a data log entry was added and it is time to update the usage
+    // tracking, get the most recent values and stage them. They are
+    // committed between frames, so no SD card write is added here.
+    if ( FileSystem::isDataLogOpen( ) && snapStatus &&
+         (USAGE_FILE_UPDATE_INTERVAL_EVENTS <= 1 ||
+         (usage.numberOfEventsLogged % USAGE_FILE_UPDATE_INTERVAL_EVENTS) == 0) )
     {
-        // Read the sensors.
-        Sensors::getWaterPressure( pressure, depth );
-        Sensors::getWaterTemperature( waterTemperature );
-        Sensors::getInertia( accel, mag, gyro, deviceTemperature );
-#ifdef DEBUG_BENCHMARK_SNAP_AND_LOG
-        sensorTime = (nextTime = millis()) - previousTime;
-        previousTime = nextTime;
+        // Copy out the current Camera and Laser counters.
+        usage.numberOfCameraBoots = Camera::getNumberOfPowerOns( );
+        usage.cameraUptimeSeconds = Camera::getUptimeSeconds( );
+        usage.numberOfLaserBoots  = Laser::getNumberOfPowerOns( );
+        usage.laserUptimeSeconds  = Laser::getUptimeSeconds( );
+        FileSystem::stageUsage( usage );
+    }
 #endif
 
-        // Write to the data log.
-        if ( !FileSystem::writeDataLog(
-            Clock::nowString( ),
-            Clock::nowMillisOffset( ),
-            pressure,
-            depth,
-            waterTemperature,
-            deviceTemperature,
-            accel,
-            mag,
-            gyro ) )
-        {
-            // Log file write error. Possible failures:
-            // - The SD card is not inserted.
-            // - The SD card is full.
-            // - The file has reached the 4GB max size for FAT.
-            // - A hardware error has occurred.
-            // - An internal SdFat error has occurred.
-            Serial.print( "Cannot write to data log file.\r\n" );
-            FileSystem::printErrorMessage( );
+    // A running frame's length is how long the laser is on for it, unless
+    // it is on all the time.
+    if ( getSoftwareStatus( ) == SOFTWARE_RUNNING && !snapInitialLaserPower )
+        Planner::addSnap( (micros( ) - snapBeginMicros) / 1000, snapImages );
 
-            if ( FileSystem::isCardPresent( ) )
-            {
-                // Try to log a status message. This will fail silently if the
-                // SD card is full.
-                FileSystem::writeStatus( "Cannot write to data log file" );
-                FileSystem::writeStatus( FileSystem::getErrorMessage( ) );
-            }
-            status = false;
-        }
-#if defined(ENABLE_USAGE_TRACKING)
-        else
-        {
-            // Update the usage tracking file.
-            if ( USAGE_FILE_UPDATE_INTERVAL_EVENTS <= 1 ||
-                (usage.numberOfEventsLogged % USAGE_FILE_UPDATE_INTERVAL_EVENTS) == 0 )
+    Perf::record( Perf::STAGE_FRAME, snapBeginMicros );
+    snapState = SNAP_IDLE;
+}
+
+/**
+ * Advances a snap-and-log in progress, if any.
+ *
+ * This is called on each pass through loop(). Each call takes at most one
+ * step, and then returns, so that switches and serial commands can be
+ * serviced in between. The steps are:
+ *
+ * - Wait for the laser to warm up. Meanwhile, read the inertia sensor,
+ *   batteries, and clock.
+ * - Start the water pressure and temperature conversions, then start
+ *   the camera's burst. The camera's timer presses and releases the
+ *   shutter for each image. Meanwhile, collect the water pressure and
+ *   temperature.
+ * - Once the burst is over, add a data log row for each image.
+ * - Turn off the laser and camera, as needed.
+ *
+ * @see beginSnapAndLog()
+ * @see isSnapping()
+ */
+void updateSnapAndLog( )
+{
+    switch ( snapState )
+    {
+        default:
+        case SNAP_IDLE:
+            return;
+
+        case SNAP_LASER_WARMUP:
+            if ( !Laser::isWarmedUp( ) )
             {
-                // Copy out the current Camera and Laser counters.
-                usage.numberOfCameraBoots = Camera::getNumberOfPowerOns( );
-                usage.cameraUptimeSeconds = Camera::getUptimeSeconds( );
-                usage.numberOfLaserBoots  = Laser::getNumberOfPowerOns( );
-                usage.laserUptimeSeconds  = Laser::getUptimeSeconds( );
-                FileSystem::saveUsage( usage );
+                doSnapAndLogWork( false );
+                return;
             }
-        }
-#endif
 
-#ifdef DEBUG_BENCHMARK_SNAP_AND_LOG
-        logTime = (nextTime = millis()) - previousTime;
-        previousTime = nextTime;
-#endif
+            // Time stamp the entry at the first shutter press.
+            startSnapAndLogWater( );
+            snapState     = SNAP_BURST;
+            snapStateTime = millis( );
+            Camera::startBurst( snapImages );
+            snapRecord.frameMicros = Camera::getBurstPressMicros( 0 );
+            Clock::getTime( snapStateTime, snapRecord.seconds,
+                snapRecord.milliseconds );
+            return;
+
+        case SNAP_BURST:
+            if ( doSnapAndLogWork( false ) || Camera::isBursting( ) )
+                return;
+            break;
     }
 
-#ifdef DEBUG_BENCHMARK_SNAP_AND_LOG
-    Serial.printf( "On %ld |Image %ld |Off %ld |Sensor %ld |Log %ld|= %ld\r\n",
-        powerOnTime,
-        shutterTime,
-        powerOffTime,
-        sensorTime,
-        logTime,
-        (powerOnTime + shutterTime + powerOffTime + sensorTime + logTime) );
-#endif
-    return status;
+    // The burst is over. Finish any remaining work and end.
+    for ( uint8_t i = 0; i < snapImages; ++i )
+        Perf::add( Perf::STAGE_SHUTTER, Camera::getBurstPressLength( i ) );
+    while ( doSnapAndLogWork( true ) )
+        ;
+    endSnapAndLog( );
+}
+
+/**
+ * Queues a snap-and-log to start as soon as the camera is ready.
+ *
+ * This is for snapping outside of a run. If the camera and intensifier
+ * are off, they start powering up now, without waiting, and are turned
+ * off again after the snap-and-log. updateCamera() starts the
+ * snap-and-log once the camera is ready, so loop() carries on servicing
+ * switches and serial commands while the camera boots.
+ *
+ * @param[in] nImages
+ *   The number of images in a burst.
+ *
+ * @return
+ *   Returns false if a snap-and-log is already queued or in progress.
+ *
+ * @see beginSnapAndLog()
+ * @see isSnapQueued()
+ * @see updateCamera()
+ */
+bool queueSnapAndLog( const uint8_t nImages )
+{
+    if ( isSnapping( ) || isSnapQueued( ) || nImages == 0 )
+        return false;
+
+    snapQueuedCameraPower = Camera::isPowerOn( );
+    if ( !snapQueuedCameraPower )
+    {
+        setCameraStatus( CAMERA_BOOTING );
+        Camera::beginPower( true );
+    }
+    snapQueued = nImages;
+    return true;
+}
+
+/**
+ * Returns true if a snap-and-log is queued.
+ *
+ * @return
+ *   Returns true if queued.
+ *
+ * @see queueSnapAndLog()
+ */
+bool isSnapQueued( )
+{
+    return snapQueued > 0;
 }
 
 /**
@@ -576,13 +1341,14 @@ bool snapAndLog( const uint8_t nImages )
  *
  * If the current state is not READY_STATE, no action is taken.
  *
- * The camera and intensifier power is turned on. The lights are set
- * to show the device is running. A new log file is created. A starting
- * photo and sensor reading is logged and the current time noted for
- * tracking frame intervals.
- *
- * There are several delays built in to these steps, so this function
- * does not return quickly.
+ * The mission plan, if any, is loaded first. The run is then planned,
+ * and refused if the SD card or a battery is too low for it (see
+ * Planner::startRun()), unless the device is armed and already at the
+ * start depth, when it is only warned about. A new log file is created.
+ * The camera and intensifier start powering up, without waiting. The
+ * lights are set to show the device is running.
+ * The run's first photo and sensor reading are taken by loop() as soon
+ * as the camera is ready, and its time starts the frame schedule.
  *
  * @return
  *   Returns true on success, false on failure. On failure, error
@@ -591,7 +1357,7 @@ bool snapAndLog( const uint8_t nImages )
  * @see getCameraStatus()
  * @see getHardwareStatus()
  * @see getSoftwareStatus()
- * @see snapAndLog()
+ * @see startFrameSchedule()
  * @see stopRunning()
  */
 bool startRunning( )
@@ -600,6 +1366,47 @@ bool startRunning( )
         return false;
 
     Serial.printf( "Starting...\r\n" );
+
+    // Finish a snap-and-log in progress, and drop a queued one. The run's
+    // first frame takes its place.
+    while ( isSnapping( ) )
+        updateSnapAndLog( );
+    snapQueued = 0;
+
+    // Parse the mission plan, if any, so that the run does not read it
+    // again, and so that the forecast below follows its intervals. A plan
+    // with errors is reported, and the run follows the settings.
+    if ( Mission::startRun( armHasDepth ? armPreviousDepth : 0.0 ) )
+        Serial.print( "Following the mission plan. Type 'mission' for details.\r\n" );
+    else if ( Mission::getErrorLine( ) != 0 )
+    {
+        Serial.print( "Mission plan not used. Following the settings.\r\n" );
+        FileSystem::writeStatus( "Mission plan has errors. Following the settings",
+            FileSystem::STATUS_WARNING );
+    }
+
+    // Forecast the run before its data log takes SD card space. The
+    // planner warns, or lengthens the frame interval, if the run would be
+    // cut short. A run with room for hardly any frames is refused, except
+    // an armed one, which is already at depth and has only this chance.
+    if ( FileSystem::isInitialized( ) &&
+         Planner::startRun( ) == Planner::PLAN_TOO_SHORT )
+    {
+        if ( armState != ARM_RUNNING )
+        {
+            Serial.print( "Cannot start. The SD card or a battery is too low for a run.\r\n" );
+            Serial.print( "Type 'plan' for details.\r\n" );
+            FileSystem::writeStatus( "** Cannot start. SD card or battery too low for a run",
+                FileSystem::STATUS_WARNING );
+            Mission::endRun( );
+            return false;
+        }
+        Serial.print( "Warning: The SD card or a battery is too low for a run. Starting anyway.\r\n" );
+        FileSystem::writeStatus( "SD card or battery too low for a run. Armed, so starting anyway",
+            FileSystem::STATUS_WARNING );
+    }
+
+    DropDetector::reset( );
     if ( !FileSystem::newDataLog( ) )
     {
         // Fail to create a new log. Possible failures:
@@ -611,6 +1418,8 @@ bool startRunning( )
         // FileSystem error codes have been set, so print an error message.
         Serial.print( "Cannot create new data log file.\r\n" );
         FileSystem::printErrorMessage( );
+        Mission::endRun( );
+        setRunFrameInterval( 0 );
 
         if ( !FileSystem::isCardPresent( ) )
         {
@@ -624,7 +1433,8 @@ bool startRunning( )
             // Try to log a status message. This will fail silently if the
             // SD card is full.
             FileSystem::writeStatus( "** Cannot create new data log file" );
-            FileSystem::writeStatus( FileSystem::getErrorMessage( ) );
+            FileSystem::writeStatus( FileSystem::getErrorMessage( ),
+                FileSystem::STATUS_ERROR );
         }
         return false;
     }
@@ -632,44 +1442,26 @@ bool startRunning( )
     // Announce and add a status message.
     char buf[1025];
     const char*const name = FileSystem::getDataLogFilename( );
-    Serial.print( "Camera and intensifier powering up...\r\n" );
     sprintf( buf, "Start running. Logging to %s.", name );
     FileSystem::writeStatus( buf );
 
-    // Turn on the camera. Leave it on while running.
+    // Start turning on the camera, if it is not already. Leave it on
+    // while running.
     setSoftwareStatus( SOFTWARE_RUNNING );
-    setCameraStatus( CAMERA_BOOTING );
-    Camera::setPower( true );
-    setCameraStatus( CAMERA_READY );
+    if ( !Camera::isPowerOn( ) )
+    {
+        Serial.print( "Camera and intensifier powering up...\r\n" );
+        setCameraStatus( CAMERA_BOOTING );
+        Camera::beginPower( true );
+    }
     Serial.printf( "Running. Logging to %s.\r\n", name );
 
     // If the laser mode is continuous, turn on the laser and leave it on.
-    if ( isLaserContinuous( ) )
+    if ( Mission::isLaserContinuous( isLaserContinuous( ) ) )
         Laser::setPower( true );
 
-    // Initial shot.
-    if ( !snapAndLog( burstSize ) )
-    {
-        // Write error on the log. Possible failures:
-        // - The SD card is not inserted.
-        // - The SD card is full.
-        // - The file has reached the 4GB max size for FAT.
-        // - A hardware error has occurred.
-        // - An internal SdFat error has occurred.
-        Camera::setPower( false );
-        Laser::setPower( false );
-        setCameraStatus( CAMERA_OFF );
-        setSoftwareStatus( SOFTWARE_ERRORS );
-
-        if ( !FileSystem::isCardPresent( ) )
-        {
-            Serial.print( "Cannot start running due to critical problems.\r\n" );
-            setHardwareStatus( HARDWARE_ERRORS );
-        }
-        return false;
-    }
-
-    previousLogTime = millis( );
+    // The initial shot, once the camera is ready, starts the frame schedule.
+    startFrameSchedule( );
     Serial.println( );
     return true;
 }
@@ -679,11 +1471,9 @@ bool startRunning( )
  *
  * If the current state is not RUNNING_STATE, no action is taken.
  *
- * The log file is closed. Camera power is turned off. The lights are
- * set to show the device is not running.
- *
- * There are several delays built in to these steps, so this function
- * does not return quickly.
+ * Any snap-and-log in progress is finished. The log file is closed.
+ * Camera power is turned off. The lights are set to show the device is
+ * not running.
  *
  * @return
  *   Returns true on success, false on failure. On failure, error
@@ -692,7 +1482,6 @@ bool startRunning( )
  * @see getCameraStatus()
  * @see getHardwareStatus()
  * @see getSoftwareStatus()
- * @see snapAndLog()
  * @see startRunning()
  */
 bool stopRunning( )
@@ -701,23 +1490,34 @@ bool stopRunning( )
         return false;
 
     Serial.printf( "Stopping...\r\n" );
+
+    // Finish any snap-and-log in progress, so that its entry is logged
+    // and the laser is left off.
+    while ( isSnapping( ) )
+        updateSnapAndLog( );
+
     const uint32_t nEntries = FileSystem::getNumberOfDataLogEntries( );
     const char*const name = FileSystem::getDataLogFilename( );
 
-    // Close the log file.
+    // Close the log file, with the last drop, if any, in its drop index.
+    DropDetector::finish( );
     FileSystem::closeDataLog( );
+    Mission::endRun( );
+    setRunFrameInterval( 0 );
 
-    // Turn off the camera and laser, if they are on.
-    Camera::setPower( false );
+    // Turn off the camera and laser, if they are on. The camera relays are
+    // pulsed by updateCamera().
+    Camera::beginPower( false );
     Laser::setPower( false );
 
     setCameraStatus( CAMERA_OFF );
     setSoftwareStatus( SOFTWARE_READY );
 
     char buf[1025];
-    Serial.printf( "Ready. %ld logged entries in %s\r\n\r\n", nEntries, name );
-    sprintf( buf, "Stop running. %ld logged entries in %s", nEntries, name );
+    Serial.printf( "Ready. %ld logged entries in %s\r\n\r\n", (long) nEntries, name );
+    sprintf( buf, "Stop running. %ld logged entries in %s", (long) nEntries, name );
     FileSystem::writeStatus( buf );
+    FileSystem::flushStatus( );
     Serial.println( );
     return true;
 }
@@ -726,6 +1526,268 @@ bool stopRunning( )
 
 
 
+//----------------------------------------------------------------------
+// Camera power.
+//----------------------------------------------------------------------
+/**
+ * Advances the camera and intensifier power sequence, if any.
+ *
+ * This is called on each pass through loop(), so that the camera's relay
+ * pulses and boot do not hold up switches, serial commands, or battery
+ * checks. When the camera finishes booting, the camera status goes from
+ * CAMERA_BOOTING to CAMERA_READY. Then a queued snap-and-log, if any,
+ * is started.
+ *
+ * @see Camera::update()
+ * @see queueSnapAndLog()
+ */
+void updateCamera( )
+{
+    Camera::update( );
+    if ( !Camera::isReady( ) )
+    {
+        // A queued snap-and-log cannot go ahead if the camera was
+        // turned off meanwhile.
+        if ( !Camera::isPowerOn( ) )
+            snapQueued = 0;
+        return;
+    }
+
+    if ( getCameraStatus( ) == CAMERA_BOOTING )
+    {
+        setCameraStatus( CAMERA_READY );
+        Serial.print( "Camera and intensifier ready.\r\n" );
+    }
+
+    if ( snapQueued > 0 && !isSnapping( ) )
+    {
+        const uint8_t nImages = snapQueued;
+        snapQueued = 0;
+        beginSnapAndLog( nImages );
+
+        // Turn the camera off afterwards if it was off when queued.
+        snapInitialCameraPower = snapQueuedCameraPower;
+    }
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Armed mode.
+//----------------------------------------------------------------------
+/**
+ * Returns true if armed to start and stop runs by depth.
+ *
+ * @return
+ *   Returns true if armed.
+ *
+ * @see setArmed()
+ */
+bool isArmed( )
+{
+    return armState != ARM_OFF;
+}
+
+/**
+ * Arms or disarms the device to start and stop runs by depth.
+ *
+ * While armed, the device waits at the surface with the camera off,
+ * powers up the camera when it is submerged, starts running at the start
+ * depth, and stops running when it is back at the surface. See
+ * updateArmed().
+ *
+ * Disarming powers down a camera that is powering up for a drop, but
+ * leaves a run in progress running. Like the telemetry stream, this is
+ * not saved, so the device is disarmed after a reboot.
+ *
+ * @param[in] onOff
+ *   True to arm, and false to disarm.
+ *
+ * @return
+ *   Returns true if the change is accepted. Arming needs the device to
+ *   be ready, and not running, with a pressure sensor.
+ *
+ * @see isArmed()
+ * @see updateArmed()
+ */
+bool setArmed( const bool onOff )
+{
+    if ( onOff == isArmed( ) )
+        return true; // No change.
+
+    if ( !onOff )
+    {
+        if ( armState == ARM_WARMING )
+        {
+            // The relays are pulsed by updateCamera().
+            Camera::beginPower( false );
+            setCameraStatus( CAMERA_OFF );
+        }
+        armState = ARM_OFF;
+        FileSystem::writeStatus( "Disarmed." );
+        return true;
+    }
+
+    if ( getSoftwareStatus( ) != SOFTWARE_READY ||
+         !Sensors::isPressureSensorPresent( ) )
+        return false;
+    armState    = ARM_WAITING;
+    armPolling  = false;
+    armPollTime = millis( ) - ARM_POLL_INTERVAL;
+    armHasDepth = false;
+    FileSystem::writeStatus( "Armed." );
+    return true;
+}
+
+/**
+ * Polls the water depth without waiting.
+ *
+ * A reading is started every ARM_POLL_INTERVAL ms, and collected by a
+ * later call once its conversion is done.
+ *
+ * @param[out] depth
+ *   The depth, in m, when a reading is collected.
+ *
+ * @return
+ *   Returns true if a new reading was collected.
+ *
+ * @see updateArmed()
+ */
+bool pollArmedDepth( float& depth )
+{
+    if ( !armPolling )
+    {
+        if ( (millis( ) - armPollTime) < ARM_POLL_INTERVAL )
+            return false;
+        armPollTime = millis( );
+        Sensors::startWaterPressure( );
+        armPolling = true;
+        return false;
+    }
+    if ( !Sensors::updateWaterPressure( ) )
+        return false;
+
+    float pressure;
+    Sensors::getWaterPressure( pressure, depth );
+    armPolling = false;
+    return true;
+}
+
+/**
+ * Starts and stops runs by depth, while armed.
+ *
+ * - Waiting: the depth is polled. When the device is deeper than
+ *   ARM_WAKE_DEPTH, or descending faster than ARM_WAKE_RATE, the camera
+ *   and intensifier start powering up, without waiting for them.
+ *
+ * - Warming: the depth is polled. Once the device is at the start depth
+ *   and the camera is ready, running starts, with a new data log. If the
+ *   device stays shallower than ARM_WAKE_DEPTH for ARM_SURFACE_TIME ms,
+ *   the camera starts powering down, without waiting, and waiting
+ *   resumes.
+ *
+ * - Running: each frame's depth is checked. Once frames have been
+ *   shallower than ARM_SURFACE_DEPTH for ARM_SURFACE_TIME ms, running
+ *   stops and waiting resumes for the next drop.
+ *
+ * This is called from loop() between snap-and-logs.
+ *
+ * @see setArmed()
+ */
+void updateArmed( )
+{
+    const uint32_t currentTime = millis( );
+    float depth;
+    char buf[128];
+    switch ( armState )
+    {
+        default:
+        case ARM_OFF:
+            return;
+
+        case ARM_WAITING:
+        case ARM_WARMING:
+            if ( getSoftwareStatus( ) != SOFTWARE_READY ||
+                 !pollArmedDepth( depth ) )
+                return;
+            break;
+
+        case ARM_RUNNING:
+            if ( getSoftwareStatus( ) != SOFTWARE_RUNNING )
+            {
+                // The run was stopped some other way.
+                armState = ARM_OFF;
+                return;
+            }
+
+            // The most recent frame's depth.
+            if ( snapRecord.depth >= ARM_SURFACE_DEPTH )
+                armDeepTime = currentTime;
+            else if ( (currentTime - armDeepTime) >= ARM_SURFACE_TIME )
+            {
+                FileSystem::writeStatus( "Surfaced." );
+                Serial.print( "Surfaced.\r\n" );
+                stopRunning( );
+                armState    = ARM_WAITING;
+                armHasDepth = false;
+            }
+            return;
+    }
+
+    // Descent rate since the previous poll.
+    float rate = 0.0;
+    if ( armHasDepth && currentTime != armPreviousTime )
+        rate = (depth - armPreviousDepth) * 1000.0 / (currentTime - armPreviousTime);
+    armHasDepth      = true;
+    armPreviousDepth = depth;
+    armPreviousTime  = currentTime;
+
+    if ( armState == ARM_WAITING )
+    {
+        if ( depth < ARM_WAKE_DEPTH && rate < ARM_WAKE_RATE )
+            return;
+        sprintf( buf, "Submerged at %.2f m. Camera and intensifier powering up.",
+            depth );
+        FileSystem::writeStatus( buf );
+        Serial.printf( "%s\r\n", buf );
+        setCameraStatus( CAMERA_BOOTING );
+        Camera::beginPower( true );
+        armState    = ARM_WARMING;
+        armDeepTime = currentTime;
+        return;
+    }
+
+    // Warming.
+    if ( depth >= ARM_WAKE_DEPTH )
+        armDeepTime = currentTime;
+    else if ( (currentTime - armDeepTime) >= ARM_SURFACE_TIME )
+    {
+        FileSystem::writeStatus( "Back at the surface before the start depth." );
+        Camera::beginPower( false );
+        setCameraStatus( CAMERA_OFF );
+        armState = ARM_WAITING;
+        return;
+    }
+    if ( depth < startDepth || !Camera::isReady( ) )
+        return;
+
+    armState    = ARM_RUNNING;
+    armDeepTime = currentTime;
+    if ( !startRunning( ) )
+    {
+        // startRunning() has reported the problem.
+        Camera::beginPower( false );
+        setCameraStatus( CAMERA_OFF );
+        armState = ARM_OFF;
+    }
+}
+
+
+
+
+
 //----------------------------------------------------------------------
 // Battery checking.
 //----------------------------------------------------------------------
@@ -735,7 +1797,8 @@ bool stopRunning( )
  *
  * If a battery goes low, the hardware status is changed to a warning
  * and a message is logged and printed. This does not stop the device
- * from continuing to run.
+ * from continuing to run, but buffered data log rows are synced to the
+ * SD card in case power is lost.
  *
  * If a battery goes critically low, the hardware and software status
  * are changed to an error state and a message is logged and printed.
@@ -746,18 +1809,21 @@ bool stopRunning( )
  * won't go back until the device is rebooted (and presumably a new
  * battery is installed first).
  *
+ * The battery levels checked are those of the most recent battery
+ * sample, so this does not touch the I2C bus.
+ *
  * @see getSoftwareStatus()
  * @see setHardwareSTatus()
  * @see setSoftwareStatus()
  * @see stopRunning()
- * @see Battery::getControllerPercent()
- * @see Battery::getMainPercent()
+ * @see Battery::getSampledControllerPercent()
+ * @see Battery::getSampledMainPercent()
  */
 void checkBatteries( )
 {
     if ( Battery::isMainPresent( ) )
     {
-        const float percent = Battery::getMainPercent( );
+        const float percent = Battery::getSampledMainPercent( );
         if ( percent < BATTERY_ERROR_PERCENT )
         {
             // Very low main battery is critical.
@@ -772,7 +1838,9 @@ void checkBatteries( )
                 setSoftwareStatus( SOFTWARE_ERRORS );
 #endif
                 mainBatteryState = BATTERY_CRITICAL;
-                FileSystem::writeStatus( "** Main battery is critically low." );
+                FileSystem::syncDataLog( );
+                FileSystem::writeStatus( "** Main battery is critically low.",
+                    FileSystem::STATUS_ERROR );
                 Serial.print( "** Main battery is critically low.\r\n" );
             }
         }
@@ -785,7 +1853,9 @@ void checkBatteries( )
                 // status and post a message.
                 setHardwareStatus( HARDWARE_WARNINGS );
                 mainBatteryState = BATTERY_LOW;
-                FileSystem::writeStatus( "** Main battery is low." );
+                FileSystem::syncDataLog( );
+                FileSystem::writeStatus( "** Main battery is low.",
+                    FileSystem::STATUS_WARNING );
                 Serial.print( "** Main battery is low.\r\n" );
             }
         }
@@ -793,7 +1863,7 @@ void checkBatteries( )
 
     if ( Battery::isControllerPresent( ) )
     {
-        const float percent = Battery::getControllerPercent( );
+        const float percent = Battery::getSampledControllerPercent( );
         if ( percent < BATTERY_ERROR_PERCENT )
         {
             // Very low controller battery is critical.
@@ -808,7 +1878,9 @@ void checkBatteries( )
                 setSoftwareStatus( SOFTWARE_ERRORS );
 #endif
                 controllerBatteryState = BATTERY_CRITICAL;
-                FileSystem::writeStatus( "** Controller battery is critically low." );
+                FileSystem::syncDataLog( );
+                FileSystem::writeStatus( "** Controller battery is critically low.",
+                    FileSystem::STATUS_ERROR );
                 Serial.print( "** Controller battery is critically low.\r\n" );
             }
         }
@@ -821,7 +1893,9 @@ void checkBatteries( )
                 // status and post a message.
                 setHardwareStatus( HARDWARE_WARNINGS );
                 controllerBatteryState = BATTERY_LOW;
-                FileSystem::writeStatus( "** Controller battery is low." );
+                FileSystem::syncDataLog( );
+                FileSystem::writeStatus( "** Controller battery is low.",
+                    FileSystem::STATUS_WARNING );
                 Serial.print( "** Controller battery is low.\r\n" );
             }
         }
@@ -951,7 +2025,7 @@ void setup( )
 #if defined(ENABLE_BATTERY_CHECK)
     else
     {
-        const float percent = Battery::getControllerPercent( );
+        const float percent = Battery::getSampledControllerPercent( );
         if ( percent < BATTERY_ERROR_PERCENT )
         {
             // Very low controller battery is critical.
@@ -988,7 +2062,7 @@ void setup( )
 #if defined(ENABLE_BATTERY_CHECK)
     else
     {
-        const float percent = Battery::getMainPercent( );
+        const float percent = Battery::getSampledMainPercent( );
         if ( percent < BATTERY_ERROR_PERCENT )
         {
             // Very low main battery is critical.
@@ -1072,16 +2146,29 @@ void setup( )
         uint32_t interval = getFrameInterval( );
         bool laser = isLaserContinuous( );
         uint8_t burst = getBurstSize( );
-        if ( FileSystem::loadSettings( interval, laser, burst ) )
+        float spacing = getFrameSpacing( );
+        uint32_t maximumInterval = getMaximumFrameInterval( );
+        float depth = getStartDepth( );
+        if ( FileSystem::loadSettings( interval, laser, burst, spacing,
+            maximumInterval, depth ) )
         {
             setFrameInterval( interval );
             setLaserContinuous( laser );
             setBurstSize( burst );
+            setFrameSpacing( spacing );
+            setMaximumFrameInterval( maximumInterval );
+            setStartDepth( depth );
         }
         else
         {
-            // No Settings file yet. Create one.
-            FileSystem::saveSettings( interval, laser, burst );
+            // No settings yet. Stage the defaults, to be committed to a
+            // new settings journal.
+            FileSystem::stageInteger( FileSystem::KEY_INTERVAL, interval );
+            FileSystem::stageInteger( FileSystem::KEY_BURST_SIZE, burst );
+            FileSystem::stageInteger( FileSystem::KEY_LASER_CONTINUOUS, laser ? 1 : 0 );
+            FileSystem::stageFloat( FileSystem::KEY_SPACING, spacing );
+            FileSystem::stageInteger( FileSystem::KEY_MAXIMUM_INTERVAL, maximumInterval );
+            FileSystem::stageFloat( FileSystem::KEY_START_DEPTH, depth );
         }
     }
 
@@ -1140,7 +2227,8 @@ void setup( )
         Serial.print( "** Cannot run due to critical hardware problems.\r\n" );
         Serial.print( "Type 'hwinfo' for hardware info.\r\n" );
         if ( !fileSystemFail )
-            FileSystem::writeStatus( "** Cannot run due to critical hardware problems." );
+            FileSystem::writeStatus( "** Cannot run due to critical hardware problems.",
+                FileSystem::STATUS_ERROR );
     }
     else if ( nWarnings > 0 )
     {
@@ -1173,7 +2261,7 @@ void setup( )
         usage.cameraUptimeSeconds = Camera::getUptimeSeconds( );
         usage.numberOfLaserBoots  = Laser::getNumberOfPowerOns( );
         usage.laserUptimeSeconds  = Laser::getUptimeSeconds( );
-        FileSystem::saveUsage( usage );
+        FileSystem::stageUsage( usage );
     }
 #endif
 }
@@ -1187,17 +2275,32 @@ void setup( )
  */
 void loop( )
 {
-    uint32_t currentTime = millis( );
-
     // For any run state, check for and run serial port commands. This
     // allows status checks and file downloads even when there are
     // hardware errors.
     //Commands::processCommands( );
 
+    // Sample the batteries and resynchronize the clock periodically, but
+    // not during a snap-and-log, so that the I2C reads don't delay it.
+    if ( !isSnapping( ) )
+    {
+        Battery::update( );
+        Clock::update( );
+    }
+
+    // Write queued status messages and commit staged settings while
+    // idle. While running, that is done between frames, below.
+    if ( getSoftwareStatus( ) != SOFTWARE_RUNNING && !isSnapping( ) )
+    {
+        FileSystem::updateStatus( );
+        FileSystem::updateSettings( );
+    }
+
 #if defined(ENABLE_BATTERY_CHECK)
     // Check batteries periodically. If a battery goes low or critically
     // low, the hardware and software status may change and snap and log
     // may stop.
+    const uint32_t currentTime = millis( );
     if ( (currentTime - previousBatteryCheckTime) >= BATTERY_CHECK_INTERVAL )
     {
         previousBatteryCheckTime = currentTime;
@@ -1205,6 +2308,19 @@ void loop( )
     }
 #endif
 
+#if defined(ENABLE_IMU_FIFO)
+    // Drain the IMU FIFO before it overflows. The camera's timer keeps
+    // the shutter timing meanwhile.
+    updateInertia( false );
+#endif
+
+    // Advance the camera power sequence, which may start a queued
+    // snap-and-log, and any snap-and-log in progress. This is done for any
+    // run state, so that a snap-and-log always finishes and turns off the
+    // laser.
+    updateCamera( );
+    updateSnapAndLog( );
+
     // Updates switch state.
     Switches::update( );
 
@@ -1228,28 +2344,42 @@ void loop( )
     }
 
     // If the start/stop switch is pressed, toggle between RUNNING and
-    // READY states.
+    // READY states. Either way, this takes over from armed mode.
     if ( Switches::isStartStopPressed( ) )
     {
+        setArmed( false );
         if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
             stopRunning( );
         else
         {
-            // This automatically takes the first photo.
+            // This takes the first photo once the camera is ready.
             startRunning( );
         }
         return;
     }
 
-    // While running, check if enough time has elapsed since the last
-    // snapshot and log entry.  If so, snap a picture and log sensors.
-    if ( getSoftwareStatus( ) == SOFTWARE_RUNNING )
+    // While armed, watch the depth to start and stop runs.
+    if ( !isSnapping( ) )
+        updateArmed( );
+
+    // While running, check if the next frame is due. If so, start to snap
+    // a picture and log sensors. Otherwise sync buffered data log rows if
+    // they have waited too long, write queued status messages, and commit
+    // staged settings.
+    if ( getSoftwareStatus( ) == SOFTWARE_RUNNING && !isSnapping( ) )
     {
-        currentTime = millis( );
-        if ( (currentTime - previousLogTime) >= frameInterval )
+        if ( updateFrameSchedule( ) )
+            beginSnapAndLog( Mission::getBurstSize( getBurstSize( ) ) );
+        else
         {
-            previousLogTime = currentTime;
-            snapAndLog( getBurstSize( ) );
+            if ( !FileSystem::updateDataLog( ) )
+            {
+                Serial.print( "Cannot write to data log file.\r\n" );
+                FileSystem::printErrorMessage( );
+            }
+            FileSystem::updateStatus( );
+            FileSystem::updateSettings( );
+            Planner::update( );
         }
     }
 }
@@ -0,0 +1,193 @@
+#pragma once
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+//----------------------------------------------------------------------
+// Simulated time.
+//----------------------------------------------------------------------
+// The simulated clock, in us since boot. It only moves forward when the
+// firmware calls a stand-in, by the time the real call would take. Every
+// call costs at least HOST_CALL_COST_US, so that polling loops end.
+#define HOST_CALL_COST_US 2
+
+extern uint64_t hostClockMicros;
+
+/**
+ * Advances the simulated clock.
+ *
+ * In real time mode (-p), the simulated clock follows the host's clock
+ * instead, and long advances sleep.
+ *
+ * @param[in] us
+ *   The time to advance, in us.
+ */
+void hostAdvance( const uint64_t us );
+
+
+//----------------------------------------------------------------------
+// Serial port.
+//----------------------------------------------------------------------
+/**
+ * Queues a line of serial input, as though typed at the given time.
+ *
+ * @param[in] atMicros
+ *   The simulated time, in us since boot.
+ * @param[in] line
+ *   The line, without a line ending.
+ */
+void hostQueueInput( const uint64_t atMicros, const std::string& line );
+
+/**
+ * Connects the serial port to a new pseudo-terminal, and switches to
+ * real time, so that host tools such as pltget can talk to the logger.
+ *
+ * @return
+ *   Returns the pseudo-terminal's device path, or an empty string on
+ *   failure.
+ */
+std::string hostOpenPty( );
+
+// In pseudo-terminal mode, drop every Nth serial write of more than 100
+// bytes, to test host tools' recovery. Zero to drop nothing.
+extern uint32_t hostSerialDropEvery;
+
+
+//----------------------------------------------------------------------
+// SD card model.
+//----------------------------------------------------------------------
+typedef struct HostSdModel
+{
+    // The host directory that holds the card's files.
+    std::string root = "sdcard";
+
+    // Card geometry.
+    uint64_t capacityBytes = 1ull << 30;
+    uint32_t clusterBytes = 32768;
+
+    // Modeled costs, in us.
+    uint32_t sectorWriteMicros = 250;       // Per whole 512-byte sector.
+    uint32_t cachedWriteMicros = 60;        // Extra for a partial sector.
+    uint32_t syncMicros = 4000;             // Per sync.
+    uint32_t clusterAllocMicros = 3000;     // Per cluster as a file grows.
+    uint32_t freeCountMicrosPerGB = 2000000;// Counting free clusters.
+
+    // Every Nth sync takes spikeMicros longer, like a card's occasional
+    // internal housekeeping. Zero for none.
+    uint32_t spikeEvery = 0;
+    uint32_t spikeMicros = 0;
+
+    // Counters.
+    uint64_t writes = 0;
+    uint64_t syncs = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t clustersAllocated = 0;
+} HostSdModel;
+
+extern HostSdModel hostSd;
+
+
+//----------------------------------------------------------------------
+// Environment model.
+//----------------------------------------------------------------------
+typedef struct HostEnvironment
+{
+    // Piecewise-linear depth profile of (seconds, meters) points. The
+    // water cools with depth from the surface temperature.
+    std::vector<std::pair<double, double>> depth;
+    double surfaceTemperature = 18.0;       // C.
+    double temperatureLapse = 0.02;         // C/m.
+
+    // Time for the batteries to drain, in hours.
+    double batteryHours = 10.0;
+
+    // How fast the processor's millis() and micros() run compared to the
+    // real time clock, in parts per million.
+    double counterPpm = 0.0;
+
+    // Real time clock presence and starting date, in seconds since 1970.
+    bool rtcPresent = true;
+    uint32_t rtcBaseUnix = 1700000000;
+} HostEnvironment;
+
+extern HostEnvironment hostEnv;
+
+/**
+ * Returns the scripted depth at a time.
+ *
+ * @param[in] us
+ *   The simulated time, in us since boot.
+ *
+ * @return
+ *   Returns the depth, in meters.
+ */
+double hostDepthAt( const uint64_t us );
+
+/**
+ * Returns the water temperature at a time.
+ *
+ * @param[in] us
+ *   The simulated time, in us since boot.
+ *
+ * @return
+ *   Returns the temperature, in C.
+ */
+double hostTemperatureAt( const uint64_t us );
+
+
+//----------------------------------------------------------------------
+// I2C devices.
+//----------------------------------------------------------------------
+/**
+ * A simulated device on the I2C bus, registered in hostWireDevices by
+ * its address.
+ */
+class HostWireDevice
+{
+public:
+    virtual ~HostWireDevice( ) { }
+
+    /**
+     * Receives the bytes of a write transaction.
+     *
+     * @param[in] bytes
+     *   The bytes written.
+     */
+    virtual void receive( const std::vector<uint8_t>& bytes ) = 0;
+
+    /**
+     * Answers a read transaction.
+     *
+     * @param[out] bytes
+     *   The bytes read.
+     * @param[in] n
+     *   The number of bytes requested.
+     */
+    virtual void request( std::vector<uint8_t>& bytes, const uint8_t n ) = 0;
+};
+
+extern HostWireDevice* hostWireDevices[128];
+
+
+//----------------------------------------------------------------------
+// Measurements.
+//----------------------------------------------------------------------
+typedef struct HostStats
+{
+    // Camera shutter presses: count, and the shortest, longest, and total
+    // time between presses, in us.
+    uint64_t numberOfShutters = 0;
+    uint64_t recentShutterMicros = 0;
+    uint64_t minimumShutterGap = UINT64_MAX;
+    uint64_t maximumShutterGap = 0;
+    uint64_t totalShutterGap = 0;
+
+    // Calls to loop(), and the longest one, in us.
+    uint64_t numberOfLoops = 0;
+    uint64_t maximumLoopMicros = 0;
+} HostStats;
+
+extern HostStats hostStats;
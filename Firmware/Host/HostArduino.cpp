@@ -0,0 +1,432 @@
+//----------------------------------------------------------------------
+// Host stand-ins for the Arduino core: time, pins, and the serial port.
+//----------------------------------------------------------------------
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <deque>
+#include <string>
+
+#include <Adafruit_ZeroTimer.h>
+#include <Arduino.h>
+
+#include "Host.h"
+#include "pins.h"
+
+
+uint64_t hostClockMicros = 0;
+HostStats hostStats;
+HostSerial Serial;
+uint32_t hostSerialDropEvery = 0;
+
+// Pin levels, as last written.
+static uint8_t pinLevels[64];
+
+// Scripted serial input lines, in time order, and input ready to read.
+typedef struct ScriptLine
+{
+    uint64_t atMicros;
+    std::string line;
+} ScriptLine;
+static std::deque<ScriptLine> scriptLines;
+static std::string serialInput;
+
+// The pseudo-terminal in real time mode, or -1.
+static int ptyFd = -1;
+
+// Enabled timers, by timer number.
+static Adafruit_ZeroTimer* timers[8];
+
+static void runTimers( const uint64_t untilMicros );
+
+
+
+
+
+//----------------------------------------------------------------------
+// Time.
+//----------------------------------------------------------------------
+/**
+ * Returns the host's clock, in us since the first call.
+ *
+ * @return
+ *   Returns the time.
+ */
+static uint64_t getRealMicros( )
+{
+    static uint64_t startMicros = 0;
+    struct timeval tv;
+    gettimeofday( &tv, nullptr );
+    const uint64_t now = (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+    if ( startMicros == 0 )
+        startMicros = now;
+    return now - startMicros;
+}
+
+/**
+ * Advances the simulated clock.
+ *
+ * @param[in] us
+ *   The time to advance, in us.
+ */
+void hostAdvance( const uint64_t us )
+{
+    if ( ptyFd < 0 )
+    {
+        // Timer interrupts due meanwhile happen at their own times.
+        const uint64_t end = hostClockMicros + us;
+        runTimers( end );
+        hostClockMicros = std::max( hostClockMicros, end );
+        return;
+    }
+
+    // Real time mode.
+    if ( us > 100 )
+        usleep( us );
+    const uint64_t now = getRealMicros( );
+    if ( now > hostClockMicros )
+        hostClockMicros = now;
+    runTimers( hostClockMicros );
+}
+
+uint32_t millis( )
+{
+    hostAdvance( HOST_CALL_COST_US );
+    return (uint32_t) (hostClockMicros * (1.0 + hostEnv.counterPpm / 1e6) / 1000);
+}
+
+uint32_t micros( )
+{
+    hostAdvance( HOST_CALL_COST_US );
+    return (uint32_t) (hostClockMicros * (1.0 + hostEnv.counterPpm / 1e6));
+}
+
+void delay( uint32_t ms )
+{
+    hostAdvance( (uint64_t) ms * 1000 );
+}
+
+void delayMicroseconds( uint32_t us )
+{
+    hostAdvance( us );
+}
+
+void yield( )
+{
+    hostAdvance( HOST_CALL_COST_US );
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Pins.
+//----------------------------------------------------------------------
+void pinMode( uint8_t, uint8_t )
+{
+}
+
+void digitalWrite( uint8_t pin, uint8_t value )
+{
+    if ( pin >= sizeof( pinLevels ) )
+        return;
+
+    // Measure the time between camera shutter presses.
+    if ( pin == CAMERA_SHUTTER_PIN && value == HIGH && pinLevels[pin] != HIGH )
+    {
+        if ( hostStats.numberOfShutters != 0 )
+        {
+            const uint64_t gap = hostClockMicros - hostStats.recentShutterMicros;
+            hostStats.minimumShutterGap = std::min( hostStats.minimumShutterGap, gap );
+            hostStats.maximumShutterGap = std::max( hostStats.maximumShutterGap, gap );
+            hostStats.totalShutterGap += gap;
+        }
+        hostStats.recentShutterMicros = hostClockMicros;
+        ++hostStats.numberOfShutters;
+    }
+    pinLevels[pin] = value;
+}
+
+int digitalRead( uint8_t pin )
+{
+    return (pin < sizeof( pinLevels )) ? pinLevels[pin] : 0;
+}
+
+int analogRead( uint8_t )
+{
+    return 0;
+}
+
+void noInterrupts( )
+{
+}
+
+void interrupts( )
+{
+}
+
+void attachInterrupt( uint8_t, void (*)( void ), int )
+{
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Timers.
+//----------------------------------------------------------------------
+/**
+ * Returns a timer's period, from one compare match to the next.
+ *
+ * The timer counts the 48 MHz clock, which runs fast or slow with the
+ * millisecond counter.
+ *
+ * @param[in] timer
+ *   The timer.
+ *
+ * @return
+ *   Returns the period, in simulated ns.
+ */
+static uint64_t getTimerPeriodNanos( const Adafruit_ZeroTimer& timer )
+{
+    const double ticks = (double) (timer.compare + 1) * timer.prescaler;
+    return (uint64_t) (ticks * 1000.0 / 48.0 / (1.0 + hostEnv.counterPpm / 1e6) + 0.5);
+}
+
+/**
+ * Calls the callbacks of timers that match up to a time, in time order.
+ *
+ * The clock is moved to each match before its callback is called, as
+ * though the timer's interrupt had broken into whatever the firmware
+ * was doing. Calls from within a callback do nothing.
+ *
+ * @param[in] untilMicros
+ *   The simulated time, in us since boot.
+ */
+static void runTimers( const uint64_t untilMicros )
+{
+    static bool inTimer = false;
+    if ( inTimer )
+        return;
+    inTimer = true;
+
+    for ( ;; )
+    {
+        Adafruit_ZeroTimer* next = nullptr;
+        for ( Adafruit_ZeroTimer* timer : timers )
+            if ( timer != nullptr &&
+                 (next == nullptr || timer->matchNanos < next->matchNanos) )
+                next = timer;
+        if ( next == nullptr || next->matchNanos > untilMicros * 1000 )
+            break;
+
+        const uint64_t matchNanos = next->matchNanos;
+        hostClockMicros = std::max( hostClockMicros, (matchNanos + 999) / 1000 );
+        if ( next->callback != nullptr )
+            next->callback( );
+        if ( next->enabled )
+            next->matchNanos = matchNanos + getTimerPeriodNanos( *next );
+    }
+
+    inTimer = false;
+}
+
+void Adafruit_ZeroTimer::configure( tc_clock_prescaler prescale, tc_counter_size,
+    tc_wave_generation, tc_count_direction )
+{
+    // Configuring resets the timer.
+    enable( false );
+    prescaler = prescale;
+    compare   = 0;
+    callback  = nullptr;
+}
+
+void Adafruit_ZeroTimer::setCompare( uint8_t channel, uint32_t value )
+{
+    if ( channel == 0 )
+        compare = value;
+}
+
+void Adafruit_ZeroTimer::setCallback( boolean on, tc_callback type,
+    void (*function)( void ) )
+{
+    if ( type == TC_CALLBACK_CC_CHANNEL0 )
+        callback = on ? function : nullptr;
+}
+
+void Adafruit_ZeroTimer::enable( boolean on )
+{
+    if ( on && !enabled )
+        matchNanos = hostClockMicros * 1000 + getTimerPeriodNanos( *this );
+    enabled = on;
+    timers[number % 8] = on ? this : nullptr;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Serial port.
+//----------------------------------------------------------------------
+/**
+ * Queues a line of serial input, as though typed at the given time.
+ *
+ * @param[in] atMicros
+ *   The simulated time, in us since boot.
+ * @param[in] line
+ *   The line, without a line ending.
+ */
+void hostQueueInput( const uint64_t atMicros, const std::string& line )
+{
+    ScriptLine scriptLine = { atMicros, line };
+    scriptLines.push_back( scriptLine );
+}
+
+/**
+ * Connects the serial port to a new pseudo-terminal, and switches to
+ * real time.
+ *
+ * @return
+ *   Returns the pseudo-terminal's device path, or an empty string on
+ *   failure.
+ */
+std::string hostOpenPty( )
+{
+    const int fd = posix_openpt( O_RDWR | O_NOCTTY );
+    if ( fd < 0 || grantpt( fd ) != 0 || unlockpt( fd ) != 0 )
+        return "";
+
+    struct termios tio;
+    tcgetattr( fd, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( fd, TCSANOW, &tio );
+    fcntl( fd, F_SETFL, O_NONBLOCK );
+
+    ptyFd = fd;
+    hostClockMicros = getRealMicros( );
+    return ptsname( fd );
+}
+
+/**
+ * Moves scripted lines that are due, and pseudo-terminal input, to the
+ * serial input.
+ */
+static void pumpInput( )
+{
+    while ( !scriptLines.empty( ) && scriptLines.front( ).atMicros <= hostClockMicros )
+    {
+        serialInput += scriptLines.front( ).line;
+        serialInput += "\r";
+        scriptLines.pop_front( );
+    }
+
+    if ( ptyFd >= 0 )
+    {
+        uint8_t bytes[512];
+        const ssize_t n = ::read( ptyFd, bytes, sizeof( bytes ) );
+        if ( n > 0 )
+            serialInput.append( (const char*) bytes, n );
+    }
+}
+
+size_t Print::printf( const char* format, ... )
+{
+    char buffer[2048];
+    va_list args;
+    va_start( args, format );
+    const int n = vsnprintf( buffer, sizeof( buffer ), format, args );
+    va_end( args );
+    if ( n < 0 )
+        return 0;
+    return write( (const uint8_t*) buffer, strlen( buffer ) );
+}
+
+size_t Stream::readBytesUntil( char terminator, char* buffer, size_t n )
+{
+    size_t i = 0;
+    while ( i < n )
+    {
+        const int c = read( );
+        if ( c < 0 || c == terminator )
+            break;
+        buffer[i++] = (char) c;
+    }
+    return i;
+}
+
+size_t Stream::readBytes( char* buffer, size_t n )
+{
+    size_t i = 0;
+    while ( i < n )
+    {
+        const int c = read( );
+        if ( c < 0 )
+            break;
+        buffer[i++] = (char) c;
+    }
+    return i;
+}
+
+int HostSerial::available( )
+{
+    pumpInput( );
+    return (int) serialInput.size( );
+}
+
+int HostSerial::read( )
+{
+    pumpInput( );
+    if ( serialInput.empty( ) )
+        return -1;
+    const int c = (uint8_t) serialInput[0];
+    serialInput.erase( 0, 1 );
+    return c;
+}
+
+int HostSerial::peek( )
+{
+    pumpInput( );
+    return serialInput.empty( ) ? -1 : (uint8_t) serialInput[0];
+}
+
+int HostSerial::availableForWrite( )
+{
+    // As for the USB serial port, which has a 64-byte endpoint.
+    return 63;
+}
+
+size_t HostSerial::write( uint8_t c )
+{
+    return write( &c, 1 );
+}
+
+size_t HostSerial::write( const uint8_t* bytes, size_t n )
+{
+    if ( ptyFd < 0 )
+    {
+        fwrite( bytes, 1, n, stdout );
+        return n;
+    }
+
+    static uint32_t numberOfLargeWrites = 0;
+    if ( n > 100 && hostSerialDropEvery != 0 &&
+         ++numberOfLargeWrites % hostSerialDropEvery == 0 )
+        return n;       // Dropped.
+
+    size_t i = 0;
+    while ( i < n )
+    {
+        const ssize_t written = ::write( ptyFd, bytes + i, n - i );
+        if ( written > 0 )
+            i += written;
+        else
+            usleep( 100 );
+    }
+    return n;
+}
@@ -0,0 +1,838 @@
+//----------------------------------------------------------------------
+// Host stand-ins for the I2C bus and the devices on it: the real time
+// clock, battery monitors, pressure and temperature sensors, and the
+// inertia module.
+//----------------------------------------------------------------------
+#include <time.h>
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_LC709203F.h>
+#include <Adafruit_LSM9DS1.h>
+#include <MS5837.h>
+#include <RTClib.h>
+#include <TSYS01.h>
+
+#include "Host.h"
+
+
+HostEnvironment hostEnv;
+HostWireDevice* hostWireDevices[128];
+
+// Standard gravity and sea level pressure, for depth.
+static const double GRAVITY = 9.80665;          // m/s^2.
+static const double SEA_LEVEL_PRESSURE = 101300.0; // Pa.
+static const double WATER_DENSITY = 1029.0;     // kg/m^3.
+
+
+
+
+
+//----------------------------------------------------------------------
+// Environment.
+//----------------------------------------------------------------------
+/**
+ * Returns the scripted depth at a time.
+ *
+ * @param[in] us
+ *   The simulated time, in us since boot.
+ *
+ * @return
+ *   Returns the depth, in meters.
+ */
+double hostDepthAt( const uint64_t us )
+{
+    const double t = us / 1e6;
+    const std::vector<std::pair<double, double>>& points = hostEnv.depth;
+    if ( points.empty( ) )
+        return 0.0;
+    if ( t <= points.front( ).first )
+        return points.front( ).second;
+
+    for ( size_t i = 1; i < points.size( ); ++i )
+    {
+        if ( t <= points[i].first )
+        {
+            const double f = (t - points[i-1].first) / (points[i].first - points[i-1].first);
+            return points[i-1].second + f * (points[i].second - points[i-1].second);
+        }
+    }
+    return points.back( ).second;
+}
+
+/**
+ * Returns the water temperature at a time.
+ *
+ * @param[in] us
+ *   The simulated time, in us since boot.
+ *
+ * @return
+ *   Returns the temperature, in C.
+ */
+double hostTemperatureAt( const uint64_t us )
+{
+    return hostEnv.surfaceTemperature - hostEnv.temperatureLapse * hostDepthAt( us );
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// I2C bus.
+//----------------------------------------------------------------------
+TwoWire Wire;
+
+static uint8_t wireAddress;
+static std::vector<uint8_t> wireOutput;
+static std::vector<uint8_t> wireInput;
+static size_t wireInputIndex;
+
+void TwoWire::beginTransmission( uint8_t address )
+{
+    wireAddress = address;
+    wireOutput.clear( );
+}
+
+size_t TwoWire::write( uint8_t value )
+{
+    wireOutput.push_back( value );
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission( bool )
+{
+    hostAdvance( 100 + 25 * wireOutput.size( ) );
+    HostWireDevice* device = (wireAddress < 128) ? hostWireDevices[wireAddress] : nullptr;
+    if ( device == nullptr )
+        return 2;       // Address not acknowledged.
+    device->receive( wireOutput );
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom( uint8_t address, uint8_t n, bool )
+{
+    hostAdvance( 100 + 25 * n );
+    wireInput.clear( );
+    wireInputIndex = 0;
+    HostWireDevice* device = (address < 128) ? hostWireDevices[address] : nullptr;
+    if ( device == nullptr )
+        return 0;
+    device->request( wireInput, n );
+    return (uint8_t) wireInput.size( );
+}
+
+int TwoWire::available( )
+{
+    return (int) (wireInput.size( ) - wireInputIndex);
+}
+
+int TwoWire::read( )
+{
+    return (wireInputIndex < wireInput.size( )) ? wireInput[wireInputIndex++] : -1;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Real time clock.
+//----------------------------------------------------------------------
+// Seconds added to the clock by adjust().
+static int64_t rtcOffset = 0;
+
+DateTime::DateTime( uint32_t t )
+{
+    const time_t tt = t;
+    struct tm tm;
+    gmtime_r( &tt, &tm );
+    yOff = tm.tm_year + 1900 - 2000;
+    m    = tm.tm_mon + 1;
+    d    = tm.tm_mday;
+    hh   = tm.tm_hour;
+    mm   = tm.tm_min;
+    ss   = tm.tm_sec;
+}
+
+DateTime::DateTime(
+    uint16_t year,
+    uint8_t month,
+    uint8_t day,
+    uint8_t hour,
+    uint8_t minute,
+    uint8_t second )
+{
+    yOff = (year >= 2000) ? year - 2000 : year;
+    m    = month;
+    d    = day;
+    hh   = hour;
+    mm   = minute;
+    ss   = second;
+}
+
+bool DateTime::isValid( ) const
+{
+    if ( m < 1 || m > 12 || d < 1 || d > 31 || hh > 23 || mm > 59 || ss > 59 )
+        return false;
+
+    // Catch days past the end of the month.
+    const DateTime o( unixtime( ) );
+    return o.yOff == yOff && o.m == m && o.d == d &&
+        o.hh == hh && o.mm == mm && o.ss == ss;
+}
+
+uint32_t DateTime::unixtime( ) const
+{
+    struct tm tm = { };
+    tm.tm_year = yOff + 100;
+    tm.tm_mon  = m - 1;
+    tm.tm_mday = d;
+    tm.tm_hour = hh;
+    tm.tm_min  = mm;
+    tm.tm_sec  = ss;
+    return (uint32_t) timegm( &tm );
+}
+
+char* DateTime::toString( char* buffer ) const
+{
+    // The buffer holds a format, such as "YYYY-MM-DD hh:mm:ss", that is
+    // replaced by the formatted date.
+    const std::string format = buffer;
+    std::string result;
+    for ( size_t i = 0; i < format.size( ); )
+    {
+        char field[8];
+        if ( format.compare( i, 4, "YYYY" ) == 0 )
+        {
+            snprintf( field, sizeof( field ), "%04d", 2000 + yOff );
+            i += 4;
+        }
+        else if ( format.compare( i, 2, "YY" ) == 0 )
+        {
+            snprintf( field, sizeof( field ), "%02d", yOff );
+            i += 2;
+        }
+        else if ( format.compare( i, 2, "MM" ) == 0 )
+        {
+            snprintf( field, sizeof( field ), "%02d", m );
+            i += 2;
+        }
+        else if ( format.compare( i, 2, "DD" ) == 0 )
+        {
+            snprintf( field, sizeof( field ), "%02d", d );
+            i += 2;
+        }
+        else if ( format.compare( i, 2, "hh" ) == 0 )
+        {
+            snprintf( field, sizeof( field ), "%02d", hh );
+            i += 2;
+        }
+        else if ( format.compare( i, 2, "mm" ) == 0 )
+        {
+            snprintf( field, sizeof( field ), "%02d", mm );
+            i += 2;
+        }
+        else if ( format.compare( i, 2, "ss" ) == 0 )
+        {
+            snprintf( field, sizeof( field ), "%02d", ss );
+            i += 2;
+        }
+        else
+        {
+            field[0] = format[i++];
+            field[1] = '\0';
+        }
+        result += field;
+    }
+    strcpy( buffer, result.c_str( ) );
+    return buffer;
+}
+
+String DateTime::timestamp( timestampOpt ) const
+{
+    char buffer[32];
+    snprintf( buffer, sizeof( buffer ), "%04d-%02d-%02dT%02d:%02d:%02d",
+        2000 + yOff, m, d, hh, mm, ss );
+    return String( buffer );
+}
+
+bool RTC_DS3231::begin( TwoWire* )
+{
+    hostAdvance( 500 );
+    return hostEnv.rtcPresent;
+}
+
+DateTime RTC_DS3231::now( )
+{
+    hostAdvance( 600 );
+    return DateTime( (uint32_t) (hostEnv.rtcBaseUnix + rtcOffset +
+        (int64_t) (hostClockMicros / 1000000)) );
+}
+
+void RTC_DS3231::adjust( const DateTime& dt )
+{
+    hostAdvance( 600 );
+    rtcOffset = (int64_t) dt.unixtime( ) - hostEnv.rtcBaseUnix -
+        (int64_t) (hostClockMicros / 1000000);
+}
+
+bool RTC_DS3231::lostPower( )
+{
+    return false;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Battery monitors.
+//----------------------------------------------------------------------
+bool Adafruit_LC709203F::begin( TwoWire* )
+{
+    hostAdvance( 1000 );
+    return true;
+}
+
+float Adafruit_LC709203F::cellPercent( )
+{
+    hostAdvance( 1200 );
+    const double percent = 100.0 - 100.0 * (hostClockMicros / 3.6e9) / hostEnv.batteryHours;
+    return (float) ((percent < 0.0) ? 0.0 : percent);
+}
+
+float Adafruit_LC709203F::cellVoltage( )
+{
+    hostAdvance( 1200 );
+    return (float) (3.3 + 0.9 * cellPercent( ) / 100.0);
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Pressure and temperature sensors, library level.
+//----------------------------------------------------------------------
+const float MS5837::Pa   = 100.0f;
+const float MS5837::bar  = 0.001f;
+const float MS5837::mbar = 1.0f;
+
+bool MS5837::init( )
+{
+    hostAdvance( 10000 );
+    return true;
+}
+
+void MS5837::read( )
+{
+    // Both conversions, at the library's highest resolution.
+    delay( 40 );
+    const double depthMeters = hostDepthAt( hostClockMicros );
+    p = (float) ((SEA_LEVEL_PRESSURE + depthMeters * density * GRAVITY) / 100.0);
+    t = (float) hostTemperatureAt( hostClockMicros );
+}
+
+float MS5837::pressure( float conversion )
+{
+    return p * conversion;
+}
+
+float MS5837::temperature( )
+{
+    return t;
+}
+
+float MS5837::depth( )
+{
+    return (pressure( MS5837::Pa ) - SEA_LEVEL_PRESSURE) / (density * GRAVITY);
+}
+
+float MS5837::altitude( )
+{
+    return 0.0f;
+}
+
+bool TSYS01::init( )
+{
+    hostAdvance( 10000 );
+    return true;
+}
+
+void TSYS01::read( )
+{
+    delay( 10 );
+    t = (float) hostTemperatureAt( hostClockMicros );
+}
+
+float TSYS01::temperature( )
+{
+    return t;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Pressure and temperature sensors, register level.
+//----------------------------------------------------------------------
+// Calibration PROMs, from real sensors. The MS5837's CRC4 is in the top
+// of its first word.
+static const uint16_t MS5837_PROM[8] = { 0x2000, 34982, 36352, 20328, 22354, 26646, 26146, 0 };
+static const uint16_t TSYS01_PROM[8] = { 0, 28446, 24926, 36016, 32791, 40781, 0, 0 };
+
+/**
+ * Returns the raw pressure conversion that the sensor gives at a
+ * pressure, by working the MS5837-30BA data sheet's conversion backwards.
+ *
+ * @param[in] mbar
+ *   The pressure, in mbar.
+ * @param[in] d2
+ *   The raw temperature.
+ *
+ * @return
+ *   Returns the raw 24-bit pressure.
+ */
+static uint32_t getMs5837RawPressure( const double mbar, const uint32_t d2 )
+{
+    // The data sheet's first order terms.
+    const uint16_t* c = MS5837_PROM;
+    const double dT = d2 - c[5] * 256.0;
+    const double temp = 2000.0 + dT * c[6] / 8388608.0;
+    double off = c[2] * 65536.0 + c[4] * dT / 128.0;
+    double sens = c[1] * 32768.0 + c[3] * dT / 256.0;
+
+    // The data sheet's second order terms.
+    const double t2000 = temp - 2000.0;
+    if ( temp < 2000.0 )
+    {
+        off -= 3.0 * t2000 * t2000 / 2.0;
+        sens -= 5.0 * t2000 * t2000 / 8.0;
+        if ( temp < -1500.0 )
+        {
+            const double t1500 = temp + 1500.0;
+            off -= 7.0 * t1500 * t1500;
+            sens -= 4.0 * t1500 * t1500;
+        }
+    }
+    else
+        off -= t2000 * t2000 / 16.0;
+
+    // P = (D1 * SENS / 2^21 - OFF) / 2^13, in 0.1 mbar.
+    const double d1 = (mbar * 10.0 * 8192.0 + off) * 2097152.0 / sens;
+    return (uint32_t) ceil( d1 );
+}
+
+/**
+ * Converts a raw water temperature sensor value to temperature, using
+ * the data sheet's polynomial.
+ *
+ * @param[in] adc24
+ *   The raw 24-bit temperature.
+ *
+ * @return
+ *   Returns the temperature, in C.
+ */
+static double getTsys01Temperature( const uint32_t adc24 )
+{
+    const double adc = adc24 / 256;
+    const uint16_t* k = TSYS01_PROM;
+    return -2.0 * k[1] / 1e21 * pow( adc, 4 ) +
+        4.0 * k[2] / 1e16 * pow( adc, 3 ) -
+        2.0 * k[3] / 1e11 * adc * adc +
+        1.0 * k[4] / 1e6 * adc -
+        1.5 * k[5] / 1e2;
+}
+
+/**
+ * Returns the smallest raw value whose conversion reaches a target.
+ *
+ * @param[in] convert
+ *   The conversion, which must increase with the raw value.
+ * @param[in] target
+ *   The target value.
+ *
+ * @return
+ *   Returns the raw 24-bit value.
+ */
+template<class Convert>
+static uint32_t findRawValue( Convert convert, const double target )
+{
+    uint32_t low = 0;
+    uint32_t high = 16777215;
+    while ( low < high )
+    {
+        const uint32_t middle = low + (high - low) / 2;
+        if ( convert( middle ) < target )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * Appends a PROM word or a 24-bit conversion result to a read.
+ */
+static void putProm( std::vector<uint8_t>& bytes, const uint16_t value )
+{
+    bytes.push_back( value >> 8 );
+    bytes.push_back( value & 0xFF );
+}
+
+static void putAdc( std::vector<uint8_t>& bytes, const uint32_t value, uint8_t n )
+{
+    for ( int i = 2; i >= 0 && n-- > 0; --i )
+        bytes.push_back( (value >> (8 * i)) & 0xFF );
+}
+
+/**
+ * The pressure sensor, at address 0x76.
+ *
+ * A conversion samples the depth when it starts, and its result reads
+ * as zero if read before the conversion time has passed.
+ */
+class HostMs5837 : public HostWireDevice
+{
+private:
+    static const uint32_t CONVERSION_MICROS = 18000;
+    static const uint32_t RAW_TEMPERATURE = 6815414; // Data sheet example, 19.81 C
+
+    uint8_t command = 0;
+    uint8_t converting = 0;
+    uint64_t convertTime = 0;
+
+public:
+    void receive( const std::vector<uint8_t>& bytes ) override
+    {
+        if ( bytes.empty( ) )
+            return;
+        command = bytes[0];
+        if ( command == 0x4A || command == 0x5A )
+        {
+            converting = command;
+            convertTime = hostClockMicros;
+        }
+    }
+
+    void request( std::vector<uint8_t>& bytes, const uint8_t n ) override
+    {
+        if ( command >= 0xA0 && command <= 0xAE )
+        {
+            putProm( bytes, MS5837_PROM[(command - 0xA0) / 2] );
+            return;
+        }
+
+        uint32_t value = 0;
+        if ( converting != 0 && hostClockMicros >= convertTime + CONVERSION_MICROS )
+        {
+            if ( converting == 0x5A )
+                value = RAW_TEMPERATURE;
+            else
+            {
+                const double target = (SEA_LEVEL_PRESSURE +
+                    hostDepthAt( convertTime ) * WATER_DENSITY * GRAVITY) / 100.0;
+                value = getMs5837RawPressure( target, RAW_TEMPERATURE );
+            }
+        }
+        converting = 0;
+        putAdc( bytes, value, n );
+    }
+};
+
+/**
+ * The water temperature sensor, at address 0x77.
+ */
+class HostTsys01 : public HostWireDevice
+{
+private:
+    static const uint32_t CONVERSION_MICROS = 8220;
+
+    uint8_t command = 0;
+    bool converting = false;
+    uint64_t convertTime = 0;
+
+public:
+    void receive( const std::vector<uint8_t>& bytes ) override
+    {
+        if ( bytes.empty( ) )
+            return;
+        command = bytes[0];
+        if ( command == 0x48 )
+        {
+            converting = true;
+            convertTime = hostClockMicros;
+        }
+    }
+
+    void request( std::vector<uint8_t>& bytes, const uint8_t n ) override
+    {
+        if ( command >= 0xA0 && command <= 0xAE )
+        {
+            putProm( bytes, TSYS01_PROM[(command - 0xA0) / 2] );
+            return;
+        }
+
+        uint32_t value = 0;
+        if ( converting && hostClockMicros >= convertTime + CONVERSION_MICROS )
+            value = findRawValue( getTsys01Temperature, hostTemperatureAt( convertTime ) );
+        converting = false;
+        putAdc( bytes, value, n );
+    }
+};
+
+
+
+
+
+//----------------------------------------------------------------------
+// Inertia module.
+//----------------------------------------------------------------------
+/**
+ * Returns an accelerometer and gyroscope sample for the current time.
+ *
+ * The device sways gently while hanging straight down.
+ *
+ * @param[out] accel
+ *   The raw accelerometer sample, at +/- 2 g.
+ * @param[out] gyro
+ *   The raw gyroscope sample, at 245 dps.
+ */
+static void getImuSample( lsm9ds1Vector_t& accel, lsm9ds1Vector_t& gyro )
+{
+    const double t = hostClockMicros / 1e6;
+    accel.x = (int16_t) (300 * sin( t * 2.0 ));
+    accel.y = (int16_t) (200 * cos( t * 1.3 ));
+    accel.z = 16393;
+    gyro.x  = (int16_t) (500 * sin( t * 0.7 ));
+    gyro.y  = (int16_t) (400 * sin( t * 1.1 ));
+    gyro.z  = (int16_t) (100 * cos( t ));
+}
+
+bool Adafruit_LSM9DS1::begin( )
+{
+    hostAdvance( 5000 );
+    return true;
+}
+
+void Adafruit_LSM9DS1::readAccel( )
+{
+    hostAdvance( 300 );
+    lsm9ds1Vector_t gyro;
+    getImuSample( accelData, gyro );
+}
+
+void Adafruit_LSM9DS1::readGyro( )
+{
+    hostAdvance( 300 );
+    lsm9ds1Vector_t accel;
+    getImuSample( accel, gyroData );
+}
+
+void Adafruit_LSM9DS1::readMag( )
+{
+    hostAdvance( 300 );
+    magData.x = 1200;
+    magData.y = -300;
+    magData.z = 4000;
+}
+
+void Adafruit_LSM9DS1::readTemp( )
+{
+    hostAdvance( 200 );
+    temperature = 40;
+}
+
+void Adafruit_LSM9DS1::read( )
+{
+    readAccel( );
+    readMag( );
+    readGyro( );
+    readTemp( );
+}
+
+bool Adafruit_LSM9DS1::getEvent(
+    sensors_event_t* accel,
+    sensors_event_t* mag,
+    sensors_event_t* gyro,
+    sensors_event_t* temp )
+{
+    read( );
+    const float accelScale = LSM9DS1_ACCEL_MG_LSB_2G / 1000.0f * SENSORS_GRAVITY_STANDARD;
+    accel->acceleration.x = accelData.x * accelScale;
+    accel->acceleration.y = accelData.y * accelScale;
+    accel->acceleration.z = accelData.z * accelScale;
+
+    const float magScale = LSM9DS1_MAG_MGAUSS_4GAUSS / 1000.0f;
+    mag->magnetic.x = magData.x * magScale;
+    mag->magnetic.y = magData.y * magScale;
+    mag->magnetic.z = magData.z * magScale;
+
+    const float gyroScale = LSM9DS1_GYRO_DPS_DIGIT_245DPS * SENSORS_DPS_TO_RADS;
+    gyro->gyro.x = gyroData.x * gyroScale;
+    gyro->gyro.y = gyroData.y * gyroScale;
+    gyro->gyro.z = gyroData.z * gyroScale;
+
+    temp->temperature = temperature;
+    return true;
+}
+
+// Registers written and read through the library.
+static uint8_t imuRegisters[2][128];
+
+void Adafruit_LSM9DS1::write8( boolean type, byte reg, byte value )
+{
+    hostAdvance( 150 );
+    imuRegisters[type ? 1 : 0][reg & 0x7F] = value;
+}
+
+byte Adafruit_LSM9DS1::read8( boolean type, byte reg )
+{
+    hostAdvance( 150 );
+    return imuRegisters[type ? 1 : 0][reg & 0x7F];
+}
+
+byte Adafruit_LSM9DS1::readBuffer( boolean type, byte reg, byte len, uint8_t* buffer )
+{
+    hostAdvance( 100 + 25 * len );
+    for ( byte i = 0; i < len; ++i )
+        buffer[i] = imuRegisters[type ? 1 : 0][(reg + i) & 0x7F];
+    return len;
+}
+
+/**
+ * The inertia module's accelerometer and gyroscope, at address 0x6B,
+ * for FIFO use.
+ *
+ * While the FIFO is enabled, samples are added at 119 Hz, up to the
+ * FIFO's 32 samples, after which the oldest are overwritten and an
+ * overrun is flagged.
+ */
+class HostLsm9ds1 : public HostWireDevice
+{
+private:
+    static const uint8_t FIFO_SIZE = 32;
+    static const uint64_t SAMPLE_MICROS = 1000000 / 119;
+
+    uint8_t registers[128] = { };
+    uint8_t pointer = 0;
+    std::deque<std::pair<lsm9ds1Vector_t, lsm9ds1Vector_t>> fifo;
+    uint64_t sampleTime = 0;
+    bool overrun = false;
+
+    bool isFifoOn( ) const
+    {
+        return (registers[0x23] & 0x02) != 0 &&     // CTRL_REG9 FIFO_EN.
+            (registers[0x2E] & 0xE0) == 0xC0 &&     // FIFO_CTRL continuous.
+            (registers[0x10] & 0xE0) == 0x60;       // CTRL_REG1_G 119 Hz.
+    }
+
+    void fill( )
+    {
+        if ( !isFifoOn( ) )
+        {
+            sampleTime = hostClockMicros;
+            return;
+        }
+
+        while ( hostClockMicros - sampleTime >= SAMPLE_MICROS )
+        {
+            sampleTime += SAMPLE_MICROS;
+            lsm9ds1Vector_t accel;
+            lsm9ds1Vector_t gyro;
+            const uint64_t now = hostClockMicros;
+            hostClockMicros = sampleTime;
+            getImuSample( accel, gyro );
+            hostClockMicros = now;
+
+            if ( fifo.size( ) == FIFO_SIZE )
+            {
+                fifo.pop_front( );
+                overrun = true;
+            }
+            fifo.push_back( std::make_pair( accel, gyro ) );
+        }
+    }
+
+    static void put( std::vector<uint8_t>& bytes, const lsm9ds1Vector_t& v )
+    {
+        const int16_t values[3] = { v.x, v.y, v.z };
+        for ( int i = 0; i < 3; ++i )
+        {
+            bytes.push_back( values[i] & 0xFF );
+            bytes.push_back( (values[i] >> 8) & 0xFF );
+        }
+    }
+
+public:
+    void receive( const std::vector<uint8_t>& bytes ) override
+    {
+        fill( );
+        if ( bytes.empty( ) )
+            return;
+        pointer = bytes[0] & 0x7F;
+        if ( bytes.size( ) > 1 )
+        {
+            for ( size_t i = 1; i < bytes.size( ); ++i )
+                registers[(pointer + i - 1) & 0x7F] = bytes[i];
+            if ( isFifoOn( ) && sampleTime == 0 )
+                sampleTime = hostClockMicros;
+        }
+    }
+
+    void request( std::vector<uint8_t>& bytes, const uint8_t n ) override
+    {
+        fill( );
+        const lsm9ds1Vector_t zero = { 0, 0, 0 };
+        if ( pointer == 0x2F )
+        {
+            // FIFO_SRC: sample count and overrun flag.
+            bytes.push_back( (uint8_t) (fifo.size( ) | (overrun ? 0x40 : 0)) );
+            overrun = false;
+            return;
+        }
+        if ( pointer == 0x18 && n == 6 )
+        {
+            // Gyroscope output. Read before the accelerometer.
+            put( bytes, fifo.empty( ) ? zero : fifo.front( ).second );
+            return;
+        }
+        if ( pointer == 0x28 && n == 6 )
+        {
+            // Accelerometer output. Reading it pops the sample.
+            put( bytes, fifo.empty( ) ? zero : fifo.front( ).first );
+            if ( !fifo.empty( ) )
+                fifo.pop_front( );
+            return;
+        }
+        for ( uint8_t i = 0; i < n; ++i )
+            bytes.push_back( registers[(pointer + i) & 0x7F] );
+    }
+};
+
+
+
+
+
+//----------------------------------------------------------------------
+// Device registration.
+//----------------------------------------------------------------------
+static HostMs5837 hostMs5837;
+static HostTsys01 hostTsys01;
+static HostLsm9ds1 hostLsm9ds1;
+
+static struct HostDeviceRegistration
+{
+    HostDeviceRegistration( )
+    {
+        hostWireDevices[0x6B] = &hostLsm9ds1;
+        hostWireDevices[0x76] = &hostMs5837;
+        hostWireDevices[0x77] = &hostTsys01;
+    }
+} hostDeviceRegistration;
@@ -0,0 +1,491 @@
+//----------------------------------------------------------------------
+// Host stand-in for SdFat, backed by a host directory.
+//----------------------------------------------------------------------
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <SdFat.h>
+
+#include "Host.h"
+
+
+HostSdModel hostSd;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Utilities.
+//----------------------------------------------------------------------
+/**
+ * Returns the host path for a card path.
+ *
+ * @param[in] path
+ *   The card path.
+ *
+ * @return
+ *   Returns the host path.
+ */
+static std::string getHostPath( const char* path )
+{
+    std::string p = (path != nullptr) ? path : "";
+    while ( !p.empty( ) && p[0] == '/' )
+        p.erase( 0, 1 );
+    return p.empty( ) ? hostSd.root : hostSd.root + "/" + p;
+}
+
+static bool isHostDir( const std::string& path )
+{
+    struct stat st;
+    return stat( path.c_str( ), &st ) == 0 && S_ISDIR( st.st_mode );
+}
+
+static bool isHostFile( const std::string& path )
+{
+    struct stat st;
+    return stat( path.c_str( ), &st ) == 0 && S_ISREG( st.st_mode );
+}
+
+/**
+ * Returns the number of clusters needed for a number of bytes.
+ *
+ * @param[in] nBytes
+ *   The number of bytes.
+ *
+ * @return
+ *   Returns the number of clusters.
+ */
+static uint64_t getClusters( const uint64_t nBytes )
+{
+    return (nBytes + hostSd.clusterBytes - 1) / hostSd.clusterBytes;
+}
+
+/**
+ * Returns the bytes in clusters used by a directory and its contents.
+ *
+ * @param[in] dir
+ *   The host directory path.
+ *
+ * @return
+ *   Returns the number of bytes.
+ */
+static uint64_t getUsedBytes( const std::string& dir )
+{
+    DIR* handle = opendir( dir.c_str( ) );
+    if ( handle == nullptr )
+        return 0;
+
+    uint64_t total = 0;
+    while ( struct dirent* entry = readdir( handle ) )
+    {
+        const std::string name = entry->d_name;
+        if ( name == "." || name == ".." )
+            continue;
+
+        const std::string path = dir + "/" + name;
+        if ( isHostDir( path ) )
+            total += hostSd.clusterBytes + getUsedBytes( path );
+        else
+        {
+            struct stat st;
+            stat( path.c_str( ), &st );
+            total += getClusters( st.st_size ) * hostSd.clusterBytes;
+        }
+    }
+    closedir( handle );
+    return total;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Card and volume.
+//----------------------------------------------------------------------
+uint32_t SdCard::sectorCount( )
+{
+    return (uint32_t) (hostSd.capacityBytes / 512);
+}
+
+uint32_t FsVolume::bytesPerCluster( )
+{
+    return hostSd.clusterBytes;
+}
+
+uint32_t FsVolume::clusterCount( )
+{
+    return (uint32_t) (hostSd.capacityBytes / hostSd.clusterBytes);
+}
+
+int32_t FsVolume::freeClusterCount( )
+{
+    // Counting free clusters scans the whole FAT.
+    hostAdvance( (uint64_t) hostSd.freeCountMicrosPerGB * (hostSd.capacityBytes >> 20) / 1024 );
+    return (int32_t) (clusterCount( ) - getUsedBytes( hostSd.root ) / hostSd.clusterBytes);
+}
+
+bool SdFat::begin( uint8_t, uint32_t )
+{
+    ::mkdir( hostSd.root.c_str( ), 0755 );
+    errorCode = SD_CARD_ERROR_NONE;
+    return true;
+}
+
+bool SdFat::exists( const char* path )
+{
+    hostAdvance( 200 );
+    const std::string hostPath = getHostPath( path );
+    return isHostDir( hostPath ) || isHostFile( hostPath );
+}
+
+bool SdFat::remove( const char* path )
+{
+    const std::string hostPath = getHostPath( path );
+    return isHostFile( hostPath ) && ::unlink( hostPath.c_str( ) ) == 0;
+}
+
+bool SdFat::rmdir( const char* path )
+{
+    return ::rmdir( getHostPath( path ).c_str( ) ) == 0;
+}
+
+bool SdFat::mkdir( const char* path )
+{
+    return ::mkdir( getHostPath( path ).c_str( ), 0755 ) == 0;
+}
+
+bool SdFat::format( Print* )
+{
+    const std::string command =
+        "rm -rf '" + hostSd.root + "' && mkdir -p '" + hostSd.root + "'";
+    return system( command.c_str( ) ) == 0;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Files.
+//----------------------------------------------------------------------
+SdFile::SdFile( )
+{
+}
+
+SdFile::SdFile( const char* path, int flags )
+{
+    open( path, flags );
+}
+
+SdFile::~SdFile( )
+{
+    close( );
+}
+
+bool SdFile::isOpen( ) const
+{
+    return file != nullptr || directory;
+}
+
+bool SdFile::isDir( ) const
+{
+    return directory;
+}
+
+bool SdFile::isFile( ) const
+{
+    return file != nullptr;
+}
+
+uint32_t SdFile::fileSize( ) const
+{
+    return size;
+}
+
+uint32_t SdFile::curPosition( ) const
+{
+    return position;
+}
+
+bool SdFile::open( const char* path, int flags )
+{
+    close( );
+    std::string base = (path != nullptr) ? path : "/";
+    const size_t slash = base.find_last_of( '/' );
+    if ( slash != std::string::npos )
+        base = base.substr( slash + 1 );
+    return openPath( getHostPath( path ), base, flags );
+}
+
+bool SdFile::open( SdFile* dir, const char* path, int flags )
+{
+    close( );
+    return openPath( dir->hostPath + "/" + path, path, flags );
+}
+
+/**
+ * Opens a host file or directory.
+ *
+ * @param[in] path
+ *   The host path.
+ * @param[in] base
+ *   The file's name, without its directory.
+ * @param[in] flags
+ *   The O_* open flags.
+ *
+ * @return
+ *   Returns true on success.
+ */
+bool SdFile::openPath( const std::string& path, const std::string& base, int flags )
+{
+    hostAdvance( 300 );
+    hostPath = path;
+    name = base;
+
+    if ( isHostDir( path ) )
+    {
+        if ( (flags & O_ACCMODE) != O_RDONLY )
+            return false;
+        directory = true;
+        previousEntries.clear( );
+        size = 0;
+        return true;
+    }
+
+    const bool exists = isHostFile( path );
+    if ( !exists && (flags & O_CREAT) == 0 )
+        return false;
+    if ( exists && (flags & O_CREAT) != 0 && (flags & O_EXCL) != 0 )
+        return false;
+
+    readOnly = (flags & O_ACCMODE) == O_RDONLY;
+    file = fopen( path.c_str( ), exists ? (readOnly ? "rb" : "r+b") : "w+b" );
+    if ( file == nullptr )
+        return false;
+
+    struct stat st;
+    stat( path.c_str( ), &st );
+    size = (uint32_t) st.st_size;
+    if ( (flags & O_TRUNC) != 0 && !readOnly && ftruncate( fileno( file ), 0 ) == 0 )
+        size = 0;
+    allocated = getClusters( size ) * hostSd.clusterBytes;
+    append = (flags & O_APPEND) != 0;
+    position = append ? size : 0;
+    return true;
+}
+
+bool SdFile::openNext( SdFile* dir, int flags )
+{
+    close( );
+    if ( dir == nullptr || !dir->directory )
+        return false;
+
+    // Entries are listed in name order. As on the card, removing an entry
+    // does not move the ones after it.
+    DIR* handle = opendir( dir->hostPath.c_str( ) );
+    if ( handle == nullptr )
+        return false;
+    std::vector<std::string> names;
+    while ( struct dirent* entry = readdir( handle ) )
+    {
+        const std::string entryName = entry->d_name;
+        if ( entryName != "." && entryName != ".." )
+            names.push_back( entryName );
+    }
+    closedir( handle );
+    std::sort( names.begin( ), names.end( ) );
+
+    const std::string previous = dir->previousEntries.empty( ) ?
+        std::string( ) : dir->previousEntries.back( );
+    const auto next = std::upper_bound( names.begin( ), names.end( ), previous );
+    if ( next == names.end( ) )
+        return false;
+    const std::string entryName = *next;
+    dir->previousEntries.push_back( entryName );
+    dir->position = 32 * dir->previousEntries.size( );
+    hostAdvance( 100 );
+    return open( dir, entryName.c_str( ), flags );
+}
+
+bool SdFile::close( )
+{
+    if ( file != nullptr )
+        fclose( file );
+    file       = nullptr;
+    directory  = false;
+    size       = 0;
+    position   = 0;
+    contiguous = false;
+    previousEntries.clear( );
+    return true;
+}
+
+size_t SdFile::getName( char* buffer, size_t n )
+{
+    if ( n == 0 )
+        return 0;
+    if ( !isOpen( ) )
+    {
+        buffer[0] = '\0';
+        return 0;
+    }
+    snprintf( buffer, n, "%s", name.c_str( ) );
+    return strlen( buffer );
+}
+
+int SdFile::read( void* buffer, size_t n )
+{
+    if ( file == nullptr )
+        return -1;
+    fseek( file, position, SEEK_SET );
+    const size_t nRead = fread( buffer, 1, n, file );
+    position += nRead;
+    hostAdvance( 20 + nRead / 8 );
+    return (int) nRead;
+}
+
+int SdFile::read( )
+{
+    uint8_t c;
+    return (read( &c, 1 ) == 1) ? c : -1;
+}
+
+size_t SdFile::write( const void* buffer, size_t n )
+{
+    if ( file == nullptr || readOnly )
+        return (size_t) -1;
+    if ( append )
+        position = size;
+    fseek( file, position, SEEK_SET );
+    if ( fwrite( buffer, 1, n, file ) != n )
+        return (size_t) -1;
+
+    // Whole aligned sectors go straight to the card. Anything else goes
+    // through the one-sector cache. Growing past the allocated clusters
+    // costs a FAT search and update per new cluster.
+    const uint32_t end = position + n;
+    uint64_t cost = 0;
+    if ( (position % 512) == 0 && (n % 512) == 0 )
+        cost += (uint64_t) hostSd.sectorWriteMicros * (n / 512);
+    else
+        cost += hostSd.cachedWriteMicros +
+            (uint64_t) hostSd.sectorWriteMicros * ((n + 511) / 512);
+    if ( end > allocated )
+    {
+        const uint64_t nClusters = getClusters( end ) - getClusters( allocated );
+        cost += nClusters * hostSd.clusterAllocMicros;
+        hostSd.clustersAllocated += nClusters;
+        allocated = getClusters( end ) * hostSd.clusterBytes;
+    }
+    hostAdvance( cost );
+
+    position = end;
+    if ( position > size )
+        size = position;
+    ++hostSd.writes;
+    hostSd.bytesWritten += n;
+    return n;
+}
+
+bool SdFile::sync( )
+{
+    if ( file == nullptr )
+        return false;
+    fflush( file );
+    ++hostSd.syncs;
+
+    uint64_t cost = hostSd.syncMicros;
+    if ( hostSd.spikeEvery != 0 && (hostSd.syncs % hostSd.spikeEvery) == 0 )
+        cost += hostSd.spikeMicros;
+    hostAdvance( cost );
+    return true;
+}
+
+bool SdFile::seekSet( uint32_t newPosition )
+{
+    if ( directory )
+    {
+        if ( (newPosition % 32) != 0 || newPosition / 32 > previousEntries.size( ) )
+            return false;
+        previousEntries.resize( newPosition / 32 );
+        position = newPosition;
+        return true;
+    }
+    if ( file == nullptr || newPosition > size )
+        return false;
+    position = newPosition;
+    return true;
+}
+
+bool SdFile::seekEnd( int32_t offset )
+{
+    return seekSet( size + offset );
+}
+
+bool SdFile::preAllocate( uint32_t length )
+{
+    if ( file == nullptr || size != 0 || length == 0 )
+        return false;
+    if ( ftruncate( fileno( file ), length ) != 0 )
+        return false;
+    size = length;
+    allocated = getClusters( length ) * hostSd.clusterBytes;
+    contiguous = true;
+    hostAdvance( 5000 );
+    return true;
+}
+
+bool SdFile::truncate( uint32_t length )
+{
+    if ( file == nullptr || length > size )
+        return false;
+    fflush( file );
+    if ( ftruncate( fileno( file ), length ) != 0 )
+        return false;
+    size = length;
+    if ( position > size )
+        position = size;
+    allocated = getClusters( length ) * hostSd.clusterBytes;
+    hostAdvance( hostSd.syncMicros );
+    return true;
+}
+
+bool SdFile::truncate( )
+{
+    return truncate( position );
+}
+
+bool SdFile::contiguousRange( uint32_t* begin, uint32_t* end )
+{
+    if ( !contiguous )
+        return false;
+    *begin = 1000;
+    *end = 1000 + (size + 511) / 512 - 1;
+    return true;
+}
+
+bool SdFile::remove( )
+{
+    if ( file == nullptr )
+        return false;
+    const std::string path = hostPath;
+    close( );
+    return ::unlink( path.c_str( ) ) == 0;
+}
+
+bool SdFile::rmdir( )
+{
+    if ( !directory )
+        return false;
+    const std::string path = hostPath;
+    close( );
+    return ::rmdir( path.c_str( ) ) == 0;
+}
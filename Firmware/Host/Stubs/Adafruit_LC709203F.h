@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+
+
+class TwoWire;
+
+typedef enum
+{
+    LC709203F_APA_100MAH  = 0x08,
+    LC709203F_APA_2000MAH = 0x2D,
+    LC709203F_APA_3000MAH = 0x36
+} lc709203_adjustment_t;
+
+typedef enum
+{
+    LC709203F_TEMPERATURE_I2C        = 0x0000,
+    LC709203F_TEMPERATURE_THERMISTOR = 0x0001
+} lc709203_tempmode_t;
+
+
+/**
+ * Host stand-in for the battery monitor library.
+ *
+ * The battery drains linearly over HostEnvironment::batteryHours.
+ */
+class Adafruit_LC709203F
+{
+public:
+    bool begin( TwoWire* wire = nullptr );
+    bool setPackSize( lc709203_adjustment_t ) { return true; }
+    bool setAlarmVoltage( float ) { return true; }
+    bool setTemperatureMode( lc709203_tempmode_t ) { return true; }
+
+    float cellVoltage( );
+    float cellPercent( );
+};
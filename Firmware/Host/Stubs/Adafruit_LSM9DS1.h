@@ -0,0 +1,70 @@
+#pragma once
+#include <Adafruit_Sensor.h>
+#include <Wire.h>
+
+
+#define LSM9DS1_ACCEL_MG_LSB_2G         (0.061F)
+#define LSM9DS1_GYRO_DPS_DIGIT_245DPS   (0.00875F)
+#define LSM9DS1_MAG_MGAUSS_4GAUSS       (0.14F)
+
+#define XGTYPE  false
+#define MAGTYPE true
+
+typedef struct
+{
+    int16_t x, y, z;
+} lsm9ds1Vector_t;
+
+
+/**
+ * Host stand-in for the inertia module library.
+ *
+ * Readings follow a slow simulated sway. The accelerometer and gyroscope
+ * FIFO is simulated at the register level. See HostDevices.cpp.
+ */
+class Adafruit_LSM9DS1
+{
+public:
+    typedef enum
+    {
+        LSM9DS1_ACCELRANGE_2G  = (0b00 << 3),
+        LSM9DS1_ACCELRANGE_16G = (0b01 << 3),
+        LSM9DS1_ACCELRANGE_4G  = (0b10 << 3),
+        LSM9DS1_ACCELRANGE_8G  = (0b11 << 3)
+    } lsm9ds1AccelRange_t;
+
+    typedef enum
+    {
+        LSM9DS1_MAGGAIN_4GAUSS = (0b00 << 5)
+    } lsm9ds1MagGain_t;
+
+    typedef enum
+    {
+        LSM9DS1_GYROSCALE_245DPS = (0b00 << 3)
+    } lsm9ds1GyroScale_t;
+
+    bool begin( );
+    void setupAccel( lsm9ds1AccelRange_t ) { }
+    void setupMag( lsm9ds1MagGain_t ) { }
+    void setupGyro( lsm9ds1GyroScale_t ) { }
+
+    bool getEvent(
+        sensors_event_t* accel,
+        sensors_event_t* mag,
+        sensors_event_t* gyro,
+        sensors_event_t* temp );
+    void read( );
+    void readAccel( );
+    void readMag( );
+    void readGyro( );
+    void readTemp( );
+
+    void write8( boolean type, byte reg, byte value );
+    byte read8( boolean type, byte reg );
+    byte readBuffer( boolean type, byte reg, byte len, uint8_t* buffer );
+
+    lsm9ds1Vector_t accelData;
+    lsm9ds1Vector_t gyroData;
+    lsm9ds1Vector_t magData;
+    int16_t temperature;
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+
+
+//----------------------------------------------------------------------
+// Host stand-in for the Adafruit unified sensor types.
+//----------------------------------------------------------------------
+#define SENSORS_GRAVITY_STANDARD    (9.80665F)
+#define SENSORS_DPS_TO_RADS         (0.017453293F)
+
+typedef struct
+{
+    float x, y, z;
+} sensors_vec_t;
+
+typedef struct
+{
+    int32_t version;
+    int32_t sensor_id;
+    int32_t type;
+    int32_t reserved0;
+    int32_t timestamp;
+    union
+    {
+        float data[4];
+        sensors_vec_t acceleration;
+        sensors_vec_t magnetic;
+        sensors_vec_t gyro;
+        float temperature;
+    };
+} sensors_event_t;
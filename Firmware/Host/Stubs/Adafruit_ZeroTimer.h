@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+
+
+//----------------------------------------------------------------------
+// Host stand-in for the Adafruit SAMD timer library.
+//----------------------------------------------------------------------
+// A timer counts the simulated 48 MHz clock through its prescaler, and
+// its compare channel 0 callback is called from the simulated clock as
+// the counter matches, as though from the timer's interrupt. Only the
+// match frequency mode is modeled: the counter restarts on each match,
+// and a new compare value set by the callback applies to the period
+// just started. See ../HostArduino.cpp.
+
+enum tc_clock_prescaler
+{
+    TC_CLOCK_PRESCALER_DIV1    = 1,
+    TC_CLOCK_PRESCALER_DIV2    = 2,
+    TC_CLOCK_PRESCALER_DIV4    = 4,
+    TC_CLOCK_PRESCALER_DIV8    = 8,
+    TC_CLOCK_PRESCALER_DIV16   = 16,
+    TC_CLOCK_PRESCALER_DIV64   = 64,
+    TC_CLOCK_PRESCALER_DIV256  = 256,
+    TC_CLOCK_PRESCALER_DIV1024 = 1024,
+};
+
+enum tc_counter_size
+{
+    TC_COUNTER_SIZE_8BIT,
+    TC_COUNTER_SIZE_16BIT,
+    TC_COUNTER_SIZE_32BIT,
+};
+
+enum tc_wave_generation
+{
+    TC_WAVE_GENERATION_NORMAL_FREQ,
+    TC_WAVE_GENERATION_MATCH_FREQ,
+    TC_WAVE_GENERATION_NORMAL_PWM,
+    TC_WAVE_GENERATION_MATCH_PWM,
+};
+
+enum tc_count_direction
+{
+    TC_COUNT_DIRECTION_UP,
+    TC_COUNT_DIRECTION_DOWN,
+};
+
+enum tc_callback
+{
+    TC_CALLBACK_OVERFLOW,
+    TC_CALLBACK_ERROR,
+    TC_CALLBACK_CC_CHANNEL0,
+    TC_CALLBACK_CC_CHANNEL1,
+    TC_CALLBACK_N,
+};
+
+
+/**
+ * A SAMD timer/counter.
+ */
+class Adafruit_ZeroTimer
+{
+public:
+    Adafruit_ZeroTimer( uint8_t timerNumber ) : number( timerNumber ) { }
+
+    void configure( tc_clock_prescaler prescale, tc_counter_size countersize,
+        tc_wave_generation wavegen,
+        tc_count_direction countdir = TC_COUNT_DIRECTION_UP );
+    void setCompare( uint8_t channel, uint32_t compare );
+    void setCallback( boolean enable, tc_callback type,
+        void (*callback)( void ) = nullptr );
+    void enable( boolean enable );
+
+    static void timerHandler( uint8_t ) { }
+
+    // Modeled state.
+    uint8_t number;
+    uint32_t prescaler = 1;
+    uint32_t compare = 0;
+    void (*callback)( void ) = nullptr;
+    bool enabled = false;
+    uint64_t matchNanos = 0;    // Next match, in simulated ns since boot.
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+
+//----------------------------------------------------------------------
+// Host stand-in for the Arduino core.
+//----------------------------------------------------------------------
+// Only what the logger uses is here. Time is virtual: millis(), micros(),
+// delay(), and the other stand-ins advance a simulated clock by the time
+// the real call would take, so a run is repeatable and independent of
+// the speed of the host. See ../Host.h.
+
+#undef abs
+#define abs(x) ((x) > 0 ? (x) : -(x))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH            1
+#define LOW             0
+
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define A0              14
+#define A1              15
+#define A2              16
+#define A3              17
+#define A4              18
+#define A5              19
+#define A7              9
+
+#define digitalPinToInterrupt(p) (p)
+
+uint32_t millis( );
+uint32_t micros( );
+void delay( uint32_t ms );
+void delayMicroseconds( uint32_t us );
+void yield( );
+
+void pinMode( uint8_t pin, uint8_t mode );
+void digitalWrite( uint8_t pin, uint8_t value );
+int digitalRead( uint8_t pin );
+int analogRead( uint8_t pin );
+
+void noInterrupts( );
+void interrupts( );
+void attachInterrupt( uint8_t interrupt, void (*handler)( void ), int mode );
+
+inline bool isSpace( int c ) { return isspace( c ) != 0; }
+inline bool isDigit( int c ) { return isdigit( c ) != 0; }
+inline bool isAlpha( int c ) { return isalpha( c ) != 0; }
+
+using std::min;
+using std::max;
+
+
+/**
+ * A minimal Arduino String.
+ */
+class String
+{
+public:
+    std::string s;
+
+    String( ) { }
+    String( const char* c ) : s( (c != nullptr) ? c : "" ) { }
+    String( const std::string& c ) : s( c ) { }
+    String( int value ) : s( std::to_string( value ) ) { }
+
+    const char* c_str( ) const { return s.c_str( ); }
+    unsigned length( ) const { return s.size( ); }
+
+    String operator+( const String& o ) const { return String( s + o.s ); }
+    String operator+( const char* o ) const { return String( s + o ); }
+    friend String operator+( const char* a, const String& b )
+    {
+        return String( std::string( a ) + b.s );
+    }
+};
+
+
+/**
+ * Formatted output, as inherited by Serial.
+ */
+class Print
+{
+public:
+    virtual ~Print( ) { }
+
+    virtual size_t write( uint8_t c ) = 0;
+    virtual size_t write( const uint8_t* bytes, size_t n )
+    {
+        for ( size_t i = 0; i < n; ++i )
+            write( bytes[i] );
+        return n;
+    }
+    size_t write( const char* s ) { return write( (const uint8_t*) s, strlen( s ) ); }
+    size_t write( const char* s, size_t n ) { return write( (const uint8_t*) s, n ); }
+
+    size_t print( const char* s ) { return write( s ); }
+    size_t print( const String& s ) { return write( s.c_str( ) ); }
+    size_t print( char c ) { return write( (uint8_t) c ); }
+    size_t print( int v ) { return printf( "%d", v ); }
+    size_t print( unsigned v ) { return printf( "%u", v ); }
+    size_t print( long v ) { return printf( "%ld", v ); }
+    size_t print( unsigned long v ) { return printf( "%lu", v ); }
+    size_t print( double v ) { return printf( "%.2f", v ); }
+
+    size_t println( ) { return write( "\r\n" ); }
+    template<class T> size_t println( T v ) { return print( v ) + println( ); }
+
+    size_t printf( const char* format, ... ) __attribute__((format(printf, 2, 3)));
+};
+
+
+/**
+ * Formatted output plus input, as inherited by Serial.
+ */
+class Stream : public Print
+{
+public:
+    virtual int available( ) = 0;
+    virtual int read( ) = 0;
+    virtual int peek( ) = 0;
+
+    size_t readBytesUntil( char terminator, char* buffer, size_t n );
+    size_t readBytes( char* buffer, size_t n );
+};
+
+
+/**
+ * The USB serial port.
+ *
+ * Input comes from the host script, or from a pseudo-terminal when the
+ * host is run with -p. Output goes to standard output, or to the
+ * pseudo-terminal.
+ */
+class HostSerial : public Stream
+{
+public:
+    void begin( unsigned long ) { }
+    void flush( ) { }
+    operator bool( ) const { return true; }
+
+    int available( ) override;
+    int read( ) override;
+    int peek( ) override;
+    int availableForWrite( );
+
+    size_t write( uint8_t c ) override;
+    size_t write( const uint8_t* bytes, size_t n ) override;
+    using Print::write;
+};
+
+extern HostSerial Serial;
@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+
+
+/**
+ * Host stand-in for the pressure sensor library.
+ *
+ * Readings follow the scripted depth profile. The sensor's split-phase
+ * conversions are simulated at the register level. See HostDevices.cpp.
+ */
+class MS5837
+{
+public:
+    static const float Pa;
+    static const float bar;
+    static const float mbar;
+
+    static const uint8_t MS5837_30BA = 0;
+    static const uint8_t MS5837_02BA = 1;
+
+    bool init( );
+    void setModel( uint8_t ) { }
+    void setFluidDensity( float d ) { density = d; }
+
+    void read( );
+    float pressure( float conversion = 1.0f );
+    float temperature( );
+    float depth( );
+    float altitude( );
+
+private:
+    float density = 1029.0f;    // kg/m^3.
+    float p = 1013.25f;         // mbar.
+    float t = 20.0f;            // C.
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <Arduino.h>
+
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+class TwoWire;
+
+
+/**
+ * Host stand-in for the real time clock library's date and time.
+ */
+class DateTime
+{
+public:
+    enum timestampOpt
+    {
+        TIMESTAMP_FULL,
+        TIMESTAMP_TIME,
+        TIMESTAMP_DATE
+    };
+
+    DateTime( uint32_t t = SECONDS_FROM_1970_TO_2000 );
+    DateTime(
+        uint16_t year,
+        uint8_t month,
+        uint8_t day,
+        uint8_t hour = 0,
+        uint8_t minute = 0,
+        uint8_t second = 0 );
+
+    bool isValid( ) const;
+    char* toString( char* buffer ) const;
+    String timestamp( timestampOpt opt = TIMESTAMP_FULL ) const;
+
+    uint16_t year( ) const { return 2000U + yOff; }
+    uint8_t month( ) const { return m; }
+    uint8_t day( ) const { return d; }
+    uint8_t hour( ) const { return hh; }
+    uint8_t minute( ) const { return mm; }
+    uint8_t second( ) const { return ss; }
+
+    uint32_t unixtime( ) const;
+    uint32_t secondstime( ) const { return unixtime( ) - SECONDS_FROM_1970_TO_2000; }
+
+protected:
+    uint8_t yOff, m, d, hh, mm, ss;
+};
+
+enum Ds3231SqwPinMode
+{
+    DS3231_OFF           = 0x1C,
+    DS3231_SquareWave1Hz = 0x00
+};
+
+
+/**
+ * Host stand-in for the real time clock.
+ *
+ * The clock ticks with the simulated time, from HostEnvironment's
+ * starting date. The processor's counters can be made to drift from it
+ * with the "drift" script command.
+ */
+class RTC_DS3231
+{
+public:
+    bool begin( TwoWire* wire = nullptr );
+    void adjust( const DateTime& dt );
+    DateTime now( );
+    bool lostPower( );
+    void writeSqwPinMode( Ds3231SqwPinMode ) { }
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+
+//----------------------------------------------------------------------
+// Host stand-in for SdFat.
+//----------------------------------------------------------------------
+// The card is a directory on the host (see HostSdModel in ../Host.h), so
+// its files can be looked at directly after a run. Card operations
+// advance the simulated clock by a modeled cost: sector writes, partial
+// writes through the sector cache, syncs, and cluster allocation as a
+// file grows, with optional periodic slow syncs.
+
+#define SD_ERROR_CODE_LIST \
+    SD_CARD_ERROR(NONE, "No error")\
+    SD_CARD_ERROR(CMD0, "Card reset failed")\
+    SD_CARD_ERROR(WRITE_DATA, "Write data")\
+    SD_CARD_ERROR(INIT_NOT_CALLED, "card.begin() not called")
+
+enum
+{
+#define SD_CARD_ERROR(e, m) SD_CARD_ERROR_##e,
+    SD_ERROR_CODE_LIST
+#undef SD_CARD_ERROR
+    SD_CARD_ERROR_UNKNOWN
+};
+
+#define O_RDONLY        0x00
+#define O_WRONLY        0x01
+#define O_RDWR          0x02
+#define O_ACCMODE       0x03
+#define O_APPEND        0x08
+#define O_CREAT         0x10
+#define O_TRUNC         0x20
+#define O_EXCL          0x40
+#define O_READ          O_RDONLY
+#define O_WRITE         O_WRONLY
+
+#define SPI_FULL_SPEED  1
+#define SPI_HALF_SPEED  2
+
+
+/**
+ * The card itself.
+ */
+class SdCard
+{
+public:
+    uint32_t sectorCount( );
+    bool erase( uint32_t, uint32_t ) { return true; }
+};
+
+
+/**
+ * The card's FAT volume.
+ */
+class FsVolume
+{
+public:
+    uint8_t fatType( ) { return 32; }
+    uint32_t bytesPerCluster( );
+    uint32_t clusterCount( );
+    int32_t freeClusterCount( );
+};
+
+
+/**
+ * A file or directory on the card.
+ */
+class SdFile
+{
+public:
+    SdFile( );
+    SdFile( const char* path, int flags );
+    ~SdFile( );
+    SdFile( const SdFile& ) = delete;
+    SdFile& operator=( const SdFile& ) = delete;
+
+    bool open( const char* path, int flags = O_RDONLY );
+    bool open( SdFile* dir, const char* path, int flags = O_RDONLY );
+    bool openNext( SdFile* dir, int flags = O_RDONLY );
+    bool close( );
+
+    bool isOpen( ) const;
+    bool isDir( ) const;
+    bool isFile( ) const;
+    operator bool( ) const { return isOpen( ); }
+
+    uint32_t fileSize( ) const;
+    uint32_t curPosition( ) const;
+    size_t getName( char* name, size_t size );
+
+    int read( void* buffer, size_t n );
+    int read( );
+    size_t write( const void* buffer, size_t n );
+    size_t write( uint8_t b ) { return write( &b, 1 ); }
+    size_t write( const char* s ) { return write( s, strlen( s ) ); }
+    bool getWriteError( ) const { return false; }
+    bool sync( );
+
+    bool seekSet( uint32_t position );
+    bool seekEnd( int32_t offset = 0 );
+    void rewind( ) { seekSet( 0 ); }
+
+    bool preAllocate( uint32_t length );
+    bool truncate( uint32_t length );
+    bool truncate( );
+    bool contiguousRange( uint32_t* begin, uint32_t* end );
+    bool isContiguous( ) const { return contiguous; }
+
+    bool remove( );
+    bool rmdir( );
+
+private:
+    bool openPath( const std::string& path, const std::string& base, int flags );
+
+    FILE* file = nullptr;       // Open host file, if a file.
+    bool directory = false;     // True if an open directory.
+    std::string hostPath;
+    std::string name;
+    bool readOnly = false;
+    bool append = false;
+    bool contiguous = false;
+    uint32_t position = 0;
+    uint32_t size = 0;
+    uint32_t allocated = 0;     // Bytes in allocated clusters.
+    // The entries opened by openNext(), in order, which may since have
+    // been removed. A directory's position is 32 bytes per entry, as on
+    // the card, so that seekSet() can go back to an earlier entry.
+    std::vector<std::string> previousEntries;
+};
+
+typedef SdFile File;
+typedef SdFile FatFile;
+
+
+/**
+ * The SD card file system.
+ */
+class SdFat
+{
+public:
+    bool begin( uint8_t csPin, uint32_t speed );
+    SdCard* card( ) { return &cardObject; }
+    FsVolume* vol( ) { return &volumeObject; }
+    uint8_t sdErrorCode( ) { return errorCode; }
+
+    bool exists( const char* path );
+    bool remove( const char* path );
+    bool rmdir( const char* path );
+    bool mkdir( const char* path );
+    bool format( Print* print = nullptr );
+
+    uint32_t bytesPerCluster( ) { return volumeObject.bytesPerCluster( ); }
+    uint32_t clusterCount( ) { return volumeObject.clusterCount( ); }
+    int32_t freeClusterCount( ) { return volumeObject.freeClusterCount( ); }
+
+private:
+    SdCard cardObject;
+    FsVolume volumeObject;
+    uint8_t errorCode = SD_CARD_ERROR_NONE;
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <Arduino.h>
+
+
+/**
+ * Host stand-in for the water temperature sensor library.
+ *
+ * Readings follow the scripted depth profile. The sensor's split-phase
+ * conversions are simulated at the register level. See HostDevices.cpp.
+ */
+class TSYS01
+{
+public:
+    bool init( );
+    void read( );
+    float temperature( );
+
+private:
+    float t = 20.0f;            // C.
+};
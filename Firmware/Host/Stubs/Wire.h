@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+
+
+/**
+ * Host stand-in for the I2C bus.
+ *
+ * Transactions are passed to the simulated device registered at the
+ * address, if any. See HostWireDevice in ../Host.h.
+ */
+class TwoWire
+{
+public:
+    void begin( ) { }
+    void setClock( uint32_t ) { }
+
+    void beginTransmission( uint8_t address );
+    size_t write( uint8_t value );
+    uint8_t endTransmission( bool stop = true );
+
+    uint8_t requestFrom( uint8_t address, uint8_t n, bool stop = true );
+    int available( );
+    int read( );
+};
+
+extern TwoWire Wire;
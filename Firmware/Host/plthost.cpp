@@ -0,0 +1,240 @@
+//----------------------------------------------------------------------
+// plthost: runs the logger firmware on the host, under simulated time.
+//
+// Usage: plthost [-p] [-d N] [script] [seconds]
+//        plthost -c
+//
+// The firmware's setup() and loop() run against stand-ins for the
+// Arduino core, the I2C devices, and the SD card, whose files go in the
+// "sdcard" directory. Serial output goes to stdout. At the end, a
+// timing report goes to stderr.
+//
+// Each script line is "<seconds> <command>", and "#" starts a comment.
+// Commands are typed at the logger at the given time, except for these,
+// which set up the simulation:
+//	depth METERS        - a point on the depth profile
+//	temperature C       - the water temperature at the surface
+//	drift PPM           - how fast millis() runs against the clock
+//	sdsync US           - the time for an SD card sync
+//	sdspike EVERY US    - make every Nth sync US slower
+//	end                 - the time to stop, instead of [seconds]
+//
+// With -p, the serial port is a pseudo-terminal, whose path is printed
+// on stderr, and time is real, so that tools such as pltget can talk to
+// the logger. With -d N, every Nth large serial write is dropped.
+//
+// With -c, the firmware's sensor conversions are checked against the
+// data sheets' examples instead.
+//----------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <Arduino.h>
+
+#include "Host.h"
+#include "Sensors.h"
+
+// The firmware's entry points, in pltlogger.ino.
+void setup( );
+void loop( );
+void serialEventRun( );
+
+
+
+
+
+/**
+ * Prints the usage message and exits.
+ */
+static void printUsage( )
+{
+    fprintf( stderr, "Usage: plthost [-p] [-d N] [script] [seconds]\n" );
+    fprintf( stderr, "       plthost -c\n" );
+    exit( 2 );
+}
+
+/**
+ * Checks the firmware's sensor conversions against the data sheets'
+ * examples.
+ *
+ * @return
+ *   Returns true if they all match.
+ */
+static bool checkConversions( )
+{
+    // MS5837-30BA data sheet: typical calibration and conversions, which
+    // give 3999.8 mbar. Its CRC4 is 2.
+    static const uint16_t prom[7] = { 0x2000, 34982, 36352, 20328, 22354, 26646, 26146 };
+    const int32_t pressure = Sensors::convertPressure( prom, 4958179, 6815414 );
+    const bool crcOk = Sensors::checkPressureCrc( prom );
+    printf( "plthost: MS5837 example %.1f mbar, expected 3999.8, CRC %s\n",
+        pressure / 10.0,
+        crcOk ? "ok" : "BAD" );
+    return pressure == 39998 && crcOk;
+}
+
+/**
+ * Reads a script.
+ *
+ * @param[in] path
+ *   The script's path.
+ * @param[out] seconds
+ *   The run time, if the script has an "end" line.
+ *
+ * @return
+ *   Returns true on success.
+ */
+static bool readScript( const char* path, double& seconds )
+{
+    std::ifstream in( path );
+    if ( !in )
+        return false;
+
+    std::string line;
+    int lineNumber = 0;
+    while ( std::getline( in, line ) )
+    {
+        ++lineNumber;
+        const size_t comment = line.find( '#' );
+        if ( comment != std::string::npos )
+            line.erase( comment );
+
+        std::istringstream words( line );
+        double at;
+        if ( !(words >> at) )
+            continue;       // Blank line.
+        std::string command;
+        std::getline( words >> std::ws, command );
+
+        std::istringstream arguments( command );
+        std::string verb;
+        arguments >> verb;
+        if ( verb == "depth" )
+        {
+            double meters = 0.0;
+            arguments >> meters;
+            hostEnv.depth.push_back( std::make_pair( at, meters ) );
+        }
+        else if ( verb == "temperature" )
+            arguments >> hostEnv.surfaceTemperature;
+        else if ( verb == "drift" )
+            arguments >> hostEnv.counterPpm;
+        else if ( verb == "sdsync" )
+            arguments >> hostSd.syncMicros;
+        else if ( verb == "sdspike" )
+            arguments >> hostSd.spikeEvery >> hostSd.spikeMicros;
+        else if ( verb == "end" )
+            seconds = at;
+        else if ( !verb.empty( ) )
+            hostQueueInput( (uint64_t) (at * 1e6), command );
+        else
+        {
+            fprintf( stderr, "plthost: %s:%d: no command\n", path, lineNumber );
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Prints the timing report.
+ *
+ * @param[in] out
+ *   The stream to print to.
+ */
+static void printReport( FILE* out )
+{
+    fprintf( out, "\n" );
+    fprintf( out, "plthost: %.3f s simulated, %llu loops, longest loop %.3f ms\n",
+        hostClockMicros / 1e6,
+        (unsigned long long) hostStats.numberOfLoops,
+        hostStats.maximumLoopMicros / 1e3 );
+
+    if ( hostStats.numberOfShutters > 1 )
+    {
+        const uint64_t nGaps = hostStats.numberOfShutters - 1;
+        fprintf( out, "plthost: %llu shutters, gap min %.3f ms, mean %.3f ms, max %.3f ms\n",
+            (unsigned long long) hostStats.numberOfShutters,
+            hostStats.minimumShutterGap / 1e3,
+            hostStats.totalShutterGap / 1e3 / nGaps,
+            hostStats.maximumShutterGap / 1e3 );
+    }
+    else
+        fprintf( out, "plthost: %llu shutters\n",
+            (unsigned long long) hostStats.numberOfShutters );
+
+    fprintf( out, "plthost: SD %llu writes, %llu bytes, %llu syncs, %llu clusters allocated\n",
+        (unsigned long long) hostSd.writes,
+        (unsigned long long) hostSd.bytesWritten,
+        (unsigned long long) hostSd.syncs,
+        (unsigned long long) hostSd.clustersAllocated );
+}
+
+int main( int argc, char** argv )
+{
+    bool usePty = false;
+    int option;
+    while ( (option = getopt( argc, argv, "cpd:" )) != -1 )
+    {
+        switch ( option )
+        {
+        case 'c':
+            return checkConversions( ) ? 0 : 1;
+        case 'p':
+            usePty = true;
+            break;
+        case 'd':
+            hostSerialDropEvery = (uint32_t) strtoul( optarg, nullptr, 10 );
+            break;
+        default:
+            printUsage( );
+        }
+    }
+    if ( argc - optind > 2 )
+        printUsage( );
+
+    double seconds = 60.0;
+    if ( optind < argc && !readScript( argv[optind], seconds ) )
+    {
+        fprintf( stderr, "plthost: cannot read script %s\n", argv[optind] );
+        return 1;
+    }
+    if ( optind + 1 < argc )
+        seconds = atof( argv[optind + 1] );
+
+    if ( usePty )
+    {
+        const std::string path = hostOpenPty( );
+        if ( path.empty( ) )
+        {
+            fprintf( stderr, "plthost: cannot open a pseudo-terminal\n" );
+            return 1;
+        }
+        fprintf( stderr, "plthost: serial port is %s\n", path.c_str( ) );
+    }
+
+    setup( );
+    const uint64_t endMicros = (uint64_t) (seconds * 1e6);
+    while ( hostClockMicros < endMicros )
+    {
+        const uint64_t loopStart = hostClockMicros;
+        loop( );
+        if ( Serial.available( ) )
+            serialEventRun( );
+        const uint64_t loopMicros = hostClockMicros - loopStart;
+        if ( loopMicros > hostStats.maximumLoopMicros )
+            hostStats.maximumLoopMicros = loopMicros;
+        ++hostStats.numberOfLoops;
+        hostAdvance( HOST_CALL_COST_US );
+    }
+
+    fflush( stdout );
+    printReport( stderr );
+    return 0;
+}
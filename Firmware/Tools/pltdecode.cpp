@@ -0,0 +1,340 @@
+//----------------------------------------------------------------------
+// pltdecode
+//
+// Decodes a binary PLT data log (DATA_NNN.BIN) into the CSV file the
+// logger writes when binary logging is not enabled. The CSV output is
+// identical, byte for byte, so it can be used by the data processing
+// scripts (such as DropDetect.py and AlignImagesToLog.py) unchanged.
+// IMU stream files (IMU_NN.BIN) use the same format and decode the same
+// way.
+//
+// Usage:
+//   pltdecode [-c] [-o output.csv] DATA_NNN.BIN
+//
+//   -c   Print the file's column table (name, units, type) instead
+//        of decoding its records.
+//   -o   Write the CSV to the given file instead of standard output.
+//
+// Problems found along the way, such as blocks with bad CRCs or missing
+// blocks, are reported on standard error. Records in bad blocks are
+// skipped. Decoding stops at the first sector that is not a block of the
+// file, such as the unwritten end of a file after a power loss.
+//
+// The binary format is described in ../Code/LogFormat.h.
+//----------------------------------------------------------------------
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../Code/Crc32.h"
+#include "../Code/LogFormat.h"
+
+
+
+
+
+//----------------------------------------------------------------------
+// Utilities.
+//----------------------------------------------------------------------
+/**
+ * Prints a usage message and exits.
+ */
+static void usage( )
+{
+    fprintf( stderr, "Usage: pltdecode [-c] [-o output.csv] DATA_NNN.BIN\n" );
+    exit( 1 );
+}
+
+/**
+ * Returns the name of a column value type.
+ *
+ * @param[in] type
+ *   The LOG_TYPE_* value type.
+ *
+ * @return
+ *   Returns the name.
+ */
+static const char* getTypeName( const uint8_t type )
+{
+    switch ( type )
+    {
+        case LOG_TYPE_TIME:   return "time";
+        case LOG_TYPE_UINT32: return "uint32";
+        case LOG_TYPE_INT32:  return "int32";
+        case LOG_TYPE_FLOAT:  return "float";
+        default:              return "unknown";
+    }
+}
+
+/**
+ * Prints one record as a CSV row.
+ *
+ * Each column is printed with its printf() format from the file header,
+ * exactly as the logger prints it. The timestamp is printed as the
+ * logger's Excel-style "MM/DD/YYYY hh:mm:ss" time.
+ *
+ * @param[in] out
+ *   The output file.
+ * @param[in] columns
+ *   The column table.
+ * @param[in] record
+ *   The record.
+ */
+static void printRecord(
+    FILE* out,
+    const std::vector<LogColumn>& columns,
+    const uint8_t* record )
+{
+    for ( size_t i = 0; i < columns.size( ); ++i )
+    {
+        const LogColumn& column = columns[i];
+        const uint8_t* field = record + column.offset;
+        if ( i != 0 )
+            fputc( ',', out );
+
+        switch ( column.type )
+        {
+            case LOG_TYPE_TIME:
+            {
+                uint32_t seconds;
+                memcpy( &seconds, field, sizeof( seconds ) );
+                const time_t t = seconds;
+                struct tm tm;
+                gmtime_r( &t, &tm );
+                char timestamp[80];
+                snprintf( timestamp, sizeof( timestamp ),
+                    "%02d/%02d/%04d %02d:%02d:%02d",
+                    tm.tm_mon + 1, tm.tm_mday, tm.tm_year + 1900,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec );
+                fprintf( out, column.format, timestamp );
+                break;
+            }
+
+            case LOG_TYPE_UINT32:
+            {
+                // The logger's formats use %ld, which is 32-bit on the
+                // device. Widen to long to match on 64-bit hosts.
+                uint32_t value;
+                memcpy( &value, field, sizeof( value ) );
+                fprintf( out, column.format, (long) value );
+                break;
+            }
+
+            case LOG_TYPE_INT32:
+            {
+                int32_t value;
+                memcpy( &value, field, sizeof( value ) );
+                fprintf( out, column.format, (long) value );
+                break;
+            }
+
+            case LOG_TYPE_FLOAT:
+            {
+                float value;
+                memcpy( &value, field, sizeof( value ) );
+                fprintf( out, column.format, (double) value );
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+    fputs( "\r\n", out );
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Main.
+//----------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+    bool listColumns = false;
+    const char* outPath = NULL;
+    const char* inPath = NULL;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[i], "-c" ) == 0 )
+            listColumns = true;
+        else if ( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc )
+            outPath = argv[++i];
+        else if ( argv[i][0] == '-' || inPath != NULL )
+            usage( );
+        else
+            inPath = argv[i];
+    }
+    if ( inPath == NULL )
+        usage( );
+
+    FILE* in = fopen( inPath, "rb" );
+    if ( in == NULL )
+    {
+        fprintf( stderr, "pltdecode: cannot open %s\n", inPath );
+        return 1;
+    }
+
+    //
+    // File header.
+    //
+    // Read the first sector to get the header size, then the rest of
+    // the header, and check its CRC.
+    std::vector<uint8_t> headerBytes( LOG_SECTOR_SIZE );
+    if ( fread( headerBytes.data( ), 1, LOG_SECTOR_SIZE, in ) != LOG_SECTOR_SIZE )
+    {
+        fprintf( stderr, "pltdecode: %s: too short for a data log\n", inPath );
+        return 1;
+    }
+
+    LogFileHeader header;
+    memcpy( &header, headerBytes.data( ), sizeof( header ) );
+    if ( header.magic != LOG_FILE_MAGIC )
+    {
+        fprintf( stderr, "pltdecode: %s: not a binary data log\n", inPath );
+        return 1;
+    }
+    if ( header.version > LOG_FORMAT_VERSION )
+    {
+        fprintf( stderr, "pltdecode: %s: unsupported format version %d\n",
+            inPath, header.version );
+        return 1;
+    }
+
+    const size_t headerSize = (size_t) header.numberOfSectors * LOG_SECTOR_SIZE;
+    if ( header.numberOfSectors == 0 ||
+         sizeof( LogFileHeader ) + header.numberOfColumns * sizeof( LogColumn ) +
+            sizeof( uint32_t ) > headerSize )
+    {
+        fprintf( stderr, "pltdecode: %s: bad file header\n", inPath );
+        return 1;
+    }
+
+    headerBytes.resize( headerSize );
+    if ( fread( headerBytes.data( ) + LOG_SECTOR_SIZE, 1,
+            headerSize - LOG_SECTOR_SIZE, in ) != headerSize - LOG_SECTOR_SIZE )
+    {
+        fprintf( stderr, "pltdecode: %s: truncated file header\n", inPath );
+        return 1;
+    }
+
+    uint32_t headerCrc;
+    memcpy( &headerCrc, headerBytes.data( ) + headerSize - sizeof( uint32_t ),
+        sizeof( headerCrc ) );
+    if ( headerCrc != Crc32::compute( headerBytes.data( ), headerSize - sizeof( uint32_t ) ) )
+    {
+        fprintf( stderr, "pltdecode: %s: file header CRC mismatch\n", inPath );
+        return 1;
+    }
+
+    std::vector<LogColumn> columns( header.numberOfColumns );
+    memcpy( columns.data( ), headerBytes.data( ) + sizeof( LogFileHeader ),
+        header.numberOfColumns * sizeof( LogColumn ) );
+    for ( size_t i = 0; i < columns.size( ); ++i )
+    {
+        LogColumn& column = columns[i];
+        column.name[LOG_COLUMN_NAME_SIZE - 1] = '\0';
+        column.units[LOG_COLUMN_UNITS_SIZE - 1] = '\0';
+        column.format[LOG_COLUMN_FORMAT_SIZE - 1] = '\0';
+        if ( column.offset + sizeof( uint32_t ) > header.recordSize )
+        {
+            fprintf( stderr, "pltdecode: %s: column %s is outside the record\n",
+                inPath, column.name );
+            return 1;
+        }
+    }
+
+    if ( listColumns )
+    {
+        char version[sizeof( header.firmwareVersion ) + 1];
+        memcpy( version, header.firmwareVersion, sizeof( header.firmwareVersion ) );
+        version[sizeof( header.firmwareVersion )] = '\0';
+        printf( "Firmware %s, format version %d, %d-byte records\n",
+            version, header.version, header.recordSize );
+        for ( size_t i = 0; i < columns.size( ); ++i )
+            printf( "  %-24s %-8s %-8s offset %d\n",
+                columns[i].name,
+                columns[i].units,
+                getTypeName( columns[i].type ),
+                columns[i].offset );
+        return 0;
+    }
+
+    //
+    // Data blocks.
+    //
+    FILE* out = stdout;
+    if ( outPath != NULL && (out = fopen( outPath, "wb" )) == NULL )
+    {
+        fprintf( stderr, "pltdecode: cannot create %s\n", outPath );
+        return 1;
+    }
+
+    for ( size_t i = 0; i < columns.size( ); ++i )
+        fprintf( out, "%s\"%s\"", (i == 0) ? "" : ",", columns[i].name );
+    fputs( "\r\n", out );
+
+    const size_t recordsPerBlock = LOG_BLOCK_DATA_SIZE / header.recordSize;
+    uint8_t block[LOG_SECTOR_SIZE];
+    uint32_t expectedSequence = 0;
+    uint32_t numberOfRecords = 0;
+    uint32_t numberOfBadBlocks = 0;
+    uint32_t numberOfMissingBlocks = 0;
+
+    while ( fread( block, 1, LOG_SECTOR_SIZE, in ) == LOG_SECTOR_SIZE )
+    {
+        LogBlockHeader blockHeader;
+        memcpy( &blockHeader, block, sizeof( blockHeader ) );
+
+        // A sector that isn't one of this file's blocks marks the end of
+        // the data.
+        if ( blockHeader.magic != LOG_BLOCK_MAGIC ||
+             blockHeader.fileId != header.fileId )
+            break;
+
+        uint32_t crc;
+        memcpy( &crc, block + LOG_SECTOR_SIZE - sizeof( uint32_t ), sizeof( crc ) );
+        if ( crc != Crc32::compute( block, LOG_SECTOR_SIZE - sizeof( uint32_t ) ) ||
+             blockHeader.recordSize != header.recordSize ||
+             blockHeader.numberOfRecords > recordsPerBlock )
+        {
+            fprintf( stderr, "pltdecode: %s: block %u is corrupt; skipped\n",
+                inPath, expectedSequence );
+            ++numberOfBadBlocks;
+            ++expectedSequence;
+            continue;
+        }
+
+        if ( blockHeader.sequence != expectedSequence )
+        {
+            fprintf( stderr, "pltdecode: %s: expected block %u, found %u\n",
+                inPath, expectedSequence, blockHeader.sequence );
+            if ( blockHeader.sequence > expectedSequence )
+                numberOfMissingBlocks += blockHeader.sequence - expectedSequence;
+        }
+        expectedSequence = blockHeader.sequence + 1;
+
+        for ( uint16_t i = 0; i < blockHeader.numberOfRecords; ++i )
+            printRecord( out,
+                columns,
+                block + sizeof( LogBlockHeader ) + i * header.recordSize );
+        numberOfRecords += blockHeader.numberOfRecords;
+    }
+
+    fclose( in );
+    if ( out != stdout )
+        fclose( out );
+
+    fprintf( stderr, "pltdecode: %s: %u records", inPath, numberOfRecords );
+    if ( numberOfBadBlocks != 0 || numberOfMissingBlocks != 0 )
+        fprintf( stderr, ", %u corrupt and %u missing blocks",
+            numberOfBadBlocks, numberOfMissingBlocks );
+    fputs( "\n", stderr );
+    return (numberOfBadBlocks != 0 || numberOfMissingBlocks != 0) ? 2 : 0;
+}
@@ -0,0 +1,507 @@
+//----------------------------------------------------------------------
+// pltget
+//
+// Downloads a file from the logger's SD card over its USB serial port,
+// using the logger's "get" command. The file is sent as binary frames,
+// each with a CRC, and bad or missing frames are sent again. An
+// interrupted download can be resumed from where it stopped. At the end,
+// the whole local file is checked against the logger's CRC of the file.
+//
+// Usage:
+//   pltget [-r] [-o output] PORT PATH
+//
+//   -r   Resume a download, starting after the bytes already in the
+//        output file.
+//   -o   Write to the given file instead of the last part of PATH.
+//
+// PORT is the logger's serial device, such as /dev/ttyACM0 on Linux or
+// /dev/cu.usbmodem14101 on macOS. PATH is the file on the SD card, such
+// as DATA_050.CSV. The logger must not be running.
+//
+// The frame protocol is described in ../Code/SerialFrames.h.
+//----------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../Code/Crc32.h"
+#include "../Code/SerialFrames.h"
+
+
+// Set by the interrupt signal handler to stop the download.
+static volatile sig_atomic_t interrupted = 0;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Utilities.
+//----------------------------------------------------------------------
+/**
+ * Prints a usage message and exits.
+ */
+static void usage( )
+{
+    fprintf( stderr, "Usage: pltget [-r] [-o output] PORT PATH\n" );
+    exit( 1 );
+}
+
+/**
+ * Notes an interrupt signal, so the download can be aborted cleanly.
+ *
+ * @param[in] signal
+ *   The signal number.
+ */
+static void onInterrupt( int signal )
+{
+    (void) signal;
+    interrupted = 1;
+}
+
+/**
+ * Returns the time in ms from an arbitrary start.
+ *
+ * @return
+ *   Returns the time.
+ */
+static uint64_t getMillis( )
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/**
+ * Opens and configures a serial port for raw binary transfers.
+ *
+ * @param[in] path
+ *   The serial device path.
+ *
+ * @return
+ *   Returns the file descriptor, or -1 on failure.
+ */
+static int openPort( const char*const path )
+{
+    const int fd = open( path, O_RDWR | O_NOCTTY );
+    if ( fd < 0 )
+        return -1;
+
+    // The logger's port is USB, so the baud rate is ignored, but it is
+    // set to the usual rate anyway for USB-to-serial adapters.
+    struct termios tio;
+    if ( tcgetattr( fd, &tio ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    cfmakeraw( &tio );
+    cfsetispeed( &tio, B115200 );
+    cfsetospeed( &tio, B115200 );
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN]  = 0;
+    tio.c_cc[VTIME] = 0;
+    if ( tcsetattr( fd, TCSANOW, &tio ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    tcflush( fd, TCIOFLUSH );
+    return fd;
+}
+
+/**
+ * Writes all bytes to a file descriptor.
+ *
+ * @param[in] fd
+ *   The file descriptor.
+ * @param[in] data
+ *   The bytes.
+ * @param[in] nBytes
+ *   The number of bytes.
+ *
+ * @return
+ *   Returns true on success.
+ */
+static bool writeAll( const int fd, const void*const data, const size_t nBytes )
+{
+    const uint8_t* bytes = (const uint8_t*) data;
+    size_t n = 0;
+    while ( n < nBytes )
+    {
+        const ssize_t written = write( fd, bytes + n, nBytes - n );
+        if ( written < 0 && errno != EINTR && errno != EAGAIN )
+            return false;
+        if ( written > 0 )
+            n += written;
+    }
+    return true;
+}
+
+/**
+ * Sends a host frame, which has no payload, to the logger.
+ *
+ * @param[in] fd
+ *   The serial port.
+ * @param[in] type
+ *   The FRAME_* frame type.
+ * @param[in] sequence
+ *   The sequence number of the next chunk needed.
+ *
+ * @return
+ *   Returns true on success.
+ */
+static bool sendFrame( const int fd, const uint8_t type, const uint32_t sequence )
+{
+    uint8_t frame[sizeof( FrameHeader ) + sizeof( uint32_t )];
+    FrameHeader header;
+    header.magic    = FRAME_MAGIC;
+    header.type     = type;
+    header.reserved = 0;
+    header.sequence = sequence;
+    header.offset   = 0;
+    header.length   = 0;
+    const uint32_t crc = Crc32::compute( &header, sizeof( header ) );
+    memcpy( frame, &header, sizeof( header ) );
+    memcpy( frame + sizeof( header ), &crc, sizeof( crc ) );
+    return writeAll( fd, frame, sizeof( frame ) );
+}
+
+/**
+ * Extracts the next good frame from the bytes received so far.
+ *
+ * Bytes before the frame, such as the echo of the "get" command, and
+ * frames with bad CRCs are dropped.
+ *
+ * @param[in,out] input
+ *   The bytes received so far. The frame and anything before it are
+ *   removed.
+ * @param[out] header
+ *   The frame's header.
+ * @param[out] payload
+ *   The frame's payload.
+ *
+ * @return
+ *   Returns true if a frame was extracted, and false if more bytes are
+ *   needed.
+ */
+static bool extractFrame(
+    std::vector<uint8_t>& input,
+    FrameHeader& header,
+    std::vector<uint8_t>& payload )
+{
+    size_t start = 0;
+    bool found = false;
+    while ( start + sizeof( header ) <= input.size( ) )
+    {
+        memcpy( &header, input.data( ) + start, sizeof( header ) );
+        if ( header.magic != FRAME_MAGIC || header.length > FRAME_CHUNK_SIZE )
+        {
+            ++start;
+            continue;
+        }
+
+        const size_t frameSize = sizeof( header ) + header.length + sizeof( uint32_t );
+        if ( start + frameSize > input.size( ) )
+            break;      // Wait for the rest.
+
+        uint32_t crc;
+        memcpy( &crc, input.data( ) + start + frameSize - sizeof( crc ), sizeof( crc ) );
+        if ( crc != Crc32::compute( input.data( ) + start, frameSize - sizeof( crc ) ) )
+        {
+            ++start;
+            continue;
+        }
+
+        payload.assign( input.begin( ) + start + sizeof( header ),
+            input.begin( ) + start + sizeof( header ) + header.length );
+        start += frameSize;
+        found = true;
+        break;
+    }
+
+    // Drop everything before the frame, or before a partial frame.
+    input.erase( input.begin( ), input.begin( ) + start );
+    return found;
+}
+
+/**
+ * Computes the CRC-32 of a whole file.
+ *
+ * @param[in] file
+ *   The file.
+ * @param[out] nBytes
+ *   The file size.
+ *
+ * @return
+ *   Returns the CRC.
+ */
+static uint32_t computeFileCrc( FILE* file, uint64_t& nBytes )
+{
+    uint8_t buffer[8192];
+    uint32_t crc = 0;
+    size_t n;
+    nBytes = 0;
+    fseek( file, 0, SEEK_SET );
+    while ( (n = fread( buffer, 1, sizeof( buffer ), file )) > 0 )
+    {
+        crc = Crc32::compute( buffer, n, crc );
+        nBytes += n;
+    }
+    return crc;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Main.
+//----------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+    bool resume = false;
+    const char* outPath = NULL;
+    const char* portPath = NULL;
+    const char* path = NULL;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[i], "-r" ) == 0 )
+            resume = true;
+        else if ( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc )
+            outPath = argv[++i];
+        else if ( argv[i][0] == '-' || path != NULL )
+            usage( );
+        else if ( portPath == NULL )
+            portPath = argv[i];
+        else
+            path = argv[i];
+    }
+    if ( path == NULL || strchr( path, ' ' ) != NULL )
+        usage( );
+    if ( outPath == NULL )
+    {
+        const char* slash = strrchr( path, '/' );
+        outPath = (slash != NULL) ? slash + 1 : path;
+        if ( *outPath == '\0' )
+            usage( );
+    }
+
+    //
+    // Output file.
+    //
+    // On a resume, keep the bytes already there and ask for the rest.
+    FILE* out = fopen( outPath, resume ? "r+b" : "w+b" );
+    if ( out == NULL && resume )
+        out = fopen( outPath, "w+b" );
+    if ( out == NULL )
+    {
+        fprintf( stderr, "pltget: cannot create %s\n", outPath );
+        return 1;
+    }
+    uint32_t offset = 0;
+    if ( resume )
+    {
+        fseek( out, 0, SEEK_END );
+        offset = (uint32_t) ftell( out );
+    }
+
+    //
+    // Serial port.
+    //
+    const int fd = openPort( portPath );
+    if ( fd < 0 )
+    {
+        fprintf( stderr, "pltget: cannot open %s: %s\n", portPath, strerror( errno ) );
+        return 1;
+    }
+    signal( SIGINT, onInterrupt );
+    signal( SIGTERM, onInterrupt );
+
+    // Start at a fresh command line, then ask for the file.
+    char command[300];
+    snprintf( command, sizeof( command ), "\rget %s %u\r", path, offset );
+    if ( !writeAll( fd, command, strlen( command ) ) )
+    {
+        fprintf( stderr, "pltget: cannot write to %s\n", portPath );
+        return 1;
+    }
+
+    //
+    // Frames.
+    //
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> payload;
+    bool started = false;
+    bool nakSent = false;
+    uint32_t fileSize = 0;
+    uint32_t startOffset = offset;
+    uint32_t expectedSequence = 0;
+    uint64_t receivedBytes = 0;
+    const uint64_t startTime = getMillis( );
+    uint64_t progressTime = 0;
+    uint64_t heardTime = startTime;
+    int result = -1;
+
+    while ( result < 0 )
+    {
+        if ( interrupted )
+        {
+            sendFrame( fd, FRAME_ABORT, expectedSequence );
+            fprintf( stderr, "\npltget: interrupted; resume with -r\n" );
+            result = 1;
+            break;
+        }
+
+        FrameHeader header;
+        if ( !extractFrame( input, header, payload ) )
+        {
+            if ( getMillis( ) - heardTime >= FRAME_IDLE_TIMEOUT )
+            {
+                fprintf( stderr, "\npltget: no response from the logger%s\n",
+                    started ? "; resume with -r" : "" );
+                result = 1;
+                break;
+            }
+
+            fd_set readSet;
+            FD_ZERO( &readSet );
+            FD_SET( fd, &readSet );
+            struct timeval timeout = { 0, 100000 };
+            if ( select( fd + 1, &readSet, NULL, NULL, &timeout ) > 0 )
+            {
+                uint8_t buffer[4096];
+                const ssize_t n = read( fd, buffer, sizeof( buffer ) );
+                if ( n > 0 )
+                {
+                    input.insert( input.end( ), buffer, buffer + n );
+                    heardTime = getMillis( );
+                }
+            }
+            continue;
+        }
+
+        switch ( header.type )
+        {
+            case FRAME_START:
+            {
+                FrameStart start;
+                if ( payload.size( ) != sizeof( start ) )
+                    break;
+                memcpy( &start, payload.data( ), sizeof( start ) );
+                fileSize    = start.fileSize;
+                startOffset = header.offset;
+                started     = true;
+
+                // The logger starts no later than the end of its file, so
+                // drop any local bytes past that.
+                fflush( out );
+                if ( ftruncate( fileno( out ), startOffset ) != 0 )
+                {
+                    fprintf( stderr, "pltget: cannot truncate %s\n", outPath );
+                    sendFrame( fd, FRAME_ABORT, 0 );
+                    result = 1;
+                }
+                break;
+            }
+
+            case FRAME_DATA:
+                if ( !started )
+                    break;
+                if ( header.sequence == expectedSequence )
+                {
+                    fseek( out, header.offset, SEEK_SET );
+                    if ( fwrite( payload.data( ), 1, payload.size( ), out ) != payload.size( ) )
+                    {
+                        fprintf( stderr, "\npltget: cannot write %s\n", outPath );
+                        sendFrame( fd, FRAME_ABORT, expectedSequence );
+                        result = 1;
+                        break;
+                    }
+                    ++expectedSequence;
+                    receivedBytes += payload.size( );
+                    nakSent = false;
+                    sendFrame( fd, FRAME_ACK, expectedSequence );
+                }
+                else if ( header.sequence > expectedSequence )
+                {
+                    // A chunk was lost or corrupted. Ask once for a resend
+                    // from it, and ignore the rest of the window meanwhile.
+                    if ( !nakSent )
+                        sendFrame( fd, FRAME_NAK, expectedSequence );
+                    nakSent = true;
+                }
+                else
+                {
+                    // A resent chunk we already have. Our ACK may have
+                    // been lost, so send it again.
+                    sendFrame( fd, FRAME_ACK, expectedSequence );
+                }
+
+                if ( getMillis( ) - progressTime >= 250 )
+                {
+                    progressTime = getMillis( );
+                    fprintf( stderr, "\rpltget: %s: %u of %u bytes",
+                        path, (uint32_t) (startOffset + receivedBytes), fileSize );
+                }
+                break;
+
+            case FRAME_END:
+            {
+                FrameEnd end;
+                if ( !started || payload.size( ) != sizeof( end ) )
+                    break;
+                memcpy( &end, payload.data( ), sizeof( end ) );
+                fflush( out );
+
+                uint64_t nBytes = 0;
+                const uint32_t crc = computeFileCrc( out, nBytes );
+                const double seconds = (getMillis( ) - startTime) / 1000.0;
+                fprintf( stderr, "\rpltget: %s: %u of %u bytes", path,
+                    (uint32_t) nBytes, end.fileSize );
+                if ( nBytes != end.fileSize || crc != end.fileCrc )
+                {
+                    fprintf( stderr, "\npltget: %s: CRC mismatch; download again without -r\n",
+                        outPath );
+                    result = 2;
+                }
+                else
+                {
+                    fprintf( stderr, ", %.1f KB/s, CRC %08x OK\n",
+                        (seconds > 0) ? receivedBytes / 1024.0 / seconds : 0.0, crc );
+                    result = 0;
+                }
+                break;
+            }
+
+            case FRAME_ERROR:
+            {
+                const std::string message( payload.begin( ), payload.end( ) );
+                fprintf( stderr, "%spltget: %s: %s\n",
+                    started ? "\n" : "", path, message.c_str( ) );
+                result = 1;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    fclose( out );
+    close( fd );
+    return result;
+}
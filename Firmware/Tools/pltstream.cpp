@@ -0,0 +1,338 @@
+//----------------------------------------------------------------------
+// pltstream
+//
+// Shows the logger's live telemetry during a cast. The tool turns on the
+// logger's telemetry stream with the "stream on" command, then prints
+// one line per data log record as it arrives: time, data log record
+// count, depth, temperatures, acceleration, and rotation. The stream is
+// turned off again on exit (press Control-C).
+//
+// Usage:
+//   pltstream [-o output.csv] PORT
+//
+//   -o   Also write the records to the given CSV file.
+//
+// PORT is the logger's serial device, such as /dev/ttyACM0 on Linux or
+// /dev/cu.usbmodem14101 on macOS.
+//
+// The logger drops telemetry records rather than hold up imaging when
+// the serial port is busy. Dropped records are counted from gaps in the
+// frame sequence numbers and reported on exit.
+//
+// The frame format is described in ../Code/SerialFrames.h.
+//----------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "../Code/Crc32.h"
+#include "../Code/SerialFrames.h"
+
+
+// Set by the interrupt signal handler to stop streaming.
+static volatile sig_atomic_t interrupted = 0;
+
+
+
+
+
+//----------------------------------------------------------------------
+// Utilities.
+//----------------------------------------------------------------------
+/**
+ * Prints a usage message and exits.
+ */
+static void usage( )
+{
+    fprintf( stderr, "Usage: pltstream [-o output.csv] PORT\n" );
+    exit( 1 );
+}
+
+/**
+ * Notes an interrupt signal, so streaming can be turned off cleanly.
+ *
+ * @param[in] signal
+ *   The signal number.
+ */
+static void onInterrupt( int signal )
+{
+    (void) signal;
+    interrupted = 1;
+}
+
+/**
+ * Opens and configures a serial port for raw binary input.
+ *
+ * @param[in] path
+ *   The serial device path.
+ *
+ * @return
+ *   Returns the file descriptor, or -1 on failure.
+ */
+static int openPort( const char*const path )
+{
+    const int fd = open( path, O_RDWR | O_NOCTTY );
+    if ( fd < 0 )
+        return -1;
+
+    struct termios tio;
+    if ( tcgetattr( fd, &tio ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    cfmakeraw( &tio );
+    cfsetispeed( &tio, B115200 );
+    cfsetospeed( &tio, B115200 );
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN]  = 0;
+    tio.c_cc[VTIME] = 0;
+    if ( tcsetattr( fd, TCSANOW, &tio ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    tcflush( fd, TCIOFLUSH );
+    return fd;
+}
+
+/**
+ * Sends a command line to the logger.
+ *
+ * @param[in] fd
+ *   The serial port.
+ * @param[in] command
+ *   The command, without a line ending.
+ *
+ * @return
+ *   Returns true on success.
+ */
+static bool sendCommand( const int fd, const char*const command )
+{
+    char line[100];
+    snprintf( line, sizeof( line ), "\r%s\r", command );
+    const size_t nBytes = strlen( line );
+    return write( fd, line, nBytes ) == (ssize_t) nBytes;
+}
+
+/**
+ * Extracts the next good frame from the bytes received so far.
+ *
+ * Bytes between frames, such as the logger's text output, and frames
+ * with bad CRCs are dropped.
+ *
+ * @param[in,out] input
+ *   The bytes received so far. The frame and anything before it are
+ *   removed.
+ * @param[out] header
+ *   The frame's header.
+ * @param[out] payload
+ *   The frame's payload.
+ *
+ * @return
+ *   Returns true if a frame was extracted, and false if more bytes are
+ *   needed.
+ */
+static bool extractFrame(
+    std::vector<uint8_t>& input,
+    FrameHeader& header,
+    std::vector<uint8_t>& payload )
+{
+    size_t start = 0;
+    bool found = false;
+    while ( start + sizeof( header ) <= input.size( ) )
+    {
+        memcpy( &header, input.data( ) + start, sizeof( header ) );
+        if ( header.magic != FRAME_MAGIC || header.length > FRAME_CHUNK_SIZE )
+        {
+            ++start;
+            continue;
+        }
+
+        const size_t frameSize = sizeof( header ) + header.length + sizeof( uint32_t );
+        if ( start + frameSize > input.size( ) )
+            break;      // Wait for the rest.
+
+        uint32_t crc;
+        memcpy( &crc, input.data( ) + start + frameSize - sizeof( crc ), sizeof( crc ) );
+        if ( crc != Crc32::compute( input.data( ) + start, frameSize - sizeof( crc ) ) )
+        {
+            ++start;
+            continue;
+        }
+
+        payload.assign( input.begin( ) + start + sizeof( header ),
+            input.begin( ) + start + sizeof( header ) + header.length );
+        start += frameSize;
+        found = true;
+        break;
+    }
+
+    // Drop everything before the frame, or before a partial frame.
+    input.erase( input.begin( ), input.begin( ) + start );
+    return found;
+}
+
+/**
+ * Formats a telemetry timestamp as the logger's "MM/DD/YYYY hh:mm:ss.mmm".
+ *
+ * @param[in] record
+ *   The telemetry record.
+ * @param[out] timestamp
+ *   The formatted time.
+ * @param[in] size
+ *   The size of the timestamp buffer.
+ */
+static void formatTime(
+    const TelemetryRecord& record,
+    char*const timestamp,
+    const size_t size )
+{
+    const time_t t = record.seconds;
+    struct tm tm;
+    gmtime_r( &t, &tm );
+    snprintf( timestamp, size, "%02d/%02d/%04d %02d:%02d:%02d.%03u",
+        tm.tm_mon + 1, tm.tm_mday, tm.tm_year + 1900,
+        tm.tm_hour, tm.tm_min, tm.tm_sec, record.milliseconds );
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// Main.
+//----------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+    const char* outPath = NULL;
+    const char* portPath = NULL;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc )
+            outPath = argv[++i];
+        else if ( argv[i][0] == '-' || portPath != NULL )
+            usage( );
+        else
+            portPath = argv[i];
+    }
+    if ( portPath == NULL )
+        usage( );
+
+    FILE* out = NULL;
+    if ( outPath != NULL )
+    {
+        if ( (out = fopen( outPath, "wb" )) == NULL )
+        {
+            fprintf( stderr, "pltstream: cannot create %s\n", outPath );
+            return 1;
+        }
+        fputs( "\"Time\",\"Frame\",\"Depth\",\"Water_Temperature\",\"Device_Temperature\","
+            "\"Acceleration_X\",\"Acceleration_Y\",\"Acceleration_Z\","
+            "\"Gyroscope_X\",\"Gyroscope_Y\",\"Gyroscope_Z\"\r\n", out );
+    }
+
+    const int fd = openPort( portPath );
+    if ( fd < 0 )
+    {
+        fprintf( stderr, "pltstream: cannot open %s: %s\n", portPath, strerror( errno ) );
+        return 1;
+    }
+    signal( SIGINT, onInterrupt );
+    signal( SIGTERM, onInterrupt );
+
+    if ( !sendCommand( fd, "stream on" ) )
+    {
+        fprintf( stderr, "pltstream: cannot write to %s\n", portPath );
+        return 1;
+    }
+    printf( "%-23s %7s %8s %7s %7s %22s %22s\n",
+        "Time", "Frame", "Depth", "Water", "Device",
+        "Accel (m/s^2)", "Gyro (rad/s)" );
+
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> payload;
+    bool first = true;
+    uint32_t nextSequence = 0;
+    uint32_t numberOfRecords = 0;
+    uint32_t numberOfDropped = 0;
+
+    while ( !interrupted )
+    {
+        FrameHeader header;
+        if ( !extractFrame( input, header, payload ) )
+        {
+            fd_set readSet;
+            FD_ZERO( &readSet );
+            FD_SET( fd, &readSet );
+            struct timeval timeout = { 0, 100000 };
+            if ( select( fd + 1, &readSet, NULL, NULL, &timeout ) > 0 )
+            {
+                uint8_t buffer[4096];
+                const ssize_t n = read( fd, buffer, sizeof( buffer ) );
+                if ( n > 0 )
+                    input.insert( input.end( ), buffer, buffer + n );
+                else if ( n == 0 || errno != EINTR )
+                {
+                    fprintf( stderr, "pltstream: %s closed\n", portPath );
+                    break;
+                }
+            }
+            continue;
+        }
+
+        TelemetryRecord record;
+        if ( header.type != FRAME_TELEMETRY || payload.size( ) != sizeof( record ) )
+            continue;
+        memcpy( &record, payload.data( ), sizeof( record ) );
+
+        // The sequence restarts when the stream is turned on again.
+        if ( !first && header.sequence > nextSequence )
+            numberOfDropped += header.sequence - nextSequence;
+        nextSequence = header.sequence + 1;
+        first = false;
+        ++numberOfRecords;
+
+        char timestamp[80];
+        formatTime( record, timestamp, sizeof( timestamp ) );
+        const double accel[3] = {
+            record.accel[0] / 100.0, record.accel[1] / 100.0, record.accel[2] / 100.0 };
+        const double gyro[3] = {
+            record.gyro[0] / 1000.0, record.gyro[1] / 1000.0, record.gyro[2] / 1000.0 };
+
+        printf( "%-23s %7u %7.2fm %6.2fC %6.2fC %7.2f%7.2f%7.2f  %7.3f%7.3f%7.3f\n",
+            timestamp, record.frame, record.depth,
+            record.waterTemperature, record.deviceTemperature,
+            accel[0], accel[1], accel[2], gyro[0], gyro[1], gyro[2] );
+        fflush( stdout );
+
+        if ( out != NULL )
+        {
+            fprintf( out, "%s,%u,%f,%f,%f,%f,%f,%f,%f,%f,%f\r\n",
+                timestamp, record.frame, record.depth,
+                record.waterTemperature, record.deviceTemperature,
+                accel[0], accel[1], accel[2], gyro[0], gyro[1], gyro[2] );
+            fflush( out );
+        }
+    }
+
+    sendCommand( fd, "stream off" );
+    close( fd );
+    if ( out != NULL )
+        fclose( out );
+
+    fprintf( stderr, "pltstream: %u records, %u dropped by the logger\n",
+        numberOfRecords, numberOfDropped );
+    return 0;
+}